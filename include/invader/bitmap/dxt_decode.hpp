@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__BITMAP__DXT_DECODE_HPP
+#define INVADER__BITMAP__DXT_DECODE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "../tag/hek/definition.hpp"
+
+namespace Invader::DXTDecode {
+    /**
+     * Decode a single 4x4 block into 32-bit A8R8G8B8 pixels
+     * @param block         input block; DXT1 blocks are 8 bytes and DXT3/DXT5 blocks are 16 bytes
+     * @param output        output pixels; all 4x4 pixels are written
+     * @param output_stride number of pixels between each row of the output
+     * @param format        DXT1, DXT3, or DXT5
+     */
+    void decode_block(const std::byte *block, std::uint32_t *output, std::size_t output_stride, HEK::BitmapDataFormat format);
+
+    /**
+     * Decode a region of DXT-compressed pixel data into 32-bit A8R8G8B8 pixels. Only the blocks that overlap the region are read.
+     * @param blocks        DXT blocks of the whole bitmap (or mipmap), row by row
+     * @param width         width of the bitmap in pixels
+     * @param height        height of the bitmap in pixels
+     * @param region_x      left edge of the region in pixels
+     * @param region_y      top edge of the region in pixels
+     * @param region_width  width of the region in pixels; this is clipped to the bitmap
+     * @param region_height height of the region in pixels; this is clipped to the bitmap
+     * @param output        output pixels; the top left pixel of the region is written to output[0]
+     * @param output_stride number of pixels between each row of the output
+     * @param format        DXT1, DXT3, or DXT5
+     */
+    void decode_dxt_region(const std::byte *blocks, std::size_t width, std::size_t height, std::size_t region_x, std::size_t region_y, std::size_t region_width, std::size_t region_height, std::uint32_t *output, std::size_t output_stride, HEK::BitmapDataFormat format);
+
+    /**
+     * Decode DXT-compressed pixel data into 32-bit A8R8G8B8 pixels
+     * @param blocks DXT blocks of the whole bitmap (or mipmap), row by row
+     * @param width  width of the bitmap in pixels
+     * @param height height of the bitmap in pixels
+     * @param output output pixels; this must be large enough to hold width * height pixels
+     * @param format DXT1, DXT3, or DXT5
+     */
+    void decode_dxt(const std::byte *blocks, std::size_t width, std::size_t height, std::uint32_t *output, HEK::BitmapDataFormat format);
+}
+
+#endif
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__BITMAP__DXT_ENCODE_HPP
+#define INVADER__BITMAP__DXT_ENCODE_HPP
+
+#include <cstddef>
+#include "../tag/hek/definition.hpp"
+#include "color_plate_pixel.hpp"
+#include "../thread/thread_pool.hpp"
+
+namespace Invader::DXTEncode {
+    enum DXTQuality {
+        /** Use the colors furthest apart along the block's principal axis as endpoints */
+        DXT_QUALITY_FAST,
+
+        /** Same as fast, but then refine the endpoints with least squares */
+        DXT_QUALITY_NORMAL,
+
+        /** Try every ordered clustering of the block's colors and keep the one with the least error */
+        DXT_QUALITY_HIGH
+    };
+
+    /**
+     * Encode a single 4x4 block
+     * @param block   16 pixels, row by row
+     * @param output  output block; DXT1 blocks are 8 bytes and DXT3/DXT5 blocks are 16 bytes
+     * @param format  DXT1, DXT3, or DXT5
+     * @param quality quality to use
+     * @param dither  dither the colors to 16-bit color before encoding
+     */
+    void encode_block(const ColorPlatePixel *block, std::byte *output, HEK::BitmapDataFormat format, DXTQuality quality, bool dither);
+
+    /**
+     * Encode pixel data into DXT blocks. The output is identical regardless of the number of threads used.
+     * @param pixels  pixel data; width and height must be multiples of 4
+     * @param width   width in pixels
+     * @param height  height in pixels
+     * @param output  output data; this must be large enough to hold every block
+     * @param format  DXT1, DXT3, or DXT5
+     * @param quality quality to use
+     * @param dither      dither the colors to 16-bit color before encoding
+     * @param thread_pool thread pool to encode rows of blocks on, or nullptr to encode them on the calling thread
+     */
+    void encode_dxt(const ColorPlatePixel *pixels, std::size_t width, std::size_t height, std::byte *output, HEK::BitmapDataFormat format, DXTQuality quality, bool dither, ThreadPool *thread_pool = nullptr);
+}
+
+#endif
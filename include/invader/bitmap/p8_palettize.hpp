@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__BITMAP__P8_PALETTIZE_HPP
+#define INVADER__BITMAP__P8_PALETTIZE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "color_plate_pixel.hpp"
+
+namespace Invader::P8Palettize {
+    /** Alpha below this is fully transparent, using one of the last two indices depending on blue */
+    static constexpr std::uint8_t TRANSPARENT_ALPHA = 0x2F;
+
+    /** First of the two transparent indices; the second one is used if blue is at least 0x80 */
+    static constexpr std::uint8_t TRANSPARENT_INDEX = 0xFE;
+
+    /**
+     * Convert pixels to p8 bump. This is the same as calling ColorPlatePixel::convert_to_p8 on each pixel.
+     * @param pixels pixels to convert
+     * @param output p8 indices to write; this must be able to hold count indices
+     * @param count  number of pixels
+     */
+    void palettize(const ColorPlatePixel *pixels, std::uint8_t *output, std::size_t count);
+
+    /**
+     * Convert a single bitmap or mipmap to p8 bump, diffusing the error of each pixel into its neighbors (Floyd-Steinberg)
+     * @param pixels       pixels to convert; the error is diffused into these, so they will be modified
+     * @param output       p8 indices to write; this must be able to hold width * height indices
+     * @param width        width in pixels
+     * @param height       height in pixels
+     * @param dither_alpha dither the alpha channel
+     * @param dither_red   dither the red channel
+     * @param dither_green dither the green channel
+     * @param dither_blue  dither the blue channel
+     */
+    void palettize_dithered(ColorPlatePixel *pixels, std::uint8_t *output, std::uint32_t width, std::uint32_t height, bool dither_alpha, bool dither_red, bool dither_green, bool dither_blue);
+}
+
+#endif
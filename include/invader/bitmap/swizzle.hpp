@@ -17,6 +17,17 @@ namespace Invader::Swizzle {
      * @output               (de)swizzled data
      */
     std::vector<std::byte> swizzle(const std::byte *data, std::size_t bits_per_pixel, std::size_t width, std::size_t height, bool deswizzle);
+
+    /**
+     * Swizzle the pixel data into a buffer. The width and height must be powers of two.
+     * @param data           raw pixel data
+     * @param output         output pixel data; this must be the same size as the input and must not overlap it
+     * @param bits_per_pixel number of bits per pixel (can be 8, 16, 32, 64)
+     * @param width          width in pixels
+     * @param height         height in pixels
+     * @param deswizzle      deswizzle instead of swizzle
+     */
+    void swizzle(const std::byte *data, std::byte *output, std::size_t bits_per_pixel, std::size_t width, std::size_t height, bool deswizzle);
 }
 
 #endif
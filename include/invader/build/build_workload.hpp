@@ -8,10 +8,13 @@
 #include <string>
 #include <filesystem>
 #include <chrono>
+#include <memory>
+#include <unordered_map>
 #include "../hek/map.hpp"
 #include "../resource/resource_map.hpp"
 #include "../tag/parser/parser.hpp"
 #include "../error_handler/error_handler.hpp"
+#include "../file/file.hpp"
 
 namespace Invader {
     class BuildWorkload : public ErrorHandler {
@@ -48,6 +51,8 @@ namespace Invader {
          * @param optimize_space         should dedupe structs
          * @param compress               Zstd-compress the resulting map file
          * @param hide_pedantic_warnings hide pedantic warnings
+         * @param jobs                   number of threads to use for reading and parsing tags
+         * @param tag_cache_directory    directory to store compiled tags in and reuse them from, if any
          */
         static std::vector<std::byte> compile_map (
             const char *scenario,
@@ -62,7 +67,9 @@ namespace Invader {
             const std::optional<std::string> &rename_scenario = std::nullopt,
             bool optimize_space = false,
             bool compress = false,
-            bool hide_pedantic_warnings = false
+            bool hide_pedantic_warnings = false,
+            std::size_t jobs = 1,
+            const std::optional<std::string> &tag_cache_directory = std::nullopt
         );
 
         /**
@@ -83,6 +90,14 @@ namespace Invader {
          */
         static BuildWorkload compile_single_tag(const std::byte *tag_data, std::size_t tag_data_size, const std::vector<std::string> &tags_directories = std::vector<std::string>(), bool recursion = false);
 
+        /**
+         * Find every tag a cache file built from the scenario would use without generating any tag data, raw data, or cache file
+         * @param scenario          scenario tag to use
+         * @param tags_directories  tags directories to use
+         * @return                  path (with Halo path separators) and class of each tag and the path to the file it was found at, in the order they were found
+         */
+        static std::vector<std::pair<File::TagFilePath, std::string>> resolve_map_dependencies(const char *scenario, const std::vector<std::string> &tags_directories);
+
         /** Denotes an individual tag dependency */
         struct BuildWorkloadDependency {
             /** Index of the depended tag */
@@ -166,13 +181,6 @@ namespace Invader {
             std::optional<std::size_t> resolve_pointer(const HEK::LittleEndian<HEK::Pointer64> *pointer_pointer) const noexcept {
                 return this->resolve_pointer(reinterpret_cast<const std::byte *>(pointer_pointer) - this->data.data());
             }
-
-            /**
-             * Get whether or not a struct can be safely deduped and replaced with this
-             * @param  other other struct to check
-             * @return       true if it can be
-             */
-            bool can_dedupe(const BuildWorkloadStruct &other) const noexcept;
         };
 
         /** Denotes an individual tag */
@@ -203,6 +211,9 @@ namespace Invader {
 
             /** Tag path offset of the tag */
             std::size_t path_offset;
+
+            /** Path to the tag file; only set when resolving dependencies */
+            std::optional<std::string> file_path;
         };
 
         /** Bitmaps resources */
@@ -270,8 +281,9 @@ namespace Invader {
          * @param tag_data_size size of the tag
          * @param tag_index     index of the tag
          * @param tag_class_int explicitly give a tag class
+         * @param parsed_tag    tag data that was already parsed from tag_data, if any
          */
-        void compile_tag_data_recursively(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, std::optional<TagClassInt> tag_class_int = std::nullopt);
+        void compile_tag_data_recursively(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, std::optional<TagClassInt> tag_class_int = std::nullopt, std::unique_ptr<Parser::ParserStruct> parsed_tag = nullptr);
         
         ~BuildWorkload() override = default;
 
@@ -306,6 +318,21 @@ namespace Invader {
         std::size_t raw_data_indices_offset;
         std::uint32_t tag_file_checksums = 0;
         RawDataHandling raw_data_handling = RawDataHandling::RAW_DATA_HANDLING_DEFAULT;
+        std::size_t jobs = 1;
+        std::unordered_map<std::string, std::vector<std::size_t>> tag_indices_by_path;
+        std::size_t indexed_tag_count = 0;
+        void index_tag(std::size_t tag_index);
+        void rename_tag(std::size_t tag_index, std::string new_path);
+        std::optional<std::size_t> find_tag(const std::string &tag_path, TagClassInt tag_class_int);
+        struct TagPrefetcher;
+        std::shared_ptr<TagPrefetcher> prefetcher;
+        std::optional<std::filesystem::path> tag_cache_directory;
+        std::vector<std::pair<std::string, TagClassInt>> *tag_cache_dependencies = nullptr;
+        std::string get_tag_cache_key(const std::byte *tag_data, std::size_t tag_data_size, TagClassInt tag_class_int) const;
+        bool load_cached_tag(const std::string &key, std::size_t tag_index);
+        void save_cached_tag(const std::string &key, std::size_t tag_index, const std::vector<std::pair<std::string, TagClassInt>> &dependencies, std::size_t first_struct, std::size_t first_raw_data);
+        bool dependencies_only = false;
+        void resolve_tag_dependencies(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, TagClassInt tag_class_int);
     };
 }
 
@@ -4,6 +4,7 @@
 #define INVADER__COMPRESS__COMPRESSION_HPP
 
 #include <vector>
+#include <cstddef>
 
 namespace Invader::Compression {
     /**
@@ -13,9 +14,10 @@ namespace Invader::Compression {
      * @param output            data output
      * @param output_size       output buffer size
      * @param compression_level compression level to use
+     * @param jobs              number of threads to compress with
      * @return                  actual size of the output
      */
-    std::size_t compress_map_data(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size, int compression_level = 19);
+    std::size_t compress_map_data(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size, int compression_level = 19, std::size_t jobs = 1);
 
     /**
      * Decompress the map data
@@ -23,26 +25,39 @@ namespace Invader::Compression {
      * @param data_size         size of the data
      * @param output            data output
      * @param output_size       output buffer size
+     * @param jobs              number of threads to decompress with
      * @return                  actual size of the output
      */
-    std::size_t decompress_map_data(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size);
+    std::size_t decompress_map_data(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size, std::size_t jobs = 1);
 
     /**
      * Compress the map data
      * @param data              data pointer
      * @param data_size         size of the data
      * @param compression_level compression level to use
+     * @param jobs              number of threads to compress with
      * @return                  vector of compressed data
      */
-    std::vector<std::byte> compress_map_data(const std::byte *data, std::size_t data_size, int compression_level = 19);
+    std::vector<std::byte> compress_map_data(const std::byte *data, std::size_t data_size, int compression_level = 19, std::size_t jobs = 1);
 
     /**
      * Decompress the map data
      * @param data              data pointer
      * @param data_size         size of the data
+     * @param jobs              number of threads to decompress with
      * @return                  vector of decompressed data
      */
-    std::vector<std::byte> decompress_map_data(const std::byte *data, std::size_t data_size);
+    std::vector<std::byte> decompress_map_data(const std::byte *data, std::size_t data_size, std::size_t jobs = 1);
+
+    /**
+     * Compress one file to another file without holding the whole map in memory. Only Xbox maps can be compressed this way.
+     * @param input             path to the uncompressed file
+     * @param output            path to the compressed file
+     * @param compression_level compression level to use
+     * @param jobs              number of threads to compress with
+     * @return                  size of output in bytes
+     */
+    std::size_t compress_map_file(const char *input, const char *output, int compression_level = 19, std::size_t jobs = 1);
 
     /**
      * Decompress one file to another file, using significantly less memory but also significantly more disk I/O
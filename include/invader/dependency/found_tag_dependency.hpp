@@ -3,7 +3,10 @@
 #ifndef INVADER__DEPENDENCY__FOUND_TAG_DEPENDENCY_HPP
 #define INVADER__DEPENDENCY__FOUND_TAG_DEPENDENCY_HPP
 
+#include <filesystem>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 #include "../hek/class_int.hpp"
 
@@ -14,7 +17,27 @@ namespace Invader {
         bool broken;
         std::string file_path;
 
-        static std::vector<FoundTagDependency> find_dependencies(const char *tag_path_to_find, Invader::TagClassInt tag_int_to_find, std::vector<std::string> tags, bool reverse, bool recursive, bool &success);
+        /**
+         * Find the dependencies of a tag, or the tags that depend on a tag if reverse is set
+         * @param tag_path_to_find   path of the tag
+         * @param tag_int_to_find    class of the tag
+         * @param tags               tags directories, ordered by precedence
+         * @param reverse            find tags that depend on the tag instead
+         * @param recursive          also find dependencies of dependencies (not supported with reverse)
+         * @param success            set to false if something went wrong
+         * @param reverse_index_path saved reverse dependency index to use and update if reverse is set
+         * @return                   found tags
+         */
+        static std::vector<FoundTagDependency> find_dependencies(const char *tag_path_to_find, Invader::TagClassInt tag_int_to_find, std::vector<std::string> tags, bool reverse, bool recursive, bool &success, const std::optional<std::filesystem::path> &reverse_index_path = std::nullopt);
+
+        /**
+         * Find the tags directly referenced by a tag file
+         * @param tag_data      tag file data
+         * @param tag_data_size size of the tag file
+         * @return              paths (with Halo separators) and classes of referenced tags
+         * @throws              InvalidTagDataException or OutOfBoundsException if the tag is invalid
+         */
+        static std::vector<std::pair<std::string, Invader::TagClassInt>> find_dependencies_in_tag_file(const std::byte *tag_data, std::size_t tag_data_size);
 
         FoundTagDependency(std::string path, Invader::TagClassInt class_int, bool broken, std::string file_path) : path(path), class_int(class_int), broken(broken), file_path(file_path) {}
     };
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__DEPENDENCY__REVERSE_DEPENDENCY_INDEX_HPP
+#define INVADER__DEPENDENCY__REVERSE_DEPENDENCY_INDEX_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../file/file.hpp"
+
+namespace Invader {
+    /**
+     * Index of which tags are referenced by each tag in a set of tags directories, used to quickly find what tags
+     * reference a given tag. The index can be saved to a file, and when it is loaded again, only tags that were changed
+     * since it was saved need to be read.
+     */
+    class ReverseDependencyIndex {
+    public:
+        struct IndexedTag {
+            /** Path (with Halo separators) and class of the tag */
+            File::TagFilePath tag;
+
+            /** Full filesystem path */
+            std::string file_path;
+
+            /** Modification time of the file when it was indexed */
+            std::int64_t modified_time = 0;
+
+            /** Size of the file when it was indexed */
+            std::uint64_t file_size = 0;
+
+            /** CRC32 of the file when it was indexed (0 if the file was not read) */
+            std::uint32_t crc32 = 0;
+
+            /** Tags this tag references */
+            std::vector<File::TagFilePath> dependencies;
+        };
+
+        /**
+         * Index the given tags directories. Only the highest priority copy of each tag is indexed.
+         * @param tags       tags directories, ordered by precedence
+         * @param index_path path to a previously saved index to update, if any
+         * @return           index
+         */
+        static ReverseDependencyIndex index_tags_directories(const std::vector<std::string> &tags, const std::optional<std::filesystem::path> &index_path = std::nullopt);
+
+        /**
+         * Find all tags that reference the given tag
+         * @param tag tag path (with Halo separators) and class
+         * @return    tags that reference the tag
+         */
+        std::vector<const IndexedTag *> find_references(const File::TagFilePath &tag) const;
+
+        /**
+         * Save the index
+         * @param index_path path to save to
+         * @return           true if successful
+         */
+        bool save(const std::filesystem::path &index_path) const;
+
+        /**
+         * Get all indexed tags
+         * @return indexed tags
+         */
+        const std::vector<IndexedTag> &get_tags() const noexcept {
+            return this->tags;
+        }
+
+        /**
+         * Get the number of tags that had to be read when indexing (as opposed to being reused from a saved index)
+         * @return number of tags read
+         */
+        std::size_t get_read_tag_count() const noexcept {
+            return this->read_tag_count;
+        }
+
+    private:
+        /** Indexed tags */
+        std::vector<IndexedTag> tags;
+
+        /** Indices of tags referencing each tag, keyed by joined tag path */
+        std::unordered_map<std::string, std::vector<std::size_t>> references;
+
+        /** Number of tags read when indexing */
+        std::size_t read_tag_count = 0;
+
+        /**
+         * Load a saved index, returning the saved tags by file path
+         * @param index_path path to the saved index
+         * @return           saved tags, or an empty map if the index could not be loaded
+         */
+        static std::unordered_map<std::string, IndexedTag> load(const std::filesystem::path &index_path);
+
+        ReverseDependencyIndex() = default;
+    };
+}
+
+#endif
@@ -30,15 +30,28 @@ namespace Invader {
          * @param overwrite       overwrite tag files that exist
          * @param non_mp_globals  allow extraction of non-multiplayer globals
          * @param reporting_level reporting level to use
+         * @param jobs            number of threads to extract tags with
          */
-        static void extract_map(const Map &map, const std::string &tags, const std::vector<std::string> &queries, bool recursive = false, bool overwrite = false, bool non_mp_globals = false, ReportingLevel reporting_level = ReportingLevel::REPORTING_LEVEL_ALL);
+        static void extract_map(const Map &map, const std::string &tags, const std::vector<std::string> &queries, bool recursive = false, bool overwrite = false, bool non_mp_globals = false, ReportingLevel reporting_level = ReportingLevel::REPORTING_LEVEL_ALL, std::size_t jobs = 1);
         
     private:
+        struct ExtractedTag;
+
         /**
          * Extract a tag from the map
          * @param tag tag to extract
          */
         std::optional<std::unique_ptr<Parser::ParserStruct>> extract_tag(std::size_t tag_index);
+
+        /**
+         * Extract a tag from the map into a tag file without writing it. This is safe to call from multiple threads.
+         * @param tag_index      tag to extract
+         * @param recursive      also find the tag's dependencies
+         * @param overwrite      overwrite tag files that exist
+         * @param non_mp_globals allow extraction of non-multiplayer globals
+         * @return               extracted tag
+         */
+        ExtractedTag prepare_tag(std::size_t tag_index, bool recursive, bool overwrite, bool non_mp_globals) const;
         
         /**
          * Perform the extraction
@@ -47,9 +60,10 @@ namespace Invader {
          * @param recursive      also extract tags depended by a tag
          * @param overwrite      overwrite tag files that exist
          * @param non_mp_globals allow extraction of non-multiplayer globals
+         * @param jobs           number of threads to extract tags with
          * @return               number of tags successfully extracted
          */
-        std::size_t perform_extraction(const std::vector<std::string> &queries, const std::filesystem::path &tags, bool recursive, bool overwrite, bool non_mp_globals);
+        std::size_t perform_extraction(const std::vector<std::string> &queries, const std::filesystem::path &tags, bool recursive, bool overwrite, bool non_mp_globals, std::size_t jobs);
         
         /** Map reference */
         const Map &map;
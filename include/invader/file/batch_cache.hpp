@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__BATCH_CACHE_HPP
+#define INVADER__FILE__BATCH_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Invader::File {
+    /**
+     * Remembers the source files and settings each tag was last made with, so tags that would come out the same can be
+     * skipped. This can be saved to a file between runs, and it is safe to use from multiple threads.
+     */
+    class BatchCache {
+    public:
+        /**
+         * Check if the tag was made from the same source files with the same settings and hasn't been changed since
+         * @param tag          tag path
+         * @param source_paths paths to the source files
+         * @param tag_path     path to the tag file
+         * @param settings     settings the tag would be made with
+         * @return             true if the tag does not need to be made again
+         */
+        bool is_unchanged(const std::string &tag, const std::vector<std::filesystem::path> &source_paths, const std::filesystem::path &tag_path, const std::string &settings) const;
+
+        /**
+         * Remember that the tag was made. This should be called after the tag is saved.
+         * @param tag          tag path
+         * @param source_paths paths to the source files
+         * @param tag_path     path to the tag file
+         * @param settings     settings the tag was made with
+         */
+        void update(const std::string &tag, const std::vector<std::filesystem::path> &source_paths, const std::filesystem::path &tag_path, const std::string &settings);
+
+        /**
+         * Save the cache, warning if it couldn't be saved
+         * @param cache_path path to save to
+         * @return           true if successful
+         */
+        bool save(const std::filesystem::path &cache_path) const;
+
+        /**
+         * Load a saved cache. If it doesn't exist or is from a different version of Invader, the cache starts out empty.
+         * @param cache_path path to the saved cache
+         */
+        BatchCache(const std::filesystem::path &cache_path);
+
+    private:
+        struct CachedFile {
+            /** Full filesystem path */
+            std::string path;
+
+            /** Modification time of the file */
+            std::int64_t modified_time = 0;
+
+            /** Size of the file */
+            std::uint64_t file_size = 0;
+
+            /** CRC32 of the file */
+            std::uint32_t crc32 = 0;
+        };
+
+        struct CachedTag {
+            /** Source files the tag was made from */
+            std::vector<CachedFile> sources;
+
+            /** Tag file that was saved */
+            CachedFile tag;
+
+            /** Settings the tag was made with */
+            std::string settings;
+        };
+
+        /** Cached tags, keyed by tag path */
+        std::unordered_map<std::string, CachedTag> tags;
+
+        /** Locked when accessing tags */
+        mutable std::mutex mutex;
+
+        /**
+         * Get the size, modification time, and CRC32 of a file
+         * @param path path to the file
+         * @return     file info, or std::nullopt if it could not be read
+         */
+        static std::optional<CachedFile> read_file_info(const std::filesystem::path &path);
+
+        /**
+         * Check if a file matches what was cached. The file is only read if its modification time changed.
+         * @param cached cached file info
+         * @param path   path to the file
+         * @return       true if unchanged
+         */
+        static bool file_is_unchanged(const CachedFile &cached, const std::filesystem::path &path);
+    };
+
+    /**
+     * Read a list of tag paths to make, one per line. Blank lines are skipped.
+     * @param path path to the list
+     * @return     tag paths, or std::nullopt if the list couldn't be read
+     */
+    std::optional<std::vector<std::string>> read_batch_list(const char *path);
+
+    /**
+     * Add a command line option to the settings a tag is made with so a BatchCache can tell when they change
+     * @param settings       settings to add to
+     * @param opt            option
+     * @param arguments      arguments given to the option
+     * @param ignored_opts   options that can't change the tag (such as directories and thread counts) and are left out
+     */
+    void record_batch_setting(std::string &settings, char opt, const std::vector<const char *> &arguments, const char *ignored_opts);
+
+    /**
+     * Print how many tags were made
+     * @param tag_type  type of tag being made, such as "bitmap"
+     * @param made      number of tags made
+     * @param total     number of tags that were to be made
+     * @param unchanged number of tags skipped for being unchanged, if a BatchCache was used
+     */
+    void print_batch_summary(const char *tag_type, std::size_t made, std::size_t total, std::optional<std::size_t> unchanged);
+}
+
+#endif
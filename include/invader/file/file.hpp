@@ -25,6 +25,50 @@ namespace Invader::File {
      */
     std::optional<std::vector<std::byte>> open_file(const char *path);
 
+    /**
+     * File mapped into memory. Pages are only read from disk when they are accessed, and writes to the mapping are
+     * private to this process and never written back to the file.
+     */
+    class MemoryMappedFile {
+    public:
+        /**
+         * Get the mapped data
+         * @return pointer to the data, or nullptr if the file is empty
+         */
+        std::byte *data() noexcept {
+            return this->file_data;
+        }
+
+        /**
+         * Get the size of the mapped data
+         * @return size in bytes
+         */
+        std::size_t size() const noexcept {
+            return this->file_size;
+        }
+
+        MemoryMappedFile(MemoryMappedFile &&move) noexcept;
+        MemoryMappedFile &operator=(MemoryMappedFile &&move) noexcept;
+        MemoryMappedFile(const MemoryMappedFile &) = delete;
+        MemoryMappedFile &operator=(const MemoryMappedFile &) = delete;
+        ~MemoryMappedFile();
+
+    private:
+        friend std::optional<MemoryMappedFile> map_file(const char *path);
+        MemoryMappedFile() = default;
+        void unmap() noexcept;
+
+        std::byte *file_data = nullptr;
+        std::size_t file_size = 0;
+    };
+
+    /**
+     * Attempt to map the file into memory
+     * @param path path to the file
+     * @return     the mapped file or std::nullopt if failed
+     */
+    std::optional<MemoryMappedFile> map_file(const char *path);
+
     /**
      * Attempt to save the file
      * @param  path path to the file
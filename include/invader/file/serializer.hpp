@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__SERIALIZER_HPP
+#define INVADER__FILE__SERIALIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Invader::File {
+    /**
+     * Writes data for Invader's own cache and index files. Integers are always written as 64-bit little endian, and
+     * byte arrays and strings are prefixed with their length.
+     */
+    class BinaryWriter {
+    public:
+        /**
+         * Write an integer
+         * @param value value to write
+         */
+        void write_int(std::uint64_t value);
+
+        /**
+         * Write bytes as-is without a length (e.g. a magic number)
+         * @param bytes bytes to write
+         * @param size  number of bytes
+         */
+        void write_raw(const void *bytes, std::size_t size);
+
+        /**
+         * Write bytes prefixed with their length
+         * @param bytes bytes to write
+         * @param size  number of bytes
+         */
+        void write_bytes(const void *bytes, std::size_t size);
+
+        /**
+         * Write a string prefixed with its length
+         * @param string string to write
+         */
+        void write_string(const std::string &string);
+
+        /** Data written so far */
+        std::vector<std::byte> data;
+    };
+
+    /**
+     * Reads data written by BinaryWriter. Reading past the end throws OutOfBoundsException.
+     */
+    class BinaryReader {
+    public:
+        /**
+         * Read an integer
+         * @return value read
+         */
+        std::uint64_t read_int();
+
+        /**
+         * Read bytes that were written without a length
+         * @param size number of bytes
+         * @return     pointer to the bytes
+         */
+        const std::byte *read_raw(std::size_t size);
+
+        /**
+         * Read bytes prefixed with their length
+         * @param size set to the number of bytes
+         * @return     pointer to the bytes
+         */
+        const std::byte *read_bytes(std::size_t &size);
+
+        /**
+         * Read a string prefixed with its length
+         * @return string read
+         */
+        std::string read_string();
+
+        /**
+         * Get whether everything has been read
+         * @return true if at the end
+         */
+        bool at_end() const noexcept {
+            return this->offset == this->size;
+        }
+
+        /**
+         * Read from the given data. The data must outlive the reader.
+         * @param data data to read
+         * @param size size of the data
+         */
+        BinaryReader(const std::byte *data, std::size_t size) noexcept : data(data), size(size) {}
+
+        /**
+         * Read from the given data. The data must outlive the reader.
+         * @param data data to read
+         */
+        BinaryReader(const std::vector<std::byte> &data) noexcept : BinaryReader(data.data(), data.size()) {}
+
+    private:
+        const std::byte *data;
+        std::size_t size;
+        std::size_t offset = 0;
+    };
+}
+
+#endif
@@ -8,9 +8,11 @@
 #include <cstddef>
 #include <memory>
 #include <optional>
+#include <unordered_map>
 
 #include "../resource/resource_map.hpp"
 #include "../hek/map.hpp"
+#include "../file/file.hpp"
 #include "tag.hpp"
 
 namespace Invader {
@@ -175,6 +177,23 @@ namespace Invader {
                                     std::byte *loc_data = nullptr, std::size_t loc_data_size = 0,
                                     std::byte *sounds_data = nullptr, std::size_t sounds_data_size = 0);
 
+        /**
+         * Create a Map by memory mapping the given map, bitmaps, loc, and sounds files. Only the parts of the files
+         * that are actually accessed are read from disk, and tag data points directly into the mappings. The files
+         * are never modified. Compressed maps can be loaded this way, but they will be decompressed into memory.
+         *
+         * @param path          path to the map file
+         * @param bitmaps_path  path to bitmaps.map (optional)
+         * @param loc_path      path to loc.map (optional)
+         * @param sounds_path   path to sounds.map (optional)
+         * @return              map
+         * @throws              FailedToOpenFileException if the map file could not be mapped
+         */
+        static Map map_with_mmap(const char *path,
+                                 const char *bitmaps_path = nullptr,
+                                 const char *loc_path = nullptr,
+                                 const char *sounds_path = nullptr);
+
         /**
          * Get the data at the specified offset
          * @param  offset       offset
@@ -275,7 +294,7 @@ namespace Invader {
         /**
          * Find the tag with the given path and class
          * @param tag_path      tag path to find
-         * @param tag_class_int tag class to find
+         * @param tag_class_int tag class to find; parent classes such as object or unit also match
          * @return              the index of the first tag found or std::nullopt if not found
          */
         std::optional<std::size_t> find_tag(const char *tag_path, TagClassInt tag_class_int) const noexcept;
@@ -306,6 +325,9 @@ namespace Invader {
 
         Map(Map &&);
     private:
+        /** Memory mapped files backing the map data, if any */
+        std::vector<File::MemoryMappedFile> mappings;
+
         /** Map data if managed */
         std::vector<std::byte> data_m;
 
@@ -359,6 +381,9 @@ namespace Invader {
         /** Tag array */
         std::vector<Tag> tags;
 
+        /** Tag indices and the classes they can be looked up as (primary, secondary, and tertiary), keyed by tag path */
+        std::unordered_map<std::string, std::vector<std::pair<TagClassInt, std::size_t>>> tag_indices_by_path;
+
         /** Scenario tag ID */
         std::size_t scenario_tag_id = 0;
 
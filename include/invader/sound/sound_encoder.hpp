@@ -6,9 +6,93 @@
 #include <cstddef>
 #include <vector>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include "../thread/thread_pool.hpp"
 
 namespace Invader::SoundEncoder {
+    enum XboxADPCMQuality {
+        /** Pick each sample's nibble without looking ahead */
+        XBOX_ADPCM_QUALITY_FAST,
+
+        /** Look ahead 3 samples when picking each nibble */
+        XBOX_ADPCM_QUALITY_NORMAL,
+
+        /** Look ahead 5 samples when picking each nibble */
+        XBOX_ADPCM_QUALITY_HIGH
+    };
+
+    /**
+     * Encoder that is given PCM data a piece at a time, so the whole sound does not need to be in memory at once
+     */
+    class StreamEncoder {
+    public:
+        /**
+         * Encode more PCM data
+         * @param pcm  pointer to the PCM data
+         * @param size size of the PCM data in bytes; this must be a whole number of frames
+         */
+        virtual void encode(const std::byte *pcm, std::size_t size) = 0;
+
+        /**
+         * Encode the rest of the data. Nothing can be encoded after this.
+         * @return encoded data
+         */
+        virtual std::vector<std::byte> finish() = 0;
+
+        virtual ~StreamEncoder() = default;
+    };
+
+    /**
+     * Create an encoder for Ogg Vorbis with a variable bitrate. This is lossy.
+     * @param bits_per_sample bits per sample of the PCM data
+     * @param channel_count   channel count
+     * @param sample_rate     sample rate
+     * @param vorbis_quality  vorbis quality (0.0 to 1.0)
+     * @return                encoder
+     */
+    std::unique_ptr<StreamEncoder> create_ogg_vorbis_vbr_encoder(std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, float vorbis_quality);
+
+    /**
+     * Create an encoder for Ogg Vorbis with a constant bitrate. This is lossy.
+     * @param bits_per_sample bits per sample of the PCM data
+     * @param channel_count   channel count
+     * @param sample_rate     sample rate
+     * @param vorbis_bitrate  vorbis bitrate (kilobits per second)
+     * @return                encoder
+     */
+    std::unique_ptr<StreamEncoder> create_ogg_vorbis_cbr_encoder(std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint16_t vorbis_bitrate);
+
+    /**
+     * Create an encoder for FLAC. This is lossless.
+     * @param bits_per_sample   bits per sample of the PCM data
+     * @param channel_count     channel count
+     * @param sample_rate       sample rate
+     * @param compression_level compression level to use (0 to 8)
+     * @return                  encoder
+     */
+    std::unique_ptr<StreamEncoder> create_flac_encoder(std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint32_t compression_level = 5);
+
+    /**
+     * Create an encoder for Xbox ADPCM. This is lossy. Samples that do not fill a whole block at the end are dropped.
+     *
+     * Blocks are encoded in fixed-size segments, each starting from a fresh encoder state, so the output is identical
+     * regardless of the number of threads used.
+     * @param bits_per_sample bits per sample of the PCM data
+     * @param channel_count   number of channels
+     * @param quality         quality to use
+     * @param thread_pool     thread pool to encode segments on, or nullptr to encode them on the calling thread
+     * @return                encoder
+     */
+    std::unique_ptr<StreamEncoder> create_xbox_adpcm_encoder(std::size_t bits_per_sample, std::size_t channel_count, XboxADPCMQuality quality = XboxADPCMQuality::XBOX_ADPCM_QUALITY_NORMAL, ThreadPool *thread_pool = nullptr);
+
+    /**
+     * Create an encoder for 16-bit big endian PCM. This is lossless unless the input data is greater than 16 bits.
+     * @param bits_per_sample bits per sample of the PCM data
+     * @return                encoder
+     */
+    std::unique_ptr<StreamEncoder> create_16_bit_pcm_big_endian_encoder(std::size_t bits_per_sample);
+
     /**
      * Encode the PCM data to Ogg Vorbis with a variable bitrate. This is lossy.
      * @param pcm             PCM data
@@ -57,9 +141,10 @@ namespace Invader::SoundEncoder {
      * @param pcm             PCM data
      * @param bits_per_sample bits per sample of the PCM data
      * @param channel_count   number of channels
+     * @param quality         quality to use
      * @return                Xbox ADPCM data
      */
-    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count);
+    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count, XboxADPCMQuality quality = XboxADPCMQuality::XBOX_ADPCM_QUALITY_NORMAL);
     
     /**
      * Calculate the PCM block size to use for encoding to ADPCM. Basically the number of samples must be a multiple of this.
@@ -85,6 +170,30 @@ namespace Invader::SoundEncoder {
      */
     std::vector<std::byte> convert_int_to_int(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t new_bits_per_sample);
 
+    /**
+     * Encode from one PCM size to another. This is lossless unless converting from higher to lower.
+     * @param pcm                 PCM data
+     * @param sample_count        number of samples
+     * @param bits_per_sample     bits per sample
+     * @param new_bits_per_sample new bits per sample
+     * @param output              output; must hold sample_count samples of new_bits_per_sample
+     */
+    void convert_int_to_int(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample, std::size_t new_bits_per_sample, std::byte *output) noexcept;
+
+    /**
+     * Convert PCM data to another bits per sample and channel count in one pass. Mono is converted to stereo by
+     * duplicating the channel, and stereo is mixed down to mono by averaging the channels. Otherwise, the channel counts
+     * must be the same.
+     * @param pcm                 PCM data
+     * @param frame_count         number of frames (one sample for each channel)
+     * @param bits_per_sample     bits per sample
+     * @param channel_count       channel count
+     * @param new_bits_per_sample new bits per sample
+     * @param new_channel_count   new channel count
+     * @param output              output; must hold frame_count frames of the new format
+     */
+    void convert_pcm(const std::byte *pcm, std::size_t frame_count, std::size_t bits_per_sample, std::size_t channel_count, std::size_t new_bits_per_sample, std::size_t new_channel_count, std::byte *output) noexcept;
+
     /**
      * Encode from one PCM size to another. This is lossless.
      * @param pcm             PCM data
@@ -93,6 +202,25 @@ namespace Invader::SoundEncoder {
      */
     std::vector<float> convert_int_to_float(const std::vector<std::byte> &pcm, std::size_t bits_per_sample);
 
+    /**
+     * Encode from one PCM size to another. This is lossless.
+     * @param pcm             PCM data
+     * @param sample_count    number of samples
+     * @param bits_per_sample bits per sample
+     * @param output          output; must hold sample_count floats
+     */
+    void convert_int_to_float(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample, float *output) noexcept;
+
+    /**
+     * Encode from one PCM size to another, splitting each channel into its own buffer. This is lossless.
+     * @param pcm             PCM data (interleaved)
+     * @param frame_count     number of frames (one sample for each channel)
+     * @param bits_per_sample bits per sample
+     * @param channel_count   channel count
+     * @param output          one output for each channel; each must hold frame_count floats
+     */
+    void convert_int_to_float_deinterleaved(const std::byte *pcm, std::size_t frame_count, std::size_t bits_per_sample, std::size_t channel_count, float *const *output) noexcept;
+
     /**
      * Encode from one PCM size to another. This is lossy unless the PCM data was originally integer PCM of the same bitness or smaller.
      * @param pcm                 PCM data
@@ -100,6 +228,24 @@ namespace Invader::SoundEncoder {
      */
     std::vector<std::byte> convert_float_to_int(const std::vector<float> &pcm, std::size_t new_bits_per_sample);
 
+    /**
+     * Encode from one PCM size to another. This is lossy unless the PCM data was originally integer PCM of the same bitness or smaller.
+     * @param pcm                 PCM data
+     * @param sample_count        number of samples
+     * @param new_bits_per_sample new bits per sample
+     * @param output              output; must hold sample_count samples of new_bits_per_sample
+     */
+    void convert_float_to_int(const float *pcm, std::size_t sample_count, std::size_t new_bits_per_sample, std::byte *output) noexcept;
+
+    /**
+     * Read samples as ints.
+     * @param pcm             PCM data
+     * @param sample_count    number of samples
+     * @param bits_per_sample number of bits per sample
+     * @param output          output; must hold sample_count ints
+     */
+    void unpack_samples(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample, std::int32_t *output) noexcept;
+
     /**
      * Read the little sample as an int.
      * @param  pcm             pointer to sample
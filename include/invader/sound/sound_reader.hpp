@@ -7,6 +7,7 @@
 #include <cstddef>
 #include <vector>
 #include <string>
+#include <memory>
 
 namespace Invader::SoundReader {
     struct Sound {
@@ -38,6 +39,89 @@ namespace Invader::SoundReader {
         void *internal;
     };
 
+    /**
+     * Sound that is read a piece at a time, so the whole sound does not need to be in memory at once
+     */
+    class SoundStream {
+    public:
+        /**
+         * Read PCM data, interleaved and in little endian
+         * @param pcm         where to read to; this must hold frame_count frames
+         * @param frame_count maximum number of frames (one sample for each channel) to read
+         * @return            number of frames read; this is less than frame_count only at the end of the sound
+         */
+        virtual std::size_t read(std::byte *pcm, std::size_t frame_count) = 0;
+
+        /**
+         * Get the sample rate
+         * @return sample rate
+         */
+        std::uint32_t get_sample_rate() const noexcept {
+            return this->sample_rate;
+        }
+
+        /**
+         * Get the channel count
+         * @return channel count
+         */
+        std::uint16_t get_channel_count() const noexcept {
+            return this->channel_count;
+        }
+
+        /**
+         * Get the number of bits per sample of the PCM data that is read
+         * @return bits per sample
+         */
+        std::uint32_t get_bits_per_sample() const noexcept {
+            return this->bits_per_sample;
+        }
+
+        /**
+         * Get the number of bits per sample of the input file
+         * @return bits per sample
+         */
+        std::uint32_t get_input_bits_per_sample() const noexcept {
+            return this->input_bits_per_sample;
+        }
+
+        virtual ~SoundStream() = default;
+
+    protected:
+        std::uint32_t sample_rate = 0;
+        std::uint16_t channel_count = 0;
+        std::uint32_t bits_per_sample = 0;
+        std::uint32_t input_bits_per_sample = 0;
+    };
+
+    /**
+     * Open a sound file to be read a piece at a time. WAV and FLAC files are read as needed, while other files are
+     * decoded all at once.
+     * @param  path path to the file
+     * @return      sound stream
+     */
+    std::unique_ptr<SoundStream> open_sound_stream(const char *path);
+
+    /**
+     * Open a WAV file to be read a piece at a time
+     * @param  path path to the file
+     * @return      sound stream
+     */
+    std::unique_ptr<SoundStream> open_wav_stream(const char *path);
+
+    /**
+     * Open a FLAC file to be read a piece at a time
+     * @param  path path to the file
+     * @return      sound stream
+     */
+    std::unique_ptr<SoundStream> open_flac_stream(const char *path);
+
+    /**
+     * Read a sound that was already decoded a piece at a time
+     * @param  sound sound to read
+     * @return       sound stream
+     */
+    std::unique_ptr<SoundStream> open_pcm_stream(Sound sound);
+
     /**
      * Get the sound from a WAV file
      * @param  path path to the file
@@ -13,6 +13,30 @@ namespace Invader::Parser {
      * @return          true if the flag was wrong, false if not
      */
     bool fix_missing_script_source_data(Scenario &scenario, bool fix);
+
+    /**
+     * Get the class of the tag a script node references by name, if it references one
+     * @param  type  value type of the node
+     * @param  flags flags of the node
+     * @return       class of the tag, or std::nullopt if the node doesn't reference a tag
+     */
+    std::optional<TagClassInt> script_node_tag_class(HEK::ScenarioScriptValueType type, HEK::ScenarioScriptNodeFlags flags) noexcept;
+
+    /**
+     * Call the function for every script node that references a tag by name
+     * @param nodes      script nodes
+     * @param node_count number of script nodes
+     * @param function   function to call with the node index, the node, and the class of the tag it references
+     */
+    template <typename Node, typename F> void for_each_script_tag_reference(Node *nodes, std::size_t node_count, const F &function) {
+        for(std::size_t i = 0; i < node_count; i++) {
+            auto &node = nodes[i];
+            auto tag_class = script_node_tag_class(node.type.read(), node.flags.read());
+            if(tag_class.has_value()) {
+                function(i, node, *tag_class);
+            }
+        }
+    }
 }
 
 #endif
@@ -776,6 +776,14 @@ namespace Invader::Parser {
          */
         static std::unique_ptr<ParserStruct> parse_hek_tag_file(const std::byte *data, std::size_t data_size, bool postprocess = false);
 
+        /**
+         * Find the dependencies in a HEK tag file without parsing the rest of the tag
+         * @param  data      Tag file data to read from
+         * @param  data_size Size of the tag file
+         * @return           dependencies with a path set, in the order they appear in the tag
+         */
+        static std::vector<Dependency> scan_hek_tag_file_dependencies(const std::byte *data, std::size_t data_size);
+
         /**
          * Generate a tag base struct
          * @param  tag_class tag class
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__THREAD__THREAD_POOL_HPP
+#define INVADER__THREAD__THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Invader {
+    /**
+     * Fixed number of threads that run tasks in the order they were submitted. Each task returns a future, so results
+     * (and exceptions) can be collected in whatever order they're needed.
+     *
+     * Tasks must not wait on other tasks submitted to the same pool, as every thread could end up waiting.
+     */
+    class ThreadPool {
+    public:
+        /**
+         * Submit a task to be run
+         * @param function function to run
+         * @return         future holding the return value of the function (or the exception it threw)
+         */
+        template<typename Function> auto submit(Function &&function) {
+            using Result = std::invoke_result_t<std::decay_t<Function>>;
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+            auto future = task->get_future();
+
+            // With no threads, just run it now
+            if(this->threads.empty()) {
+                (*task)();
+            }
+            else {
+                this->enqueue([task]() { (*task)(); });
+            }
+
+            return future;
+        }
+
+        /**
+         * Get the number of threads in the pool
+         * @return number of threads (0 if tasks are run when submitted)
+         */
+        std::size_t get_thread_count() const noexcept {
+            return this->threads.size();
+        }
+
+        /**
+         * Start the threads
+         * @param thread_count number of threads; if this is 0 or 1, tasks are instead run on the calling thread when submitted
+         */
+        ThreadPool(std::size_t thread_count);
+
+        /**
+         * Finish every task that was submitted and then stop the threads
+         */
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+    private:
+        /** Threads running tasks */
+        std::vector<std::thread> threads;
+
+        /** Tasks that haven't been started yet */
+        std::deque<std::function<void()>> tasks;
+
+        /** Locked when accessing tasks or stopping */
+        std::mutex mutex;
+
+        /** Notified when a task is added or the pool is stopping */
+        std::condition_variable task_added;
+
+        /** Set when the pool is being destroyed */
+        bool stopping = false;
+
+        /**
+         * Add a task to the queue and wake up a thread to run it
+         * @param task task to add
+         */
+        void enqueue(std::function<void()> task);
+
+        /**
+         * Run tasks until the pool is stopped
+         */
+        void run_tasks();
+    };
+}
+
+#endif
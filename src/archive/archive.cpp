@@ -3,12 +3,13 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <algorithm>
+#include <cstdio>
 #include <archive.h>
 #include <archive_entry.h>
 #include <invader/version.hpp>
 #include <invader/printf.hpp>
 #include <invader/build/build_workload.hpp>
-#include <invader/map/map.hpp>
 #include <invader/dependency/found_tag_dependency.hpp>
 #include <invader/command_line_option.hpp>
 #include <invader/file/file.hpp>
@@ -20,6 +21,7 @@ int main(int argc, const char **argv) {
         std::string output;
         bool use_filesystem_path = false;
         bool copy = false;
+        std::size_t jobs = 1;
     } archive_options;
 
     static constexpr char DESCRIPTION[] = "Generate .tar.xz archives of the tags required to build a cache file.";
@@ -32,6 +34,7 @@ int main(int argc, const char **argv) {
     options.emplace_back("output", 'o', 1, "Output to a specific file. Extension must be .tar.xz unless using --copy which then it's a directory.", "<file>");
     options.emplace_back("fs-path", 'P', 0, "Use a filesystem path for the tag.");
     options.emplace_back("copy", 'C', 0, "Copy instead of making an archive.");
+    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for compressing the archive. Default: 1", "<#>");
 
     auto remaining_arguments = Invader::CommandLineOption::parse_arguments<ArchiveOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, archive_options, [](char opt, const auto &arguments, auto &archive_options) {
         switch(opt) {
@@ -53,6 +56,19 @@ int main(int argc, const char **argv) {
             case 'C':
                 archive_options.copy = true;
                 break;
+            case 'j':
+                try {
+                    int jobs = std::stoi(arguments[0]);
+                    if(jobs < 1) {
+                        throw std::exception();
+                    }
+                    archive_options.jobs = static_cast<std::size_t>(jobs);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
         }
     });
 
@@ -122,50 +138,19 @@ int main(int argc, const char **argv) {
     Invader::File::remove_duplicate_slashes_chars(base_tag.data());
 
     if(!archive_options.single_tag) {
-        // Build the map
-        std::vector<std::byte> map;
-
-        try {
-            map = Invader::BuildWorkload::compile_map(base_tag.data(), archive_options.tags);
-        }
-        catch(std::exception &e) {
-            eprintf_error("Failed to compile scenario %s into a map\n", base_tag.data());
-            return EXIT_FAILURE;
-        }
-
-        // Parse the map
-        std::unique_ptr<Invader::Map> parsed_map;
+        // Find everything the map would use; we don't need to actually build it for this
+        std::vector<std::pair<Invader::File::TagFilePath, std::string>> dependencies;
         try {
-            parsed_map = std::make_unique<Invader::Map>(Invader::Map::map_with_pointer(map.data(), map.size()));
+            dependencies = Invader::BuildWorkload::resolve_map_dependencies(base_tag.data(), archive_options.tags);
         }
         catch(std::exception &e) {
-            eprintf_error("Failed to parse the map file generated with scenario %s\n", base_tag.data());
+            eprintf_error("Failed to find the tags used by scenario %s. Archive could not be made.\n", base_tag.data());
             return EXIT_FAILURE;
         }
-        auto tag_count = parsed_map->get_tag_count();
 
-        // Go through each tag and see if we can find everything.
-        archive_list.reserve(tag_count);
-        for(std::size_t i = 0; i < tag_count; i++) {
-            // Get the tag path information
-            auto &tag = parsed_map->get_tag(i);
-            std::string full_tag_path = Invader::File::halo_path_to_preferred_path(std::string(tag.get_path()) + "." + tag_class_to_extension(tag.get_tag_class_int()));
-
-            // Check each tags directory if it exists. If so, archive it
-            bool exists = false;
-            for(auto &dir : archive_options.tags) {
-                std::filesystem::path tag_path = std::filesystem::path(dir) / full_tag_path;
-                if(std::filesystem::exists(tag_path)) {
-                    exists = true;
-                    archive_list.emplace_back(tag_path.string(), full_tag_path);
-                    break;
-                }
-            }
-
-            if(!exists) {
-                eprintf_error("Failed to find %s. Archive could not be made.\n", full_tag_path.c_str());
-                return EXIT_FAILURE;
-            }
+        archive_list.reserve(dependencies.size());
+        for(auto &dependency : dependencies) {
+            archive_list.emplace_back(dependency.second, Invader::File::halo_path_to_preferred_path(dependency.first.join()));
         }
     }
     else {
@@ -220,10 +205,15 @@ int main(int argc, const char **argv) {
         // Begin making the archive
         auto *archive = archive_write_new();
         archive_write_add_filter_xz(archive);
+        if(archive_options.jobs > 1) {
+            auto threads = std::to_string(archive_options.jobs);
+            archive_write_set_filter_option(archive, "xz", "threads", threads.c_str());
+        }
         archive_write_set_format_pax_restricted(archive);
         archive_write_open_filename(archive, archive_options.output.c_str());
 
         // Go through each tag path we got
+        std::vector<std::byte> buffer(1024 * 1024);
         for(std::size_t i = 0; i < archive_list.size(); i++) {
             const char *path = archive_list[i].first.c_str();
 
@@ -233,17 +223,14 @@ int main(int argc, const char **argv) {
             archive_entry_set_perm(entry, 0644);
             archive_entry_set_filetype(entry, AE_IFREG);
 
-            auto data_maybe = Invader::File::open_file(path);
-            if(!data_maybe.has_value()) {
+            // Stream it in so we don't have to hold the whole tag in memory
+            std::FILE *file = std::fopen(path, "rb");
+            if(!file) {
                 eprintf_error("Failed to open %s\n", path);
                 return EXIT_FAILURE;
             }
-            auto &data = data_maybe.value();
-
-            // Get the filesystem path and write time
-            std::filesystem::path path_path = path;
 
-            // Get the modified time
+            // Get the size and modified time
             struct stat s;
             stat(path, &s);
 
@@ -255,9 +242,21 @@ int main(int argc, const char **argv) {
             #endif
 
             // Archive that bastard
-            archive_entry_set_size(entry, data.size());
+            archive_entry_set_size(entry, s.st_size);
             archive_write_header(archive, entry);
-            archive_write_data(archive, data.data(), data.size());
+
+            std::size_t remaining = static_cast<std::size_t>(s.st_size);
+            while(remaining > 0) {
+                std::size_t read = std::fread(buffer.data(), 1, std::min(remaining, buffer.size()), file);
+                if(read == 0) {
+                    eprintf_error("Failed to read %s\n", path);
+                    std::fclose(file);
+                    return EXIT_FAILURE;
+                }
+                archive_write_data(archive, buffer.data(), read);
+                remaining -= read;
+            }
+            std::fclose(file);
 
             // Close it
             archive_entry_free(entry);
@@ -2,6 +2,8 @@
 
 #include <zlib.h>
 #include <filesystem>
+#include <future>
+#include <map>
 #include <optional>
 #include <zstd.h>
 
@@ -14,7 +16,9 @@
 #include "bitmap_data_writer.hpp"
 #include <invader/command_line_option.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/batch_cache.hpp>
 #include <invader/tag/parser/parser.hpp>
+#include <invader/thread/thread_pool.hpp>
 
 enum SupportedFormatsInt {
     SUPPORTED_FORMATS_TIF = 0,
@@ -93,6 +97,133 @@ struct BitmapOptions {
     
     // Regenerate?
     bool regenerate = false;
+
+    // DXT compression quality
+    DXTEncode::DXTQuality dxt_quality = DXTEncode::DXTQuality::DXT_QUALITY_NORMAL;
+
+    // Number of threads to compress with (or, if making multiple tags, the number of tags to make at once)
+    std::size_t jobs = 1;
+
+    // Make every bitmap tag in the data directory?
+    bool all = false;
+
+    // File listing the bitmap tags to make
+    std::optional<const char *> batch;
+
+    // Cache used to skip tags that are unchanged
+    std::optional<const char *> batch_cache;
+
+    // Options that can change the tag, used to tell if a tag needs to be made again
+    std::string settings;
+
+    // Print each bitmap?
+    bool verbose = true;
+};
+
+/**
+ * Find the source image of a bitmap tag
+ * @param data_path    data directory
+ * @param bitmap_tag   tag path
+ * @param found_format first format to look for
+ * @return             path to the image and its format, if found
+ */
+static std::optional<std::pair<std::string, SupportedFormatsInt>> find_source_image(const std::filesystem::path &data_path, const std::string &bitmap_tag, SupportedFormatsInt found_format) {
+    auto bitmap_data_path = (data_path / bitmap_tag).string();
+    for(auto i = found_format; i < SUPPORTED_FORMATS_INT_COUNT; i = static_cast<SupportedFormatsInt>(i + 1)) {
+        std::string image_path = bitmap_data_path + SUPPORTED_FORMATS[i];
+        if(std::filesystem::exists(image_path)) {
+            return std::pair(image_path, i);
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * Compresses each row of the color plate as the scanner reads it, so the color plate can be stored in the tag without all of it being in memory
+ */
+class CompressingColorPlateReader : public ColorPlateReader {
+public:
+    void read_row(ColorPlatePixel *row) override {
+        this->reader.read_row(row);
+        this->compress(reinterpret_cast<const std::byte *>(row), sizeof(*row) * this->width, false);
+    }
+
+    /**
+     * Finish compressing. This must be called after every row has been read.
+     * @return compressed color plate
+     */
+    std::vector<std::byte> finish() {
+        this->compress(nullptr, 0, true);
+        return std::move(this->compressed_data);
+    }
+
+    /**
+     * Instantiate a compressing reader
+     * @param reader reader to read rows from
+     * @param zstd   use Zstandard (extended bitmaps) rather than DEFLATE
+     */
+    CompressingColorPlateReader(ColorPlateReader &reader, bool zstd) : reader(reader), output_buffer(OUTPUT_BUFFER_SIZE) {
+        this->width = reader.get_width();
+        this->height = reader.get_height();
+
+        if(zstd) {
+            this->zstd_stream = ZSTD_createCCtx();
+            ZSTD_CCtx_setParameter(this->zstd_stream, ZSTD_c_compressionLevel, 19);
+            ZSTD_CCtx_setPledgedSrcSize(this->zstd_stream, static_cast<std::size_t>(this->width) * this->height * sizeof(ColorPlatePixel));
+        }
+        else {
+            this->deflate_stream.zalloc = Z_NULL;
+            this->deflate_stream.zfree = Z_NULL;
+            this->deflate_stream.opaque = Z_NULL;
+            deflateInit(&this->deflate_stream, Z_BEST_COMPRESSION);
+        }
+    }
+
+    ~CompressingColorPlateReader() override {
+        if(this->zstd_stream) {
+            ZSTD_freeCCtx(this->zstd_stream);
+        }
+        else {
+            deflateEnd(&this->deflate_stream);
+        }
+    }
+
+private:
+    static constexpr std::size_t OUTPUT_BUFFER_SIZE = 128 * 1024;
+
+    ColorPlateReader &reader;
+    ZSTD_CCtx *zstd_stream = nullptr;
+    z_stream deflate_stream = {};
+    std::vector<std::byte> output_buffer;
+    std::vector<std::byte> compressed_data;
+
+    void compress(const std::byte *data, std::size_t size, bool finish) {
+        if(this->zstd_stream) {
+            ZSTD_inBuffer input = { data, size, 0 };
+            std::size_t remaining;
+            do {
+                ZSTD_outBuffer output = { this->output_buffer.data(), this->output_buffer.size(), 0 };
+                remaining = ZSTD_compressStream2(this->zstd_stream, &output, &input, finish ? ZSTD_e_end : ZSTD_e_continue);
+                if(ZSTD_isError(remaining)) {
+                    eprintf_error("Failed to compress the color plate: %s", ZSTD_getErrorName(remaining));
+                    throw CompressionFailureException();
+                }
+                this->compressed_data.insert(this->compressed_data.end(), this->output_buffer.data(), this->output_buffer.data() + output.pos);
+            }
+            while(finish ? remaining != 0 : input.pos != input.size);
+        }
+        else {
+            this->deflate_stream.avail_in = static_cast<uInt>(size);
+            this->deflate_stream.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(data));
+            do {
+                this->deflate_stream.avail_out = static_cast<uInt>(this->output_buffer.size());
+                this->deflate_stream.next_out = reinterpret_cast<Bytef *>(this->output_buffer.data());
+                deflate(&this->deflate_stream, finish ? Z_FINISH : Z_NO_FLUSH);
+                this->compressed_data.insert(this->compressed_data.end(), this->output_buffer.data(), this->output_buffer.data() + (this->output_buffer.size() - this->deflate_stream.avail_out));
+            }
+            while(this->deflate_stream.avail_out == 0);
+        }
+    }
 };
 
 template <typename T> static int perform_the_ritual(const std::string &bitmap_tag, const std::filesystem::path &tag_path, const std::string &final_path, BitmapOptions &bitmap_options, SupportedFormatsInt found_format, TagClassInt tag_class_int) {
@@ -213,7 +344,8 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
     // Have these variables handy
     std::uint32_t image_width = 0, image_height = 0;
     std::size_t image_size = 0;
-    ColorPlatePixel *image_pixels = nullptr;
+    std::vector<ColorPlatePixel> image_pixels;
+    std::unique_ptr<ColorPlateReader> image_reader;
 
     // If we're regenerating, our color plate data is in the tag
     if(bitmap_options.regenerate) {
@@ -229,19 +361,19 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
         // Get the size of the data we're going to decompress
         auto *data = bitmap_tag_data.compressed_color_plate_data.data();
         image_size = reinterpret_cast<HEK::BigEndian<std::uint32_t> *>(data)->read();
-        if((image_size % sizeof(ColorPlatePixel)) != 0) {
+        if(image_size != static_cast<std::size_t>(image_width) * image_height * sizeof(ColorPlatePixel)) {
             invalid_color_plate_data_size_spaghetti_code:
             eprintf_error("Cannot regenerate due the compressed color plate data size being wrong)");
             return EXIT_FAILURE;
         }
-        image_pixels = new ColorPlatePixel[image_size / sizeof(ColorPlatePixel)];
+        image_pixels.resize(image_size / sizeof(ColorPlatePixel));
         
         data += sizeof(std::uint32_t);
         size -= sizeof(std::uint32_t);
         
         // Zstandard if extended
         if(source_is_extended) {
-            if(ZSTD_decompress(image_pixels, image_size, data, size) != image_size) {
+            if(ZSTD_decompress(image_pixels.data(), image_size, data, size) != image_size) {
                 goto invalid_color_plate_data_size_spaghetti_code;
             }
         }
@@ -253,7 +385,7 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
             inflate_stream.zfree = Z_NULL;
             inflate_stream.opaque = Z_NULL;
             inflate_stream.avail_out = image_size;
-            inflate_stream.next_out = reinterpret_cast<Bytef *>(image_pixels);
+            inflate_stream.next_out = reinterpret_cast<Bytef *>(image_pixels.data());
             inflate_stream.avail_in = size;
             inflate_stream.next_in = reinterpret_cast<Bytef *>(data);
 
@@ -262,34 +394,15 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
             inflate(&inflate_stream, Z_FINISH);
             inflateEnd(&inflate_stream);
         }
+
+        image_reader = std::make_unique<ColorPlatePixelReader>(image_pixels.data(), image_width, image_height);
     }
     
     // Otherwise, find the file
     else {
         // Try to figure out the extension
-        auto bitmap_data_path = (data_path / bitmap_tag).string();
-        for(auto i = found_format; i < SUPPORTED_FORMATS_INT_COUNT; i = static_cast<SupportedFormatsInt>(i + 1)) {
-            std::string image_path = bitmap_data_path + SUPPORTED_FORMATS[i];
-            if(std::filesystem::exists(image_path)) {
-                switch(i) {
-                    case SUPPORTED_FORMATS_TIF:
-                    case SUPPORTED_FORMATS_TIFF:
-                        image_pixels = load_tiff(image_path.c_str(), image_width, image_height, image_size);
-                        break;
-                    case SUPPORTED_FORMATS_PNG:
-                    case SUPPORTED_FORMATS_TGA:
-                    case SUPPORTED_FORMATS_BMP:
-                        image_pixels = load_image(image_path.c_str(), image_width, image_height, image_size);
-                        break;
-                    default:
-                        std::terminate();
-                        break;
-                }
-                break;
-            }
-        }
-
-        if(image_pixels == nullptr) {
+        auto source_image = find_source_image(data_path, bitmap_tag, found_format);
+        if(!source_image.has_value()) {
             eprintf_error("Failed to find %s in %s", bitmap_tag.c_str(), bitmap_options.data);
             eprintf("Valid formats are:\n");
             for(auto *format : SUPPORTED_FORMATS) {
@@ -297,6 +410,30 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
             }
             return EXIT_FAILURE;
         }
+
+        try {
+            switch(source_image->second) {
+                case SUPPORTED_FORMATS_TIF:
+                case SUPPORTED_FORMATS_TIFF:
+                    image_reader = open_tiff(source_image->first.c_str());
+                    break;
+                case SUPPORTED_FORMATS_PNG:
+                case SUPPORTED_FORMATS_TGA:
+                case SUPPORTED_FORMATS_BMP:
+                    image_reader = open_image(source_image->first.c_str());
+                    break;
+                default:
+                    std::terminate();
+                    break;
+            }
+        }
+        catch(std::exception &) {
+            return EXIT_FAILURE;
+        }
+
+        image_width = image_reader->get_width();
+        image_height = image_reader->get_height();
+        image_size = static_cast<std::size_t>(image_width) * image_height * sizeof(ColorPlatePixel);
     }
 
     // Set up sprite parameters
@@ -309,58 +446,45 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
         p.sprite_usage = bitmap_options.sprite_usage.value();
     }
 
-    // Do it!
-    auto try_to_scan_color_plate = [&image_pixels, &image_width, &image_height, &bitmap_options, &sprite_parameters]() {
-        try {
-            return ColorPlateScanner::scan_color_plate(reinterpret_cast<const ColorPlatePixel *>(image_pixels), image_width, image_height, bitmap_options.bitmap_type.value(), bitmap_options.usage.value(), bitmap_options.bump_height.value(), sprite_parameters, bitmap_options.max_mipmap_count.value(), bitmap_options.mipmap_scale_type.value(), bitmap_options.usage == BitmapUsage::BITMAP_USAGE_DETAIL_MAP ? bitmap_options.mipmap_fade : std::nullopt, bitmap_options.sharpen, bitmap_options.blur);
-        }
-        catch (std::exception &e) {
-            eprintf_error("Failed to process the image: %s", e.what());
-            std::exit(1);
-        };
-    };
+    // If we aren't regenerating, compress the original input blob as it gets scanned
+    std::optional<CompressingColorPlateReader> compressing_reader;
+    ColorPlateReader *reader = image_reader.get();
+    if(!bitmap_options.regenerate) {
+        reader = &compressing_reader.emplace(*image_reader, bitmap_options.use_extended);
+    }
 
-    auto scanned_color_plate = try_to_scan_color_plate();
+    // Do it!
+    GeneratedBitmapData scanned_color_plate;
+    try {
+        scanned_color_plate = ColorPlateScanner::scan_color_plate(*reader, bitmap_options.bitmap_type.value(), bitmap_options.usage.value(), bitmap_options.bump_height.value(), sprite_parameters, bitmap_options.max_mipmap_count.value(), bitmap_options.mipmap_scale_type.value(), bitmap_options.usage == BitmapUsage::BITMAP_USAGE_DETAIL_MAP ? bitmap_options.mipmap_fade : std::nullopt, bitmap_options.sharpen, bitmap_options.blur, bitmap_options.jobs);
+    }
+    catch (std::exception &e) {
+        eprintf_error("Failed to process the image: %s", e.what());
+        return EXIT_FAILURE;
+    }
     std::size_t bitmap_count = scanned_color_plate.bitmaps.size();
 
-    // Compress the original input blob
-    if(!bitmap_options.regenerate) {
+    // Store the compressed input blob (Zstandard if extended; DEFLATE if not extended)
+    if(compressing_reader.has_value()) {
         // Get ready
-        bitmap_tag_data.compressed_color_plate_data.clear();
-        std::vector<std::byte> compressed_data(image_size * 4);
         BigEndian<std::uint32_t> decompressed_size;
         decompressed_size = static_cast<std::uint32_t>(image_size);
         bitmap_tag_data.color_plate_width = image_width;
         bitmap_tag_data.color_plate_height = image_height;
 
         // Set compressed size
+        bitmap_tag_data.compressed_color_plate_data.clear();
         bitmap_tag_data.compressed_color_plate_data.resize(sizeof(decompressed_size));
         *reinterpret_cast<BigEndian<std::uint32_t> *>(bitmap_tag_data.compressed_color_plate_data.data()) = decompressed_size;
 
-        // Zstandard if extended
-        if(bitmap_options.use_extended) {
-            compressed_data.resize(ZSTD_compressBound(image_size));
-            compressed_data.resize(ZSTD_compress(compressed_data.data(), compressed_data.size(), image_pixels, image_size, 19));
+        // Add the compressed data
+        try {
+            auto compressed_data = compressing_reader->finish();
             bitmap_tag_data.compressed_color_plate_data.insert(bitmap_tag_data.compressed_color_plate_data.end(), compressed_data.begin(), compressed_data.end());
         }
-
-        // DEFLATE if not extended
-        else {
-            compressed_data.resize(image_size * 4);
-            z_stream deflate_stream;
-            deflate_stream.zalloc = Z_NULL;
-            deflate_stream.zfree = Z_NULL;
-            deflate_stream.opaque = Z_NULL;
-            deflate_stream.avail_in = image_size;
-            deflate_stream.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(image_pixels));
-            deflate_stream.avail_out = compressed_data.size();
-            deflate_stream.next_out = reinterpret_cast<Bytef *>(compressed_data.data());
-
-            // Do it
-            deflateInit(&deflate_stream, Z_BEST_COMPRESSION);
-            deflate(&deflate_stream, Z_FINISH);
-            deflateEnd(&deflate_stream);
-            bitmap_tag_data.compressed_color_plate_data.insert(bitmap_tag_data.compressed_color_plate_data.end(), compressed_data.data(), compressed_data.data() + deflate_stream.total_out);
+        catch (std::exception &e) {
+            eprintf_error("Failed to compress the color plate: %s", e.what());
+            return EXIT_FAILURE;
         }
     }
 
@@ -368,15 +492,19 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
     #define BYTES_TO_MIB(bytes) (bytes / 1024.0F / 1024.0F)
 
     // Add our bitmap data
-    oprintf("Found %zu bitmap%s:\n", bitmap_count, bitmap_count == 1 ? "" : "s");
+    if(bitmap_options.verbose) {
+        oprintf("Found %zu bitmap%s:\n", bitmap_count, bitmap_count == 1 ? "" : "s");
+    }
     try {
-        write_bitmap_data(scanned_color_plate, bitmap_tag_data.processed_pixel_data, bitmap_tag_data.bitmap_data, bitmap_options.usage.value(), bitmap_options.format.value(), bitmap_options.bitmap_type.value(), bitmap_options.palettize.value(), bitmap_options.dither_alpha.value(), bitmap_options.dither_color.value(), bitmap_options.dither_color.value(), bitmap_options.dither_color.value());
+        write_bitmap_data(scanned_color_plate, bitmap_tag_data.processed_pixel_data, bitmap_tag_data.bitmap_data, bitmap_options.usage.value(), bitmap_options.format.value(), bitmap_options.bitmap_type.value(), bitmap_options.palettize.value(), bitmap_options.dither_alpha.value(), bitmap_options.dither_color.value(), bitmap_options.dither_color.value(), bitmap_options.dither_color.value(), bitmap_options.dxt_quality, bitmap_options.jobs, bitmap_options.verbose);
     }
     catch (std::exception &e) {
         eprintf_error("Failed to generate bitmap data: %s", e.what());
-        std::exit(1);
+        return EXIT_FAILURE;
+    }
+    if(bitmap_options.verbose) {
+        oprintf("Total: %.03f MiB%s\n", BYTES_TO_MIB(bitmap_tag_data.processed_pixel_data.size()), (sizeof(T) == sizeof(Parser::InvaderBitmap)) ? "; --extended" : "");
     }
-    oprintf("Total: %.03f MiB%s\n", BYTES_TO_MIB(bitmap_tag_data.processed_pixel_data.size()), (sizeof(T) == sizeof(Parser::InvaderBitmap)) ? "; --extended" : "");
 
     // Add all sequences
     for(auto &sequence : scanned_color_plate.sequences) {
@@ -485,6 +613,123 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
     return EXIT_SUCCESS;
 }
 
+/**
+ * Find the path and class of a bitmap tag, and then make it
+ * @param bitmap_tag     tag path (or a filesystem path if using --fs-path)
+ * @param bitmap_options options to make the tag with
+ * @param found_format   first format to look for the source image in
+ * @param cache          cache to skip the tag with if it is unchanged (and to update if it isn't), if any
+ * @param unchanged      set to true if the tag was skipped for being unchanged
+ * @return               EXIT_SUCCESS if successful
+ */
+static int make_bitmap_tag(std::string bitmap_tag, BitmapOptions bitmap_options, SupportedFormatsInt found_format, File::BatchCache *cache, bool &unchanged) {
+    // Keep what we were given for error messages
+    const std::string tag_argument = bitmap_tag;
+
+    // Remember what kind of tag class we're using, if we're using -P with -R
+    std::optional<TagClassInt> tag_class_to_use;
+
+    if(bitmap_options.filesystem_path) {
+        // Check for a ".bitmap" and ".extended_bitmap"
+        if(bitmap_options.regenerate) {
+            std::vector<std::string> tags_v(&*bitmap_options.tags, &*bitmap_options.tags + 1);
+            auto try_it_and_buy_it = [&tags_v, &bitmap_tag, &tag_class_to_use](HEK::TagClassInt tag_class_int) -> bool {
+                auto p = Invader::File::file_path_to_tag_path_with_extension(bitmap_tag, tags_v, std::string(".") + HEK::tag_class_to_extension(tag_class_int));
+                if(!p.has_value()) {
+                    return false;
+                }
+                bitmap_tag = *p;
+                tag_class_to_use = tag_class_int;
+                return true;
+            };
+            
+            if(!try_it_and_buy_it(HEK::TagClassInt::TAG_CLASS_INVADER_BITMAP) && !try_it_and_buy_it(HEK::TagClassInt::TAG_CLASS_BITMAP)) {
+                eprintf_error("Failed to find a valid bitmap %s in the tags directory.", tag_argument.c_str());
+                return EXIT_FAILURE;
+            }
+        }
+        
+        // Iterate through all the possible extensions
+        else {
+            std::vector<std::string> data_v(&bitmap_options.data, &bitmap_options.data + 1);
+            SupportedFormatsInt i;
+            for(i = found_format; i < SupportedFormatsInt::SUPPORTED_FORMATS_INT_COUNT; i = static_cast<SupportedFormatsInt>(i + 1)) {
+                auto bitmap_tag_maybe = Invader::File::file_path_to_tag_path_with_extension(bitmap_tag, data_v, SUPPORTED_FORMATS[i]);
+                if(bitmap_tag_maybe.has_value()) {
+                    bitmap_tag = *bitmap_tag_maybe;
+                    found_format = i;
+                    break;
+                }
+            }
+            if(i == SupportedFormatsInt::SUPPORTED_FORMATS_INT_COUNT) {
+                eprintf_error("Failed to find a valid bitmap %s in the data directory.", tag_argument.c_str());
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    // Ensure it's lowercase
+    for(char &c : bitmap_tag) {
+        if(c >= 'A' && c <= 'Z') {
+            eprintf_error("Invalid tag path %s. Tag paths must be lowercase.", bitmap_tag.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::filesystem::path tags_path(*bitmap_options.tags);
+    auto tag_path = tags_path / bitmap_tag;
+
+    auto final_path_bitmap = tag_path.string() + ".bitmap";
+    auto final_path_invader_bitmap = tag_path.string() + ".invader_bitmap";
+    
+    // Determine if we're using extended or not
+    if(tag_class_to_use.has_value()) { // if -P and -R is used
+        switch(tag_class_to_use.value()) {
+            case HEK::TagClassInt::TAG_CLASS_BITMAP:
+                if(bitmap_options.use_extended) {
+                    eprintf_error("Using --extended while regenerating a non-extended bitmap is not yet supported");
+                    return EXIT_FAILURE;
+                }
+                break;
+            
+            case HEK::TagClassInt::TAG_CLASS_INVADER_BITMAP:
+                bitmap_options.use_extended = true;
+                break;
+            
+            default:
+                std::terminate();
+        }
+    }
+    else if(bitmap_options.use_extended || (!bitmap_options.use_extended && std::filesystem::exists(final_path_invader_bitmap))) { // if .invader_bitmap exists or we're using extended
+        bitmap_options.use_extended = true;
+    }
+
+    // If the source image and settings haven't changed since the tag was last made, we don't need to make it again
+    auto &final_path = bitmap_options.use_extended ? final_path_invader_bitmap : final_path_bitmap;
+    std::optional<std::pair<std::string, SupportedFormatsInt>> source_image;
+    if(cache) {
+        source_image = find_source_image(bitmap_options.data, bitmap_tag, found_format);
+        if(source_image.has_value() && cache->is_unchanged(bitmap_tag, { source_image->first }, final_path, bitmap_options.settings)) {
+            unchanged = true;
+            return EXIT_SUCCESS;
+        }
+    }
+
+    int result;
+    if(bitmap_options.use_extended) {
+        result = perform_the_ritual<Invader::Parser::InvaderBitmap>(bitmap_tag, tag_path, final_path, bitmap_options, found_format, TagClassInt::TAG_CLASS_INVADER_BITMAP);
+    }
+    else {
+        result = perform_the_ritual<Invader::Parser::Bitmap>(bitmap_tag, tag_path, final_path, bitmap_options, found_format, TagClassInt::TAG_CLASS_BITMAP);
+    }
+
+    if(result == EXIT_SUCCESS && cache && source_image.has_value()) {
+        cache->update(bitmap_tag, { source_image->first }, final_path, bitmap_options.settings);
+    }
+
+    return result;
+}
+
 int main(int argc, char *argv[]) {
     EXIT_IF_INVADER_EXTRACT_HIDDEN_VALUES
 
@@ -499,7 +744,7 @@ int main(int argc, char *argv[]) {
     options.emplace_back("format", 'F', 1, "Pixel format. Can be: 32-bit, 16-bit, monochrome, dxt5, dxt3, or dxt1. Default (new tag): 32-bit", "<type>");
     options.emplace_back("type", 'T', 1, "Set the type of bitmap. Can be: 2d-textures, 3d-textures, cube-maps, interface-bitmaps, or sprites. Default (new tag): 2d", "<type>");
     options.emplace_back("mipmap-count", 'M', 1, "Set maximum mipmaps. Default (new tag): 32767", "<count>");
-    options.emplace_back("mipmap-scale", 's', 1, "[REQUIRES --extended] Mipmap scale type. Can be: linear, nearest-alpha, nearest. Default (new tag): linear", "<type>");
+    options.emplace_back("mipmap-scale", 's', 1, "[REQUIRES --extended] Mipmap scale type. Can be: linear, nearest-alpha, nearest, lanczos, kaiser. Default (new tag): linear", "<type>");
     options.emplace_back("detail-fade", 'f', 1, "Set detail fade factor. Default (new tag): 0.0", "<factor>");
     options.emplace_back("budget", 'B', 1, "Set max length of sprite sheet. Can be 32, 64, 128, 256, or 512. If --extended, then 1024 or 2048 can be used, too. Default (new tag): 32", "<length>");
     options.emplace_back("budget-count", 'C', 1, "Set maximum number of sprite sheets. Setting this to 0 disables budgeting. Default (new tag): 0", "<count>");
@@ -509,12 +754,20 @@ int main(int argc, char *argv[]) {
     options.emplace_back("fs-path", 'P', 0, "Use a filesystem path for the data.");
     options.emplace_back("regenerate", 'R', 0, "Use the bitmap tag's compressed color plate data as data.");
     options.emplace_back("extended", 'x', 0, "Create an invader_bitmap tag (required for some features).");
+    options.emplace_back("dxt-quality", 'Q', 1, "Set the DXT compression quality. Can be: fast, normal, or high. Default: normal", "<quality>");
+    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for generating mipmaps and DXT compression. If --all or --batch is used, this is the number of tags to make at once instead. Default: 1", "<#>");
+    options.emplace_back("all", 'a', 0, "Make a bitmap tag for every image in the data directory.");
+    options.emplace_back("batch", 'b', 1, "Make a bitmap tag for each tag path listed in a file (one per line).", "<file>");
+    options.emplace_back("batch-cache", 'k', 1, "Remember the source image and settings of each tag in a file, and skip tags that are unchanged since then.", "<file>");
 
     static constexpr char DESCRIPTION[] = "Create or modify a bitmap tag.";
-    static constexpr char USAGE[] = "[options] <bitmap-tag>";
+    static constexpr char USAGE[] = "[options] <-a | -b <file> | bitmap-tag>";
 
     // Go through each argument
-    auto remaining_arguments = CommandLineOption::parse_arguments<BitmapOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, bitmap_options, [](char opt, const std::vector<const char *> &arguments, auto &bitmap_options) {
+    auto remaining_arguments = CommandLineOption::parse_arguments<BitmapOptions &>(argc, argv, options, USAGE, DESCRIPTION, 0, 1, bitmap_options, [](char opt, const std::vector<const char *> &arguments, auto &bitmap_options) {
+        // Remember the options that can change the tag, leaving out directories, threads, and batch options
+        File::record_batch_setting(bitmap_options.settings, opt, arguments, "idtPjabk");
+
         switch(opt) {
             case 'd':
                 bitmap_options.data = arguments[0];
@@ -665,6 +918,48 @@ int main(int argc, char *argv[]) {
             case 'x':
                 bitmap_options.use_extended = true;
                 break;
+
+            case 'Q':
+                if(std::strcmp(arguments[0], "fast") == 0) {
+                    bitmap_options.dxt_quality = DXTEncode::DXTQuality::DXT_QUALITY_FAST;
+                }
+                else if(std::strcmp(arguments[0], "normal") == 0) {
+                    bitmap_options.dxt_quality = DXTEncode::DXTQuality::DXT_QUALITY_NORMAL;
+                }
+                else if(std::strcmp(arguments[0], "high") == 0) {
+                    bitmap_options.dxt_quality = DXTEncode::DXTQuality::DXT_QUALITY_HIGH;
+                }
+                else {
+                    eprintf_error("Unknown DXT quality %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'j':
+                try {
+                    int jobs = std::stoi(arguments[0]);
+                    if(jobs < 1) {
+                        throw std::exception();
+                    }
+                    bitmap_options.jobs = static_cast<std::size_t>(jobs);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'a':
+                bitmap_options.all = true;
+                break;
+
+            case 'b':
+                bitmap_options.batch = arguments[0];
+                break;
+
+            case 'k':
+                bitmap_options.batch_cache = arguments[0];
+                break;
         }
     });
     
@@ -673,58 +968,22 @@ int main(int argc, char *argv[]) {
         bitmap_options.tags = "tags";
     }
 
-    // See if we can figure out the bitmap tag using extensions
-    std::string bitmap_tag = remaining_arguments[0];
-    SupportedFormatsInt found_format = static_cast<SupportedFormatsInt>(0);
-    
-    // Remember what kind of tag class we're using, if we're using -P with -R
-    std::optional<TagClassInt> tag_class_to_use;
-
-    if(bitmap_options.filesystem_path) {
-        // Check for a ".bitmap" and ".extended_bitmap"
-        if(bitmap_options.regenerate) {
-            std::vector<std::string> tags_v(&*bitmap_options.tags, &*bitmap_options.tags + 1);
-            auto try_it_and_buy_it = [&tags_v, &bitmap_tag, &tag_class_to_use](HEK::TagClassInt tag_class_int) -> bool {
-                auto p = Invader::File::file_path_to_tag_path_with_extension(bitmap_tag, tags_v, std::string(".") + HEK::tag_class_to_extension(tag_class_int));
-                if(!p.has_value()) {
-                    return false;
-                }
-                bitmap_tag = *p;
-                tag_class_to_use = tag_class_int;
-                return true;
-            };
-            
-            if(!try_it_and_buy_it(HEK::TagClassInt::TAG_CLASS_INVADER_BITMAP) && !try_it_and_buy_it(HEK::TagClassInt::TAG_CLASS_BITMAP)) {
-                eprintf_error("Failed to find a valid bitmap %s in the tags directory.", remaining_arguments[0]);
-                return EXIT_FAILURE;
-            }
-        }
-        
-        // Iterate through all the possible extensions
-        else {
-            std::vector<std::string> data_v(&bitmap_options.data, &bitmap_options.data + 1);
-            SupportedFormatsInt i;
-            for(i = found_format; i < SupportedFormatsInt::SUPPORTED_FORMATS_INT_COUNT; i = static_cast<SupportedFormatsInt>(i + 1)) {
-                auto bitmap_tag_maybe = Invader::File::file_path_to_tag_path_with_extension(bitmap_tag, data_v, SUPPORTED_FORMATS[i]);
-                if(bitmap_tag_maybe.has_value()) {
-                    bitmap_tag = *bitmap_tag_maybe;
-                    found_format = i;
-                    break;
-                }
-            }
-            if(i == SupportedFormatsInt::SUPPORTED_FORMATS_INT_COUNT) {
-                eprintf_error("Failed to find a valid bitmap %s in the data directory.", remaining_arguments[0]);
-                return EXIT_FAILURE;
-            }
-        }
+    bool batch_mode = bitmap_options.all || bitmap_options.batch.has_value();
+    if(bitmap_options.all && bitmap_options.batch.has_value()) {
+        eprintf_error("--all and --batch cannot be used at the same time. Use -h for more information.");
+        return EXIT_FAILURE;
     }
-
-    // Ensure it's lowercase
-    for(char &c : bitmap_tag) {
-        if(c >= 'A' && c <= 'Z') {
-            eprintf_error("Invalid tag path %s. Tag paths must be lowercase.", bitmap_tag.c_str());
-            return EXIT_FAILURE;
-        }
+    if(batch_mode && remaining_arguments.size() != 0) {
+        eprintf_error("--all or --batch and a tag path cannot be used at the same time. Use -h for more information.");
+        return EXIT_FAILURE;
+    }
+    if(!batch_mode && remaining_arguments.size() == 0) {
+        eprintf_error("Expected --all, --batch, or a tag path. Use -h for more information.");
+        return EXIT_FAILURE;
+    }
+    if(bitmap_options.batch_cache.has_value() && bitmap_options.regenerate) {
+        eprintf_error("--batch-cache cannot be used with --regenerate.");
+        return EXIT_FAILURE;
     }
 
     // Check if the tags directory exists
@@ -739,37 +998,115 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    auto tag_path = tags_path / bitmap_tag;
+    // Load the cache, if we're using one
+    std::optional<File::BatchCache> cache;
+    if(bitmap_options.batch_cache.has_value()) {
+        cache.emplace(*bitmap_options.batch_cache);
+    }
+    auto *cache_ptr = cache.has_value() ? &*cache : nullptr;
+    auto save_cache = [&cache, &bitmap_options]() {
+        if(cache.has_value()) {
+            cache->save(*bitmap_options.batch_cache);
+        }
+    };
 
-    auto final_path_bitmap = tag_path.string() + ".bitmap";
-    auto final_path_invader_bitmap = tag_path.string() + ".invader_bitmap";
-    
-    // Determine if we're using extended or not
-    if(tag_class_to_use.has_value()) { // if -P and -R is used
-        switch(tag_class_to_use.value()) {
-            case HEK::TagClassInt::TAG_CLASS_BITMAP:
-                if(bitmap_options.use_extended) {
-                    eprintf_error("Using --extended while regenerating a non-extended bitmap is not yet supported");
-                    return EXIT_FAILURE;
+    // Just one tag?
+    if(!batch_mode) {
+        bool unchanged = false;
+        int result = make_bitmap_tag(remaining_arguments[0], bitmap_options, static_cast<SupportedFormatsInt>(0), cache_ptr, unchanged);
+        if(unchanged) {
+            oprintf("%s is unchanged\n", remaining_arguments[0]);
+        }
+        save_cache();
+        return result;
+    }
+
+    // Find the tags to make
+    std::vector<std::pair<std::string, SupportedFormatsInt>> bitmap_tags;
+    if(bitmap_options.all) {
+        // If there are multiple images for a tag, use the one that would be used if the tag was made by itself
+        std::map<std::string, SupportedFormatsInt> found_tags;
+        std::filesystem::path data_path(bitmap_options.data);
+        try {
+            for(auto &i : std::filesystem::recursive_directory_iterator(data_path)) {
+                if(!i.is_regular_file()) {
+                    continue;
                 }
-                break;
-            
-            case HEK::TagClassInt::TAG_CLASS_INVADER_BITMAP:
-                bitmap_options.use_extended = true;
-                break;
-            
-            default:
-                std::terminate();
+                auto extension = i.path().extension().string();
+                for(auto f = static_cast<SupportedFormatsInt>(0); f < SUPPORTED_FORMATS_INT_COUNT; f = static_cast<SupportedFormatsInt>(f + 1)) {
+                    if(extension == SUPPORTED_FORMATS[f]) {
+                        auto found_tag = found_tags.emplace(i.path().lexically_relative(data_path).replace_extension().string(), f).first;
+                        found_tag->second = std::min(found_tag->second, f);
+                        break;
+                    }
+                }
+            }
         }
+        catch(std::exception &e) {
+            eprintf_error("Failed to read the data directory %s: %s", bitmap_options.data, e.what());
+            return EXIT_FAILURE;
+        }
+        bitmap_tags.assign(found_tags.begin(), found_tags.end());
+        bitmap_options.filesystem_path = false;
     }
-    else if(bitmap_options.use_extended || (!bitmap_options.use_extended && std::filesystem::exists(final_path_invader_bitmap))) { // if .invader_bitmap exists or we're using extended
-        bitmap_options.use_extended = true;
+    else {
+        auto batch_list = File::read_batch_list(*bitmap_options.batch);
+        if(!batch_list.has_value()) {
+            eprintf_error("Failed to open %s", *bitmap_options.batch);
+            return EXIT_FAILURE;
+        }
+        for(auto &tag : *batch_list) {
+            bitmap_tags.emplace_back(std::move(tag), static_cast<SupportedFormatsInt>(0));
+        }
     }
 
-    if(bitmap_options.use_extended) {
-        return perform_the_ritual<Invader::Parser::InvaderBitmap>(bitmap_tag, tag_path, final_path_invader_bitmap, bitmap_options, found_format, TagClassInt::TAG_CLASS_INVADER_BITMAP);
+    // Make each tag on its own thread rather than splitting up each tag
+    ThreadPool thread_pool(std::min(bitmap_options.jobs, bitmap_tags.size()));
+    bitmap_options.jobs = 1;
+    bitmap_options.verbose = false;
+
+    // Each result is the exit code and whether or not it was skipped for being unchanged
+    std::vector<std::future<std::pair<int, bool>>> results;
+    results.reserve(bitmap_tags.size());
+    for(auto &[bitmap_tag, found_format] : bitmap_tags) {
+        results.emplace_back(thread_pool.submit([&bitmap_tag = bitmap_tag, found_format = found_format, &bitmap_options, cache_ptr]() {
+            bool unchanged = false;
+            int result = make_bitmap_tag(bitmap_tag, bitmap_options, found_format, cache_ptr, unchanged);
+            return std::pair(result, unchanged);
+        }));
     }
-    else {
-        return perform_the_ritual<Invader::Parser::Bitmap>(bitmap_tag, tag_path, final_path_bitmap, bitmap_options, found_format, TagClassInt::TAG_CLASS_BITMAP);
+
+    // Report them in the order they were listed
+    std::size_t made = 0, unchanged = 0, failed = 0;
+    for(std::size_t t = 0; t < bitmap_tags.size(); t++) {
+        auto &bitmap_tag = bitmap_tags[t].first;
+        int result;
+        try {
+            auto [tag_result, tag_unchanged] = results[t].get();
+            if(tag_unchanged) {
+                unchanged++;
+                continue;
+            }
+            result = tag_result;
+        }
+        catch(std::exception &e) {
+            eprintf_error("Failed to make %s: %s", bitmap_tag.c_str(), e.what());
+            result = EXIT_FAILURE;
+        }
+
+        if(result == EXIT_SUCCESS) {
+            made++;
+            oprintf_success("Made %s", bitmap_tag.c_str());
+        }
+        else {
+            failed++;
+            oprintf_fail("Failed to make %s", bitmap_tag.c_str());
+        }
     }
+
+    save_cache();
+
+    File::print_batch_summary("bitmap", made, bitmap_tags.size(), cache.has_value() ? std::optional<std::size_t>(unchanged) : std::nullopt);
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -1,10 +1,8 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
-#define STB_DXT_USE_ROUNDING_BIAS
-#include "stb/stb_dxt.h"
-
 #include "bitmap_data_writer.hpp"
 #include <invader/tag/hek/class/bitmap.hpp>
+#include <invader/bitmap/p8_palettize.hpp>
 #include <invader/printf.hpp>
 
 static inline bool is_power_of_two(std::uint32_t number) {
@@ -17,11 +15,14 @@ static inline bool is_power_of_two(std::uint32_t number) {
 }
 
 namespace Invader {
-    void write_bitmap_data(const GeneratedBitmapData &scanned_color_plate, std::vector<std::byte> &bitmap_data_pixels, std::vector<Parser::BitmapData> &bitmap_data, BitmapUsage usage, BitmapFormat format, BitmapType bitmap_type, bool palettize, bool dither_alpha, bool dither_red, bool dither_green, bool dither_blue) {
+    void write_bitmap_data(const GeneratedBitmapData &scanned_color_plate, std::vector<std::byte> &bitmap_data_pixels, std::vector<Parser::BitmapData> &bitmap_data, BitmapUsage usage, BitmapFormat format, BitmapType bitmap_type, bool palettize, bool dither_alpha, bool dither_red, bool dither_green, bool dither_blue, DXTEncode::DXTQuality dxt_quality, std::size_t jobs, bool verbose) {
         using namespace Invader::HEK;
 
         bool dithering = dither_alpha || dither_red || dither_green || dither_blue;
 
+        // Made once here rather than for each mipmap, cube map face, or 3D texture slice that gets DXT compressed
+        ThreadPool thread_pool(jobs);
+
         auto bitmap_count = scanned_color_plate.bitmaps.size();
         for(std::size_t i = 0; i < bitmap_count; i++) {
             // Write all of the fields here
@@ -345,12 +346,19 @@ namespace Invader {
 
                     // If we're dithering, do dithering things
                     if(dithering) {
-                        dither_do(&ColorPlatePixel::convert_to_p8, ColorPlatePixel::convert_from_p8, first_pixel, pixel_8_bit, bitmap.width, bitmap.height, mipmap_count);
+                        std::uint32_t mip_width = bitmap.width;
+                        std::uint32_t mip_height = bitmap.height;
+                        auto *mip_pixel = first_pixel;
+                        for(std::uint32_t m = 0; m <= mipmap_count; m++) {
+                            P8Palettize::palettize_dithered(mip_pixel, pixel_8_bit, mip_width, mip_height, dither_alpha, dither_red, dither_green, dither_blue);
+                            mip_pixel += mip_width * mip_height;
+                            pixel_8_bit += mip_width * mip_height;
+                            mip_height /= 2;
+                            mip_width /= 2;
+                        }
                     }
                     else {
-                        for(auto *pixel = first_pixel; pixel < last_pixel; pixel++, pixel_8_bit++) {
-                            *pixel_8_bit = pixel->convert_to_p8();
-                        }
+                        P8Palettize::palettize(first_pixel, pixel_8_bit, pixel_count);
                     }
 
                     current_bitmap_pixels.clear();
@@ -364,11 +372,8 @@ namespace Invader {
                 case BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3:
                 case BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5: {
                     // Begin
-                    bool use_dxt1 = bitmap.format == BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1;
-                    bool use_dxt3 = bitmap.format == BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3;
-                    bool use_dxt5 = bitmap.format == BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5;
-                    std::size_t pixel_size = (!use_dxt1) ? 2 : 1;
-                    std::vector<std::byte> new_bitmap_pixels(pixel_count * pixel_size / 2);
+                    std::size_t block_size = bitmap.format == BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1 ? 8 : 16;
+                    std::vector<std::byte> new_bitmap_pixels(pixel_count * block_size / 16);
                     auto *compressed_pixel = new_bitmap_pixels.data();
 
                     std::size_t mipmap_width = bitmap.width;
@@ -376,58 +381,18 @@ namespace Invader {
 
                     auto *uncompressed_pixel = first_pixel;
 
-                    #define BLOCK_LENGTH 4
-
                     std::size_t mipmaps_reduced = 0;
 
-                    std::size_t pixel_increment = BLOCK_LENGTH * (use_dxt3 ? 1 : pixel_size) * 2;
-
-                    // Go through each 4x4 block and make them compressed
+                    // Go through each mipmap and compress its 4x4 blocks
                     for(std::size_t i = 0; i <= mipmap_count; i++) {
                         std::uint32_t effective_mipmap_height = mipmap_height;
                         if(bitmap.type == BitmapDataType::BITMAP_DATA_TYPE_CUBE_MAP) {
                             effective_mipmap_height *= 6;
                         }
 
-                        if(mipmap_width >= BLOCK_LENGTH && effective_mipmap_height >= BLOCK_LENGTH) {
-                            for(std::size_t y = 0; y < effective_mipmap_height; y += BLOCK_LENGTH) {
-                                for(std::size_t x = 0; x < mipmap_width; x += BLOCK_LENGTH) {
-                                    // Let's make the 4x4 block
-                                    ColorPlatePixel block[BLOCK_LENGTH * BLOCK_LENGTH];
-
-                                    // Get the block
-                                    for(int i = 0; i < BLOCK_LENGTH; i++) {
-                                        std::size_t offset = ((y + i) * mipmap_width + x);
-                                        auto *first_block_pixel = block + i * BLOCK_LENGTH;
-                                        auto *first_uncompressed_pixel = uncompressed_pixel + offset;
-
-                                        for(std::size_t j = 0; j < 4; j++) {
-                                            first_block_pixel[j].alpha = first_uncompressed_pixel[j].alpha;
-                                            first_block_pixel[j].red = first_uncompressed_pixel[j].blue;
-                                            first_block_pixel[j].green = first_uncompressed_pixel[j].green;
-                                            first_block_pixel[j].blue = first_uncompressed_pixel[j].red;
-                                        }
-                                    }
-
-                                    // If we're using DXT3, put the alpha in here
-                                    if(use_dxt3) {
-                                        std::uint64_t dxt3_alpha = 0;
-
-                                        // Alpha is stored in order from the first ones being the least significant bytes, and the last ones being the most significant bytes
-                                        for(int i = 0; i < BLOCK_LENGTH * BLOCK_LENGTH; i++) {
-                                            dxt3_alpha = (dxt3_alpha << 4) | (block[BLOCK_LENGTH * BLOCK_LENGTH - i - 1].alpha >> 4);
-                                        }
-
-                                        auto &compressed_alpha = *reinterpret_cast<LittleEndian<std::uint64_t> *>(compressed_pixel);
-                                        compressed_alpha = dxt3_alpha;
-                                        compressed_pixel += sizeof(compressed_alpha);
-                                    }
-
-                                    // Compress
-                                    stb_compress_dxt_block(reinterpret_cast<unsigned char *>(compressed_pixel), reinterpret_cast<unsigned char *>(block), use_dxt5, STB_DXT_HIGHQUAL | (dithering ? STB_DXT_DITHER : 0));
-                                    compressed_pixel += pixel_increment;
-                                }
-                            }
+                        if(mipmap_width >= 4 && effective_mipmap_height >= 4) {
+                            DXTEncode::encode_dxt(uncompressed_pixel, mipmap_width, effective_mipmap_height, compressed_pixel, bitmap.format, dxt_quality, dithering, &thread_pool);
+                            compressed_pixel += (mipmap_width / 4) * (effective_mipmap_height / 4) * block_size;
                         }
                         else {
                             mipmaps_reduced++;
@@ -444,8 +409,6 @@ namespace Invader {
                     // If we had to cut out mipmaps due to them being less than 4x4, here we go
                     mipmap_count -= mipmaps_reduced;
 
-                    #undef BLOCK_LENGTH
-
                     break;
                 }
 
@@ -480,7 +443,9 @@ namespace Invader {
 
             #define BYTES_TO_MIB(bytes) (bytes / 1024.0F / 1024.0F)
 
-            oprintf("    Bitmap #%zu: %ux%u, %u mipmap%s, %s - %.03f MiB\n", i, scanned_color_plate.bitmaps[i].width, scanned_color_plate.bitmaps[i].height, mipmap_count, mipmap_count == 1 ? "" : "s", bitmap_data_format_name(bitmap.format), BYTES_TO_MIB(current_bitmap_pixels.size()));
+            if(verbose) {
+                oprintf("    Bitmap #%zu: %ux%u, %u mipmap%s, %s - %.03f MiB\n", i, scanned_color_plate.bitmaps[i].width, scanned_color_plate.bitmaps[i].height, mipmap_count, mipmap_count == 1 ? "" : "s", bitmap_data_format_name(bitmap.format), BYTES_TO_MIB(current_bitmap_pixels.size()));
+            }
         }
     }
 }
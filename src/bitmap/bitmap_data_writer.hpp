@@ -5,11 +5,12 @@
 
 #include "color_plate_scanner.hpp"
 #include <invader/tag/parser/parser.hpp>
+#include <invader/bitmap/dxt_encode.hpp>
 
 namespace Invader {
     using BitmapFormat = HEK::BitmapFormat;
 
-    void write_bitmap_data(const GeneratedBitmapData &scanned_color_plate, std::vector<std::byte> &bitmap_data_pixels, std::vector<Parser::BitmapData> &bitmap_data, BitmapUsage usage, BitmapFormat format, BitmapType bitmap_type, bool palettize, bool dither_alpha, bool dither_red, bool dither_green, bool dither_blue);
+    void write_bitmap_data(const GeneratedBitmapData &scanned_color_plate, std::vector<std::byte> &bitmap_data_pixels, std::vector<Parser::BitmapData> &bitmap_data, BitmapUsage usage, BitmapFormat format, BitmapType bitmap_type, bool palettize, bool dither_alpha, bool dither_red, bool dither_green, bool dither_blue, DXTEncode::DXTQuality dxt_quality, std::size_t jobs, bool verbose);
 }
 
 #endif
@@ -3,25 +3,25 @@
 #include <invader/bitmap/bitmap_encode.hpp>
 #include <invader/tag/hek/class/bitmap.hpp>
 #include <invader/bitmap/color_plate_pixel.hpp>
-#include "s3tc/s3tc.hpp"
+#include <invader/bitmap/dxt_decode.hpp>
+#include <cstring>
+#include <type_traits>
 
 namespace Invader::BitmapEncode {
-    static std::vector<std::byte> decode_to_32_bit(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::size_t width, std::size_t height);
+    static void decode_to_32_bit(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::LittleEndian<std::uint32_t> *output, std::size_t width, std::size_t height);
     
     void encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height) {
-        auto as_32_bit = decode_to_32_bit(input_data, input_format, width, height);
-        
-        // If it's already 32-bit ARGB, output it
+        // If it's 32-bit ARGB, decode it straight to the output
         if(output_format == HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8) {
-            std::memcpy(output_data, as_32_bit.data(), as_32_bit.size());
+            decode_to_32_bit(input_data, input_format, reinterpret_cast<HEK::LittleEndian<std::uint32_t> *>(output_data), width, height);
             return;
         }
         
-        // If it's 32-bit XRGB, copy it but then set the alpha to 0xFF
+        // If it's 32-bit XRGB, do the same but then set the alpha to 0xFF
         if(output_format == HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_X8R8G8B8) {
-            std::memcpy(output_data, as_32_bit.data(), as_32_bit.size());
+            decode_to_32_bit(input_data, input_format, reinterpret_cast<HEK::LittleEndian<std::uint32_t> *>(output_data), width, height);
             auto *start = reinterpret_cast<ColorPlatePixel *>(output_data);
-            auto *end = reinterpret_cast<ColorPlatePixel *>(output_data + as_32_bit.size());
+            auto *end = start + width * height;
             for(auto *i = start; i < end; i++) {
                 i->alpha = 0xFF;
             }
@@ -34,7 +34,7 @@ namespace Invader::BitmapEncode {
     
     std::vector<std::byte> encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height) {
         // Get our output buffer
-        std::vector<std::byte> output(bitmap_data_size(input_format, width, height));
+        std::vector<std::byte> output(bitmap_data_size(output_format, width, height));
         
         // Do it
         encode_bitmap(input_data, input_format, output.data(), output_format, width, height);
@@ -70,15 +70,13 @@ namespace Invader::BitmapEncode {
         return (container_width * container_height * output_bits_per_pixel) / 8;
     }
     
-    static std::vector<std::byte> decode_to_32_bit(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::size_t width, std::size_t height) {
-        // First, decode it to 32-bit A8R8G8B8 if necessary
+    static void decode_to_32_bit(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::LittleEndian<std::uint32_t> *output, std::size_t width, std::size_t height) {
         std::size_t pixel_count = width * height;
-        std::vector<HEK::LittleEndian<std::uint32_t>> data(pixel_count);
         
-        auto decode_8_bit = [&pixel_count, &input_data, &data](ColorPlatePixel (*with_what)(std::uint8_t)) {
+        auto decode_8_bit = [&pixel_count, &input_data, &output](ColorPlatePixel (*with_what)(std::uint8_t)) {
             auto pixels_left = pixel_count;
             auto *bytes_to_add = input_data;
-            auto *bytes_to_write = data.data();
+            auto *bytes_to_write = output;
             while(pixels_left) {
                 auto from_pixel = *reinterpret_cast<const std::uint8_t *>(bytes_to_add);
                 auto to_pixel = with_what(from_pixel);
@@ -90,10 +88,10 @@ namespace Invader::BitmapEncode {
             }
         };
 
-        auto decode_16_bit = [&pixel_count, &input_data, &data](ColorPlatePixel (*with_what)(std::uint16_t)) {
+        auto decode_16_bit = [&pixel_count, &input_data, &output](ColorPlatePixel (*with_what)(std::uint16_t)) {
             auto pixels_left = pixel_count;
             auto *bytes_to_add = input_data;
-            auto *bytes_to_write = data.data();
+            auto *bytes_to_write = output;
             while(pixels_left) {
                 auto from_pixel = *reinterpret_cast<const std::uint16_t *>(bytes_to_add);
                 auto to_pixel = with_what(from_pixel);
@@ -105,84 +103,30 @@ namespace Invader::BitmapEncode {
             }
         };
         
-        auto decode_dxt = [&width, &height, &input_format, &data, &input_data]() {
-            // Get the number of DXT blocks
-            std::size_t block_h = (height + 3) / 4;
-            std::size_t block_w = (width + 3) / 4;
-            const auto *block_input = reinterpret_cast<const std::uint8_t *>(input_data);
-            
-            auto copy_block = [&width, &height](const std::uint32_t *from, HEK::LittleEndian<std::uint32_t> *to, std::size_t to_x, std::size_t to_y) {
-                for(std::uint32_t y = 0; y < 4 && y < height && (y + to_y < height); y++) {
-                    for(std::uint32_t x = 0; x < 4 && x < width && (x + to_x < width); x++) {
-                        std::uint32_t color = from[x + 4 * y];
-                        to[to_x + x + width * (to_y + y)] = ((color & 0xFF) << 24) | (((color >> 24) & 0xFF) << 16) | (((color >> 16) & 0xFF) << 8) | (((color >> 8) & 0xFF));
-                    }
-                }
-            };
-            
-            switch(input_format) {
-                case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1:
-                    for(std::size_t y = 0; y < block_h; y++) {
-                        for(std::size_t x = 0; x < block_w; x++) {
-                            std::uint32_t output[4*4];
-                            S3TCH::DecompressBlockDXT1(0, 0, 4, block_input + x * 8 + y * 8 * block_w, output);
-                            copy_block(output, data.data(), x * 4, y * 4);
-                        }
-                    }
-                    break;
-
-                case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3:
-                    for(std::size_t y = 0; y < block_h; y++) {
-                        for(std::size_t x = 0; x < block_w; x++) {
-                            std::uint32_t output[4*4];
-                            // Decompress color
-                            auto *input = block_input + x * 16 + y * 16 * block_w;
-                            S3TCH::DecompressBlockDXT1(0, 0, 4, input + 8, output);
-
-                            // Decompress alpha
-                            auto input_alpha = *reinterpret_cast<const std::uint64_t *>(input);
-                            for(std::uint32_t ya = 0; ya < 4; ya++) {
-                                for(std::uint32_t xa = 0; xa < 4; xa++) {
-                                    auto &oa = output[xa + ya * 4];
-                                    oa &= 0xFFFFFF00;
-                                    oa |= static_cast<std::uint32_t>((input_alpha & 0b1111) / 15.0 * 0xFF);
-                                    input_alpha >>= 4;
-                                }
-                            }
-                            copy_block(output, data.data(), x * 4, y * 4);
-                        }
-                    }
-                    break;
-
-                case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5:
-                    for(std::size_t y = 0; y < block_h; y++) {
-                        for(std::size_t x = 0; x < block_w; x++) {
-                            std::uint32_t output[4*4];
-                            S3TCH::DecompressBlockDXT5(0, 0, 4, block_input + x * 16 + y * 16 * block_w, output);
-                            copy_block(output, data.data(), x * 4, y * 4);
-                        }
-                    }
-                    break;
-                default:
-                    std::terminate();
-            }
-        };
-        
         switch(input_format) {
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1:
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3:
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5:
-                decode_dxt();
+                DXTDecode::decode_dxt(input_data, width, height, reinterpret_cast<std::uint32_t *>(output), input_format);
+
+                // decode_dxt writes pixels in host endian, so those need to be swapped on big endian hosts
+                if constexpr(!std::is_same_v<HEK::LittleEndian<std::uint32_t>, HEK::NativeEndian<std::uint32_t>>) {
+                    for(std::size_t i = 0; i < pixel_count; i++) {
+                        std::uint32_t pixel;
+                        std::memcpy(&pixel, output + i, sizeof(pixel));
+                        output[i] = pixel;
+                    }
+                }
                 break;
                 
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8:
-                std::memcpy(reinterpret_cast<std::byte *>(data.data()), input_data, data.size() * sizeof(data[0]));
+                std::memcpy(output, input_data, pixel_count * sizeof(*output));
                 break;
             
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_X8R8G8B8:
-                std::memcpy(reinterpret_cast<std::byte *>(data.data()), input_data, data.size() * sizeof(data[0]));
+                std::memcpy(output, input_data, pixel_count * sizeof(*output));
                 for(std::size_t i = 0; i < pixel_count; i++) {
-                    data[i] = data[i].read() | static_cast<std::uint32_t>(0xFF000000);
+                    output[i] = output[i].read() | static_cast<std::uint32_t>(0xFF000000);
                 }
                 break;
 
@@ -219,7 +163,5 @@ namespace Invader::BitmapEncode {
             default:
                 throw std::exception();
         }
-        
-        return std::vector<std::byte>(reinterpret_cast<std::byte *>(data.data()), reinterpret_cast<std::byte *>(data.data()) + data.size() * sizeof(data[0]));
     }
 }
@@ -2,10 +2,14 @@
 
 #include <optional>
 #include <algorithm>
+#include <cmath>
+
+#include "../simd.hpp"
 
 #include <invader/hek/data_type.hpp>
 #include "color_plate_scanner.hpp"
 #include <invader/printf.hpp>
+#include <invader/thread/thread_pool.hpp>
 
 namespace Invader {
     static constexpr char ERROR_INVALID_BITMAP_WIDTH[] = "Error: Found a bitmap with an invalid width: %u\n";
@@ -39,28 +43,60 @@ namespace Invader {
 
     #define GET_PIXEL(x,y) (pixels[y * width + x])
 
-    GeneratedBitmapData ColorPlateScanner::scan_color_plate(const ColorPlatePixel *pixels, std::uint32_t width, std::uint32_t height, BitmapType type, BitmapUsage usage, float bump_height, std::optional<ColorPlateScannerSpriteParameters> &sprite_parameters, std::int16_t mipmaps, HEK::InvaderBitmapMipmapScaling mipmap_type, std::optional<float> mipmap_fade_factor, std::optional<float> sharpen, std::optional<float> blur) {
+    ColorPlatePixelReader::ColorPlatePixelReader(const ColorPlatePixel *pixels, std::uint32_t width, std::uint32_t height) : next_row(pixels) {
+        this->width = width;
+        this->height = height;
+    }
+
+    void ColorPlatePixelReader::read_row(ColorPlatePixel *row) {
+        std::copy(this->next_row, this->next_row + this->width, row);
+        this->next_row += this->width;
+    }
+
+    GeneratedBitmapData ColorPlateScanner::scan_color_plate(ColorPlateReader &reader, BitmapType type, BitmapUsage usage, float bump_height, std::optional<ColorPlateScannerSpriteParameters> &sprite_parameters, std::int16_t mipmaps, HEK::InvaderBitmapMipmapScaling mipmap_type, std::optional<float> mipmap_fade_factor, std::optional<float> sharpen, std::optional<float> blur, std::size_t jobs) {
         ColorPlateScanner scanner;
         GeneratedBitmapData generated_bitmap;
 
         generated_bitmap.type = type;
         scanner.power_of_two = (type != BitmapType::BITMAP_TYPE_SPRITES) && (type != BitmapType::BITMAP_TYPE_INTERFACE_BITMAPS);
 
+        const std::uint32_t width = reader.get_width();
+        const std::uint32_t height = reader.get_height();
         if(width == 0 || height == 0) {
             return generated_bitmap;
         }
 
+        // Rows are read one at a time into here. Only the rows of the sequence being scanned are kept (in sequence_pixels).
+        std::vector<ColorPlatePixel> row(width);
+        std::vector<ColorPlatePixel> sequence_pixels;
+        std::uint32_t rows_read = 0;
+        auto read_next_row = [&reader, &row, &rows_read]() {
+            reader.read_row(row.data());
+            rows_read++;
+        };
+
+        // Scan the sequence and then discard its rows
+        auto finish_sequence = [&scanner, &generated_bitmap, &sequence_pixels, &width](std::uint32_t y_start, std::uint32_t y_end) {
+            auto &sequence = generated_bitmap.sequences.emplace_back();
+            sequence.y_start = y_start;
+            sequence.y_end = y_end;
+            scanner.read_color_plate_sequence(generated_bitmap, sequence, sequence_pixels.data(), width);
+            sequence_pixels.clear();
+        };
+
+        read_next_row();
+
         // Check to see if we have valid color plate data. If so, look for sequences
         bool valid_color_plate_key = true;
         if(width >= 4 && height >= 2) {
             // Get the candidate pixels
-            const auto &transparency_candidate = pixels[0];
-            const auto &separator_candidate = pixels[1];
-            const auto &spacing_candidate = pixels[2];
+            const auto transparency_candidate = row[0];
+            const auto separator_candidate = row[1];
+            const auto spacing_candidate = row[2];
             
             // First, check to see if everything on the top row except the first three pixels is transparency
             for(std::uint32_t x = 3; x < width; x++) {
-                if(!same_color_ignore_opacity(GET_PIXEL(x, 0), transparency_candidate)) {
+                if(!same_color_ignore_opacity(row[x], transparency_candidate)) {
                     valid_color_plate_key = false;
                     break;
                 }
@@ -73,6 +109,49 @@ namespace Invader {
                 // What we need to do next is determine if we have a sequence divider
                 if(!same_color_ignore_opacity(transparency_candidate, separator_candidate)) {
                     scanner.sequence_divider_color = separator_candidate;
+
+                    // Check spacing
+                    if(!same_color_ignore_opacity(transparency_candidate, spacing_candidate)) {
+                        scanner.spacing_color = spacing_candidate;
+
+                        // Make sure it's valid!
+                        if(same_color_ignore_opacity(separator_candidate, spacing_candidate)) {
+                            eprintf_error("Spacing and sequence divider colors must not match");
+                            throw InvalidInputBitmapException();
+                        }
+                    }
+
+                    auto is_horizontal_bar = [&scanner, &width, &row](std::uint32_t y) {
+                        if(scanner.is_sequence_divider_color(row[0])) {
+                            for(std::uint32_t x = 1; x < width; x++) {
+                                if(!scanner.is_sequence_divider_color(row[x])) {
+                                    eprintf_error("Sequence divider broken at (%u,%u)", x, y);
+                                    throw InvalidInputBitmapException();
+                                }
+                            }
+                            return true;
+                        }
+                        return false;
+                    };
+
+                    // Each horizontal bar ends a sequence and starts the next one, except one right below the key
+                    std::uint32_t y_start = 1;
+                    for(std::uint32_t y = 1; y < height; y++) {
+                        read_next_row();
+                        if(!is_horizontal_bar(y)) {
+                            sequence_pixels.insert(sequence_pixels.end(), row.begin(), row.end());
+                        }
+                        else if(y > 1) {
+                            finish_sequence(y_start, y);
+                            y_start = y + 1;
+                        }
+                        else {
+                            y_start = 2;
+                        }
+                    }
+
+                    // Terminate the last sequence
+                    finish_sequence(y_start, height);
                 }
                 
                 // If there's no sequence divider color, check if we're blue. If not, we're not a valid key (treat as one bitmap)
@@ -84,117 +163,77 @@ namespace Invader {
                 //
                 // Basically, transparency IS the sequence divider
                 else {
-                    // start_y has a value whenever we're inside a sequence
-                    std::optional<std::size_t> start_y;
-                    
-                    auto break_off_sequence = [&start_y, &generated_bitmap](std::size_t y) {
-                        if(start_y.has_value()) {
-                            auto &sequences = generated_bitmap.sequences.emplace_back();
-                            sequences.y_start = *start_y;
-                            sequences.y_end = y;
-                            start_y = std::nullopt;
-                        }
-                        else {
-                            start_y = y;
-                        }
-                    };
+                    scanner.spacing_color = ColorPlatePixel { 0xFF, 0xFF, 0x00, 0xFF };
                     
-                    for(std::size_t y = 1; y < height; y++) {
+                    if(!scanner.is_transparency_color(spacing_candidate) && !scanner.is_spacing_color(spacing_candidate)) {
+                        eprintf_error("Error: Spacing color, if set, can only be #00FFFF if sequence divider is not set");
+                        throw InvalidInputBitmapException();
+                    }
+
+                    // start_y has a value whenever we're inside a sequence
+                    std::optional<std::uint32_t> start_y;
+                    for(std::uint32_t y = 1; y < height; y++) {
+                        read_next_row();
+
                         bool all_blue = true;
-                        for(std::size_t x = 0; x < width; x++) {
-                            if(!scanner.is_transparency_color(GET_PIXEL(x,y))) {
+                        for(std::uint32_t x = 0; x < width; x++) {
+                            if(!scanner.is_transparency_color(row[x])) {
                                 all_blue = false;
                                 break;
                             }
                         }
                         
-                        // If it's all blue and we're in a sequence, then the sequence has ended
-                        if(all_blue == start_y.has_value()) {
-                            break_off_sequence(y);
+                        // If it's all blue and we're in a sequence, then the sequence has ended. Otherwise, a sequence begins if we aren't in one.
+                        if(all_blue && start_y.has_value()) {
+                            finish_sequence(*start_y, y);
+                            start_y = std::nullopt;
                         }
-                    }
-                    
-                    break_off_sequence(height);
-                    
-                    scanner.spacing_color = ColorPlatePixel { 0xFF, 0xFF, 0x00, 0xFF };
-                    
-                    if(!scanner.is_transparency_color(spacing_candidate) && !scanner.is_spacing_color(spacing_candidate)) {
-                        eprintf_error("Error: Spacing color, if set, can only be #00FFFF if sequence divider is not set");
-                        throw InvalidInputBitmapException();
-                    }
-                }
-            }
-            
-            // If we still have a valid color plate key and we don't have sequences, find them
-            if(valid_color_plate_key && !generated_bitmap.sequences.size()) {
-                // Generate sequences
-                auto *sequence = &generated_bitmap.sequences.emplace_back();
-                
-                auto is_horizontal_bar = [&scanner, &width, &pixels](std::size_t y) {
-                    if(scanner.is_sequence_divider_color(GET_PIXEL(0,y))) {
-                        for(std::size_t x = 1; x < width; x++) {
-                            if(!scanner.is_sequence_divider_color(GET_PIXEL(x,y))) {
-                                eprintf_error("Sequence divider broken at (%zu,%zu)", x, y);
-                                throw InvalidInputBitmapException();
+                        else if(!all_blue) {
+                            if(!start_y.has_value()) {
+                                start_y = y;
                             }
+                            sequence_pixels.insert(sequence_pixels.end(), row.begin(), row.end());
                         }
-                        return true;
                     }
-                    return false;
-                };
-                
-                sequence->y_start = is_horizontal_bar(1) ? 2 : 1;
-
-                // Next, we need to find all of the sequences
-                for(std::uint32_t y = sequence->y_start; y < height; y++) {
-                    // If we got it, create a new sequence, but not before terminating the last one
-                    if(is_horizontal_bar(y)) {
-                        sequence->y_end = y;
-                        sequence = &generated_bitmap.sequences.emplace_back();
-                        sequence->y_start = y + 1;
+                    
+                    if(start_y.has_value()) {
+                        finish_sequence(*start_y, height);
                     }
                 }
-
-                // Terminate the last sequence index
-                sequence->y_end = height;
-            }
-            
-            // Is it still valid? If so, check spacing
-            if(valid_color_plate_key && !scanner.spacing_color.has_value() && !same_color_ignore_opacity(transparency_candidate, spacing_candidate)) {
-                scanner.spacing_color = spacing_candidate;
-                
-                // Make sure it's valid!
-                if(same_color_ignore_opacity(separator_candidate, spacing_candidate)) {
-                    eprintf_error("Spacing and sequence divider colors must not match");
-                    throw InvalidInputBitmapException();
-                }
             }
         }
 
-        // If we have valid color plate data, use the color plate data
-        if(valid_color_plate_key) {
-            scanner.read_color_plate(generated_bitmap, pixels, width);
-        }
-
-        // Otherwise, read as one bitmap
-        else {
+        // If we don't have valid color plate data, read the whole thing as one bitmap
+        if(!valid_color_plate_key) {
             auto &new_sequence = generated_bitmap.sequences.emplace_back();
             new_sequence.bitmap_count = 1;
             new_sequence.first_bitmap = 0;
             new_sequence.y_start = 0;
             new_sequence.y_end = height;
 
-            if(type == BitmapType::BITMAP_TYPE_CUBE_MAPS) {
-                scanner.read_unrolled_cubemap(generated_bitmap, pixels, width, height);
-            }
-            else if(type == BitmapType::BITMAP_TYPE_SPRITES) {
+            if(type == BitmapType::BITMAP_TYPE_SPRITES) {
                 eprintf_error("Error: Sprite color plates must have a color plate key.\n");
                 throw InvalidInputBitmapException();
             }
+
+            std::vector<ColorPlatePixel> pixels(static_cast<std::size_t>(width) * height);
+            std::copy(row.begin(), row.end(), pixels.begin());
+            for(; rows_read < height; rows_read++) {
+                reader.read_row(pixels.data() + static_cast<std::size_t>(rows_read) * width);
+            }
+
+            if(type == BitmapType::BITMAP_TYPE_CUBE_MAPS) {
+                scanner.read_unrolled_cubemap(generated_bitmap, pixels.data(), width, height);
+            }
             else {
-                scanner.read_single_bitmap(generated_bitmap, pixels, width, height);
+                scanner.read_single_bitmap(generated_bitmap, std::move(pixels), width, height);
             }
         }
+
+        // Read whatever is left (this happens if the color plate is too small to have a key) so every row is read
+        while(rows_read < height) {
+            read_next_row();
+        }
         
         // If we have zero bitmaps, error
         if(generated_bitmap.bitmaps.size() == 0) {
@@ -219,7 +258,7 @@ namespace Invader {
 
         // If we aren't making interface bitmaps, generate mipmaps when needed
         if(type != BitmapType::BITMAP_TYPE_INTERFACE_BITMAPS && usage != BitmapUsage::BITMAP_USAGE_LIGHT_MAP) {
-            generate_mipmaps(generated_bitmap, mipmaps, mipmap_type, mipmap_fade_factor, sprite_parameters, sharpen, blur, usage);
+            generate_mipmaps(generated_bitmap, mipmaps, mipmap_type, mipmap_fade_factor, sprite_parameters, sharpen, blur, usage, jobs);
         }
 
         // If we're making cubemaps, we need to make all sides of each cubemap sequence one cubemap bitmap data. 3D textures work similarly
@@ -235,164 +274,167 @@ namespace Invader {
         return generated_bitmap;
     }
 
-    void ColorPlateScanner::read_color_plate(GeneratedBitmapData &generated_bitmap, const ColorPlatePixel *pixels, std::uint32_t width) const {
-        for(auto &sequence : generated_bitmap.sequences) {
-            sequence.first_bitmap = generated_bitmap.bitmaps.size();
-            sequence.bitmap_count = 0;
+    // pixels starts at the first row of the sequence
+    #define GET_SEQUENCE_PIXEL(x,y) (pixels[static_cast<std::size_t>(y - Y_START) * width + x])
 
-            // Search left and right for bitmap borders
-            const std::uint32_t X_END = width;
-            const std::uint32_t Y_START = sequence.y_start;
-            const std::uint32_t Y_END = sequence.y_end;
+    void ColorPlateScanner::read_color_plate_sequence(GeneratedBitmapData &generated_bitmap, GeneratedBitmapDataSequence &sequence, const ColorPlatePixel *pixels, std::uint32_t width) const {
+        sequence.first_bitmap = generated_bitmap.bitmaps.size();
+        sequence.bitmap_count = 0;
 
-            // This is used for the registration point
-            const std::int32_t MID_Y = divide_by_two_round(static_cast<std::int32_t>(Y_START + Y_END));
+        // Search left and right for bitmap borders
+        const std::uint32_t X_END = width;
+        const std::uint32_t Y_START = sequence.y_start;
+        const std::uint32_t Y_END = sequence.y_end;
 
-            // Go through each pixel
-            for(std::uint32_t x = 0; x < X_END; x++) {
-                for(std::uint32_t y = Y_START; y < Y_END; y++) {
-                    auto &pixel = GET_PIXEL(x,y);
+        // This is used for the registration point
+        const std::int32_t MID_Y = divide_by_two_round(static_cast<std::int32_t>(Y_START + Y_END));
 
-                    // Ignore? Okay.
-                    if(this->is_transparency_color(pixel) || this->is_sequence_divider_color(pixel)) {
-                        continue;
-                    }
+        // Go through each pixel
+        for(std::uint32_t x = 0; x < X_END; x++) {
+            for(std::uint32_t y = Y_START; y < Y_END; y++) {
+                auto &pixel = GET_SEQUENCE_PIXEL(x,y);
 
-                    // Begin.
-                    std::optional<std::uint32_t> min_x;
-                    std::optional<std::uint32_t> max_x;
-                    std::optional<std::uint32_t> min_y;
-                    std::optional<std::uint32_t> max_y;
-
-                    std::optional<std::uint32_t> virtual_min_x;
-                    std::optional<std::uint32_t> virtual_max_x;
-                    std::optional<std::uint32_t> virtual_min_y;
-                    std::optional<std::uint32_t> virtual_max_y;
-
-                    // Find the minimum x, y, max x, and max y stuff
-                    for(std::uint32_t xb = x; xb < X_END; xb++) {
-                        // Set this to false if we got something this column
-                        bool ignored_this_x = true;
-
-                        for(std::uint32_t yb = Y_START; yb < Y_END; yb++) {
-                            auto &pixel = GET_PIXEL(xb, yb);
-
-                            // This is for anything that's not a cyan/magenta/blue pixel
-                            if(!this->is_ignored(pixel)) {
-                                if(min_x.has_value()) {
-                                    if(min_x.value() > xb) {
-                                        min_x = xb;
-                                    }
-                                    if(min_y.value() > yb) {
-                                        min_y = yb;
-                                    }
-                                    if(max_x.value() < xb) {
-                                        max_x = xb;
-                                    }
-                                    if(max_y.value() < yb) {
-                                        max_y = yb;
-                                    }
-                                }
-                                else {
+                // Ignore? Okay.
+                if(this->is_transparency_color(pixel) || this->is_sequence_divider_color(pixel)) {
+                    continue;
+                }
+
+                // Begin.
+                std::optional<std::uint32_t> min_x;
+                std::optional<std::uint32_t> max_x;
+                std::optional<std::uint32_t> min_y;
+                std::optional<std::uint32_t> max_y;
+
+                std::optional<std::uint32_t> virtual_min_x;
+                std::optional<std::uint32_t> virtual_max_x;
+                std::optional<std::uint32_t> virtual_min_y;
+                std::optional<std::uint32_t> virtual_max_y;
+
+                // Find the minimum x, y, max x, and max y stuff
+                for(std::uint32_t xb = x; xb < X_END; xb++) {
+                    // Set this to false if we got something this column
+                    bool ignored_this_x = true;
+
+                    for(std::uint32_t yb = Y_START; yb < Y_END; yb++) {
+                        auto &pixel = GET_SEQUENCE_PIXEL(xb, yb);
+
+                        // This is for anything that's not a cyan/magenta/blue pixel
+                        if(!this->is_ignored(pixel)) {
+                            if(min_x.has_value()) {
+                                if(min_x.value() > xb) {
                                     min_x = xb;
+                                }
+                                if(min_y.value() > yb) {
                                     min_y = yb;
+                                }
+                                if(max_x.value() < xb) {
                                     max_x = xb;
+                                }
+                                if(max_y.value() < yb) {
                                     max_y = yb;
                                 }
                             }
+                            else {
+                                min_x = xb;
+                                min_y = yb;
+                                max_x = xb;
+                                max_y = yb;
+                            }
+                        }
 
-                            // Anything that's not a magenta/blue pixel then
-                            if(!this->is_transparency_color(pixel) && !this->is_sequence_divider_color(pixel)) {
-                                ignored_this_x = false;
-
-                                if(virtual_min_x.has_value()) {
-                                    if(virtual_min_x.value() > xb) {
-                                        virtual_min_x = xb;
-                                    }
-                                    if(virtual_min_y.value() > yb) {
-                                        virtual_min_y = yb;
-                                    }
-                                    if(virtual_max_x.value() < xb) {
-                                        virtual_max_x = xb;
-                                    }
-                                    if(virtual_max_y.value() < yb) {
-                                        virtual_max_y = yb;
-                                    }
-                                }
-                                else {
+                        // Anything that's not a magenta/blue pixel then
+                        if(!this->is_transparency_color(pixel) && !this->is_sequence_divider_color(pixel)) {
+                            ignored_this_x = false;
+
+                            if(virtual_min_x.has_value()) {
+                                if(virtual_min_x.value() > xb) {
                                     virtual_min_x = xb;
+                                }
+                                if(virtual_min_y.value() > yb) {
                                     virtual_min_y = yb;
+                                }
+                                if(virtual_max_x.value() < xb) {
                                     virtual_max_x = xb;
+                                }
+                                if(virtual_max_y.value() < yb) {
                                     virtual_max_y = yb;
                                 }
                             }
-                        }
-
-                        if(ignored_this_x) {
-                            break;
+                            else {
+                                virtual_min_x = xb;
+                                virtual_min_y = yb;
+                                virtual_max_x = xb;
+                                virtual_max_y = yb;
+                            }
                         }
                     }
 
-                    // If we never got a minimum x, then continue on
-                    if(!min_x.has_value()) {
-                        continue;
+                    if(ignored_this_x) {
+                        break;
                     }
+                }
 
-                    // Get the width and height
-                    std::uint32_t bitmap_width = max_x.value() - min_x.value() + 1;
-                    std::uint32_t bitmap_height = max_y.value() - min_y.value() + 1;
+                // If we never got a minimum x, then continue on
+                if(!min_x.has_value()) {
+                    continue;
+                }
 
-                    // If we require power-of-two, check
-                    if(power_of_two) {
-                        if(!is_power_of_two(bitmap_width)) {
-                            eprintf(ERROR_INVALID_BITMAP_WIDTH, bitmap_width);
-                            throw InvalidInputBitmapException();
-                        }
-                        if(!is_power_of_two(bitmap_height)) {
-                            eprintf(ERROR_INVALID_BITMAP_HEIGHT, bitmap_height);
-                            throw InvalidInputBitmapException();
-                        }
+                // Get the width and height
+                std::uint32_t bitmap_width = max_x.value() - min_x.value() + 1;
+                std::uint32_t bitmap_height = max_y.value() - min_y.value() + 1;
+
+                // If we require power-of-two, check
+                if(power_of_two) {
+                    if(!is_power_of_two(bitmap_width)) {
+                        eprintf(ERROR_INVALID_BITMAP_WIDTH, bitmap_width);
+                        throw InvalidInputBitmapException();
+                    }
+                    if(!is_power_of_two(bitmap_height)) {
+                        eprintf(ERROR_INVALID_BITMAP_HEIGHT, bitmap_height);
+                        throw InvalidInputBitmapException();
                     }
+                }
 
-                    // Add the bitmap
-                    auto &bitmap = generated_bitmap.bitmaps.emplace_back();
-                    bitmap.width = bitmap_width;
-                    bitmap.height = bitmap_height;
-                    bitmap.color_plate_x = min_x.value();
-                    bitmap.color_plate_y = min_y.value();
+                // Add the bitmap
+                auto &bitmap = generated_bitmap.bitmaps.emplace_back();
+                bitmap.width = bitmap_width;
+                bitmap.height = bitmap_height;
+                bitmap.color_plate_x = min_x.value();
+                bitmap.color_plate_y = min_y.value();
 
-                    // Calculate registration point.
-                    const std::int32_t MID_X = divide_by_two_round(static_cast<std::int32_t>(1 + virtual_max_x.value() + virtual_min_x.value()));
+                // Calculate registration point.
+                const std::int32_t MID_X = divide_by_two_round(static_cast<std::int32_t>(1 + virtual_max_x.value() + virtual_min_x.value()));
 
-                    // The x point is the midpoint of the width of the bitmap and cyan stuff relative to the left
-                    bitmap.registration_point_x = MID_X - static_cast<std::int32_t>(min_x.value());
+                // The x point is the midpoint of the width of the bitmap and cyan stuff relative to the left
+                bitmap.registration_point_x = MID_X - static_cast<std::int32_t>(min_x.value());
 
-                    // The x point is the midpoint of the height of the entire sequence relative to the top
-                    bitmap.registration_point_y = MID_Y - static_cast<std::int32_t>(min_y.value());
+                // The x point is the midpoint of the height of the entire sequence relative to the top
+                bitmap.registration_point_y = MID_Y - static_cast<std::int32_t>(min_y.value());
 
-                    // Load the pixels
-                    for(std::uint32_t by = min_y.value(); by <= max_y.value(); by++) {
-                        for(std::uint32_t bx = min_x.value(); bx <= max_x.value(); bx++) {
-                            auto &pixel = GET_PIXEL(bx, by);
-                            if(this->is_ignored(pixel)) {
-                                bitmap.pixels.push_back(ColorPlatePixel {});
-                            }
-                            else {
-                                bitmap.pixels.push_back(pixel);
-                            }
+                // Load the pixels
+                for(std::uint32_t by = min_y.value(); by <= max_y.value(); by++) {
+                    for(std::uint32_t bx = min_x.value(); bx <= max_x.value(); bx++) {
+                        auto &pixel = GET_SEQUENCE_PIXEL(bx, by);
+                        if(this->is_ignored(pixel)) {
+                            bitmap.pixels.push_back(ColorPlatePixel {});
+                        }
+                        else {
+                            bitmap.pixels.push_back(pixel);
                         }
                     }
+                }
 
-                    sequence.bitmap_count++;
+                sequence.bitmap_count++;
 
-                    // Set it to the max value. Add 1 since sprites can't possibly be adjacent to each other. Then, the for loop will add 1 again to get to the minimum possible x value.
-                    x = virtual_max_x.value() + 1;
-                    break;
-                }
+                // Set it to the max value. Add 1 since sprites can't possibly be adjacent to each other. Then, the for loop will add 1 again to get to the minimum possible x value.
+                x = virtual_max_x.value() + 1;
+                break;
             }
         }
     }
 
+    #undef GET_SEQUENCE_PIXEL
+
     void ColorPlateScanner::read_unrolled_cubemap(GeneratedBitmapData &generated_bitmap, const ColorPlatePixel *pixels, std::uint32_t width, std::uint32_t height) const {
         // Make sure the height and width of each face is the same
         std::uint32_t face_width = width / 4;
@@ -455,7 +497,7 @@ namespace Invader {
         generated_bitmap.sequences[0].bitmap_count = 6;
     }
 
-    void ColorPlateScanner::read_single_bitmap(GeneratedBitmapData &generated_bitmap, const ColorPlatePixel *pixels, std::uint32_t width, std::uint32_t height) const {
+    void ColorPlateScanner::read_single_bitmap(GeneratedBitmapData &generated_bitmap, std::vector<ColorPlatePixel> &&pixels, std::uint32_t width, std::uint32_t height) const {
         if(generated_bitmap.type != BitmapType::BITMAP_TYPE_INTERFACE_BITMAPS) {
             if(!is_power_of_two(width)) {
                 eprintf(ERROR_INVALID_BITMAP_WIDTH, width);
@@ -470,7 +512,7 @@ namespace Invader {
         auto &new_bitmap = generated_bitmap.bitmaps.emplace_back();
         new_bitmap.color_plate_x = 0;
         new_bitmap.color_plate_y = 0;
-        new_bitmap.pixels.insert(new_bitmap.pixels.begin(), pixels, pixels + width * height);
+        new_bitmap.pixels = std::move(pixels);
         new_bitmap.width = width;
         new_bitmap.height = height;
         new_bitmap.registration_point_x = divide_by_two_round(width);
@@ -561,299 +603,538 @@ namespace Invader {
         }
     }
 
-    void ColorPlateScanner::generate_mipmaps(GeneratedBitmapData &generated_bitmap, std::int16_t mipmaps, HEK::InvaderBitmapMipmapScaling mipmap_type, std::optional<float> mipmap_fade_factor, const std::optional<ColorPlateScannerSpriteParameters> &sprite_parameters, std::optional<float> sharpen, std::optional<float> blur, BitmapUsage usage) {
-        auto mipmaps_unsigned = static_cast<std::uint32_t>(mipmaps);
-        float fade = mipmap_fade_factor.value_or(0.0F);
+    namespace {
+        /** Pixel data with each channel stored separately as floats so filters can work on many pixels at once */
+        struct PlanarBitmap {
+            enum Channel {
+                CHANNEL_ALPHA,
+                CHANNEL_RED,
+                CHANNEL_GREEN,
+                CHANNEL_BLUE,
 
-        for(auto &bitmap : generated_bitmap.bitmaps) {
-            std::uint32_t mipmap_width = bitmap.width;
-            std::uint32_t mipmap_height = bitmap.height;
-            std::uint32_t max_mipmap_count = mipmap_width > mipmap_height ? log2_int(mipmap_width) : log2_int(mipmap_height);
-            if(max_mipmap_count > mipmaps_unsigned) {
-                max_mipmap_count = mipmaps_unsigned;
+                CHANNEL_COUNT
+            };
+
+            std::uint32_t width;
+            std::uint32_t height;
+            std::vector<float> channels[CHANNEL_COUNT];
+
+            PlanarBitmap(std::uint32_t width, std::uint32_t height) : width(width), height(height) {
+                for(auto &channel : this->channels) {
+                    channel.resize(static_cast<std::size_t>(width) * height);
+                }
             }
+        };
 
-            // Only generate up to log2(spacing) mipmaps for sprites
-            if(generated_bitmap.type == BitmapType::BITMAP_TYPE_SPRITES) {
-                auto sprite_spacing = sprite_parameters.value().sprite_spacing;
-                if(sprite_spacing == 0) {
-                    max_mipmap_count = 0;
+        /** Taps used to halve a dimension; output pixel x is the sum of weights[i] * input[x * 2 + first_offset + i] */
+        struct DownsampleKernel {
+            std::int32_t first_offset;
+            std::vector<float> weights;
+        };
+    }
+
+    /** Add input * scale to output */
+    static void add_scaled(float *output, const float *input, float scale, std::size_t count) {
+        std::size_t i = 0;
+        #ifdef INVADER_SSE2
+        auto scale_vector = _mm_set1_ps(scale);
+        for(; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(_mm_loadu_ps(input + i), scale_vector)));
+        }
+        #endif
+        for(; i < count; i++) {
+            output[i] += input[i] * scale;
+        }
+    }
+
+    /** Clamp everything to 0-255, as sharpening and windowed sinc filters can overshoot */
+    static void clamp_channel(float *values, std::size_t count) {
+        std::size_t i = 0;
+        #ifdef INVADER_SSE2
+        auto min_vector = _mm_setzero_ps();
+        auto max_vector = _mm_set1_ps(255.0F);
+        for(; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(values + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(values + i), min_vector), max_vector));
+        }
+        #endif
+        for(; i < count; i++) {
+            values[i] = std::clamp(values[i], 0.0F, 255.0F);
+        }
+    }
+
+    /** Copy a row with its edge pixels repeated padding times on either side */
+    static void pad_row(const float *row, std::size_t width, std::size_t padding, std::vector<float> &padded) {
+        padded.resize(width + padding * 2);
+        std::fill(padded.begin(), padded.begin() + padding, row[0]);
+        std::copy(row, row + width, padded.begin() + padding);
+        std::fill(padded.begin() + padding + width, padded.end(), row[width - 1]);
+    }
+
+    static PlanarBitmap to_planar(const ColorPlatePixel *pixels, std::uint32_t width, std::uint32_t height) {
+        PlanarBitmap bitmap(width, height);
+        std::size_t pixel_count = static_cast<std::size_t>(width) * height;
+
+        // Pixels are bytes, so hold onto each channel's pointer or the compiler has to assume writing a pixel can change it
+        float *alpha = bitmap.channels[PlanarBitmap::CHANNEL_ALPHA].data();
+        float *red = bitmap.channels[PlanarBitmap::CHANNEL_RED].data();
+        float *green = bitmap.channels[PlanarBitmap::CHANNEL_GREEN].data();
+        float *blue = bitmap.channels[PlanarBitmap::CHANNEL_BLUE].data();
+        for(std::size_t i = 0; i < pixel_count; i++) {
+            alpha[i] = pixels[i].alpha;
+            red[i] = pixels[i].red;
+            green[i] = pixels[i].green;
+            blue[i] = pixels[i].blue;
+        }
+        return bitmap;
+    }
+
+    static void from_planar(const PlanarBitmap &bitmap, ColorPlatePixel *pixels) {
+        auto to_8_bit = [](float value) { return static_cast<std::uint8_t>(value + 0.5F); };
+        std::size_t pixel_count = static_cast<std::size_t>(bitmap.width) * bitmap.height;
+        const float *alpha = bitmap.channels[PlanarBitmap::CHANNEL_ALPHA].data();
+        const float *red = bitmap.channels[PlanarBitmap::CHANNEL_RED].data();
+        const float *green = bitmap.channels[PlanarBitmap::CHANNEL_GREEN].data();
+        const float *blue = bitmap.channels[PlanarBitmap::CHANNEL_BLUE].data();
+        std::size_t i = 0;
+        #ifdef INVADER_SSE2
+        auto half = _mm_set1_ps(0.5F);
+        auto to_32_bit = [&half](const float *channel) { return _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(channel), half)); };
+        for(; i + 4 <= pixel_count; i += 4) {
+            auto packed = _mm_or_si128(_mm_or_si128(to_32_bit(blue + i), _mm_slli_epi32(to_32_bit(green + i), 8)), _mm_or_si128(_mm_slli_epi32(to_32_bit(red + i), 16), _mm_slli_epi32(to_32_bit(alpha + i), 24)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), packed);
+        }
+        #endif
+        for(; i < pixel_count; i++) {
+            pixels[i].alpha = to_8_bit(alpha[i]);
+            pixels[i].red = to_8_bit(red[i]);
+            pixels[i].green = to_8_bit(green[i]);
+            pixels[i].blue = to_8_bit(blue[i]);
+        }
+    }
+
+    static DownsampleKernel make_downsample_kernel(HEK::InvaderBitmapMipmapScaling mipmap_type) {
+        // A 2x2 box filter
+        if(mipmap_type != HEK::InvaderBitmapMipmapScaling::INVADER_BITMAP_MIPMAP_SCALING_LANCZOS && mipmap_type != HEK::InvaderBitmapMipmapScaling::INVADER_BITMAP_MIPMAP_SCALING_KAISER) {
+            return DownsampleKernel { 0, { 0.5F, 0.5F } };
+        }
+
+        // Otherwise, a windowed sinc filter with a radius of 3 output pixels (12 input pixels)
+        static constexpr std::int32_t RADIUS = 3;
+        static constexpr double KAISER_BETA = 4.0;
+        static constexpr double PI = 3.14159265358979323846;
+
+        auto sinc = [](double x) { return std::sin(PI * x) / (PI * x); };
+        auto bessel_i0 = [](double x) {
+            double sum = 1.0, term = 1.0;
+            for(int k = 1; k < 20; k++) {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        };
+
+        DownsampleKernel kernel;
+        kernel.first_offset = 1 - RADIUS * 2;
+        double total = 0.0;
+        std::vector<double> weights;
+        for(std::int32_t offset = kernel.first_offset; offset <= RADIUS * 2; offset++) {
+            // Distance between the center of the input pixel and the center of the output pixel, in output pixels
+            double distance = (offset - 0.5) / 2.0;
+            double window;
+            if(mipmap_type == HEK::InvaderBitmapMipmapScaling::INVADER_BITMAP_MIPMAP_SCALING_LANCZOS) {
+                window = sinc(distance / RADIUS);
+            }
+            else {
+                double t = distance / RADIUS;
+                window = bessel_i0(KAISER_BETA * std::sqrt(1.0 - t * t)) / bessel_i0(KAISER_BETA);
+            }
+            total += weights.emplace_back(sinc(distance) * window);
+        }
+        for(auto w : weights) {
+            kernel.weights.emplace_back(static_cast<float>(w / total));
+        }
+        return kernel;
+    }
+
+    /** Average each 2x2 quad of two rows */
+    static void box_downsample_row(const float *top, const float *bottom, float *output, std::size_t width) {
+        std::size_t x = 0;
+        #ifdef INVADER_SSE2
+        auto quarter = _mm_set1_ps(0.25F);
+        for(; x + 4 <= width; x += 4) {
+            auto low = _mm_add_ps(_mm_loadu_ps(top + x * 2), _mm_loadu_ps(bottom + x * 2));
+            auto high = _mm_add_ps(_mm_loadu_ps(top + x * 2 + 4), _mm_loadu_ps(bottom + x * 2 + 4));
+            auto sum = _mm_add_ps(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm_storeu_ps(output + x, _mm_mul_ps(sum, quarter));
+        }
+        #endif
+        for(; x < width; x++) {
+            output[x] = (top[x * 2] + top[x * 2 + 1] + bottom[x * 2] + bottom[x * 2 + 1]) * 0.25F;
+        }
+    }
+
+    /** Halve the bitmap in each dimension that is larger than 1 */
+    static PlanarBitmap downsample(const PlanarBitmap &input, const DownsampleKernel &kernel, bool filter_color, bool filter_alpha, bool discard_transparent) {
+        std::uint32_t width = std::max(input.width / 2, static_cast<std::uint32_t>(1));
+        std::uint32_t height = std::max(input.height / 2, static_cast<std::uint32_t>(1));
+        bool downsample_x = width < input.width;
+        bool downsample_y = height < input.height;
+        PlanarBitmap output(width, height);
+
+        // Fully transparent pixels shouldn't bleed their color into the next mipmap
+        const PlanarBitmap *source = &input;
+        std::optional<PlanarBitmap> opaque_input;
+        if(discard_transparent) {
+            source = &opaque_input.emplace(input);
+            std::size_t pixel_count = static_cast<std::size_t>(input.width) * input.height;
+            for(std::size_t i = 0; i < pixel_count; i++) {
+                if(input.channels[PlanarBitmap::CHANNEL_ALPHA][i] < 0.5F) {
+                    for(auto &channel : opaque_input->channels) {
+                        channel[i] = 0.0F;
+                    }
                 }
-                else {
-                    auto max_mipmaps_sprites = log2_int(sprite_parameters.value().sprite_spacing);
-                    if(max_mipmap_count > max_mipmaps_sprites) {
-                        max_mipmap_count = max_mipmaps_sprites;
+            }
+        }
+
+        // Split each padded row into even and odd pixels so each tap is a contiguous multiply-add
+        std::size_t tap_count = kernel.weights.size();
+        std::size_t padding = static_cast<std::size_t>(std::max(-kernel.first_offset, static_cast<std::int32_t>(tap_count) + kernel.first_offset));
+        padding += padding & 1;
+        bool box = tap_count == 2 && kernel.first_offset == 0;
+        std::vector<float> even, odd;
+        std::vector<float> horizontal(static_cast<std::size_t>(width) * input.height);
+
+        for(std::size_t c = 0; c < PlanarBitmap::CHANNEL_COUNT; c++) {
+            const auto &input_channel = source->channels[c];
+            auto &output_channel = output.channels[c];
+            bool filter = c == PlanarBitmap::CHANNEL_ALPHA ? filter_alpha : filter_color;
+
+            // Nearest neighbor just takes the top-left pixel
+            if(!filter) {
+                for(std::size_t y = 0; y < height; y++) {
+                    const float *input_row = input_channel.data() + (downsample_y ? y * 2 : y) * input.width;
+                    float *output_row = output_channel.data() + y * width;
+                    for(std::size_t x = 0; x < width; x++) {
+                        output_row[x] = input_row[downsample_x ? x * 2 : x];
                     }
                 }
+                continue;
             }
 
-            // Delete mipmaps if needed
-            while(bitmap.mipmaps.size() > max_mipmap_count) {
-                auto mipmap_to_remove = bitmap.mipmaps.begin() + (bitmap.mipmaps.size() - 1);
-                auto first_pixel = bitmap.pixels.begin() + mipmap_to_remove->first_pixel;
-                auto last_pixel = first_pixel + mipmap_to_remove->pixel_count;
-                bitmap.pixels.erase(first_pixel, last_pixel);
-                bitmap.mipmaps.erase(mipmap_to_remove);
+            // A box filter over both dimensions is just the average of each 2x2 quad
+            if(box && downsample_x && downsample_y) {
+                for(std::size_t y = 0; y < height; y++) {
+                    box_downsample_row(input_channel.data() + y * 2 * input.width, input_channel.data() + (y * 2 + 1) * input.width, output_channel.data() + y * width, width);
+                }
+                continue;
             }
 
-            // If we don't need to generate mipmaps, bail
-            if(bitmap.mipmaps.size() == max_mipmap_count) {
-                return;
+            // Filter horizontally
+            if(downsample_x) {
+                std::fill(horizontal.begin(), horizontal.end(), 0.0F);
+                even.resize(width + padding);
+                odd.resize(width + padding);
+                auto last_column = static_cast<std::int64_t>(input.width) - 1;
+                for(std::size_t y = 0; y < input.height; y++) {
+                    const float *input_row = input_channel.data() + y * input.width;
+                    for(std::size_t i = 0; i < even.size(); i++) {
+                        auto x = static_cast<std::int64_t>(i * 2) - static_cast<std::int64_t>(padding);
+                        even[i] = input_row[std::clamp(x, static_cast<std::int64_t>(0), last_column)];
+                        odd[i] = input_row[std::clamp(x + 1, static_cast<std::int64_t>(0), last_column)];
+                    }
+
+                    float *output_row = horizontal.data() + y * width;
+                    for(std::size_t t = 0; t < tap_count; t++) {
+                        std::size_t padded_offset = static_cast<std::size_t>(kernel.first_offset + static_cast<std::int32_t>(t + padding));
+                        const auto &parity = (padded_offset & 1) ? odd : even;
+                        add_scaled(output_row, parity.data() + padded_offset / 2, kernel.weights[t], width);
+                    }
+                }
+            }
+            else {
+                std::copy(input_channel.begin(), input_channel.end(), horizontal.begin());
             }
 
-            // Now generate mipmaps
-            std::uint32_t last_mipmap_offset = 0;
-            if(bitmap.mipmaps.size() > 0) {
-                auto &last_mipmap = bitmap.mipmaps[bitmap.mipmaps.size() - 1];
-                last_mipmap_offset = last_mipmap.first_pixel;
-                mipmap_width = last_mipmap.mipmap_width;
-                mipmap_height = last_mipmap.mipmap_height;
+            // Then vertically
+            if(downsample_y) {
+                auto last_row = static_cast<std::int64_t>(input.height) - 1;
+                for(std::size_t y = 0; y < height; y++) {
+                    float *output_row = output_channel.data() + y * width;
+                    for(std::size_t t = 0; t < tap_count; t++) {
+                        auto input_y = std::clamp(static_cast<std::int64_t>(y * 2) + kernel.first_offset + static_cast<std::int64_t>(t), static_cast<std::int64_t>(0), last_row);
+                        add_scaled(output_row, horizontal.data() + input_y * width, kernel.weights[t], width);
+                    }
+                }
+            }
+            else {
+                std::copy(horizontal.begin(), horizontal.end(), output_channel.begin());
             }
 
-            // Apply a sharpen filter? https://en.wikipedia.org/wiki/Unsharp_masking
-            if(sharpen.has_value() && sharpen.value() > 0.0F) {
-                const float &SHARPEN_VALUE = sharpen.value();
-
-                // Make a copy of the mipmap to work off of
-                auto *pixel_data = bitmap.pixels.data();
-                std::vector<ColorPlatePixel> unsharpened_pixels(pixel_data, pixel_data + mipmap_width * mipmap_height);
-
-                // Go through each pixel and apply the sharpening filter
-                for(std::uint32_t y = 0; y < mipmap_height; y++) {
-                    for(std::uint32_t x = 0; x < mipmap_width; x++) {
-                        auto &center = unsharpened_pixels[x + y * mipmap_width];
-                        auto &left = (x == 0) ? center : unsharpened_pixels[x + y * mipmap_width - 1];
-                        auto &right = (x + 1 == mipmap_width) ? center : unsharpened_pixels[x + y * mipmap_width + 1];
-                        auto &top = (y == 0) ? center : unsharpened_pixels[x + (y - 1) * mipmap_width];
-                        auto &bottom = (y + 1 == mipmap_height) ? center : unsharpened_pixels[x + (y + 1) * mipmap_width];
-                        auto &this_pixel = pixel_data[x + y * mipmap_width];
-
-                        #define APPLY_SHARPEN(channel) { \
-                            std::int32_t modification = static_cast<std::int32_t>(center.channel) * (1.0 + 4.0F * SHARPEN_VALUE) - (static_cast<std::int32_t>(top.channel) + left.channel + bottom.channel + right.channel) * SHARPEN_VALUE; \
-                            if(modification > 0xFF) { \
-                                this_pixel.channel = 0xFF; \
-                            } \
-                            else if(modification < 0x00) { \
-                                this_pixel.channel = 0x00; \
-                            } \
-                            else { \
-                                this_pixel.channel = static_cast<std::uint8_t>(modification); \
-                            } \
-                        }
+            clamp_channel(output_channel.data(), output_channel.size());
+        }
 
-                        APPLY_SHARPEN(red);
-                        APPLY_SHARPEN(green);
-                        APPLY_SHARPEN(blue);
+        return output;
+    }
 
-                        #undef APPLY_SHARPEN
+    /**
+     * Make the first mipmap with a box filter straight from the base bitmap, since converting the whole base bitmap to floats first costs more
+     * than the filter itself. Both dimensions must be at least 2.
+     */
+    static PlanarBitmap box_downsample_base(const ColorPlatePixel *pixels, std::uint32_t input_width, std::uint32_t input_height, bool filter_color, bool filter_alpha, bool discard_transparent) {
+        std::uint32_t width = input_width / 2;
+        std::uint32_t height = input_height / 2;
+        PlanarBitmap output(width, height);
+        float *alpha = output.channels[PlanarBitmap::CHANNEL_ALPHA].data();
+        float *red = output.channels[PlanarBitmap::CHANNEL_RED].data();
+        float *green = output.channels[PlanarBitmap::CHANNEL_GREEN].data();
+        float *blue = output.channels[PlanarBitmap::CHANNEL_BLUE].data();
+
+        for(std::size_t y = 0; y < height; y++) {
+            const ColorPlatePixel *top = pixels + y * 2 * input_width;
+            const ColorPlatePixel *bottom = top + input_width;
+            for(std::size_t x = 0; x < width; x++) {
+                const ColorPlatePixel quad[4] = { top[x * 2], top[x * 2 + 1], bottom[x * 2], bottom[x * 2 + 1] };
+                std::uint32_t sum[PlanarBitmap::CHANNEL_COUNT] = {};
+                for(auto &p : quad) {
+                    sum[PlanarBitmap::CHANNEL_ALPHA] += p.alpha;
+
+                    // Same as downsample(); fully transparent pixels count as black
+                    if(!discard_transparent || p.alpha != 0) {
+                        sum[PlanarBitmap::CHANNEL_RED] += p.red;
+                        sum[PlanarBitmap::CHANNEL_GREEN] += p.green;
+                        sum[PlanarBitmap::CHANNEL_BLUE] += p.blue;
                     }
                 }
+
+                std::size_t i = y * width + x;
+                if(filter_color) {
+                    red[i] = static_cast<float>(sum[PlanarBitmap::CHANNEL_RED]) * 0.25F;
+                    green[i] = static_cast<float>(sum[PlanarBitmap::CHANNEL_GREEN]) * 0.25F;
+                    blue[i] = static_cast<float>(sum[PlanarBitmap::CHANNEL_BLUE]) * 0.25F;
+                }
+                else {
+                    bool discard = discard_transparent && quad[0].alpha == 0;
+                    red[i] = discard ? 0.0F : quad[0].red;
+                    green[i] = discard ? 0.0F : quad[0].green;
+                    blue[i] = discard ? 0.0F : quad[0].blue;
+                }
+                alpha[i] = filter_alpha ? static_cast<float>(sum[PlanarBitmap::CHANNEL_ALPHA]) * 0.25F : quad[0].alpha;
             }
+        }
 
-            // Get blur radius
-            std::uint32_t blur_pixels = static_cast<std::uint32_t>(blur.value_or(0.0F) + 0.5F);
-            if(blur_pixels > 0) {
-                auto *pixel_data = bitmap.pixels.data();
-                std::vector<ColorPlatePixel> unblurred(pixel_data, pixel_data + mipmap_width * mipmap_height);
+        return output;
+    }
 
-                std::uint32_t blur_size = blur_pixels * 2 + 1;
+    /** Apply an unsharp mask to the color channels: the center pixel minus the sum of the second derivatives in each direction */
+    static void sharpen_bitmap(PlanarBitmap &bitmap, float amount) {
+        std::size_t width = bitmap.width;
+        std::size_t height = bitmap.height;
+        std::vector<float> padded;
+        std::vector<float> sharpened(width * height);
+
+        for(auto c : { PlanarBitmap::CHANNEL_RED, PlanarBitmap::CHANNEL_GREEN, PlanarBitmap::CHANNEL_BLUE }) {
+            auto &channel = bitmap.channels[c];
+            std::fill(sharpened.begin(), sharpened.end(), 0.0F);
+            for(std::size_t y = 0; y < height; y++) {
+                const float *row = channel.data() + y * width;
+                float *output_row = sharpened.data() + y * width;
+
+                // Horizontal neighbors
+                pad_row(row, width, 1, padded);
+                add_scaled(output_row, row, 1.0F + 4.0F * amount, width);
+                add_scaled(output_row, padded.data(), -amount, width);
+                add_scaled(output_row, padded.data() + 2, -amount, width);
+
+                // Vertical neighbors
+                add_scaled(output_row, channel.data() + (y == 0 ? 0 : y - 1) * width, -amount, width);
+                add_scaled(output_row, channel.data() + (y + 1 == height ? y : y + 1) * width, -amount, width);
+            }
+            clamp_channel(sharpened.data(), sharpened.size());
+            channel.swap(sharpened);
+        }
+    }
 
-                // Allocate a filter of the correct size
-                std::vector<ColorPlatePixel *> pixel_filter(blur_size * blur_size);
+    /** Apply a box blur to the color channels, one dimension at a time */
+    static void blur_bitmap(PlanarBitmap &bitmap, std::uint32_t radius) {
+        std::size_t width = bitmap.width;
+        std::size_t height = bitmap.height;
+        std::size_t size = radius * 2 + 1;
+        float scale = 1.0F / static_cast<float>(size * size);
+        std::vector<float> padded;
+        std::vector<float> horizontal(width * height);
+
+        for(auto c : { PlanarBitmap::CHANNEL_RED, PlanarBitmap::CHANNEL_GREEN, PlanarBitmap::CHANNEL_BLUE }) {
+            auto &channel = bitmap.channels[c];
+
+            std::fill(horizontal.begin(), horizontal.end(), 0.0F);
+            for(std::size_t y = 0; y < height; y++) {
+                pad_row(channel.data() + y * width, width, radius, padded);
+                for(std::size_t t = 0; t < size; t++) {
+                    add_scaled(horizontal.data() + y * width, padded.data() + t, 1.0F, width);
+                }
+            }
 
-                for(std::int64_t y = 0; y < mipmap_height; y++) {
-                    for(std::int64_t x = 0; x < mipmap_width; x++) {
-                        // Generate the filter
-                        for(std::uint32_t yf = 0; yf < blur_size; yf++) {
-                            for(std::uint32_t xf = 0; xf < blur_size; xf++) {
-                                std::int64_t blur_x = static_cast<std::int64_t>(xf) - blur_pixels + x;
-                                std::int64_t blur_y = static_cast<std::int64_t>(yf) - blur_pixels + y;
+            std::fill(channel.begin(), channel.end(), 0.0F);
+            auto last_row = static_cast<std::int64_t>(height) - 1;
+            for(std::size_t y = 0; y < height; y++) {
+                for(std::size_t t = 0; t < size; t++) {
+                    auto input_y = std::clamp(static_cast<std::int64_t>(y + t) - static_cast<std::int64_t>(radius), static_cast<std::int64_t>(0), last_row);
+                    add_scaled(channel.data() + y * width, horizontal.data() + input_y * width, scale, width);
+                }
+            }
+        }
+    }
 
-                                std::uint32_t pixel_x = (blur_x < 0) ? 0 : (blur_x >= mipmap_width) ? (mipmap_width - 1) : static_cast<std::uint32_t>(blur_x);
-                                std::uint32_t pixel_y = (blur_y < 0) ? 0 : (blur_y >= mipmap_height) ? (mipmap_height - 1) : static_cast<std::uint32_t>(blur_y);
+    static void generate_bitmap_mipmaps(GeneratedBitmapDataBitmap &bitmap, std::uint32_t mipmap_count, HEK::InvaderBitmapMipmapScaling mipmap_type, std::optional<float> mipmap_fade_factor, std::optional<float> sharpen, std::optional<float> blur, BitmapUsage usage) {
+        // Start with just the base bitmap
+        std::size_t base_pixel_count = static_cast<std::size_t>(bitmap.width) * bitmap.height;
+        bitmap.pixels.resize(base_pixel_count);
+        bitmap.mipmaps.clear();
 
-                                pixel_filter[xf + yf * blur_size] = unblurred.data() + pixel_x + pixel_y * mipmap_width;
-                            }
-                        }
+        // If we don't need to generate mipmaps, bail
+        if(mipmap_count == 0) {
+            return;
+        }
 
-                        // Do it
-                        #define BLUR_CHANNEL(channel) { \
-                            std::uint32_t channel_value = 0; \
-                            for(auto *color : pixel_filter) { \
-                                channel_value += color->channel; \
-                            } \
-                            channel_value /= pixel_filter.size(); \
-                            if(channel_value > 0xFF) { \
-                                channel_value = 0xFF; \
-                            } \
-                            pixel_data[x + y * mipmap_width].channel = static_cast<std::uint8_t>(channel_value); \
-                        }
+        auto kernel = make_downsample_kernel(mipmap_type);
+        bool filter_color = mipmap_type != HEK::InvaderBitmapMipmapScaling::INVADER_BITMAP_MIPMAP_SCALING_NEAREST;
+        bool filter_alpha = filter_color && mipmap_type != HEK::InvaderBitmapMipmapScaling::INVADER_BITMAP_MIPMAP_SCALING_NEAREST_ALPHA && usage != BitmapUsage::BITMAP_USAGE_VECTOR_MAP;
+        bool discard_transparent = usage == BitmapUsage::BITMAP_USAGE_ALPHA_BLEND;
+        std::uint32_t blur_pixels = static_cast<std::uint32_t>(blur.value_or(0.0F) + 0.5F);
+        bool sharpen_base = sharpen.has_value() && sharpen.value() > 0.0F;
+        bool blur_base = blur_pixels > 0;
+
+        // Lay out every mipmap first so the pixel data only has to be resized once
+        std::size_t first_pixel = base_pixel_count;
+        std::uint32_t mipmap_width = bitmap.width;
+        std::uint32_t mipmap_height = bitmap.height;
+        for(std::uint32_t m = 0; m < mipmap_count; m++) {
+            mipmap_width = std::max(mipmap_width / 2, static_cast<std::uint32_t>(1));
+            mipmap_height = std::max(mipmap_height / 2, static_cast<std::uint32_t>(1));
+            auto &mipmap = bitmap.mipmaps.emplace_back();
+            mipmap.first_pixel = static_cast<std::uint32_t>(first_pixel);
+            mipmap.mipmap_width = mipmap_width;
+            mipmap.mipmap_height = mipmap_height;
+            mipmap.pixel_count = mipmap_width * mipmap_height;
+            first_pixel += mipmap.pixel_count;
+        }
+        bitmap.pixels.resize(first_pixel);
 
-                        BLUR_CHANNEL(red);
-                        BLUR_CHANNEL(green);
-                        BLUR_CHANNEL(blue);
+        std::optional<PlanarBitmap> level;
+        if(!sharpen_base && !blur_base && kernel.weights.size() == 2 && bitmap.width >= 2 && bitmap.height >= 2) {
+            level = box_downsample_base(bitmap.pixels.data(), bitmap.width, bitmap.height, filter_color, filter_alpha, discard_transparent);
+        }
+        else {
+            auto base = to_planar(bitmap.pixels.data(), bitmap.width, bitmap.height);
 
-                        #undef BLUR_CHANNEL
-                    }
-                }
+            // Apply a sharpen filter? https://en.wikipedia.org/wiki/Unsharp_masking
+            if(sharpen_base) {
+                sharpen_bitmap(base, sharpen.value());
+            }
+            if(blur_base) {
+                blur_bitmap(base, blur_pixels);
+            }
+            if(sharpen_base || blur_base) {
+                from_planar(base, bitmap.pixels.data());
             }
 
-            auto last_mipmap_height = mipmap_height;
-            auto last_mipmap_width = mipmap_width;
-            
-            mipmap_height = std::max(static_cast<std::size_t>(mipmap_height / 2), static_cast<std::size_t>(1));
-            mipmap_width = std::max(static_cast<std::size_t>(mipmap_width / 2), static_cast<std::size_t>(1));
-
-            while(bitmap.mipmaps.size() < max_mipmap_count) {
-                // Begin creating the mipmap
-                auto &next_mipmap = bitmap.mipmaps.emplace_back();
-                std::size_t this_mipmap_offset = bitmap.pixels.size();
-                next_mipmap.first_pixel = static_cast<std::uint32_t>(this_mipmap_offset);
-                next_mipmap.pixel_count = mipmap_height * mipmap_width;
-                next_mipmap.mipmap_height = mipmap_height;
-                next_mipmap.mipmap_width = mipmap_width;
-
-                // Insert all the pixels needed for the mipmap
-                bitmap.pixels.insert(bitmap.pixels.end(), mipmap_height * mipmap_width, ColorPlatePixel {});
-                auto *last_mipmap_data = bitmap.pixels.data() + last_mipmap_offset;
-                auto *this_mipmap_data = bitmap.pixels.data() + next_mipmap.first_pixel;
-
-                // Combine each 2x2 block based on the given algorithm
-                for(std::uint32_t y = 0; y < mipmap_height; y++) {
-                    for(std::uint32_t x = 0; x < mipmap_width; x++) {
-                        auto &pixel = this_mipmap_data[x + y * mipmap_width];
-                        
-                        // Start getting our pixels for mipmaps
-                        ColorPlatePixel last_a, last_b, last_c, last_d;
-                        last_a = last_mipmap_data[x * 2 + y * 2 * last_mipmap_width];
-                        
-                        // If we went down a dimension, use the pixel from the last mipmap. Otherwise, just use last_a so we don't go out-of-bounds
-                        bool went_down_both_dimensions = true;
-                        
-                        // Right pixel
-                        if(mipmap_width < last_mipmap_width) {
-                            last_b = last_mipmap_data[x * 2 + 1 + y * 2 * last_mipmap_width];
-                        }
-                        else {
-                            last_b = last_a;
-                            went_down_both_dimensions = false;
-                        }
-                        
-                        // Bottom pixel
-                        if(mipmap_height < last_mipmap_height) {
-                            last_c = last_mipmap_data[x * 2     + (y * 2 + 1) * last_mipmap_width];
-                        }
-                        else {
-                            last_c = last_a;
-                            went_down_both_dimensions = false;
-                        }
-                        
-                        // Bottom-right pixel - this one's a little tricky
-                        if(went_down_both_dimensions) {
-                            last_d = last_mipmap_data[x * 2 + 1 + (y * 2 + 1) * last_mipmap_width];
-                        }
-                        else if(mipmap_height < last_mipmap_height) {
-                            last_d = last_c;
-                        }
-                        else if(mipmap_width < last_mipmap_width) {
-                            last_d = last_b;
-                        }
-                        else {
-                            last_d = last_a;
-                        }
-                        
-                        int pixel_count = 4;
-                        pixel = last_a;
+            level = downsample(base, kernel, filter_color, filter_alpha, discard_transparent);
+        }
 
-                        #define INTERPOLATE_CHANNEL(channel) pixel.channel = static_cast<std::uint8_t>((static_cast<std::uint16_t>(last_a.channel) + static_cast<std::uint16_t>(last_b.channel) + static_cast<std::uint16_t>(last_c.channel) + static_cast<std::uint16_t>(last_d.channel)) / 4)
-                        #define ZERO_OUT_IF_NO_ALPHA(what) if(what.alpha == 0) { what = {}; pixel_count--; }
-                        
-                        // If alpha blend, discard anything with 0 alpha
-                        if(usage == BitmapUsage::BITMAP_USAGE_ALPHA_BLEND) {
-                            ZERO_OUT_IF_NO_ALPHA(last_a);
-                            ZERO_OUT_IF_NO_ALPHA(last_b);
-                            ZERO_OUT_IF_NO_ALPHA(last_c);
-                            ZERO_OUT_IF_NO_ALPHA(last_d);
-                        }
-                        
-                        if(pixel_count > 0) {
-                            // Interpolate color?
-                            if(mipmap_type == HEK::InvaderBitmapMipmapScaling::INVADER_BITMAP_MIPMAP_SCALING_LINEAR || mipmap_type == HEK::InvaderBitmapMipmapScaling::INVADER_BITMAP_MIPMAP_SCALING_NEAREST_ALPHA) {
-                                INTERPOLATE_CHANNEL(red);
-                                INTERPOLATE_CHANNEL(green);
-                                INTERPOLATE_CHANNEL(blue);
-                            }
+        // Each mipmap is made from the previous one without rounding it to 8-bit first
+        for(std::uint32_t m = 0; m < mipmap_count; m++) {
+            if(m > 0) {
+                level = downsample(*level, kernel, filter_color, filter_alpha, discard_transparent);
+            }
+            from_planar(*level, bitmap.pixels.data() + bitmap.mipmaps[m].first_pixel);
+        }
 
-                            // Interpolate alpha?
-                            if(mipmap_type == HEK::InvaderBitmapMipmapScaling::INVADER_BITMAP_MIPMAP_SCALING_LINEAR && usage != BitmapUsage::BITMAP_USAGE_VECTOR_MAP) {
-                                INTERPOLATE_CHANNEL(alpha);
-                            }
-                        }
-                        else {
-                            // Delete if no pixels
-                            pixel = {};
-                        }
-                        
-                        #undef ZERO_OUT_IF_NO_ALPHA
-                        #undef INTERPOLATE_CHANNEL
-                    }
-                }
+        // Do fade-to-gray for each mipmap
+        if(mipmap_fade_factor.has_value()) {
+            float fade = mipmap_fade_factor.value();
+            float mipmap_count_plus_one = mipmap_count + 1.0F; // although Guerilla only mentions mipmaps in the fade-to-gray stuff, it includes the first bitmap in the calculation
+            float overall_fade_factor = static_cast<float>(mipmap_count_plus_one) - static_cast<float>(fade) * (mipmap_count_plus_one - 1.0F + (1.0F - fade)); // excuse me what the fuck
 
-                // Set the values for the next mipmap
-                last_mipmap_height = mipmap_height;
-                last_mipmap_width = mipmap_width;
-                mipmap_height = std::max(static_cast<std::size_t>(mipmap_height / 2), static_cast<std::size_t>(1));
-                mipmap_width = std::max(static_cast<std::size_t>(mipmap_width / 2), static_cast<std::size_t>(1));
-                last_mipmap_offset = this_mipmap_offset;
-            }
+            for(std::size_t m = 0; m < mipmap_count; m++) {
+                auto &mipmap = bitmap.mipmaps[m];
 
-            // Do fade-to-gray for each mipmap
-            if(mipmap_fade_factor.has_value()) {
-                std::size_t mipmap_count = bitmap.mipmaps.size();
-                float mipmap_count_plus_one = mipmap_count + 1.0F; // although Guerilla only mentions mipmaps in the fade-to-gray stuff, it includes the first bitmap in the calculation
-                float overall_fade_factor = static_cast<float>(mipmap_count_plus_one) - static_cast<float>(fade) * (mipmap_count_plus_one - 1.0F + (1.0F - fade)); // excuse me what the fuck
+                // Iterate through each pixel
+                ColorPlatePixel *first = bitmap.pixels.data() + mipmap.first_pixel;
+                auto *last = first + mipmap.pixel_count;
 
-                for(std::size_t m = 0; m < mipmap_count; m++) {
-                    auto &mipmap = bitmap.mipmaps[m];
+                while(first < last) {
+                    std::uint8_t alpha_delta;
 
-                    // Iterate through each pixel
-                    ColorPlatePixel *first = bitmap.pixels.data() + mipmap.first_pixel;
-                    auto *last = first + mipmap.pixel_count;
+                    // If we're fading to gray instantly, do that so we don't divide by 0
+                    if(fade >= 1.0F) {
+                        alpha_delta = UINT8_MAX;
+                    }
+                    else {
+                        // Basically, a higher mipmap fade factor scales faster
+                        float gray_multiplier = static_cast<float>(m + 1) / overall_fade_factor;
 
-                    while(first < last) {
-                        std::uint8_t alpha_delta;
+                        // If we go over 1, go to 1
+                        if(gray_multiplier > 1.0F) {
+                            gray_multiplier = 1.0F;
+                        }
 
-                        // If we're fading to gray instantly, do that so we don't divide by 0
-                        if(fade >= 1.0F) {
+                        // Round
+                        float gray_multiplied = std::floor(UINT8_MAX * gray_multiplier + 0.5F);
+                        auto new_gray = static_cast<std::uint32_t>(gray_multiplied);
+                        if(new_gray > UINT8_MAX) {
                             alpha_delta = UINT8_MAX;
                         }
                         else {
-                            // Basically, a higher mipmap fade factor scales faster
-                            float gray_multiplier = static_cast<float>(m + 1) / overall_fade_factor;
+                            alpha_delta = static_cast<std::uint8_t>(new_gray);
+                        }
+                    }
 
-                            // If we go over 1, go to 1
-                            if(gray_multiplier > 1.0F) {
-                                gray_multiplier = 1.0F;
-                            }
+                    ColorPlatePixel FADE_TO_GRAY = { 0x7F, 0x7F, 0x7F, static_cast<std::uint8_t>(alpha_delta) };
+                    *first = first->alpha_blend(FADE_TO_GRAY);
 
-                            // Round
-                            float gray_multiplied = std::floor(UINT8_MAX * gray_multiplier + 0.5F);
-                            auto new_gray = static_cast<std::uint32_t>(gray_multiplied);
-                            if(new_gray > UINT8_MAX) {
-                                alpha_delta = UINT8_MAX;
-                            }
-                            else {
-                                alpha_delta = static_cast<std::uint8_t>(new_gray);
-                            }
-                        }
+                    first++;
+                }
+            }
+        }
+    }
 
-                        ColorPlatePixel FADE_TO_GRAY = { 0x7F, 0x7F, 0x7F, static_cast<std::uint8_t>(alpha_delta) };
-                        *first = first->alpha_blend(FADE_TO_GRAY);
+    void ColorPlateScanner::generate_mipmaps(GeneratedBitmapData &generated_bitmap, std::int16_t mipmaps, HEK::InvaderBitmapMipmapScaling mipmap_type, std::optional<float> mipmap_fade_factor, const std::optional<ColorPlateScannerSpriteParameters> &sprite_parameters, std::optional<float> sharpen, std::optional<float> blur, BitmapUsage usage, std::size_t jobs) {
+        auto mipmaps_unsigned = static_cast<std::uint32_t>(mipmaps);
 
-                        first++;
+        // Every bitmap (including each face of a cubemap) is independent, so each one can be its own task
+        auto generate_bitmap = [&generated_bitmap, &sprite_parameters, mipmaps_unsigned, mipmap_type, mipmap_fade_factor, sharpen, blur, usage](std::size_t b) {
+            auto &bitmap = generated_bitmap.bitmaps[b];
+            std::uint32_t max_mipmap_count = bitmap.width > bitmap.height ? log2_int(bitmap.width) : log2_int(bitmap.height);
+            if(max_mipmap_count > mipmaps_unsigned) {
+                max_mipmap_count = mipmaps_unsigned;
+            }
+
+            // Only generate up to log2(spacing) mipmaps for sprites
+            if(generated_bitmap.type == BitmapType::BITMAP_TYPE_SPRITES) {
+                auto sprite_spacing = sprite_parameters.value().sprite_spacing;
+                if(sprite_spacing == 0) {
+                    max_mipmap_count = 0;
+                }
+                else {
+                    auto max_mipmaps_sprites = log2_int(sprite_parameters.value().sprite_spacing);
+                    if(max_mipmap_count > max_mipmaps_sprites) {
+                        max_mipmap_count = max_mipmaps_sprites;
                     }
                 }
             }
+
+            generate_bitmap_mipmaps(bitmap, max_mipmap_count, mipmap_type, mipmap_fade_factor, sharpen, blur, usage);
+        };
+
+        auto bitmap_count = generated_bitmap.bitmaps.size();
+        ThreadPool thread_pool(std::min(jobs, bitmap_count));
+        std::vector<std::future<void>> bitmaps;
+        bitmaps.reserve(bitmap_count);
+        for(std::size_t b = 0; b < bitmap_count; b++) {
+            bitmaps.emplace_back(thread_pool.submit([&generate_bitmap, b]() { generate_bitmap(b); }));
+        }
+        for(auto &b : bitmaps) {
+            b.get();
         }
     }
 
@@ -1080,261 +1361,271 @@ namespace Invader {
         }
     }
 
-    static std::optional<std::vector<GeneratedBitmapDataSequence>> fit_sprites_into_sprite_sheet(std::uint32_t length, const GeneratedBitmapData &generated_bitmap, std::uint32_t half_spacing, std::uint32_t maximum_sprite_sheets, bool horizontal) {
-        // Effectively, all sprites are this many pixels apart
-        std::uint32_t effective_sprite_spacing = half_spacing * 2;
-
-        // If it's impossible to fit even a single pixel, give up
-        if(length <= effective_sprite_spacing) {
-            return std::nullopt;
-        }
-
-        // First see if all sprites can even fit by themselves. If not, there is no point in continuing.
-        std::size_t total_pixels = 0;
-        for(auto &bitmap : generated_bitmap.bitmaps) {
-            if(bitmap.height + effective_sprite_spacing > length || bitmap.width + effective_sprite_spacing > length) {
-                return std::nullopt;
-            }
-            total_pixels += (bitmap.height + effective_sprite_spacing) * (bitmap.width + effective_sprite_spacing);
-        }
-
-        // Also, if the number of pixels is greater than length^2, there is no way we could fit everything in here
-        if(total_pixels > length * length * maximum_sprite_sheets) {
-            return std::nullopt;
-        }
-
-        std::uint32_t sheet_count = 1;
-        std::vector<GeneratedBitmapDataSequence> new_sequences;
-
-        struct SortedSprite {
-            std::uint32_t sheet_index;
+    namespace {
+        /** A sprite to place, with its size including spacing on every side */
+        struct SpriteToPack {
             std::uint32_t bitmap_index;
             std::uint32_t sequence_index;
             std::uint32_t sequence_sprite_index;
-            std::uint32_t length;
-
             std::uint32_t width;
             std::uint32_t height;
-
-            std::uint32_t top;
-            std::uint32_t left;
-            std::uint32_t bottom;
-            std::uint32_t right;
-
-            std::uint32_t registration_point_x;
-            std::uint32_t registration_point_y;
         };
 
-        // Sort each sprite by height or width depending on if sorting horizontally or vertically. The first element of the pair is the bitmap index and the second element is the length
-        std::vector<SortedSprite> sprites_sorted;
-        const auto *bitmaps = generated_bitmap.bitmaps.data();
-        for(std::uint32_t s = 0; s < generated_bitmap.sequences.size(); s++) {
-            // Go through each bitmap in the sequence
-            auto &sequence = generated_bitmap.sequences[s];
-            const auto FIRST_BITMAP = sequence.first_bitmap;
-            const auto END_BITMAP = FIRST_BITMAP + sequence.bitmap_count;
-            for(std::uint32_t b = FIRST_BITMAP; b < END_BITMAP; b++) {
-                auto &bitmap = bitmaps[b];
-                std::uint32_t length;
-                length = horizontal ? bitmap.height : bitmap.width;
-
-                // Create it!
-                SortedSprite sprite_to_add = {};
-                sprite_to_add.bitmap_index = b;
-                sprite_to_add.length = length;
-                sprite_to_add.sequence_sprite_index = b - FIRST_BITMAP;
-                sprite_to_add.sequence_index = s;
-
-                sprite_to_add.width = bitmap.width;
-                sprite_to_add.height = bitmap.height;
-                sprite_to_add.registration_point_x = bitmap.registration_point_x;
-                sprite_to_add.registration_point_y = bitmap.registration_point_y;
-
-                // Find a sprite that's smaller and add it before that, stopping when we reach the end of the array
-                auto sprite_iter = sprites_sorted.begin();
-                for(; sprite_iter < sprites_sorted.end(); sprite_iter++) {
-                    if(sprite_iter->length < length) {
-                        break;
-                    }
-                }
-                sprites_sorted.insert(sprite_iter, sprite_to_add);
-            }
-        }
-
-        // Now that it's all sorted, begin placing things. If sorting by height, then scan vertically. Otherwise scan horizontally
-        for(std::size_t sprite = 0; sprite < sprites_sorted.size(); sprite++) {
-            auto &sprite_fitting = sprites_sorted[sprite];
+        /** Where to put each sprite among the places it fits */
+        enum SpritePlacement {
+            /** Leftmost, then topmost, with the widest sprites placed first */
+            SPRITE_PLACEMENT_LEFTMOST,
 
-            for(std::uint32_t sheet = 0; sheet < sheet_count; sheet++) {
-                auto fits = [&sprite_fitting, &sprite, &sprites_sorted, &sheet, &half_spacing, &length](std::uint32_t x, std::uint32_t y) -> bool {
-                    // Calculate the top/left/bottom-1/right-1, factoring in spacing
-                    std::uint32_t potential_top = y - half_spacing;
-                    std::uint32_t potential_left = x - half_spacing;
-                    std::uint32_t potential_bottom = y + sprite_fitting.height + half_spacing - 1;
-                    std::uint32_t potential_right = x + sprite_fitting.width + half_spacing - 1;
+            /** Topmost, then leftmost, with the tallest sprites placed first */
+            SPRITE_PLACEMENT_TOPMOST,
 
-                    // If we're outside the bitmap, fail
-                    if(length <= potential_right || length <= potential_bottom) {
-                        return false;
-                    }
+            /** Wherever the least space is left on the shorter side, with the longest sprites placed first */
+            SPRITE_PLACEMENT_BEST_SHORT_SIDE,
 
-                    for(std::uint32_t sprite_test = 0; sprite_test < sprite; sprite_test++) {
-                        auto sprite_test_value = sprites_sorted[sprite_test];
+            SPRITE_PLACEMENT_COUNT
+        };
 
-                        // If we aren't even on the same bitmap, ignore
-                        if(sheet != sprite_test_value.sheet_index) {
-                            continue;
-                        }
+        /** Empty area of a sprite sheet that is not covered by any sprite; free rectangles can overlap each other */
+        struct FreeRectangle {
+            std::uint32_t left;
+            std::uint32_t top;
+            std::uint32_t right;
+            std::uint32_t bottom;
 
-                        // Get the sprite we're comparing's top/left/bottom-1/right-1, also factoring in spacing
-                        std::uint32_t compare_top = sprite_test_value.top - half_spacing;
-                        std::uint32_t compare_left = sprite_test_value.left - half_spacing;
-                        std::uint32_t compare_bottom = sprite_test_value.bottom + half_spacing - 1;
-                        std::uint32_t compare_right = sprite_test_value.right + half_spacing - 1;
-
-                        auto box_intersects_box = [](
-                            std::uint32_t box_a_top,
-                            std::uint32_t box_a_left,
-                            std::uint32_t box_a_bottom,
-                            std::uint32_t box_a_right,
-                            std::uint32_t box_b_top,
-                            std::uint32_t box_b_left,
-                            std::uint32_t box_b_bottom,
-                            std::uint32_t box_b_right
-                        ) {
-                            bool top_inside = box_a_top >= box_b_top && box_a_top <= box_b_bottom;
-                            bool bottom_inside = box_a_bottom >= box_b_top && box_a_bottom <= box_b_bottom;
-
-                            bool left_inside = box_a_left >= box_b_left && box_a_left <= box_b_right;
-                            bool right_inside = box_a_right >= box_b_left && box_a_right <= box_b_right;
-
-                            bool wider = box_a_left <= box_b_left && box_a_right >= box_b_right;
-                            bool taller = box_a_top <= box_b_top && box_a_bottom >= box_b_bottom;
-
-                            // If two perpendicular sides are inside, then that means a corner is inside, which means it's banned
-                            if((top_inside && left_inside) || (bottom_inside && left_inside) || (top_inside && right_inside) || (bottom_inside && right_inside)) {
-                                return true;
-                            }
+            bool contains(const FreeRectangle &other) const noexcept {
+                return this->left <= other.left && this->top <= other.top && this->right >= other.right && this->bottom >= other.bottom;
+            }
+        };
+    }
 
-                            // If the box is wider or taller and the adjacent side is inside, then that means it's banned.
-                            if((wider && top_inside) || (wider && bottom_inside) || (taller & left_inside) || (taller && right_inside)) {
-                                return true;
-                            }
+    /**
+     * Place a rectangle in one of the free rectangles of a sprite sheet (MaxRects), then cut it out of every free rectangle it overlaps.
+     * Since the free rectangles are every largest empty rectangle, leftmost and topmost placement find the same spot as checking every pixel.
+     * @param free_rectangles free rectangles of the sheet
+     * @param width           width of the rectangle
+     * @param height          height of the rectangle
+     * @param placement       which free rectangle to pick
+     * @return                top-left corner of the rectangle if it fits
+     */
+    static std::optional<std::pair<std::uint32_t, std::uint32_t>> place_in_free_rectangle(std::vector<FreeRectangle> &free_rectangles, std::uint32_t width, std::uint32_t height, SpritePlacement placement) {
+        const FreeRectangle *best = nullptr;
+        std::pair<std::uint32_t, std::uint32_t> best_score;
+        for(auto &f : free_rectangles) {
+            std::uint32_t free_width = f.right - f.left;
+            std::uint32_t free_height = f.bottom - f.top;
+            if(free_width < width || free_height < height) {
+                continue;
+            }
 
-                            return false;
-                        };
+            std::pair<std::uint32_t, std::uint32_t> score;
+            switch(placement) {
+                case SpritePlacement::SPRITE_PLACEMENT_LEFTMOST:
+                    score = { f.left, f.top };
+                    break;
+                case SpritePlacement::SPRITE_PLACEMENT_TOPMOST:
+                    score = { f.top, f.left };
+                    break;
+                case SpritePlacement::SPRITE_PLACEMENT_BEST_SHORT_SIDE:
+                    score = { std::min(free_width - width, free_height - height), std::max(free_width - width, free_height - height) };
+                    break;
+                case SpritePlacement::SPRITE_PLACEMENT_COUNT:
+                    std::terminate();
+            }
 
-                        if(box_intersects_box(potential_top, potential_left, potential_bottom, potential_right, compare_top, compare_left, compare_bottom, compare_right) || box_intersects_box(compare_top, compare_left, compare_bottom, compare_right, potential_top, potential_left, potential_bottom, potential_right)) {
-                            return false;
-                        }
-                    }
+            if(best == nullptr || score < best_score) {
+                best = &f;
+                best_score = score;
+            }
+        }
 
-                    return true;
-                };
+        if(best == nullptr) {
+            return std::nullopt;
+        }
 
-                // Coordinates
-                std::optional<std::pair<std::uint32_t,std::uint32_t>> coordinates;
+        FreeRectangle used = { best->left, best->top, best->left + width, best->top + height };
 
-                std::uint32_t max_x = length - sprite_fitting.width - half_spacing;
-                std::uint32_t max_y = length - sprite_fitting.height - half_spacing;
+        // Replace each free rectangle the sprite overlaps with the (up to four) parts of it left on each side of the sprite
+        std::vector<FreeRectangle> split;
+        for(std::size_t i = 0; i < free_rectangles.size();) {
+            auto f = free_rectangles[i];
+            if(used.left >= f.right || used.right <= f.left || used.top >= f.bottom || used.bottom <= f.top) {
+                i++;
+                continue;
+            }
 
-                if(horizontal) {
-                    for(std::uint32_t y = half_spacing; y <= max_y && !coordinates.has_value(); y++) {
-                        for(std::uint32_t x = half_spacing; x <= max_x && !coordinates.has_value(); x++) {
-                            if(fits(x,y)) {
-                                coordinates = std::pair<std::uint32_t,std::uint32_t>(x,y);
-                            }
-                        }
-                    }
-                }
-                else {
-                    for(std::uint32_t x = half_spacing; x <= max_x && !coordinates.has_value(); x++) {
-                        for(std::uint32_t y = half_spacing; y <= max_y && !coordinates.has_value(); y++) {
-                            if(fits(x,y)) {
-                                coordinates = std::pair<std::uint32_t,std::uint32_t>(x,y);
-                            }
-                        }
-                    }
-                }
+            if(used.left > f.left) {
+                split.push_back(FreeRectangle { f.left, f.top, used.left, f.bottom });
+            }
+            if(used.right < f.right) {
+                split.push_back(FreeRectangle { used.right, f.top, f.right, f.bottom });
+            }
+            if(used.top > f.top) {
+                split.push_back(FreeRectangle { f.left, f.top, f.right, used.top });
+            }
+            if(used.bottom < f.bottom) {
+                split.push_back(FreeRectangle { f.left, used.bottom, f.right, f.bottom });
+            }
 
-                // Did we do it?
-                if(coordinates.has_value()) {
-                    sprite_fitting.sheet_index = sheet;
+            free_rectangles[i] = free_rectangles.back();
+            free_rectangles.pop_back();
+        }
 
-                    auto &x = coordinates.value().first;
-                    auto &y = coordinates.value().second;
+        // Keep the new free rectangles that aren't inside any other one
+        for(std::size_t i = 0; i < split.size(); i++) {
+            auto contained = [&split, &i](const FreeRectangle &other) { return &other != &split[i] && other.contains(split[i]); };
+            if(std::none_of(free_rectangles.begin(), free_rectangles.end(), contained) && std::none_of(split.begin() + static_cast<std::ptrdiff_t>(i + 1), split.end(), contained)) {
+                free_rectangles.push_back(split[i]);
+            }
+        }
 
-                    sprite_fitting.left = x;
-                    sprite_fitting.top = y;
-                    sprite_fitting.bottom = y + sprite_fitting.height;
-                    sprite_fitting.right = x + sprite_fitting.width;
+        return std::pair<std::uint32_t, std::uint32_t>(used.left, used.top);
+    }
 
-                    break;
-                }
+    static std::optional<std::vector<GeneratedBitmapDataSequence>> fit_sprites_into_sprite_sheet(std::uint32_t length, const GeneratedBitmapData &generated_bitmap, const std::vector<SpriteToPack> &sprites, SpritePlacement placement, std::uint32_t half_spacing, std::uint32_t maximum_sprite_sheets) {
+        // If it's impossible to fit even a single pixel, give up
+        if(length <= half_spacing * 2) {
+            return std::nullopt;
+        }
 
-                // Try making a new sprite sheet. If we hit the maximum sprite sheets, give up.
-                if(sheet + 1 == sheet_count) {
-                    if(++sheet_count > maximum_sprite_sheets) {
-                        return std::nullopt;
-                    }
-                }
+        // First see if all sprites can even fit by themselves. If not, there is no point in continuing.
+        std::size_t total_pixels = 0;
+        for(auto &sprite : sprites) {
+            if(sprite.width > length || sprite.height > length) {
+                return std::nullopt;
             }
+            total_pixels += static_cast<std::size_t>(sprite.width) * sprite.height;
         }
 
-        // Put it all together
-        for(std::size_t s = 0; s < generated_bitmap.sequences.size(); s++) {
-            auto &sequence = generated_bitmap.sequences[s];
+        // Also, if the number of pixels is greater than length^2, there is no way we could fit everything in here
+        if(total_pixels > static_cast<std::size_t>(length) * length * maximum_sprite_sheets) {
+            return std::nullopt;
+        }
+
+        std::vector<GeneratedBitmapDataSequence> new_sequences;
+        for(auto &sequence : generated_bitmap.sequences) {
             auto &new_sequence = new_sequences.emplace_back();
             new_sequence.bitmap_count = 0;
             new_sequence.first_bitmap = 0;
             new_sequence.y_end = sequence.y_end;
             new_sequence.y_start = sequence.y_start;
+            new_sequence.sprites.resize(sequence.bitmap_count);
+        }
 
-            // Find the sprite
-            for(std::uint32_t b = 0; b < sequence.bitmap_count; b++) {
-                for(auto &sprite : sprites_sorted) {
-                    if(sprite.sequence_index == s && sprite.sequence_sprite_index == b) {
-                        auto &new_sprite = new_sequence.sprites.emplace_back();
-                        new_sprite.original_bitmap_index = sprite.bitmap_index;
-                        new_sprite.bitmap_index = sprite.sheet_index;
-                        new_sprite.top = sprite.top - half_spacing;
-                        new_sprite.left = sprite.left - half_spacing;
-                        new_sprite.bottom = sprite.bottom + half_spacing;
-                        new_sprite.right = sprite.right + half_spacing;
-                        new_sprite.registration_point_x = sprite.registration_point_x + half_spacing;
-                        new_sprite.registration_point_y = sprite.registration_point_y + half_spacing;
+        // Put each sprite on the first sheet it fits on, starting a new sheet if it doesn't fit on any of them
+        std::vector<std::vector<FreeRectangle>> sheets;
+        for(auto &sprite : sprites) {
+            std::optional<std::pair<std::uint32_t, std::uint32_t>> coordinates;
+            std::size_t sheet = 0;
+            for(; sheet < sheets.size(); sheet++) {
+                coordinates = place_in_free_rectangle(sheets[sheet], sprite.width, sprite.height, placement);
+                if(coordinates.has_value()) {
+                    break;
+                }
+            }
 
-                        break;
-                    }
+            // If we hit the maximum sprite sheets, give up
+            if(!coordinates.has_value()) {
+                if(sheets.size() == maximum_sprite_sheets) {
+                    return std::nullopt;
                 }
+                auto &new_sheet = sheets.emplace_back();
+                new_sheet.push_back(FreeRectangle { 0, 0, length, length });
+                coordinates = place_in_free_rectangle(new_sheet, sprite.width, sprite.height, placement);
             }
+
+            auto &bitmap = generated_bitmap.bitmaps[sprite.bitmap_index];
+            auto &new_sprite = new_sequences[sprite.sequence_index].sprites[sprite.sequence_sprite_index];
+            new_sprite.original_bitmap_index = sprite.bitmap_index;
+            new_sprite.bitmap_index = static_cast<std::uint32_t>(sheet);
+            new_sprite.left = coordinates->first;
+            new_sprite.top = coordinates->second;
+            new_sprite.right = new_sprite.left + sprite.width;
+            new_sprite.bottom = new_sprite.top + sprite.height;
+            new_sprite.registration_point_x = bitmap.registration_point_x + static_cast<std::int32_t>(half_spacing);
+            new_sprite.registration_point_y = bitmap.registration_point_y + static_cast<std::int32_t>(half_spacing);
         }
 
         // Done!
         return new_sequences;
     }
 
-    static std::optional<std::vector<GeneratedBitmapDataSequence>> fit_sprites_into_maximum_sprite_sheet(std::uint32_t length, const GeneratedBitmapData &generated_bitmap, std::uint32_t half_spacing, std::uint32_t maximum_sprite_sheets) {
-        auto fit_sprites_vertical = fit_sprites_into_sprite_sheet(length, generated_bitmap, half_spacing, maximum_sprite_sheets, false);
-        auto fit_sprites_horizontal = fit_sprites_into_sprite_sheet(length, generated_bitmap, half_spacing, maximum_sprite_sheets, true);
-        std::optional<std::vector<GeneratedBitmapDataSequence>> fit_sprites;
-        if(fit_sprites_vertical.has_value()) {
-            fit_sprites = fit_sprites_vertical;
+    static std::size_t area_of_sprite_sheets(const std::vector<GeneratedBitmapDataSequence> &sequences) {
+        std::size_t area = 0;
+        auto sheet_count = number_of_sprite_sheets(sequences);
+        for(std::uint32_t s = 0; s < sheet_count; s++) {
+            std::size_t length = length_of_sprite_sheet(sequences, s);
+            area += length * length;
         }
-        else if(fit_sprites_horizontal.has_value()) {
-            fit_sprites = fit_sprites_horizontal;
+        return area;
+    }
+
+    static std::optional<std::vector<GeneratedBitmapDataSequence>> fit_sprites_into_maximum_sprite_sheet(std::uint32_t length, const GeneratedBitmapData &generated_bitmap, std::uint32_t half_spacing, std::uint32_t maximum_sprite_sheets) {
+        std::vector<SpriteToPack> sprites;
+        for(std::uint32_t s = 0; s < generated_bitmap.sequences.size(); s++) {
+            auto &sequence = generated_bitmap.sequences[s];
+            for(std::uint32_t b = 0; b < sequence.bitmap_count; b++) {
+                auto &bitmap = generated_bitmap.bitmaps[sequence.first_bitmap + b];
+                sprites.push_back(SpriteToPack { sequence.first_bitmap + b, s, b, bitmap.width + half_spacing * 2, bitmap.height + half_spacing * 2 });
+            }
         }
-        else {
-            return std::nullopt;
+
+        // Sort the sprites once for each placement, since the order is the same for every length we try
+        std::vector<SpriteToPack> sorted_sprites[SpritePlacement::SPRITE_PLACEMENT_COUNT];
+        for(std::size_t p = 0; p < SpritePlacement::SPRITE_PLACEMENT_COUNT; p++) {
+            auto sort_key = [&p](const SpriteToPack &sprite) {
+                switch(p) {
+                    case SpritePlacement::SPRITE_PLACEMENT_LEFTMOST:
+                        return std::pair(sprite.width, sprite.height);
+                    case SpritePlacement::SPRITE_PLACEMENT_TOPMOST:
+                        return std::pair(sprite.height, sprite.width);
+                    default:
+                        return std::pair(std::max(sprite.width, sprite.height), std::min(sprite.width, sprite.height));
+                }
+            };
+            sorted_sprites[p] = sprites;
+            std::stable_sort(sorted_sprites[p].begin(), sorted_sprites[p].end(), [&sort_key](const SpriteToPack &a, const SpriteToPack &b) {
+                return sort_key(a) > sort_key(b);
+            });
         }
 
-        auto fit_sprites_half = fit_sprites_into_maximum_sprite_sheet(length / 2, generated_bitmap, half_spacing, maximum_sprite_sheets);
-        if(fit_sprites_half) {
-            return fit_sprites_half;
+        // Use whichever placement results in the smallest sprite sheets
+        auto fit_sprites_at_length = [&](std::uint32_t sheet_length) {
+            std::optional<std::vector<GeneratedBitmapDataSequence>> best;
+            std::size_t best_area = 0;
+            for(std::size_t p = 0; p < SpritePlacement::SPRITE_PLACEMENT_COUNT; p++) {
+                auto fit = fit_sprites_into_sprite_sheet(sheet_length, generated_bitmap, sorted_sprites[p], static_cast<SpritePlacement>(p), half_spacing, maximum_sprite_sheets);
+                if(fit.has_value()) {
+                    auto area = area_of_sprite_sheets(*fit);
+                    if(!best.has_value() || area < best_area) {
+                        best = std::move(fit);
+                        best_area = area;
+                    }
+                }
+            }
+            return best;
+        };
+
+        // Sheets get halved in size until the sprites no longer fit, so binary search for the smallest one that does
+        std::uint32_t largest_halving = 0;
+        while((length >> (largest_halving + 1)) > half_spacing * 2) {
+            largest_halving++;
         }
-        else {
-            return fit_sprites;
+
+        std::optional<std::vector<GeneratedBitmapDataSequence>> fit_sprites;
+        std::uint32_t low = 0, high = largest_halving + 1;
+        while(low < high) {
+            std::uint32_t halving = low + (high - low) / 2;
+            auto fit = fit_sprites_at_length(length >> halving);
+            if(fit.has_value()) {
+                fit_sprites = std::move(fit);
+                low = halving + 1;
+            }
+            else {
+                high = halving;
+            }
         }
+
+        return fit_sprites;
     }
 
     void ColorPlateScanner::process_sprites(GeneratedBitmapData &generated_bitmap, ColorPlateScannerSpriteParameters &parameters, std::int16_t &mipmap) {
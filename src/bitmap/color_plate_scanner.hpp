@@ -66,13 +66,65 @@ namespace Invader {
         std::uint32_t sprite_spacing;
     };
 
+    /**
+     * Reads a color plate one row at a time, top to bottom, so the whole color plate does not need to be in memory at once
+     */
+    class ColorPlateReader {
+    public:
+        /**
+         * Get the width of the color plate
+         * @return width in pixels
+         */
+        std::uint32_t get_width() const noexcept {
+            return this->width;
+        }
+
+        /**
+         * Get the height of the color plate
+         * @return height in pixels
+         */
+        std::uint32_t get_height() const noexcept {
+            return this->height;
+        }
+
+        /**
+         * Read the next row of the color plate
+         * @param row pixels to write to; this must be able to hold get_width() pixels
+         */
+        virtual void read_row(ColorPlatePixel *row) = 0;
+
+        virtual ~ColorPlateReader() = default;
+
+    protected:
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+    };
+
+    /**
+     * Reads a color plate that is already in memory
+     */
+    class ColorPlatePixelReader : public ColorPlateReader {
+    public:
+        void read_row(ColorPlatePixel *row) override;
+
+        /**
+         * Instantiate a reader
+         * @param pixels pointer to first pixel; this must stay valid while reading
+         * @param width  width of color plate
+         * @param height height of color plate
+         */
+        ColorPlatePixelReader(const ColorPlatePixel *pixels, std::uint32_t width, std::uint32_t height);
+
+    private:
+        const ColorPlatePixel *next_row;
+    };
+
     class ColorPlateScanner {
     public:
         /**
-         * Scan the color plate for bitmaps
-         * @param  pixels             pointer to first pixel
-         * @param  width              width of color plate
-         * @param  height             height of color plate
+         * Scan the color plate for bitmaps. The color plate is read one row at a time, and only the rows of the sequence being scanned are
+         * held in memory, except for color plates without a key which are read as a single bitmap.
+         * @param  reader             color plate to read; every row is read exactly once
          * @param  type               type of bitmap
          * @param  usage              usage value for bitmap
          * @param  bump_height        bump height value
@@ -82,9 +134,10 @@ namespace Invader {
          * @param  mipmap_fade_factor fade-to-gray factor for mipmaps
          * @param  sharpen            sharpening filter
          * @param  blur               blur filter
+         * @param  jobs               number of threads to generate mipmaps with
          * @return                    scanned color plate data
          */
-        static GeneratedBitmapData scan_color_plate(const ColorPlatePixel *pixels, std::uint32_t width, std::uint32_t height, BitmapType type, BitmapUsage usage, float bump_height, std::optional<ColorPlateScannerSpriteParameters> &sprite_parameters, std::int16_t mipmaps, HEK::InvaderBitmapMipmapScaling mipmap_type, std::optional<float> mipmap_fade_factor, std::optional<float> sharpen, std::optional<float> blur);
+        static GeneratedBitmapData scan_color_plate(ColorPlateReader &reader, BitmapType type, BitmapUsage usage, float bump_height, std::optional<ColorPlateScannerSpriteParameters> &sprite_parameters, std::int16_t mipmaps, HEK::InvaderBitmapMipmapScaling mipmap_type, std::optional<float> mipmap_fade_factor, std::optional<float> sharpen, std::optional<float> blur, std::size_t jobs = 1);
 
     private:
         /** Is power of two required */
@@ -128,12 +181,13 @@ namespace Invader {
         bool is_ignored(const ColorPlatePixel &color) const;
 
         /**
-         * Read the color plate data bitmap data
+         * Read the bitmaps of a sequence of the color plate
          * @param generated_bitmap bitmap data to write to (output)
-         * @param pixels           pixel input
+         * @param sequence         sequence to read; y_start and y_end must be set
+         * @param pixels           pixel input, starting at the first row of the sequence
          * @param width            width of input
          */
-        void read_color_plate(GeneratedBitmapData &generated_bitmap, const ColorPlatePixel *pixels, std::uint32_t width) const;
+        void read_color_plate_sequence(GeneratedBitmapData &generated_bitmap, GeneratedBitmapDataSequence &sequence, const ColorPlatePixel *pixels, std::uint32_t width) const;
 
         /**
          * Read an unrolled cubemap
@@ -147,11 +201,11 @@ namespace Invader {
         /**
          * Read a single bitmap.
          * @param generated_bitmap bitmap data to write to (output)
-         * @param pixels           pixel input
+         * @param pixels           pixel input; this is moved into the bitmap
          * @param width            width of input
          * @param height           height of input
          */
-        void read_single_bitmap(GeneratedBitmapData &generated_bitmap, const ColorPlatePixel *pixels, std::uint32_t width, std::uint32_t height) const;
+        void read_single_bitmap(GeneratedBitmapData &generated_bitmap, std::vector<ColorPlatePixel> &&pixels, std::uint32_t width, std::uint32_t height) const;
 
         /**
          * Process height maps for the bitmap
@@ -161,16 +215,18 @@ namespace Invader {
         static void process_height_maps(GeneratedBitmapData &generated_bitmap, float bump_height);
 
         /**
-         * Generate mipmaps for the color plate
+         * Generate mipmaps for the color plate. Each bitmap is done on its own thread, and the result is the same regardless of the number of threads.
          * @param generated_bitmap   color plate to generate mipmaps for
          * @param mipmaps            max number of mipmaps
          * @param mipmap_type        scaling filter to use for mipmaps
          * @param mipmap_fade_factor fade-to-gray factor for mipmaps
          * @param sprite_parameters  sprite parameters (if using sprites)
          * @param sharpen            sharpen filter
+         * @param blur               blur filter
          * @param usage              bitmap usage value
+         * @param jobs               number of threads to use
          */
-        static void generate_mipmaps(GeneratedBitmapData &generated_bitmap, std::int16_t mipmaps, HEK::InvaderBitmapMipmapScaling mipmap_type, std::optional<float> mipmap_fade_factor, const std::optional<ColorPlateScannerSpriteParameters> &sprite_parameters, std::optional<float> sharpen, std::optional<float> blur, BitmapUsage usage);
+        static void generate_mipmaps(GeneratedBitmapData &generated_bitmap, std::int16_t mipmaps, HEK::InvaderBitmapMipmapScaling mipmap_type, std::optional<float> mipmap_fade_factor, const std::optional<ColorPlateScannerSpriteParameters> &sprite_parameters, std::optional<float> sharpen, std::optional<float> blur, BitmapUsage usage, std::size_t jobs);
 
         /**
          * Consolidate the stacked bitmap data (cubemaps and 3d textures)
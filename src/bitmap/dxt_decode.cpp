@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <exception>
+
+#include "../simd.hpp"
+
+#include <invader/bitmap/dxt_decode.hpp>
+
+namespace Invader::DXTDecode {
+    using namespace HEK;
+
+    // Scale to 0-255 rather than replicating the upper bits so the results match what previous versions decoded
+    static inline std::uint32_t expand_5(std::uint32_t value) {
+        auto scaled = value * 255 + 16;
+        return (scaled / 32 + scaled) / 32;
+    }
+
+    static inline std::uint32_t expand_6(std::uint32_t value) {
+        auto scaled = value * 255 + 32;
+        return (scaled / 64 + scaled) / 64;
+    }
+
+    static inline std::uint32_t pack_argb(std::uint32_t alpha, std::uint32_t red, std::uint32_t green, std::uint32_t blue) {
+        return (alpha << 24) | (red << 16) | (green << 8) | blue;
+    }
+
+    /**
+     * Get the four colors of a color block. The alpha of each color is set to alpha, except for DXT1 blocks that use transparency.
+     * @param block        color block
+     * @param transparency allow the block to use three colors plus transparent black if color0 <= color1 (DXT1 only)
+     * @param alpha        alpha to use for each color
+     * @param palette      four colors to write to
+     */
+    static void make_palette(const std::byte *block, bool transparency, std::uint32_t alpha, std::uint32_t *palette) {
+        std::uint32_t color0 = reinterpret_cast<const LittleEndian<std::uint16_t> *>(block)[0].read();
+        std::uint32_t color1 = reinterpret_cast<const LittleEndian<std::uint16_t> *>(block)[1].read();
+
+        std::uint32_t red0 = expand_5(color0 >> 11), green0 = expand_6((color0 >> 5) & 0x3F), blue0 = expand_5(color0 & 0x1F);
+        std::uint32_t red1 = expand_5(color1 >> 11), green1 = expand_6((color1 >> 5) & 0x3F), blue1 = expand_5(color1 & 0x1F);
+
+        palette[0] = pack_argb(alpha, red0, green0, blue0);
+        palette[1] = pack_argb(alpha, red1, green1, blue1);
+
+        if(color0 > color1 || !transparency) {
+            palette[2] = pack_argb(alpha, (red0 * 2 + red1) / 3, (green0 * 2 + green1) / 3, (blue0 * 2 + blue1) / 3);
+            palette[3] = pack_argb(alpha, (red0 + red1 * 2) / 3, (green0 + green1 * 2) / 3, (blue0 + blue1 * 2) / 3);
+        }
+        else {
+            palette[2] = pack_argb(alpha, (red0 + red1) / 2, (green0 + green1) / 2, (blue0 + blue1) / 2);
+            palette[3] = 0;
+        }
+    }
+
+    static void decode_dxt3_alpha(const std::byte *block, std::uint8_t *alpha) {
+        std::uint64_t bits = reinterpret_cast<const LittleEndian<std::uint64_t> *>(block)->read();
+        for(std::size_t p = 0; p < 16; p++) {
+            alpha[p] = static_cast<std::uint8_t>(((bits >> (p * 4)) & 0xF) * 0x11);
+        }
+    }
+
+    static void decode_dxt5_alpha(const std::byte *block, std::uint8_t *alpha) {
+        std::uint32_t alpha0 = static_cast<std::uint32_t>(block[0]);
+        std::uint32_t alpha1 = static_cast<std::uint32_t>(block[1]);
+
+        std::uint8_t palette[8] = { static_cast<std::uint8_t>(alpha0), static_cast<std::uint8_t>(alpha1) };
+        if(alpha0 > alpha1) {
+            for(std::uint32_t i = 2; i < 8; i++) {
+                palette[i] = static_cast<std::uint8_t>(((8 - i) * alpha0 + (i - 1) * alpha1) / 7);
+            }
+        }
+        else {
+            for(std::uint32_t i = 2; i < 6; i++) {
+                palette[i] = static_cast<std::uint8_t>(((6 - i) * alpha0 + (i - 1) * alpha1) / 5);
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        // 16 3-bit indices follow the endpoints
+        std::uint64_t bits = 0;
+        for(std::size_t i = 0; i < 6; i++) {
+            bits |= static_cast<std::uint64_t>(block[2 + i]) << (i * 8);
+        }
+        for(std::size_t p = 0; p < 16; p++) {
+            alpha[p] = palette[(bits >> (p * 3)) & 7];
+        }
+    }
+
+    void decode_block(const std::byte *block, std::uint32_t *output, std::size_t output_stride, BitmapDataFormat format) {
+        alignas(16) std::uint32_t palette[4];
+        alignas(16) std::uint8_t alpha[16];
+        const std::byte *color_block;
+
+        switch(format) {
+            case BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1:
+                color_block = block;
+                make_palette(color_block, true, 0xFF, palette);
+                break;
+            case BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3:
+                decode_dxt3_alpha(block, alpha);
+                color_block = block + 8;
+                make_palette(color_block, false, 0, palette);
+                break;
+            case BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5:
+                decode_dxt5_alpha(block, alpha);
+                color_block = block + 8;
+                make_palette(color_block, false, 0, palette);
+                break;
+            default:
+                std::terminate();
+        }
+
+        bool separate_alpha = format != BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1;
+        std::uint32_t indices = reinterpret_cast<const LittleEndian<std::uint32_t> *>(color_block + 4)->read();
+
+        #ifdef INVADER_SSE2
+        // Move the alpha into the top byte of each pixel, one row at a time
+        __m128i alpha_rows[4];
+        if(separate_alpha) {
+            auto zero = _mm_setzero_si128();
+            auto alpha_vector = _mm_load_si128(reinterpret_cast<const __m128i *>(alpha));
+            auto alpha_low = _mm_unpacklo_epi8(zero, alpha_vector);
+            auto alpha_high = _mm_unpackhi_epi8(zero, alpha_vector);
+            alpha_rows[0] = _mm_unpacklo_epi16(zero, alpha_low);
+            alpha_rows[1] = _mm_unpackhi_epi16(zero, alpha_low);
+            alpha_rows[2] = _mm_unpacklo_epi16(zero, alpha_high);
+            alpha_rows[3] = _mm_unpackhi_epi16(zero, alpha_high);
+        }
+        #endif
+
+        #if defined(INVADER_AVX2)
+        // Look up eight pixels at a time with a permute
+        auto palette_vector = _mm256_castsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(palette)));
+        auto index_vector = _mm256_set1_epi32(static_cast<int>(indices));
+        auto index_mask = _mm256_set1_epi32(3);
+        auto shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+        auto top_half = _mm256_permutevar8x32_epi32(palette_vector, _mm256_and_si256(_mm256_srlv_epi32(index_vector, shifts), index_mask));
+        auto bottom_half = _mm256_permutevar8x32_epi32(palette_vector, _mm256_and_si256(_mm256_srlv_epi32(index_vector, _mm256_add_epi32(shifts, _mm256_set1_epi32(16))), index_mask));
+
+        __m128i rows[4] = {
+            _mm256_castsi256_si128(top_half),
+            _mm256_extracti128_si256(top_half, 1),
+            _mm256_castsi256_si128(bottom_half),
+            _mm256_extracti128_si256(bottom_half, 1)
+        };
+        for(std::size_t y = 0; y < 4; y++) {
+            auto row = separate_alpha ? _mm_or_si128(rows[y], alpha_rows[y]) : rows[y];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(output + y * output_stride), row);
+        }
+        #elif defined(INVADER_SSE2)
+        // Select between the colors using each bit of the index as a mask
+        auto color0 = _mm_set1_epi32(static_cast<int>(palette[0]));
+        auto color1 = _mm_set1_epi32(static_cast<int>(palette[1]));
+        auto color02 = _mm_xor_si128(color0, _mm_set1_epi32(static_cast<int>(palette[2])));
+        auto color13 = _mm_xor_si128(color1, _mm_set1_epi32(static_cast<int>(palette[3])));
+        auto low_bits = _mm_setr_epi32(0x01, 0x04, 0x10, 0x40);
+        auto high_bits = _mm_setr_epi32(0x02, 0x08, 0x20, 0x80);
+
+        for(std::size_t y = 0; y < 4; y++) {
+            auto row_indices = _mm_set1_epi32(static_cast<int>((indices >> (y * 8)) & 0xFF));
+            auto low = _mm_cmpeq_epi32(_mm_and_si128(row_indices, low_bits), low_bits);
+            auto high = _mm_cmpeq_epi32(_mm_and_si128(row_indices, high_bits), high_bits);
+            auto even = _mm_xor_si128(color0, _mm_and_si128(high, color02));
+            auto odd = _mm_xor_si128(color1, _mm_and_si128(high, color13));
+            auto row = _mm_xor_si128(even, _mm_and_si128(low, _mm_xor_si128(even, odd)));
+            if(separate_alpha) {
+                row = _mm_or_si128(row, alpha_rows[y]);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(output + y * output_stride), row);
+        }
+        #else
+        for(std::size_t p = 0; p < 16; p++) {
+            auto color = palette[(indices >> (p * 2)) & 3];
+            if(separate_alpha) {
+                color |= static_cast<std::uint32_t>(alpha[p]) << 24;
+            }
+            output[(p / 4) * output_stride + (p % 4)] = color;
+        }
+        #endif
+    }
+
+    void decode_dxt_region(const std::byte *blocks, std::size_t width, std::size_t height, std::size_t region_x, std::size_t region_y, std::size_t region_width, std::size_t region_height, std::uint32_t *output, std::size_t output_stride, BitmapDataFormat format) {
+        std::size_t block_size = format == BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1 ? 8 : 16;
+        std::size_t blocks_wide = (width + 3) / 4;
+
+        std::size_t region_right = std::min(region_x + region_width, width);
+        std::size_t region_bottom = std::min(region_y + region_height, height);
+        if(region_x >= region_right || region_y >= region_bottom) {
+            return;
+        }
+
+        alignas(16) std::uint32_t edge_block[16];
+        for(std::size_t block_y = region_y / 4; block_y * 4 < region_bottom; block_y++) {
+            std::size_t top = std::max(block_y * 4, region_y);
+            std::size_t bottom = std::min(block_y * 4 + 4, region_bottom);
+            const auto *row_blocks = blocks + block_y * blocks_wide * block_size;
+
+            for(std::size_t block_x = region_x / 4; block_x * 4 < region_right; block_x++) {
+                std::size_t left = std::max(block_x * 4, region_x);
+                std::size_t right = std::min(block_x * 4 + 4, region_right);
+                const auto *block = row_blocks + block_x * block_size;
+                auto *block_output = output + (top - region_y) * output_stride + (left - region_x);
+
+                // Blocks that are entirely in the region can be written to the output directly
+                if(bottom - top == 4 && right - left == 4) {
+                    decode_block(block, block_output, output_stride, format);
+                    continue;
+                }
+
+                // Otherwise, we need to clip it
+                decode_block(block, edge_block, 4, format);
+                for(std::size_t y = top; y < bottom; y++) {
+                    const auto *edge_row = edge_block + (y - block_y * 4) * 4 + (left - block_x * 4);
+                    std::copy(edge_row, edge_row + (right - left), block_output + (y - top) * output_stride);
+                }
+            }
+        }
+    }
+
+    void decode_dxt(const std::byte *blocks, std::size_t width, std::size_t height, std::uint32_t *output, BitmapDataFormat format) {
+        decode_dxt_region(blocks, width, height, 0, 0, width, height, output, width, format);
+    }
+}
@@ -0,0 +1,584 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../simd.hpp"
+
+#include <invader/bitmap/dxt_encode.hpp>
+
+// The principal axis and cluster fit use floats, and fusing multiplies and adds would make which endpoints get picked
+// depend on the target. GCC and Clang are given -ffp-contract=off for this file instead (see invader.cmake).
+#ifdef _MSC_VER
+#pragma fp_contract(off)
+#endif
+
+namespace Invader::DXTEncode {
+    using namespace HEK;
+
+    namespace {
+        /** Colors of a block, stored per channel so several pixels can be worked on at once */
+        struct BlockColors {
+            alignas(32) std::int32_t red[16];
+            alignas(32) std::int32_t green[16];
+            alignas(32) std::int32_t blue[16];
+        };
+
+        struct Color {
+            std::int32_t red;
+            std::int32_t green;
+            std::int32_t blue;
+        };
+
+        struct ColorBlock {
+            std::uint16_t color0 = 0;
+            std::uint16_t color1 = 0;
+            std::uint32_t error = UINT32_MAX;
+        };
+
+        /** Endpoint pairs whose 2/3 interpolation best matches each 8-bit value */
+        struct SingleColorTable {
+            std::uint8_t endpoints[256][2];
+        };
+    }
+
+    static inline std::int32_t expand_5(std::int32_t value) {
+        return (value << 3) | (value >> 2);
+    }
+
+    static inline std::int32_t expand_6(std::int32_t value) {
+        return (value << 2) | (value >> 4);
+    }
+
+    static inline std::uint16_t pack_565(std::int32_t red, std::int32_t green, std::int32_t blue) {
+        return static_cast<std::uint16_t>((((red * 31 + 127) / 255) << 11) | (((green * 63 + 127) / 255) << 5) | ((blue * 31 + 127) / 255));
+    }
+
+    static inline Color unpack_565(std::uint16_t color) {
+        return Color { expand_5(color >> 11), expand_6((color >> 5) & 0x3F), expand_5(color & 0x1F) };
+    }
+
+    static SingleColorTable make_single_color_table(std::int32_t bits) {
+        SingleColorTable table;
+        std::int32_t max = (1 << bits) - 1;
+        for(std::int32_t value = 0; value < 256; value++) {
+            std::int32_t best_error = INT32_MAX;
+            for(std::int32_t e0 = 0; e0 <= max; e0++) {
+                for(std::int32_t e1 = 0; e1 <= max; e1++) {
+                    auto x0 = bits == 5 ? expand_5(e0) : expand_6(e0);
+                    auto x1 = bits == 5 ? expand_5(e1) : expand_6(e1);
+                    auto error = std::abs((x0 * 2 + x1) / 3 - value);
+                    if(error < best_error) {
+                        best_error = error;
+                        table.endpoints[value][0] = static_cast<std::uint8_t>(e0);
+                        table.endpoints[value][1] = static_cast<std::uint8_t>(e1);
+                    }
+                }
+            }
+        }
+        return table;
+    }
+
+    static void make_palette(std::uint16_t color0, std::uint16_t color1, Color *palette) {
+        palette[0] = unpack_565(color0);
+        palette[1] = unpack_565(color1);
+        palette[2] = Color { (palette[0].red * 2 + palette[1].red) / 3, (palette[0].green * 2 + palette[1].green) / 3, (palette[0].blue * 2 + palette[1].blue) / 3 };
+        palette[3] = Color { (palette[0].red + palette[1].red * 2) / 3, (palette[0].green + palette[1].green * 2) / 3, (palette[0].blue + palette[1].blue * 2) / 3 };
+    }
+
+    /**
+     * Find the closest palette entry for each pixel. Ties go to the lowest index so every code path gives the same result.
+     * @return total squared error
+     */
+    static std::uint32_t find_indices(const BlockColors &colors, const Color *palette, std::uint8_t *indices) {
+        alignas(32) std::int32_t best_index[16];
+        alignas(32) std::int32_t best_error[16];
+
+        #if defined(INVADER_AVX2)
+        for(std::size_t p = 0; p < 16; p += 8) {
+            auto red = _mm256_load_si256(reinterpret_cast<const __m256i *>(colors.red + p));
+            auto green = _mm256_load_si256(reinterpret_cast<const __m256i *>(colors.green + p));
+            auto blue = _mm256_load_si256(reinterpret_cast<const __m256i *>(colors.blue + p));
+            __m256i best_e = _mm256_set1_epi32(INT32_MAX);
+            __m256i best_i = _mm256_setzero_si256();
+            for(std::int32_t c = 0; c < 4; c++) {
+                auto dr = _mm256_sub_epi32(red, _mm256_set1_epi32(palette[c].red));
+                auto dg = _mm256_sub_epi32(green, _mm256_set1_epi32(palette[c].green));
+                auto db = _mm256_sub_epi32(blue, _mm256_set1_epi32(palette[c].blue));
+                auto e = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(dr, dr), _mm256_mullo_epi32(dg, dg)), _mm256_mullo_epi32(db, db));
+                auto closer = _mm256_cmpgt_epi32(best_e, e);
+                best_e = _mm256_blendv_epi8(best_e, e, closer);
+                best_i = _mm256_blendv_epi8(best_i, _mm256_set1_epi32(c), closer);
+            }
+            _mm256_store_si256(reinterpret_cast<__m256i *>(best_error + p), best_e);
+            _mm256_store_si256(reinterpret_cast<__m256i *>(best_index + p), best_i);
+        }
+        #elif defined(INVADER_SSE2)
+        // SSE2 has no 32-bit multiply, so do the differences as 16-bit and square them with multiply-add instead
+        auto zero = _mm_setzero_si128();
+        for(std::size_t p = 0; p < 16; p += 8) {
+            auto red = _mm_packs_epi32(_mm_load_si128(reinterpret_cast<const __m128i *>(colors.red + p)), _mm_load_si128(reinterpret_cast<const __m128i *>(colors.red + p + 4)));
+            auto green = _mm_packs_epi32(_mm_load_si128(reinterpret_cast<const __m128i *>(colors.green + p)), _mm_load_si128(reinterpret_cast<const __m128i *>(colors.green + p + 4)));
+            auto blue = _mm_packs_epi32(_mm_load_si128(reinterpret_cast<const __m128i *>(colors.blue + p)), _mm_load_si128(reinterpret_cast<const __m128i *>(colors.blue + p + 4)));
+            __m128i best_e[2] = { _mm_set1_epi32(INT32_MAX), _mm_set1_epi32(INT32_MAX) };
+            __m128i best_i[2] = { zero, zero };
+            for(std::int32_t c = 0; c < 4; c++) {
+                auto dr = _mm_sub_epi16(red, _mm_set1_epi16(static_cast<std::int16_t>(palette[c].red)));
+                auto dg = _mm_sub_epi16(green, _mm_set1_epi16(static_cast<std::int16_t>(palette[c].green)));
+                auto db = _mm_sub_epi16(blue, _mm_set1_epi16(static_cast<std::int16_t>(palette[c].blue)));
+                auto rg_low = _mm_unpacklo_epi16(dr, dg);
+                auto rg_high = _mm_unpackhi_epi16(dr, dg);
+                auto b_low = _mm_unpacklo_epi16(db, zero);
+                auto b_high = _mm_unpackhi_epi16(db, zero);
+                __m128i e[2] = {
+                    _mm_add_epi32(_mm_madd_epi16(rg_low, rg_low), _mm_madd_epi16(b_low, b_low)),
+                    _mm_add_epi32(_mm_madd_epi16(rg_high, rg_high), _mm_madd_epi16(b_high, b_high))
+                };
+                auto index = _mm_set1_epi32(c);
+                for(std::size_t h = 0; h < 2; h++) {
+                    auto closer = _mm_cmpgt_epi32(best_e[h], e[h]);
+                    best_e[h] = _mm_or_si128(_mm_and_si128(closer, e[h]), _mm_andnot_si128(closer, best_e[h]));
+                    best_i[h] = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, best_i[h]));
+                }
+            }
+            for(std::size_t h = 0; h < 2; h++) {
+                _mm_store_si128(reinterpret_cast<__m128i *>(best_error + p + h * 4), best_e[h]);
+                _mm_store_si128(reinterpret_cast<__m128i *>(best_index + p + h * 4), best_i[h]);
+            }
+        }
+        #else
+        for(std::size_t p = 0; p < 16; p++) {
+            best_error[p] = INT32_MAX;
+            best_index[p] = 0;
+            for(std::int32_t c = 0; c < 4; c++) {
+                auto dr = colors.red[p] - palette[c].red;
+                auto dg = colors.green[p] - palette[c].green;
+                auto db = colors.blue[p] - palette[c].blue;
+                auto e = dr * dr + dg * dg + db * db;
+                if(e < best_error[p]) {
+                    best_error[p] = e;
+                    best_index[p] = c;
+                }
+            }
+        }
+        #endif
+
+        std::uint32_t total_error = 0;
+        for(std::size_t p = 0; p < 16; p++) {
+            indices[p] = static_cast<std::uint8_t>(best_index[p]);
+            total_error += static_cast<std::uint32_t>(best_error[p]);
+        }
+        return total_error;
+    }
+
+    /** Encode the block with the given endpoints, keeping it if it's better than what we have */
+    static void try_endpoints(const BlockColors &colors, std::uint16_t color0, std::uint16_t color1, ColorBlock &best, std::uint8_t *best_indices) {
+        // color0 must be greater than color1 to use four colors. If they're equal, then every pixel will pick index 0 anyway.
+        if(color0 < color1) {
+            std::swap(color0, color1);
+        }
+        if(best.error != UINT32_MAX && color0 == best.color0 && color1 == best.color1) {
+            return;
+        }
+
+        Color palette[4];
+        make_palette(color0, color1, palette);
+        std::uint8_t indices[16];
+        auto error = find_indices(colors, palette, indices);
+        if(error < best.error) {
+            best.color0 = color0;
+            best.color1 = color1;
+            best.error = error;
+            std::copy(indices, indices + 16, best_indices);
+        }
+    }
+
+    static inline std::int32_t divide_rounded(std::int64_t numerator, std::int64_t denominator) {
+        auto value = numerator >= 0 ? (numerator + denominator / 2) / denominator : -((-numerator + denominator / 2) / denominator);
+        return static_cast<std::int32_t>(std::clamp(value, static_cast<std::int64_t>(0), static_cast<std::int64_t>(255)));
+    }
+
+    /**
+     * Solve for the endpoints that best fit the colors for the given weights. The colors are fit as (a * color0 + b * color1) / 3.
+     * @return true if the endpoints could be solved
+     */
+    static bool solve_endpoints(std::int64_t aa, std::int64_t ab, std::int64_t bb, const std::int64_t *ax, const std::int64_t *bx, std::uint16_t &color0, std::uint16_t &color1) {
+        auto determinant = aa * bb - ab * ab;
+        if(determinant == 0) {
+            return false;
+        }
+        std::int32_t c0[3], c1[3];
+        for(std::size_t c = 0; c < 3; c++) {
+            c0[c] = divide_rounded(3 * (bb * ax[c] - ab * bx[c]), determinant);
+            c1[c] = divide_rounded(3 * (aa * bx[c] - ab * ax[c]), determinant);
+        }
+        color0 = pack_565(c0[0], c0[1], c0[2]);
+        color1 = pack_565(c1[0], c1[1], c1[2]);
+        return true;
+    }
+
+    /** Weights of color0 (out of 3) for each index; the weight of color1 is 3 minus this */
+    static constexpr std::int64_t INDEX_WEIGHTS[4] = { 3, 0, 2, 1 };
+
+    static void refine_endpoints(const BlockColors &colors, ColorBlock &best, std::uint8_t *best_indices) {
+        std::int64_t aa = 0, ab = 0, bb = 0;
+        std::int64_t ax[3] = {}, bx[3] = {};
+        for(std::size_t p = 0; p < 16; p++) {
+            auto a = INDEX_WEIGHTS[best_indices[p]];
+            auto b = 3 - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax[0] += a * colors.red[p];
+            ax[1] += a * colors.green[p];
+            ax[2] += a * colors.blue[p];
+            bx[0] += b * colors.red[p];
+            bx[1] += b * colors.green[p];
+            bx[2] += b * colors.blue[p];
+        }
+        std::uint16_t color0, color1;
+        if(solve_endpoints(aa, ab, bb, ax, bx, color0, color1)) {
+            try_endpoints(colors, color0, color1, best, best_indices);
+        }
+    }
+
+    static void principal_axis(const BlockColors &colors, float *axis) {
+        std::int64_t sum[3] = {};
+        std::int64_t products[6] = {};
+        for(std::size_t p = 0; p < 16; p++) {
+            std::int64_t r = colors.red[p], g = colors.green[p], b = colors.blue[p];
+            sum[0] += r;
+            sum[1] += g;
+            sum[2] += b;
+            products[0] += r * r;
+            products[1] += r * g;
+            products[2] += r * b;
+            products[3] += g * g;
+            products[4] += g * b;
+            products[5] += b * b;
+        }
+
+        // Covariance matrix (scaled by 16 * 16, which doesn't matter here)
+        float covariance[6] = {
+            static_cast<float>(products[0] * 16 - sum[0] * sum[0]),
+            static_cast<float>(products[1] * 16 - sum[0] * sum[1]),
+            static_cast<float>(products[2] * 16 - sum[0] * sum[2]),
+            static_cast<float>(products[3] * 16 - sum[1] * sum[1]),
+            static_cast<float>(products[4] * 16 - sum[1] * sum[2]),
+            static_cast<float>(products[5] * 16 - sum[2] * sum[2])
+        };
+
+        // Start with the row with the most variance, then use power iteration
+        float x, y, z;
+        if(covariance[0] >= covariance[3] && covariance[0] >= covariance[5]) {
+            x = covariance[0]; y = covariance[1]; z = covariance[2];
+        }
+        else if(covariance[3] >= covariance[5]) {
+            x = covariance[1]; y = covariance[3]; z = covariance[4];
+        }
+        else {
+            x = covariance[2]; y = covariance[4]; z = covariance[5];
+        }
+        for(int i = 0; i < 8; i++) {
+            float nx = x * covariance[0] + y * covariance[1] + z * covariance[2];
+            float ny = x * covariance[1] + y * covariance[3] + z * covariance[4];
+            float nz = x * covariance[2] + y * covariance[4] + z * covariance[5];
+            float largest = std::max(std::fabs(nx), std::max(std::fabs(ny), std::fabs(nz)));
+            if(largest == 0.0F) {
+                break;
+            }
+            x = nx / largest;
+            y = ny / largest;
+            z = nz / largest;
+        }
+
+        // Weigh it by perceived brightness if we can't find a direction at all
+        if(x == 0.0F && y == 0.0F && z == 0.0F) {
+            x = 0.299F;
+            y = 0.587F;
+            z = 0.114F;
+        }
+
+        axis[0] = x;
+        axis[1] = y;
+        axis[2] = z;
+    }
+
+    static void cluster_fit(const BlockColors &colors, const float *axis, ColorBlock &best, std::uint8_t *best_indices) {
+        // Order the pixels along the axis
+        float projections[16];
+        std::uint8_t order[16];
+        for(std::size_t p = 0; p < 16; p++) {
+            projections[p] = colors.red[p] * axis[0] + colors.green[p] * axis[1] + colors.blue[p] * axis[2];
+            order[p] = static_cast<std::uint8_t>(p);
+        }
+        std::stable_sort(order, order + 16, [&projections](std::uint8_t a, std::uint8_t b) { return projections[a] < projections[b]; });
+
+        // Prefix sums so each cluster's sum can be found quickly
+        std::int64_t prefix[17][3] = {};
+        for(std::size_t p = 0; p < 16; p++) {
+            prefix[p + 1][0] = prefix[p][0] + colors.red[order[p]];
+            prefix[p + 1][1] = prefix[p][1] + colors.green[order[p]];
+            prefix[p + 1][2] = prefix[p][2] + colors.blue[order[p]];
+        }
+
+        // Going along the axis, the pixels are split into color1, the color closer to color1, the color closer to color0, then color0
+        for(std::size_t i = 0; i <= 16; i++) {
+            for(std::size_t j = i; j <= 16; j++) {
+                for(std::size_t k = j; k <= 16; k++) {
+                    std::int64_t n1 = static_cast<std::int64_t>(i), n3 = static_cast<std::int64_t>(j - i), n2 = static_cast<std::int64_t>(k - j), n0 = static_cast<std::int64_t>(16 - k);
+                    std::int64_t aa = 9 * n0 + 4 * n2 + n3;
+                    std::int64_t bb = 9 * n1 + n2 + 4 * n3;
+                    std::int64_t ab = 2 * (n2 + n3);
+                    std::int64_t ax[3], bx[3];
+                    for(std::size_t c = 0; c < 3; c++) {
+                        auto s1 = prefix[i][c];
+                        auto s3 = prefix[j][c] - prefix[i][c];
+                        auto s2 = prefix[k][c] - prefix[j][c];
+                        auto s0 = prefix[16][c] - prefix[k][c];
+                        ax[c] = 3 * s0 + 2 * s2 + s3;
+                        bx[c] = 3 * s1 + s2 + 2 * s3;
+                    }
+                    std::uint16_t color0, color1;
+                    if(solve_endpoints(aa, ab, bb, ax, bx, color0, color1)) {
+                        try_endpoints(colors, color0, color1, best, best_indices);
+                    }
+                }
+            }
+        }
+    }
+
+    static void dither_block(BlockColors &colors) {
+        std::int32_t *channels[3] = { colors.red, colors.green, colors.blue };
+        for(std::size_t c = 0; c < 3; c++) {
+            auto *channel = channels[c];
+            bool six_bit = c == 1;
+
+            // Error is diffused with Floyd-Steinberg, stored in sixteenths
+            std::int32_t error[2][6] = {};
+            for(std::size_t y = 0; y < 4; y++) {
+                auto *current = error[y & 1];
+                auto *next = error[(y + 1) & 1];
+                std::fill(next, next + 6, 0);
+                for(std::size_t x = 0; x < 4; x++) {
+                    auto &pixel = channel[y * 4 + x];
+                    auto value = std::clamp(pixel * 16 + current[x + 1], 0, 255 * 16);
+                    auto rounded = (value + 8) / 16;
+                    auto quantized = six_bit ? expand_6((rounded * 63 + 127) / 255) : expand_5((rounded * 31 + 127) / 255);
+                    auto difference = value - quantized * 16;
+                    pixel = quantized;
+                    current[x + 2] += difference * 7 / 16;
+                    next[x] += difference * 3 / 16;
+                    next[x + 1] += difference * 5 / 16;
+                    next[x + 2] += difference / 16;
+                }
+            }
+        }
+    }
+
+    static void encode_color_block(const ColorPlatePixel *block, std::byte *output, DXTQuality quality, bool dither) {
+        BlockColors colors;
+        for(std::size_t p = 0; p < 16; p++) {
+            colors.red[p] = block[p].red;
+            colors.green[p] = block[p].green;
+            colors.blue[p] = block[p].blue;
+        }
+        if(dither) {
+            dither_block(colors);
+        }
+
+        ColorBlock best;
+        std::uint8_t best_indices[16] = {};
+
+        // If it's all one color, use the endpoints whose interpolated color is closest
+        bool single_color = true;
+        for(std::size_t p = 1; p < 16 && single_color; p++) {
+            single_color = colors.red[p] == colors.red[0] && colors.green[p] == colors.green[0] && colors.blue[p] == colors.blue[0];
+        }
+        if(single_color) {
+            static const SingleColorTable table_5 = make_single_color_table(5);
+            static const SingleColorTable table_6 = make_single_color_table(6);
+            auto &r = table_5.endpoints[colors.red[0]];
+            auto &g = table_6.endpoints[colors.green[0]];
+            auto &b = table_5.endpoints[colors.blue[0]];
+            best.color0 = static_cast<std::uint16_t>((r[0] << 11) | (g[0] << 5) | b[0]);
+            best.color1 = static_cast<std::uint16_t>((r[1] << 11) | (g[1] << 5) | b[1]);
+            std::uint8_t index = 2;
+            if(best.color0 < best.color1) {
+                std::swap(best.color0, best.color1);
+                index = 3;
+            }
+            std::fill(best_indices, best_indices + 16, index);
+        }
+        else {
+            float axis[3];
+            principal_axis(colors, axis);
+
+            // Start with the two colors at either end of the axis
+            std::size_t min_pixel = 0, max_pixel = 0;
+            float min_projection = INFINITY, max_projection = -INFINITY;
+            for(std::size_t p = 0; p < 16; p++) {
+                float projection = colors.red[p] * axis[0] + colors.green[p] * axis[1] + colors.blue[p] * axis[2];
+                if(projection < min_projection) {
+                    min_projection = projection;
+                    min_pixel = p;
+                }
+                if(projection > max_projection) {
+                    max_projection = projection;
+                    max_pixel = p;
+                }
+            }
+            try_endpoints(colors, pack_565(colors.red[max_pixel], colors.green[max_pixel], colors.blue[max_pixel]), pack_565(colors.red[min_pixel], colors.green[min_pixel], colors.blue[min_pixel]), best, best_indices);
+
+            if(quality != DXTQuality::DXT_QUALITY_FAST) {
+                for(int i = 0; i < 2; i++) {
+                    refine_endpoints(colors, best, best_indices);
+                }
+            }
+
+            if(quality == DXTQuality::DXT_QUALITY_HIGH) {
+                cluster_fit(colors, axis, best, best_indices);
+                refine_endpoints(colors, best, best_indices);
+            }
+        }
+
+        std::uint32_t indices = 0;
+        for(std::size_t p = 0; p < 16; p++) {
+            indices |= static_cast<std::uint32_t>(best_indices[p]) << (p * 2);
+        }
+        *reinterpret_cast<LittleEndian<std::uint16_t> *>(output) = best.color0;
+        *reinterpret_cast<LittleEndian<std::uint16_t> *>(output + 2) = best.color1;
+        *reinterpret_cast<LittleEndian<std::uint32_t> *>(output + 4) = indices;
+    }
+
+    static std::uint32_t find_alpha_indices(const std::int32_t *alpha, const std::int32_t *palette, std::uint64_t &indices) {
+        std::uint32_t total_error = 0;
+        indices = 0;
+        for(std::size_t p = 0; p < 16; p++) {
+            std::int32_t best_error = INT32_MAX;
+            std::uint64_t best_index = 0;
+            for(std::size_t i = 0; i < 8; i++) {
+                auto error = (alpha[p] - palette[i]) * (alpha[p] - palette[i]);
+                if(error < best_error) {
+                    best_error = error;
+                    best_index = i;
+                }
+            }
+            total_error += static_cast<std::uint32_t>(best_error);
+            indices |= best_index << (p * 3);
+        }
+        return total_error;
+    }
+
+    static void encode_dxt5_alpha_block(const ColorPlatePixel *block, std::byte *output, DXTQuality quality) {
+        std::int32_t alpha[16];
+        std::int32_t min_alpha = 255, max_alpha = 0;
+        std::int32_t min_inner_alpha = 255, max_inner_alpha = 0;
+        for(std::size_t p = 0; p < 16; p++) {
+            alpha[p] = block[p].alpha;
+            min_alpha = std::min(min_alpha, alpha[p]);
+            max_alpha = std::max(max_alpha, alpha[p]);
+            if(alpha[p] != 0 && alpha[p] != 255) {
+                min_inner_alpha = std::min(min_inner_alpha, alpha[p]);
+                max_inner_alpha = std::max(max_inner_alpha, alpha[p]);
+            }
+        }
+
+        // Eight interpolated values
+        std::int32_t palette[8] = { max_alpha, min_alpha };
+        for(std::int32_t i = 2; i < 8; i++) {
+            palette[i] = ((8 - i) * max_alpha + (i - 1) * min_alpha) / 7;
+        }
+        std::uint64_t indices;
+        auto error = find_alpha_indices(alpha, palette, indices);
+        auto alpha0 = max_alpha, alpha1 = min_alpha;
+
+        // Six interpolated values plus 0 and 255 might be better if the block has fully opaque and transparent pixels
+        if(quality == DXTQuality::DXT_QUALITY_HIGH && min_inner_alpha < max_inner_alpha && (min_alpha == 0 || max_alpha == 255)) {
+            std::int32_t palette_6[8] = { min_inner_alpha, max_inner_alpha };
+            for(std::int32_t i = 2; i < 6; i++) {
+                palette_6[i] = ((6 - i) * min_inner_alpha + (i - 1) * max_inner_alpha) / 5;
+            }
+            palette_6[6] = 0;
+            palette_6[7] = 255;
+            std::uint64_t indices_6;
+            auto error_6 = find_alpha_indices(alpha, palette_6, indices_6);
+            if(error_6 < error) {
+                indices = indices_6;
+                alpha0 = min_inner_alpha;
+                alpha1 = max_inner_alpha;
+            }
+        }
+
+        output[0] = static_cast<std::byte>(alpha0);
+        output[1] = static_cast<std::byte>(alpha1);
+        for(std::size_t i = 0; i < 6; i++) {
+            output[2 + i] = static_cast<std::byte>(indices >> (i * 8));
+        }
+    }
+
+    static void encode_dxt3_alpha_block(const ColorPlatePixel *block, std::byte *output) {
+        // Alpha is stored in order from the first ones being the least significant bytes, and the last ones being the most significant bytes
+        std::uint64_t alpha = 0;
+        for(std::size_t p = 0; p < 16; p++) {
+            alpha |= static_cast<std::uint64_t>(block[p].alpha >> 4) << (p * 4);
+        }
+        *reinterpret_cast<LittleEndian<std::uint64_t> *>(output) = alpha;
+    }
+
+    void encode_block(const ColorPlatePixel *block, std::byte *output, BitmapDataFormat format, DXTQuality quality, bool dither) {
+        switch(format) {
+            case BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1:
+                encode_color_block(block, output, quality, dither);
+                break;
+            case BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3:
+                encode_dxt3_alpha_block(block, output);
+                encode_color_block(block, output + 8, quality, dither);
+                break;
+            case BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5:
+                encode_dxt5_alpha_block(block, output, quality);
+                encode_color_block(block, output + 8, quality, dither);
+                break;
+            default:
+                std::terminate();
+        }
+    }
+
+    void encode_dxt(const ColorPlatePixel *pixels, std::size_t width, std::size_t height, std::byte *output, BitmapDataFormat format, DXTQuality quality, bool dither, ThreadPool *thread_pool) {
+        std::size_t block_size = format == BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1 ? 8 : 16;
+        std::size_t blocks_wide = width / 4;
+        std::size_t blocks_tall = height / 4;
+
+        // Each row of blocks is independent from the others, so each one can be its own task
+        auto encode_row = [&pixels, &output, width, blocks_wide, block_size, format, quality, dither](std::size_t row) {
+            ColorPlatePixel block[16];
+            auto *row_output = output + row * blocks_wide * block_size;
+            for(std::size_t x = 0; x < blocks_wide; x++) {
+                for(std::size_t y = 0; y < 4; y++) {
+                    std::copy(pixels + (row * 4 + y) * width + x * 4, pixels + (row * 4 + y) * width + x * 4 + 4, block + y * 4);
+                }
+                encode_block(block, row_output + x * block_size, format, quality, dither);
+            }
+        };
+
+        // Without any threads to hand rows off to, just encode them here
+        if(!thread_pool || thread_pool->get_thread_count() == 0 || blocks_tall <= 1) {
+            for(std::size_t row = 0; row < blocks_tall; row++) {
+                encode_row(row);
+            }
+            return;
+        }
+
+        std::vector<std::future<void>> rows;
+        rows.reserve(blocks_tall);
+        for(std::size_t row = 0; row < blocks_tall; row++) {
+            rows.emplace_back(thread_pool->submit([&encode_row, row]() { encode_row(row); }));
+        }
+        for(auto &r : rows) {
+            r.get();
+        }
+    }
+}
@@ -1,88 +1,147 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <vector>
 #include <tiffio.h>
 #include "image_loader.hpp"
 #include <invader/printf.hpp>
+#include <invader/error.hpp>
 #include "stb/stb_image.h"
 
 namespace Invader {
-    #define ALLOCATE_PIXELS(count) reinterpret_cast<Invader::ColorPlatePixel *>(calloc(sizeof(Invader::ColorPlatePixel) * pixel_count, 1))
+    /**
+     * Reads an image decoded by stb_image, converting each row from RGBA when it is read
+     */
+    class STBImageReader : public ColorPlateReader {
+    public:
+        void read_row(ColorPlatePixel *row) override {
+            const auto *data = this->next_row;
+            for(std::uint32_t x = 0; x < this->width; x++) {
+                row[x].alpha = data[3];
+                row[x].red = data[0];
+                row[x].green = data[1];
+                row[x].blue = data[2];
+                data += 4;
+            }
+            this->next_row = data;
+        }
 
-    static Invader::ColorPlatePixel *rgba_to_pixel(const std::uint8_t *data, std::size_t pixel_count) {
-        auto *pixel_data = ALLOCATE_PIXELS(pixel_count);
+        STBImageReader(const char *path) {
+            int x = 0, y = 0, channels = 0;
+            this->image_buffer = stbi_load(path, &x, &y, &channels, 4);
+            if(!this->image_buffer) {
+                eprintf_error("Failed to load %s. Error was: %s", path, stbi_failure_reason());
+                throw InvalidInputBitmapException();
+            }
 
-        for(std::size_t i = 0; i < pixel_count; i++) {
-            pixel_data[i].alpha = data[3];
-            pixel_data[i].red = data[0];
-            pixel_data[i].green = data[1];
-            pixel_data[i].blue = data[2];
-            data += 4;
+            this->width = static_cast<std::uint32_t>(x);
+            this->height = static_cast<std::uint32_t>(y);
+            this->next_row = this->image_buffer;
         }
 
-        return pixel_data;
-    }
+        ~STBImageReader() override {
+            stbi_image_free(this->image_buffer);
+        }
 
-    #undef ALLOCATE_PIXELS
+    private:
+        std::uint8_t *image_buffer;
+        const std::uint8_t *next_row;
+    };
+
+    /**
+     * Reads a TIFF one strip at a time. Tiled TIFFs and TIFFs that aren't stored top to bottom are decoded all at once instead.
+     */
+    class TIFFImageReader : public ColorPlateReader {
+    public:
+        void read_row(ColorPlatePixel *row) override {
+            const std::uint32_t *raster_row;
+
+            // Decode the whole image
+            if(this->image_tiff == nullptr) {
+                raster_row = this->raster.data() + static_cast<std::size_t>(this->next_row) * this->width;
+            }
 
-    Invader::ColorPlatePixel *load_image(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size) {
-        // Load it
-        int x = 0, y = 0, channels = 0;
-        auto *image_buffer = stbi_load(path, &x, &y, &channels, 4);
-        if(!image_buffer) {
-            eprintf_error("Failed to load %s. Error was: %s", path, stbi_failure_reason());
-            exit(EXIT_FAILURE);
-        }
+            // Decode the next strip if we need to. Strips are decoded bottom to top, so the first row of the strip is the last one.
+            else {
+                if(this->next_row == this->strip_end) {
+                    if(TIFFReadRGBAStrip(this->image_tiff, this->next_row, this->raster.data()) != 1) {
+                        eprintf_error("Failed to read row %u of the TIFF", this->next_row);
+                        throw InvalidInputBitmapException();
+                    }
+                    this->strip_end = std::min(this->next_row + this->rows_per_strip, this->height);
+                }
+                raster_row = this->raster.data() + static_cast<std::size_t>(this->strip_end - this->next_row - 1) * this->width;
+            }
+
+            for(std::uint32_t x = 0; x < this->width; x++) {
+                row[x].alpha = TIFFGetA(raster_row[x]);
+                row[x].red = TIFFGetR(raster_row[x]);
+                row[x].green = TIFFGetG(raster_row[x]);
+                row[x].blue = TIFFGetB(raster_row[x]);
+            }
 
-        // Get the width and height
-        image_width = static_cast<std::uint32_t>(x);
-        image_height = static_cast<std::uint32_t>(y);
-        image_size = image_width * image_height * sizeof(Invader::ColorPlatePixel);
+            this->next_row++;
+        }
 
-        // Do the thing
-        Invader::ColorPlatePixel *return_value = rgba_to_pixel(reinterpret_cast<std::uint8_t *>(image_buffer), image_width * image_height);
+        TIFFImageReader(const char *path) {
+            this->image_tiff = TIFFOpen(path, "r");
+            if(!this->image_tiff) {
+                eprintf_error("Cannot open %s", path);
+                throw InvalidInputBitmapException();
+            }
+            TIFFGetField(this->image_tiff, TIFFTAG_IMAGEWIDTH, &this->width);
+            TIFFGetField(this->image_tiff, TIFFTAG_IMAGELENGTH, &this->height);
+
+            // Force associated alpha if we have alpha so alpha doesn't get multiplied in TIFFReadRGBAImageOriented
+            std::uint16_t count;
+            std::uint16_t *attributes;
+            int defined = TIFFGetField(this->image_tiff, TIFFTAG_EXTRASAMPLES, &count, &attributes);
+            if(defined && count == 1) {
+                if(*attributes == EXTRASAMPLE_UNASSALPHA) {
+                    std::uint16_t new_value = EXTRASAMPLE_ASSOCALPHA;
+                    TIFFSetField(this->image_tiff, TIFFTAG_EXTRASAMPLES, 1, &new_value);
+                }
+            }
 
-        // Free the buffer
-        stbi_image_free(image_buffer);
+            std::uint16_t orientation = ORIENTATION_TOPLEFT;
+            TIFFGetFieldDefaulted(this->image_tiff, TIFFTAG_ORIENTATION, &orientation);
+            std::uint32_t rows_per_strip = this->height;
+            TIFFGetFieldDefaulted(this->image_tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
 
-        return return_value;
-    }
+            // Read one strip at a time if we can
+            if(!TIFFIsTiled(this->image_tiff) && orientation == ORIENTATION_TOPLEFT) {
+                this->rows_per_strip = std::clamp(rows_per_strip, static_cast<std::uint32_t>(1), std::max(this->height, static_cast<std::uint32_t>(1)));
+                this->raster.resize(static_cast<std::size_t>(this->width) * this->rows_per_strip);
+            }
 
-    Invader::ColorPlatePixel *load_tiff(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size) {
-        TIFF *image_tiff = TIFFOpen(path, "r");
-        if(!image_tiff) {
-            eprintf_error("Cannot open %s", path);
-            exit(EXIT_FAILURE);
-        }
-        TIFFGetField(image_tiff, TIFFTAG_IMAGEWIDTH, &image_width);
-        TIFFGetField(image_tiff, TIFFTAG_IMAGELENGTH, &image_height);
-
-        // Force associated alpha if we have alpha so alpha doesn't get multiplied in TIFFReadRGBAImageOriented
-        std::uint16_t count;
-        std::uint16_t *attributes;
-        int defined = TIFFGetField(image_tiff, TIFFTAG_EXTRASAMPLES, &count, &attributes);
-        if(defined && count == 1) {
-            if(*attributes == EXTRASAMPLE_UNASSALPHA) {
-                std::uint16_t new_value = EXTRASAMPLE_ASSOCALPHA;
-                TIFFSetField(image_tiff, TIFFTAG_EXTRASAMPLES, 1, &new_value);
+            // Otherwise, read it all
+            else {
+                this->raster.resize(static_cast<std::size_t>(this->width) * this->height);
+                TIFFReadRGBAImageOriented(this->image_tiff, this->width, this->height, this->raster.data(), ORIENTATION_TOPLEFT);
+                TIFFClose(this->image_tiff);
+                this->image_tiff = nullptr;
             }
         }
 
-        // Read it all
-        image_size = image_width * image_height * sizeof(Invader::ColorPlatePixel);
-        auto *image_pixels = reinterpret_cast<Invader::ColorPlatePixel *>(std::calloc(image_size, 1));
-        TIFFReadRGBAImageOriented(image_tiff, image_width, image_height, reinterpret_cast<std::uint32_t *>(image_pixels), ORIENTATION_TOPLEFT);
+        ~TIFFImageReader() override {
+            if(this->image_tiff) {
+                TIFFClose(this->image_tiff);
+            }
+        }
 
-        // Close the TIFF
-        TIFFClose(image_tiff);
+    private:
+        TIFF *image_tiff;
+        std::vector<std::uint32_t> raster;
+        std::uint32_t rows_per_strip = 0;
+        std::uint32_t strip_end = 0;
+        std::uint32_t next_row = 0;
+    };
 
-        // Swap red and blue channels
-        for(std::size_t i = 0; i < image_size / 4; i++) {
-            Invader::ColorPlatePixel swapped = image_pixels[i];
-            swapped.red = image_pixels[i].blue;
-            swapped.blue = image_pixels[i].red;
-            image_pixels[i] = swapped;
-        }
+    std::unique_ptr<ColorPlateReader> open_image(const char *path) {
+        return std::make_unique<STBImageReader>(path);
+    }
 
-        return image_pixels;
+    std::unique_ptr<ColorPlateReader> open_tiff(const char *path) {
+        return std::make_unique<TIFFImageReader>(path);
     }
 }
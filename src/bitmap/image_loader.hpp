@@ -3,11 +3,23 @@
 #ifndef INVADER__BITMAP__IMAGE_LOADER_HPP
 #define INVADER__BITMAP__IMAGE_LOADER_HPP
 
+#include <memory>
 #include "color_plate_scanner.hpp"
 
 namespace Invader {
-    ColorPlatePixel *load_tiff(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size);
-    ColorPlatePixel *load_image(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size);
+    /**
+     * Open a TIFF for reading. Stripped TIFFs are decoded one strip at a time as rows are read.
+     * @param  path path to the TIFF
+     * @return      reader
+     */
+    std::unique_ptr<ColorPlateReader> open_tiff(const char *path);
+
+    /**
+     * Open a PNG, TGA, or BMP for reading. These are decoded all at once, but each row is only converted when it is read.
+     * @param  path path to the image
+     * @return      reader
+     */
+    std::unique_ptr<ColorPlateReader> open_image(const char *path);
 }
 
 #endif
@@ -10,8 +10,6 @@ if len(sys.argv) != 3:
 colors = []
 color_data = []
 
-palette_indices = []
-
 # Open and read it
 with open(sys.argv[1], "rb") as palette_file:
     palette_file.seek(0,2)
@@ -33,36 +31,68 @@ for c in range(0,256):
         break
 
 # Go through each red and green. Since it's normalized, blue can be inferred
-for red in range(0,256):
-    for green in range(0,256):
-        closest_error = 65536
-        closest_index = None
-        for color_index in range(0,first_black):
+#
+# Rather than checking every color for every red and green, split red and green into cells and only check the colors that could be the closest
+# to something in that cell: anything whose closest possible distance is no more than the farthest possible distance of the best color.
+CELL_SIZE = 8
+palette_indices = [None] * (256 * 256)
+searchable = list(range(0,first_black))
+
+for red_cell in range(0,256,CELL_SIZE):
+    for green_cell in range(0,256,CELL_SIZE):
+        red_max = red_cell + CELL_SIZE - 1
+        green_max = green_cell + CELL_SIZE - 1
+
+        def axis_range(value, low, high):
+            nearest = 0 if low <= value <= high else min(abs(value - low), abs(value - high))
+            farthest = max(abs(value - low), abs(value - high))
+            return nearest, farthest
+
+        nearest_distances = []
+        best_farthest = None
+        for color_index in searchable:
             color = colors[color_index]
-            distance_x = (color[1] - red)
-            distance_y = (color[2] - green)
-            distance = distance_x * distance_x + distance_y * distance_y
-
-            if distance < closest_error:
-                closest_error = distance
-                closest_index = color_index
-
-        palette_indices.append(closest_index)
+            red_nearest, red_farthest = axis_range(color[1], red_cell, red_max)
+            green_nearest, green_farthest = axis_range(color[2], green_cell, green_max)
+            nearest_distances.append(red_nearest * red_nearest + green_nearest * green_nearest)
+            farthest = red_farthest * red_farthest + green_farthest * green_farthest
+            if best_farthest is None or farthest < best_farthest:
+                best_farthest = farthest
+
+        # Keep these in palette order so ties go to the same color as checking every color would
+        candidates = [searchable[i] for i in range(0,len(searchable)) if nearest_distances[i] <= best_farthest]
+
+        for red in range(red_cell,red_max + 1):
+            for green in range(green_cell,green_max + 1):
+                closest_error = 65536
+                closest_index = None
+                for color_index in candidates:
+                    color = colors[color_index]
+                    distance_x = (color[1] - red)
+                    distance_y = (color[2] - green)
+                    distance = distance_x * distance_x + distance_y * distance_y
+
+                    if distance < closest_error:
+                        closest_error = distance
+                        closest_index = color_index
+
+                palette_indices[red * 256 + green] = closest_index
 
 # Now write the C++ file
 with open(sys.argv[2], "w") as cpp:
     cpp.write("// This value was auto-generated. Changes made to this file may get overwritten.\n")
     cpp.write("#include <cstdint>\n")
+    cpp.write("#include <invader/bitmap/p8_palettize.hpp>\n")
     cpp.write("namespace Invader {\n")
 
-    cpp.write("    static constexpr std::uint8_t p8_map[] = {")
+    cpp.write("    extern const std::uint8_t p8_map[256 * 256] = {")
     for color in range(0,len(palette_indices)):
         if color % 16 == 0:
             cpp.write("\n        ")
         cpp.write("0x{:02X}{}".format(palette_indices[color], "," if color + 1 < len(palette_indices) else "\n"))
     cpp.write("    };\n")
 
-    cpp.write("    static constexpr std::uint8_t p8_colors[256][4] = {")
+    cpp.write("    extern const std::uint8_t p8_colors[256][4] = {")
     for color in range(0,len(colors)):
         if color % 16 == 0:
             cpp.write("\n        ")
@@ -70,9 +100,9 @@ with open(sys.argv[2], "w") as cpp:
     cpp.write("    };\n")
 
     cpp.write("    std::uint8_t rg_convert_to_p8(std::uint8_t red, std::uint8_t green, std::uint8_t blue, std::uint8_t alpha) {\n")
-    cpp.write("        if(alpha < 0x2F) {\n")
+    cpp.write("        if(alpha < P8Palettize::TRANSPARENT_ALPHA) {\n")
     cpp.write("            // Basically add 1 if blue is at least 0x80.\n")
-    cpp.write("            return 0xFE + (blue >= 0x80);\n")
+    cpp.write("            return P8Palettize::TRANSPARENT_INDEX + (blue >= 0x80);\n")
     cpp.write("        }\n")
     cpp.write("        return p8_map[red * 256 + green];\n")
     cpp.write("    }\n")
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "../simd.hpp"
+
+#include <invader/bitmap/p8_palettize.hpp>
+
+namespace Invader {
+    // These are generated from the palette (see p8/palette.py)
+    extern const std::uint8_t p8_map[256 * 256];
+    extern const std::uint8_t p8_colors[256][4];
+}
+
+namespace Invader::P8Palettize {
+    static inline std::uint8_t palettize_pixel(const ColorPlatePixel &pixel) {
+        if(pixel.alpha < TRANSPARENT_ALPHA) {
+            return TRANSPARENT_INDEX + (pixel.blue >= 0x80);
+        }
+        return p8_map[pixel.red * 256 + pixel.green];
+    }
+
+    void palettize(const ColorPlatePixel *pixels, std::uint8_t *output, std::size_t count) {
+        std::size_t i = 0;
+
+        #ifdef INVADER_SSE2
+        // Work out the table index (red and green) and the transparent index of 16 pixels at a time; only the table lookup itself is scalar
+        auto index_mask = _mm_set1_epi32(0xFFFF);
+        auto transparent_alpha = _mm_set1_epi32(TRANSPARENT_ALPHA);
+        auto transparent_index = _mm_set1_epi32(TRANSPARENT_INDEX);
+        auto one = _mm_set1_epi32(1);
+        alignas(16) std::uint32_t indices[16];
+
+        for(; i + 16 <= count; i += 16) {
+            __m128i results[4];
+            for(std::size_t v = 0; v < 4; v++) {
+                auto pixel_vector = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i + v * 4));
+                _mm_store_si128(reinterpret_cast<__m128i *>(indices + v * 4), _mm_and_si128(_mm_srli_epi32(pixel_vector, 8), index_mask));
+
+                auto transparent = _mm_cmplt_epi32(_mm_srli_epi32(pixel_vector, 24), transparent_alpha);
+                auto transparent_result = _mm_or_si128(transparent_index, _mm_and_si128(_mm_srli_epi32(pixel_vector, 7), one));
+                auto *lookup = indices + v * 4;
+                auto opaque_result = _mm_setr_epi32(p8_map[lookup[0]], p8_map[lookup[1]], p8_map[lookup[2]], p8_map[lookup[3]]);
+                results[v] = _mm_or_si128(_mm_and_si128(transparent, transparent_result), _mm_andnot_si128(transparent, opaque_result));
+            }
+
+            auto packed = _mm_packus_epi16(_mm_packs_epi32(results[0], results[1]), _mm_packs_epi32(results[2], results[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), packed);
+        }
+        #endif
+
+        for(; i < count; i++) {
+            output[i] = palettize_pixel(pixels[i]);
+        }
+    }
+
+    /** Add error * weight / 16 (rounded down) to the channel, clamping it to 0-255 */
+    static inline void apply_error(std::uint8_t &channel, int error, int weight) {
+        // Add 16 * 256 before dividing so it rounds down for negative errors, too
+        int value = channel + (error * weight + 16 * 256) / 16 - 256;
+        channel = static_cast<std::uint8_t>(value < 0 ? 0 : value > UINT8_MAX ? UINT8_MAX : value);
+    }
+
+    void palettize_dithered(ColorPlatePixel *pixels, std::uint8_t *output, std::uint32_t width, std::uint32_t height, bool dither_alpha, bool dither_red, bool dither_green, bool dither_blue) {
+        for(std::uint32_t y = 0; y < height; y++) {
+            auto *row = pixels + static_cast<std::size_t>(y) * width;
+            auto *row_output = output + static_cast<std::size_t>(y) * width;
+            auto *row_below = row + width;
+
+            for(std::uint32_t x = 0; x < width; x++) {
+                auto &pixel = row[x];
+                auto index = palettize_pixel(pixel);
+                row_output[x] = index;
+
+                // Edge pixels don't diffuse their error
+                if(x == 0 || x + 1 >= width || y + 1 >= height) {
+                    continue;
+                }
+
+                const auto *color = p8_colors[index];
+                auto diffuse = [&](bool dither, std::uint8_t ColorPlatePixel::*channel, std::uint8_t palette_value) {
+                    if(dither) {
+                        int error = static_cast<int>(pixel.*channel) - palette_value;
+                        apply_error(row[x + 1].*channel, error, 7);
+                        apply_error(row_below[x - 1].*channel, error, 3);
+                        apply_error(row_below[x].*channel, error, 5);
+                        apply_error(row_below[x + 1].*channel, error, 1);
+                    }
+                };
+
+                diffuse(dither_alpha, &ColorPlatePixel::alpha, color[0]);
+                diffuse(dither_red, &ColorPlatePixel::red, color[1]);
+                diffuse(dither_green, &ColorPlatePixel::green, color[2]);
+                diffuse(dither_blue, &ColorPlatePixel::blue, color[3]);
+            }
+        }
+    }
+}
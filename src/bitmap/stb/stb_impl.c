@@ -1,8 +1,5 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
-#define STB_DXT_IMPLEMENTATION
-#define STB_DXT_USE_ROUNDING_BIAS
-#include "stb_dxt.h"
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_NO_JPEG
 #define STBI_NO_PSD
@@ -1,97 +1,122 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <invader/bitmap/swizzle.hpp>
+#include <algorithm>
+#include <array>
 #include <vector>
 #include <cstdint>
 #include <cstring>
 
 namespace Invader::Swizzle {
-    template<typename Pixel> static std::size_t swizzle_block_2x2(const Pixel *values_in, Pixel *values_out, std::size_t stride, std::size_t counter, bool deswizzle) {
-        if(!deswizzle) {
-            // values_in  = unswizzled
-            // values_out = swizzled
-            values_out[counter++] = values_in[0];
-            values_out[counter++] = values_in[1];
-            values_out[counter++] = values_in[0 + stride];
-            values_out[counter++] = values_in[1 + stride];
-        }
-        else {
-            // values_in  = swizzled
-            // values_out = unswizzled
-            values_out[0] = values_in[counter++];
-            values_out[1] = values_in[counter++];
-            values_out[0 + stride] = values_in[counter++];
-            values_out[1 + stride] = values_in[counter++];
-        }
-        return counter;
-    }
+    /** Width and height of the tiles that are (de)swizzled at once; a 32x32 tile of 32-bit pixels is 4 KiB */
+    static constexpr std::size_t TILE_SIZE = 32;
 
-    template<typename Pixel> static std::size_t swizzle_block(const Pixel *values_in, Pixel *values_out, std::size_t width, std::size_t stride, std::size_t counter, bool deswizzle) {
-        if(width == 2) {
-            return swizzle_block_2x2(values_in, values_out, stride, counter, deswizzle);
+    /** Each byte with its bits spread out to every other bit (i.e. 0b1011 becomes 0b1000101) */
+    static constexpr std::array<std::uint16_t, 256> MORTON_TABLE = []() {
+        std::array<std::uint16_t, 256> table = {};
+        for(std::size_t i = 0; i < table.size(); i++) {
+            for(std::size_t bit = 0; bit < 8; bit++) {
+                table[i] |= static_cast<std::uint16_t>(((i >> bit) & 1) << (bit * 2));
+            }
         }
+        return table;
+    }();
 
-        std::size_t new_width = width / 2;
-
-        if(!deswizzle) {
-            counter = swizzle_block(values_in, values_out                                 , new_width, stride, counter, deswizzle);
-            counter = swizzle_block(values_in + new_width                                 , values_out, new_width, stride, counter, deswizzle);
-            counter = swizzle_block(values_in + stride * new_width                        , values_out, new_width, stride, counter, deswizzle);
-            counter = swizzle_block(values_in + stride * new_width + new_width, values_out, new_width, stride, counter, deswizzle);
-        }
-        else {
-            counter = swizzle_block(values_in, values_out                                 , new_width, stride, counter, deswizzle);
-            counter = swizzle_block(values_in, values_out + new_width                     , new_width, stride, counter, deswizzle);
-            counter = swizzle_block(values_in, values_out + stride * new_width            , new_width, stride, counter, deswizzle);
-            counter = swizzle_block(values_in, values_out + stride * new_width + new_width, new_width, stride, counter, deswizzle);
+    static std::size_t spread_bits(std::size_t value) {
+        std::size_t spread = 0;
+        for(std::size_t shift = 0; value != 0; shift += 16, value >>= 8) {
+            spread |= static_cast<std::size_t>(MORTON_TABLE[value & 0xFF]) << shift;
         }
+        return spread;
+    }
 
-        return counter;
+    /**
+     * Get the offset in the swizzled data of each column or row. The offset of a pixel is its column offset plus its row offset.
+     *
+     * The bits of the x and y coordinates are interleaved (x first) until the smaller dimension runs out of bits. The remaining bits of the
+     * larger dimension then select which square of the bitmap the pixel is in.
+     *
+     * @param length       width (if columns) or height (if rows)
+     * @param square_size  the smaller of the width and height
+     * @param shift        0 if columns or 1 if rows
+     * @return             offsets
+     */
+    static std::vector<std::size_t> axis_offsets(std::size_t length, std::size_t square_size, std::size_t shift) {
+        std::vector<std::size_t> offsets(length);
+        std::size_t square_pixels = square_size * square_size;
+        for(std::size_t i = 0; i < length; i++) {
+            offsets[i] = (spread_bits(i % square_size) << shift) + (i / square_size) * square_pixels;
+        }
+        return offsets;
     }
 
-    template <typename Pixel> static void swizzle(const Pixel *values_in, Pixel *values_out, std::size_t width, std::size_t height, bool deswizzle) {
+    template <typename Pixel, bool deswizzle> static void swizzle(const Pixel *values_in, Pixel *values_out, std::size_t width, std::size_t height) {
         // If height is <= 1 or width is <= 2, it's just a straight copy
         if(width <= 2 || height <= 1) {
             std::memcpy(values_out, values_in, width * height * sizeof(*values_in));
             return;
         }
 
-        // Also, if width is less than the height, we can subdivide
-        if(width < height) {
-            for(std::size_t y = 0; y < height; y += width) {
-                swizzle(values_in + y * width, values_out + y * width, width, width, deswizzle);
-            }
-            return;
-        }
+        std::size_t square_size = std::min(width, height);
+        auto column_offsets = axis_offsets(width, square_size, 0);
+        auto row_offsets = axis_offsets(height, square_size, 1);
 
-        std::size_t counter = 0;
-        for(std::size_t x = 0; x < width; x+=height) {
-            if(!deswizzle) {
-                counter = swizzle_block(values_in + x, values_out, height, width, counter, deswizzle);
-            }
-            else {
-                counter = swizzle_block(values_in, values_out + x, height, width, counter, deswizzle);
+        std::size_t tile_size = std::min(TILE_SIZE, square_size);
+
+        // Each tile is contiguous in the swizzled data, so this keeps both sides of the copy in cache
+        for(std::size_t tile_y = 0; tile_y < height; tile_y += tile_size) {
+            for(std::size_t tile_x = 0; tile_x < width; tile_x += tile_size) {
+                // Every 2x2 quad is four consecutive pixels in the swizzled data, with each row of the quad being two of them
+                for(std::size_t y = tile_y; y < tile_y + tile_size; y += 2) {
+                    std::size_t row = y * width;
+                    std::size_t row_offset = row_offsets[y];
+                    for(std::size_t x = tile_x; x < tile_x + tile_size; x += 2) {
+                        std::size_t swizzled = row_offset + column_offsets[x];
+                        if constexpr(deswizzle) {
+                            std::memcpy(values_out + row + x, values_in + swizzled, sizeof(Pixel) * 2);
+                            std::memcpy(values_out + row + width + x, values_in + swizzled + 2, sizeof(Pixel) * 2);
+                        }
+                        else {
+                            std::memcpy(values_out + swizzled, values_in + row + x, sizeof(Pixel) * 2);
+                            std::memcpy(values_out + swizzled + 2, values_in + row + width + x, sizeof(Pixel) * 2);
+                        }
+                    }
+                }
             }
         }
     }
 
-    std::vector<std::byte> swizzle(const std::byte *data, std::size_t bits_per_pixel, std::size_t width, std::size_t height, bool deswizzle) {
-        std::vector<std::byte> output(width*height*(bits_per_pixel/8));
+    template <typename Pixel> static void swizzle(const std::byte *data, std::byte *output, std::size_t width, std::size_t height, bool deswizzle) {
+        const auto *values_in = reinterpret_cast<const Pixel *>(data);
+        auto *values_out = reinterpret_cast<Pixel *>(output);
+        if(deswizzle) {
+            swizzle<Pixel, true>(values_in, values_out, width, height);
+        }
+        else {
+            swizzle<Pixel, false>(values_in, values_out, width, height);
+        }
+    }
 
+    void swizzle(const std::byte *data, std::byte *output, std::size_t bits_per_pixel, std::size_t width, std::size_t height, bool deswizzle) {
         switch(bits_per_pixel) {
             case 8:
-                swizzle(reinterpret_cast<const std::uint8_t *>(data), reinterpret_cast<std::uint8_t *>(output.data()), width, height, deswizzle);
+                swizzle<std::uint8_t>(data, output, width, height, deswizzle);
                 break;
             case 16:
-                swizzle(reinterpret_cast<const std::uint16_t *>(data), reinterpret_cast<std::uint16_t *>(output.data()), width, height, deswizzle);
+                swizzle<std::uint16_t>(data, output, width, height, deswizzle);
                 break;
             case 32:
-                swizzle(reinterpret_cast<const std::uint32_t *>(data), reinterpret_cast<std::uint32_t *>(output.data()), width, height, deswizzle);
+                swizzle<std::uint32_t>(data, output, width, height, deswizzle);
                 break;
             case 64:
-                swizzle(reinterpret_cast<const std::uint64_t *>(data), reinterpret_cast<std::uint64_t *>(output.data()), width, height, deswizzle);
+                swizzle<std::uint64_t>(data, output, width, height, deswizzle);
                 break;
         }
+    }
+
+    std::vector<std::byte> swizzle(const std::byte *data, std::size_t bits_per_pixel, std::size_t width, std::size_t height, bool deswizzle) {
+        std::vector<std::byte> output(width*height*(bits_per_pixel/8));
+        swizzle(data, output.data(), bits_per_pixel, width, height, deswizzle);
         return output;
     }
 }
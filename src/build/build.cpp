@@ -60,6 +60,8 @@ int main(int argc, const char **argv) {
         std::optional<bool> compress;
         bool optimize_space = false;
         bool hide_pedantic_warnings = false;
+        std::size_t jobs = 1;
+        std::optional<std::string> tag_cache;
     } build_options;
 
     std::vector<CommandLineOption> options;
@@ -80,6 +82,8 @@ int main(int argc, const char **argv) {
     options.emplace_back("uncompressed", 'u', 0, "Do not compress the cache file. This is default for demo, retail, and custom engines.");
     options.emplace_back("optimize", 'O', 0, "Optimize tag space. This will drastically increase the amount of time required to build the cache file.");
     options.emplace_back("hide-pedantic-warnings", 'H', 0, "Don't show minor warnings.");
+    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for reading and parsing tags, calculating the CRC32, and compressing. The resulting map is the same regardless of this value. Default: 1", "<#>");
+    options.emplace_back("tag-cache", 'k', 1, "Store compiled bitmap and sound tags in a directory and reuse them in later builds if the tags and settings are unchanged.", "<dir>");
 
     static constexpr char DESCRIPTION[] = "Build a cache file for a version of Halo: Combat Evolved.";
     static constexpr char USAGE[] = "[options] -g <target> <scenario>";
@@ -153,6 +157,22 @@ int main(int argc, const char **argv) {
             case 'H':
                 build_options.hide_pedantic_warnings = true;
                 break;
+            case 'j':
+                try {
+                    int jobs = std::stoi(arguments[0]);
+                    if(jobs < 1) {
+                        throw std::exception();
+                    }
+                    build_options.jobs = static_cast<std::size_t>(jobs);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s", arguments[0]);
+                    std::exit(RETURN_FAILED_INVALID_ARGUMENT);
+                }
+                break;
+            case 'k':
+                build_options.tag_cache = std::string(arguments[0]);
+                break;
         }
     });
     
@@ -255,7 +275,9 @@ int main(int argc, const char **argv) {
             build_options.rename_scenario == nullptr ? std::nullopt : std::optional<std::string>(std::string(build_options.rename_scenario)),
             build_options.optimize_space,
             *build_options.compress,
-            build_options.hide_pedantic_warnings
+            build_options.hide_pedantic_warnings,
+            build_options.jobs,
+            build_options.tag_cache
         );
 
         // Set the map name
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/build/build_workload.hpp>
+#include <invader/file/file.hpp>
+#include <invader/tag/hek/header.hpp>
+#include <invader/tag/parser/compile/scenario.hpp>
+#include <invader/printf.hpp>
+
+namespace Invader {
+    using namespace HEK;
+
+    // Scripts reference tags by name in the script string data rather than with tag references
+    static void find_script_dependencies(const Parser::Scenario &scenario, std::vector<Parser::Dependency> &dependencies) {
+        const auto &syntax_data = scenario.script_syntax_data;
+        if(syntax_data.size() < sizeof(ScenarioScriptNodeTable<BigEndian>)) {
+            return;
+        }
+
+        const auto &table_header = *reinterpret_cast<const ScenarioScriptNodeTable<BigEndian> *>(syntax_data.data());
+        std::size_t element_count = table_header.size.read();
+        if(element_count > (syntax_data.size() - sizeof(table_header)) / sizeof(ScenarioScriptNode<BigEndian>)) {
+            eprintf_error("Script syntax data is invalid");
+            throw InvalidTagDataException();
+        }
+        const auto *nodes = reinterpret_cast<const ScenarioScriptNode<BigEndian> *>(&table_header + 1);
+
+        // Ensure we're null terminated
+        const char *string_data = reinterpret_cast<const char *>(scenario.script_string_data.data());
+        std::size_t string_data_length = scenario.script_string_data.size();
+        while(string_data_length > 0 && string_data[string_data_length - 1] != 0) {
+            string_data_length--;
+        }
+
+        Parser::for_each_script_tag_reference(nodes, element_count, [&](std::size_t, const ScenarioScriptNode<BigEndian> &node, TagClassInt tag_class) {
+            // Invalid string offsets are reported when the scenario is actually compiled
+            std::size_t string_offset = node.string_offset.read();
+            if(string_offset >= string_data_length) {
+                return;
+            }
+
+            auto &dependency = dependencies.emplace_back();
+            dependency.path = string_data + string_offset;
+            dependency.tag_class_int = tag_class;
+        });
+    }
+
+    void BuildWorkload::resolve_tag_dependencies(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, TagClassInt tag_class_int) {
+        TagFileHeader::validate_header(reinterpret_cast<const TagFileHeader *>(tag_data), tag_data_size, tag_class_int);
+        this->tags[tag_index].tag_class_int = tag_class_int;
+
+        std::vector<Parser::Dependency> dependencies;
+        switch(tag_class_int) {
+            // The scenario determines the map type, and it can reference tags in its scripts
+            case TagClassInt::TAG_CLASS_SCENARIO: {
+                auto scenario = Parser::Scenario::parse_hek_tag_file(tag_data, tag_data_size);
+                if(!this->cache_file_type.has_value()) {
+                    this->cache_file_type = scenario.type;
+                }
+                dependencies = Parser::Scenario::scan_hek_tag_file_dependencies(tag_data, tag_data_size);
+                find_script_dependencies(scenario, dependencies);
+                break;
+            }
+
+            // Globals drops some references depending on the map type (see Globals::pre_compile)
+            case TagClassInt::TAG_CLASS_GLOBALS: {
+                auto globals = Parser::Globals::parse_hek_tag_file(tag_data, tag_data_size);
+                if(*this->cache_file_type != CacheFileType::SCENARIO_TYPE_MULTIPLAYER) {
+                    globals.multiplayer_information.clear();
+                    globals.cheat_powerups.clear();
+                    globals.weapon_list.clear();
+                }
+                if(*this->cache_file_type == CacheFileType::SCENARIO_TYPE_USER_INTERFACE) {
+                    for(auto &p : globals.player_information) {
+                        p.unit.path.clear();
+                        p.unit.tag_class_int = TagClassInt::TAG_CLASS_NONE;
+                    }
+                    globals.falling_damage.clear();
+                    globals.materials.clear();
+                }
+                auto globals_data = globals.generate_hek_tag_data(TagClassInt::TAG_CLASS_GLOBALS);
+                dependencies = Parser::Globals::scan_hek_tag_file_dependencies(globals_data.data(), globals_data.size());
+                break;
+            }
+
+            // Everything else just needs its references read
+            default:
+                dependencies = Parser::ParserStruct::scan_hek_tag_file_dependencies(tag_data, tag_data_size);
+                break;
+        }
+
+        for(auto &d : dependencies) {
+            if(d.tag_class_int != TagClassInt::TAG_CLASS_NONE) {
+                this->compile_tag_recursively(d.path.c_str(), d.tag_class_int);
+            }
+        }
+    }
+
+    std::vector<std::pair<File::TagFilePath, std::string>> BuildWorkload::resolve_map_dependencies(const char *scenario, const std::vector<std::string> &tags_directories) {
+        BuildWorkload workload;
+        auto scenario_name_fixed = File::preferred_path_to_halo_path(scenario);
+        workload.scenario = scenario_name_fixed.c_str();
+        workload.tags_directories = &tags_directories;
+        workload.dependencies_only = true;
+        workload.set_scenario_name(scenario_name_fixed.c_str());
+        workload.add_tags();
+
+        std::vector<std::pair<File::TagFilePath, std::string>> dependencies;
+        dependencies.reserve(workload.tags.size());
+        for(auto &t : workload.tags) {
+            if(t.file_path.has_value()) {
+                dependencies.emplace_back(File::TagFilePath(t.path, t.tag_class_int), *t.file_path);
+            }
+        }
+        return dependencies;
+    }
+}
@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include <invader/build/build_workload.hpp>
+#include <invader/file/file.hpp>
+#include <invader/file/serializer.hpp>
+#include <invader/version.hpp>
+#include "../crc/crc32.h"
+
+namespace Invader {
+    using namespace HEK;
+
+    /** Bump this whenever the format of a cached tag changes */
+    static constexpr std::uint32_t TAG_CACHE_FORMAT_VERSION = 1;
+
+    /** Magic at the start of every cached tag */
+    static constexpr char TAG_CACHE_MAGIC[8] = { 'i', 'n', 'v', 't', 'c', 'a', 'c', 'h' };
+
+    /** Dependency index used for dependencies on the cached tag itself */
+    static constexpr std::uint64_t TAG_CACHE_SELF_DEPENDENCY = UINT64_MAX;
+
+    static std::uint64_t fnv1a_64(const void *data, std::size_t size, std::uint64_t hash = 0xCBF29CE484222325) noexcept {
+        auto *bytes = reinterpret_cast<const std::uint8_t *>(data);
+        for(std::size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001B3;
+        }
+        return hash;
+    }
+
+    std::string BuildWorkload::get_tag_cache_key(const std::byte *tag_data, std::size_t tag_data_size, TagClassInt tag_class_int) const {
+        // Anything that can change the compiled tag has to go here. The tag path doesn't, so identical tags share an entry.
+        char key[512];
+        // Pedantic warnings are also part of it, since a tag compiled while hiding them would otherwise never show them.
+        std::snprintf(key, sizeof(key), "%s\n%u\n%u\n%u\n%s\n%zu\n%08X\n%016llX\n",
+                      full_version(),
+                      static_cast<unsigned int>(this->engine_target),
+                      static_cast<unsigned int>(this->cache_file_type.value_or(HEK::CacheFileType::SCENARIO_TYPE_MULTIPLAYER)),
+                      static_cast<unsigned int>(this->hide_pedantic_warnings),
+                      tag_class_to_extension(tag_class_int),
+                      tag_data_size,
+                      crc32(0, tag_data, tag_data_size),
+                      static_cast<unsigned long long>(fnv1a_64(tag_data, tag_data_size)));
+        return key;
+    }
+
+    static std::filesystem::path tag_cache_path(const std::filesystem::path &directory, const std::string &key) {
+        char file_name[32];
+        std::snprintf(file_name, sizeof(file_name), "%016llX.tagcache", static_cast<unsigned long long>(fnv1a_64(key.data(), key.size())));
+        return directory / file_name;
+    }
+
+    bool BuildWorkload::load_cached_tag(const std::string &key, std::size_t tag_index) {
+        auto file = File::open_file(tag_cache_path(*this->tag_cache_directory, key).string().c_str());
+        if(!file.has_value()) {
+            return false;
+        }
+
+        // Read the whole thing before touching the workload so a bad file can just be ignored
+        File::BinaryReader reader(*file);
+        TagClassInt tag_class_int;
+        std::optional<TagClassInt> alias;
+        std::vector<std::pair<std::string, TagClassInt>> dependencies;
+        std::vector<std::vector<std::byte>> raw_data;
+        std::vector<BuildWorkloadStruct> structs;
+
+        try {
+            std::size_t magic_size;
+            auto *magic = reader.read_bytes(magic_size);
+            if(magic_size != sizeof(TAG_CACHE_MAGIC) || std::memcmp(magic, TAG_CACHE_MAGIC, magic_size) != 0 || reader.read_int() != TAG_CACHE_FORMAT_VERSION || reader.read_string() != key) {
+                return false;
+            }
+
+            tag_class_int = static_cast<TagClassInt>(reader.read_int());
+            if(reader.read_int()) {
+                alias = static_cast<TagClassInt>(reader.read_int());
+            }
+
+            std::size_t dependency_count = reader.read_int();
+            for(std::size_t d = 0; d < dependency_count; d++) {
+                auto path = reader.read_string();
+                dependencies.emplace_back(path, static_cast<TagClassInt>(reader.read_int()));
+            }
+
+            std::size_t raw_data_count = reader.read_int();
+            for(std::size_t r = 0; r < raw_data_count; r++) {
+                std::size_t size;
+                auto *bytes = reader.read_bytes(size);
+                raw_data.emplace_back(bytes, bytes + size);
+            }
+
+            std::size_t struct_count = reader.read_int();
+            if(struct_count == 0) {
+                return false;
+            }
+            for(std::size_t s = 0; s < struct_count; s++) {
+                auto &new_struct = structs.emplace_back();
+                std::size_t size;
+                auto *bytes = reader.read_bytes(size);
+                new_struct.data.insert(new_struct.data.end(), bytes, bytes + size);
+                new_struct.bsp = std::nullopt;
+                if(reader.read_int()) {
+                    new_struct.bsp = reader.read_int();
+                }
+                new_struct.unsafe_to_dedupe = reader.read_int();
+
+                std::size_t struct_dependency_count = reader.read_int();
+                for(std::size_t d = 0; d < struct_dependency_count; d++) {
+                    auto &dependency = new_struct.dependencies.emplace_back();
+                    dependency.tag_index = reader.read_int();
+                    dependency.offset = reader.read_int();
+                    dependency.tag_id_only = reader.read_int();
+                    if((dependency.tag_index >= dependency_count && dependency.tag_index != TAG_CACHE_SELF_DEPENDENCY) || dependency.offset + (dependency.tag_id_only ? sizeof(HEK::TagID) : sizeof(HEK::TagDependency<HEK::LittleEndian>)) > size) {
+                        return false;
+                    }
+                }
+
+                std::size_t pointer_count = reader.read_int();
+                for(std::size_t p = 0; p < pointer_count; p++) {
+                    auto &pointer = new_struct.pointers.emplace_back();
+                    pointer.struct_index = reader.read_int();
+                    pointer.offset = reader.read_int();
+                    pointer.limit_to_32_bits = reader.read_int();
+                    if(pointer.struct_index >= struct_count || pointer.offset + sizeof(HEK::Pointer) > size) {
+                        return false;
+                    }
+                }
+            }
+
+            if(!reader.at_end()) {
+                return false;
+            }
+        }
+        catch(std::exception &) {
+            return false;
+        }
+
+        // Reserve the base struct first, like compiling does, so anything that references this tag back finds it
+        std::size_t base_struct = this->structs.size();
+        this->structs.emplace_back();
+        this->tags[tag_index].tag_class_int = tag_class_int;
+        this->tags[tag_index].alias = alias;
+        this->tags[tag_index].base_struct = base_struct;
+
+        // Reference everything it referenced (in the same order) so the tag array comes out the same as if it was compiled
+        std::vector<std::size_t> dependency_indices;
+        dependency_indices.reserve(dependencies.size());
+        for(auto &dependency : dependencies) {
+            dependency_indices.emplace_back(this->compile_tag_recursively(dependency.first.c_str(), dependency.second));
+        }
+
+        auto &tag = this->tags[tag_index];
+        for(auto &r : raw_data) {
+            tag.asset_data.emplace_back(this->raw_data.size());
+            this->raw_data.emplace_back(std::move(r));
+        }
+
+        // The base struct goes in the reserved slot, and the rest are appended after the dependencies
+        std::size_t first_struct = this->structs.size();
+        auto new_struct_index = [&base_struct, &first_struct](std::size_t struct_index) {
+            return struct_index == 0 ? base_struct : first_struct + struct_index - 1;
+        };
+        for(std::size_t i = 0; i < structs.size(); i++) {
+            auto &s = structs[i];
+            for(auto &pointer : s.pointers) {
+                pointer.struct_index = new_struct_index(pointer.struct_index);
+            }
+            for(auto &dependency : s.dependencies) {
+                dependency.tag_index = dependency.tag_index == TAG_CACHE_SELF_DEPENDENCY ? tag_index : dependency_indices[dependency.tag_index];
+                if(!dependency.tag_id_only) {
+                    auto &tag_id = reinterpret_cast<HEK::TagDependency<HEK::LittleEndian> *>(s.data.data() + dependency.offset)->tag_id;
+                    auto new_tag_id = tag_id.read();
+                    new_tag_id.index = static_cast<std::uint16_t>(dependency.tag_index);
+                    tag_id = new_tag_id;
+                }
+            }
+            if(i == 0) {
+                this->structs[base_struct] = std::move(s);
+            }
+            else {
+                this->structs.emplace_back(std::move(s));
+            }
+        }
+
+        return true;
+    }
+
+    void BuildWorkload::save_cached_tag(const std::string &key, std::size_t tag_index, const std::vector<std::pair<std::string, TagClassInt>> &dependencies, std::size_t first_struct, std::size_t first_raw_data) {
+        auto &tag = this->tags[tag_index];
+        if(!tag.base_struct.has_value() || *tag.base_struct < first_struct) {
+            return;
+        }
+
+        // Dependencies' structs may have been added in between this tag's structs, so find this tag's structs by following pointers from the base struct
+        std::vector<std::size_t> tag_structs;
+        std::unordered_map<std::size_t, std::size_t> tag_struct_indices;
+        tag_struct_indices.emplace(*tag.base_struct, 0);
+        tag_structs.emplace_back(*tag.base_struct);
+        for(std::size_t s = 0; s < tag_structs.size(); s++) {
+            for(auto &pointer : this->structs[tag_structs[s]].pointers) {
+                if(pointer.struct_index < first_struct) {
+                    return;
+                }
+                if(tag_struct_indices.emplace(pointer.struct_index, tag_structs.size()).second) {
+                    tag_structs.emplace_back(pointer.struct_index);
+                }
+            }
+        }
+
+        // Figure out what each dependency refers to. If it isn't something this tag referenced by path, it can't be cached.
+        std::unordered_map<std::size_t, std::size_t> dependency_indices;
+        for(std::size_t d = 0; d < dependencies.size(); d++) {
+            auto index = this->find_tag(dependencies[d].first, dependencies[d].second);
+            if(!index.has_value()) {
+                return;
+            }
+            dependency_indices.emplace(*index, d);
+        }
+
+        // Any raw data has to be this tag's
+        for(auto r : tag.asset_data) {
+            if(r < first_raw_data) {
+                return;
+            }
+        }
+
+        File::BinaryWriter writer;
+        writer.write_bytes(TAG_CACHE_MAGIC, sizeof(TAG_CACHE_MAGIC));
+        writer.write_int(TAG_CACHE_FORMAT_VERSION);
+        writer.write_string(key);
+        writer.write_int(static_cast<std::uint64_t>(tag.tag_class_int));
+        writer.write_int(tag.alias.has_value());
+        if(tag.alias.has_value()) {
+            writer.write_int(static_cast<std::uint64_t>(*tag.alias));
+        }
+
+        writer.write_int(dependencies.size());
+        for(auto &dependency : dependencies) {
+            writer.write_string(dependency.first);
+            writer.write_int(static_cast<std::uint64_t>(dependency.second));
+        }
+
+        writer.write_int(tag.asset_data.size());
+        for(auto r : tag.asset_data) {
+            writer.write_bytes(this->raw_data[r].data(), this->raw_data[r].size());
+        }
+
+        writer.write_int(tag_structs.size());
+        for(auto s : tag_structs) {
+            auto &tag_struct = this->structs[s];
+            writer.write_bytes(tag_struct.data.data(), tag_struct.data.size());
+            writer.write_int(tag_struct.bsp.has_value());
+            if(tag_struct.bsp.has_value()) {
+                writer.write_int(*tag_struct.bsp);
+            }
+            writer.write_int(tag_struct.unsafe_to_dedupe);
+
+            writer.write_int(tag_struct.dependencies.size());
+            for(auto &dependency : tag_struct.dependencies) {
+                if(dependency.tag_index == tag_index) {
+                    writer.write_int(TAG_CACHE_SELF_DEPENDENCY);
+                }
+                else if(auto index = dependency_indices.find(dependency.tag_index); index != dependency_indices.end()) {
+                    writer.write_int(index->second);
+                }
+                else {
+                    return;
+                }
+                writer.write_int(dependency.offset);
+                writer.write_int(dependency.tag_id_only);
+            }
+
+            writer.write_int(tag_struct.pointers.size());
+            for(auto &pointer : tag_struct.pointers) {
+                writer.write_int(tag_struct_indices[pointer.struct_index]);
+                writer.write_int(pointer.offset);
+                writer.write_int(pointer.limit_to_32_bits);
+            }
+        }
+
+        // Write to a temporary file first so nothing else ever reads a partially written one
+        std::error_code ec;
+        std::filesystem::create_directories(*this->tag_cache_directory, ec);
+        auto path = tag_cache_path(*this->tag_cache_directory, key);
+        auto temp_path = path;
+        temp_path += ".tmp";
+        if(!File::save_file(temp_path.string().c_str(), writer.data)) {
+            REPORT_ERROR_PRINTF(*this, ERROR_TYPE_WARNING_PEDANTIC, tag_index, "Failed to write to the tag cache at %s", temp_path.string().c_str());
+            return;
+        }
+        std::filesystem::rename(temp_path, path, ec);
+        if(ec) {
+            std::filesystem::remove(temp_path, ec);
+        }
+    }
+}
@@ -2,6 +2,13 @@
 
 #include <ctime>
 #include <cstdio>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
 
 #include <invader/build/build_workload.hpp>
 #include <invader/hek/map.hpp>
@@ -13,6 +20,7 @@
 #include <invader/tag/index/index.hpp>
 #include <invader/tag/parser/compile/bitmap.hpp>
 #include <invader/tag/parser/compile/sound.hpp>
+#include <invader/thread/thread_pool.hpp>
 #include "../crc/crc32.h"
 
 namespace Invader {
@@ -21,22 +29,238 @@ namespace Invader {
     #define TAG_DATA_HEADER_STRUCT (structs[0])
     #define TAG_ARRAY_STRUCT (structs[1])
 
-    bool BuildWorkload::BuildWorkloadStruct::can_dedupe(const BuildWorkload::BuildWorkloadStruct &other) const noexcept {
-        if(this->unsafe_to_dedupe || other.unsafe_to_dedupe || (this->bsp.has_value() && this->bsp != other.bsp)) {
-            return false;
+    BuildWorkload::BuildWorkload() : ErrorHandler() {}
+
+    // Classes to try (in order) when an object tag is referenced
+    static constexpr TagClassInt OBJECT_TAG_CLASSES[] = {
+        TagClassInt::TAG_CLASS_BIPED,
+        TagClassInt::TAG_CLASS_VEHICLE,
+        TagClassInt::TAG_CLASS_WEAPON,
+        TagClassInt::TAG_CLASS_EQUIPMENT,
+        TagClassInt::TAG_CLASS_GARBAGE,
+        TagClassInt::TAG_CLASS_SCENERY,
+        TagClassInt::TAG_CLASS_PLACEHOLDER,
+        TagClassInt::TAG_CLASS_SOUND_SCENERY,
+        TagClassInt::TAG_CLASS_DEVICE_CONTROL,
+        TagClassInt::TAG_CLASS_DEVICE_MACHINE,
+        TagClassInt::TAG_CLASS_DEVICE_LIGHT_FIXTURE
+    };
+
+    /**
+     * Reads and parses tags on worker threads ahead of compile_tag_recursively.
+     *
+     * Compiling still happens on the calling thread in the same order as a single-threaded build, so the order of tags
+     * and structs (and thus the resulting map) does not depend on the number of threads used.
+     */
+    struct BuildWorkload::TagPrefetcher {
+        using TagKey = std::pair<TagClassInt, std::string>;
+
+        /** A tag that was read and parsed */
+        struct PrefetchedTag {
+            std::vector<std::byte> data;
+            std::unique_ptr<Parser::ParserStruct> parsed;
+        };
+
+        TagPrefetcher(const std::vector<std::string> &tags_directories, const std::vector<TagKey> &tags, std::size_t jobs) : tags_directories(tags_directories), thread_pool(jobs) {
+            // Queue in reverse since the queue is popped from the back
+            for(auto t = tags.rbegin(); t != tags.rend(); t++) {
+                this->enqueue(t->second, t->first);
+            }
+
+            // Each thread works through the queue until everything has been loaded
+            for(std::size_t j = 0; j < this->thread_pool.get_thread_count(); j++) {
+                this->thread_pool.submit([this]() { this->work(); });
+            }
         }
 
-        std::size_t this_size = this->data.size();
-        std::size_t other_size = other.data.size();
+        ~TagPrefetcher() {
+            // The thread pool is the last member, so it finishes the workers before anything they use is destroyed
+            this->mutex.lock();
+            this->stopping = true;
+            this->queue.clear();
+            this->mutex.unlock();
+            this->condition.notify_all();
+        }
+
+        /**
+         * Take a tag, waiting for it if it's still being loaded
+         * @param tag_path      path of the tag
+         * @param tag_class_int class of the tag
+         * @return              the tag if it was loaded successfully, or nullopt if it should be loaded normally
+         */
+        std::optional<PrefetchedTag> take(const std::string &tag_path, TagClassInt tag_class_int) {
+            // Object references are always resolved to a class before the tag is opened
+            if(tag_class_int == TagClassInt::TAG_CLASS_OBJECT) {
+                return std::nullopt;
+            }
+
+            TagKey key(tag_class_int, File::remove_duplicate_slashes(tag_path));
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            // If it isn't being loaded, it'll be loaded normally, so don't hold onto it if it gets loaded later
+            if(this->queued.find(key) == this->queued.end()) {
+                this->taken.insert(std::move(key));
+                return std::nullopt;
+            }
+
+            // If nobody has started on it yet, move it to the front of the line
+            auto in_queue = std::find(this->queue.begin(), this->queue.end(), key);
+            if(in_queue != this->queue.end()) {
+                this->queue.erase(in_queue);
+                this->queue.emplace_back(key);
+            }
 
-        if(this->dependencies == other.dependencies && this->pointers == other.pointers && this_size >= other_size) {
-            return std::memcmp(this->data.data(), other.data.data(), other_size) == 0;
+            this->condition.wait(lock, [this, &key]() { return this->finished.find(key) != this->finished.end(); });
+            auto finished_tag = this->finished.find(key);
+            auto tag = std::move(finished_tag->second);
+            this->finished.erase(finished_tag);
+            return tag;
         }
 
-        return false;
-    }
+    private:
+        const std::vector<std::string> &tags_directories;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<TagKey> queue;
+        std::set<TagKey> queued;
+        std::map<TagKey, std::optional<PrefetchedTag>> finished;
+        std::set<TagKey> taken; // tags that were asked for before they were queued
+        std::size_t working = 0;
+        bool stopping = false;
+        ThreadPool thread_pool;
+
+        // Mutex must be locked when calling this
+        void enqueue(const std::string &tag_path, TagClassInt tag_class_int) {
+            TagKey key(tag_class_int, File::remove_duplicate_slashes(tag_path));
+            if(this->taken.find(key) == this->taken.end() && this->queued.insert(key).second) {
+                this->queue.emplace_back(std::move(key));
+            }
+        }
 
-    BuildWorkload::BuildWorkload() : ErrorHandler() {}
+        void work() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while(true) {
+                this->condition.wait(lock, [this]() { return this->stopping || !this->queue.empty() || this->working == 0; });
+                if(this->stopping || this->queue.empty()) {
+                    break;
+                }
+
+                // Depth-first, since that's roughly the order they'll be compiled in
+                auto key = std::move(this->queue.back());
+                this->queue.pop_back();
+                this->working++;
+                lock.unlock();
+
+                auto tag_class_int = key.first;
+                std::vector<TagKey> dependencies;
+                auto tag = this->load(key.second, tag_class_int, dependencies);
+
+                lock.lock();
+                this->working--;
+
+                // Only keep it if it can still be taken (objects are taken by the class they resolved to, which may
+                // also have been queued separately)
+                TagKey loaded_key(tag_class_int, key.second);
+                bool already_queued = !this->queued.insert(loaded_key).second && tag_class_int != key.first;
+                if(tag_class_int != TagClassInt::TAG_CLASS_OBJECT && this->taken.find(loaded_key) == this->taken.end() && !already_queued) {
+                    this->finished.emplace(std::move(loaded_key), std::move(tag));
+                }
+                for(auto d = dependencies.rbegin(); d != dependencies.rend(); d++) {
+                    this->enqueue(d->second, d->first);
+                }
+                this->condition.notify_all();
+            }
+            this->condition.notify_all();
+        }
+
+        std::optional<PrefetchedTag> load(const std::string &tag_path, TagClassInt &tag_class_int, std::vector<TagKey> &dependencies) const {
+            auto find_tag = [&tag_path, this](TagClassInt tag_class_int) {
+                return File::tag_path_to_file_path(File::halo_path_to_preferred_path(tag_path + "." + tag_class_to_extension(tag_class_int)), this->tags_directories, true);
+            };
+
+            // Find it
+            std::optional<std::string> file_path;
+            if(tag_class_int == TagClassInt::TAG_CLASS_OBJECT) {
+                for(auto object_class : OBJECT_TAG_CLASSES) {
+                    if((file_path = find_tag(object_class)).has_value()) {
+                        tag_class_int = object_class;
+                        break;
+                    }
+                }
+            }
+            else {
+                file_path = find_tag(tag_class_int);
+            }
+            if(!file_path.has_value()) {
+                return std::nullopt;
+            }
+
+            // Open and parse it. If anything goes wrong, leave it to compile_tag_recursively to report it.
+            PrefetchedTag tag;
+            try {
+                auto data = File::open_file(file_path->c_str());
+                if(!data.has_value()) {
+                    return std::nullopt;
+                }
+                tag.data = std::move(*data);
+                tag.parsed = Parser::ParserStruct::parse_hek_tag_file(tag.data.data(), tag.data.size(), true);
+            }
+            catch(std::exception &) {
+                return std::nullopt;
+            }
+
+            // Find everything it references
+            auto find_dependencies = [&dependencies](Parser::ParserStruct &s, auto &find_dependencies) -> void {
+                for(auto &v : s.get_values()) {
+                    switch(v.get_type()) {
+                        case Parser::ParserStructValue::VALUE_TYPE_DEPENDENCY: {
+                            auto &dependency = v.get_dependency();
+                            if(dependency.path.size() > 0 && dependency.tag_class_int != TagClassInt::TAG_CLASS_NULL) {
+                                dependencies.emplace_back(dependency.tag_class_int, dependency.path);
+                            }
+                            break;
+                        }
+                        case Parser::ParserStructValue::VALUE_TYPE_REFLEXIVE: {
+                            std::size_t count = v.get_array_size();
+                            for(std::size_t i = 0; i < count; i++) {
+                                find_dependencies(v.get_object_in_array(i), find_dependencies);
+                            }
+                            break;
+                        }
+                        default:
+                            break;
+                    }
+                }
+            };
+            find_dependencies(*tag.parsed, find_dependencies);
+
+            // The scenario type determines which UI tag collection gets loaded
+            if(auto *scenario = dynamic_cast<Parser::Scenario *>(tag.parsed.get())) {
+                switch(scenario->type) {
+                    case ScenarioType::SCENARIO_TYPE_SINGLEPLAYER:
+                        dependencies.emplace_back(TagClassInt::TAG_CLASS_TAG_COLLECTION, "ui\\ui_tags_loaded_solo_scenario_type");
+                        break;
+                    case ScenarioType::SCENARIO_TYPE_MULTIPLAYER:
+                        dependencies.emplace_back(TagClassInt::TAG_CLASS_TAG_COLLECTION, "ui\\ui_tags_loaded_multiplayer_scenario_type");
+                        break;
+                    case ScenarioType::SCENARIO_TYPE_USER_INTERFACE:
+                        dependencies.emplace_back(TagClassInt::TAG_CLASS_TAG_COLLECTION, "ui\\ui_tags_loaded_mainmenu_scenario_type");
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            return tag;
+        }
+    };
+
+    template <typename T> static T parse_tag(std::unique_ptr<Parser::ParserStruct> &parsed_tag, const std::byte *tag_data, std::size_t tag_data_size) {
+        if(auto *parsed_tag_of_type = dynamic_cast<T *>(parsed_tag.get())) {
+            return std::move(*parsed_tag_of_type);
+        }
+        return T::parse_hek_tag_file(tag_data, tag_data_size, true);
+    }
 
     std::vector<std::byte> BuildWorkload::compile_map (
         const char *scenario,
@@ -51,7 +275,9 @@ namespace Invader {
         const std::optional<std::string> &rename_scenario,
         bool optimize_space,
         bool compress,
-        bool hide_pedantic_warnings
+        bool hide_pedantic_warnings,
+        std::size_t jobs,
+        const std::optional<std::string> &tag_cache_directory
     ) {
         BuildWorkload workload;
 
@@ -70,6 +296,10 @@ namespace Invader {
         workload.optimize_space = optimize_space;
         workload.verbose = verbose;
         workload.compress = compress;
+        workload.jobs = jobs;
+        if(tag_cache_directory.has_value()) {
+            workload.tag_cache_directory = *tag_cache_directory;
+        }
 
         // Set defaults
         if(raw_data_handling == RawDataHandling::RAW_DATA_HANDLING_DEFAULT) {
@@ -583,7 +813,7 @@ namespace Invader {
                     tag_file_checksums = checksum_delta;
                 }
                 else {
-                    new_crc = calculate_map_crc(final_data.data(), final_data.size());
+                    new_crc = calculate_map_crc(final_data.data(), final_data.size(), nullptr, nullptr, nullptr, false, workload.jobs);
                 }
                 
                 header.crc32 = new_crc;
@@ -606,7 +836,7 @@ namespace Invader {
                     oprintf("Compressing...");
                     oflush();
                 }
-                final_data = Compression::compress_map_data(final_data.data(), final_data.size());
+                final_data = Compression::compress_map_data(final_data.data(), final_data.size(), 19, workload.jobs);
                 if(workload.verbose) {
                     oprintf(" done\n");
                 }
@@ -751,9 +981,9 @@ namespace Invader {
         }
     }
 
-    void BuildWorkload::compile_tag_data_recursively(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, std::optional<TagClassInt> tag_class_int) {
+    void BuildWorkload::compile_tag_data_recursively(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, std::optional<TagClassInt> tag_class_int, std::unique_ptr<Parser::ParserStruct> parsed_tag) {
         #define COMPILE_TAG_CLASS(class_struct, class_int) case TagClassInt::class_int: { \
-            do_compile_tag(std::move(Parser::class_struct::parse_hek_tag_file(tag_data, tag_data_size, true))); \
+            do_compile_tag(parse_tag<Parser::class_struct>(parsed_tag, tag_data, tag_data_size)); \
             break; \
         }
 
@@ -781,6 +1011,33 @@ namespace Invader {
         // TODO: Although it accomplishes the same task, this is NOT the algorithm tool.exe uses.
         this->tag_file_checksums = crc32(this->tag_file_checksums, &expected_crc, sizeof(expected_crc)); 
 
+        // Bitmaps and sounds don't depend on any other tag's data, so if one was compiled in an earlier build with the same settings, use that instead
+        std::optional<std::string> tag_cache_key;
+        std::vector<std::pair<std::string, TagClassInt>> tag_cache_dependencies;
+        auto *previous_tag_cache_dependencies = this->tag_cache_dependencies;
+        std::size_t first_struct = this->structs.size();
+        std::size_t first_raw_data = this->raw_data.size();
+        this->tag_cache_dependencies = nullptr;
+        if(this->tag_cache_directory.has_value()) {
+            switch(*tag_class_int) {
+                case TagClassInt::TAG_CLASS_BITMAP:
+                case TagClassInt::TAG_CLASS_SOUND:
+                case TagClassInt::TAG_CLASS_INVADER_BITMAP:
+                case TagClassInt::TAG_CLASS_INVADER_SOUND:
+                    tag_cache_key = this->get_tag_cache_key(tag_data, tag_data_size, *tag_class_int);
+                    if(this->load_cached_tag(*tag_cache_key, tag_index)) {
+                        this->tag_cache_dependencies = previous_tag_cache_dependencies;
+                        return;
+                    }
+                    this->tag_cache_dependencies = &tag_cache_dependencies;
+                    break;
+                default:
+                    break;
+            }
+        }
+        std::size_t warnings = this->get_warnings();
+        std::size_t errors = this->get_errors();
+
         auto &structs = this->structs;
         auto &tags = this->tags;
         auto &workload = *this;
@@ -877,7 +1134,7 @@ namespace Invader {
 
             // For invader sounds and bitmaps, downgrade if necessary
             case TagClassInt::TAG_CLASS_INVADER_BITMAP: {
-                auto tag_data_parsed = Parser::InvaderBitmap::parse_hek_tag_file(tag_data, tag_data_size, true);
+                auto tag_data_parsed = parse_tag<Parser::InvaderBitmap>(parsed_tag, tag_data, tag_data_size);
                 if(this->engine_target == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
                     do_compile_tag(std::move(tag_data_parsed));
                 }
@@ -889,7 +1146,7 @@ namespace Invader {
                 break;
             }
             case TagClassInt::TAG_CLASS_INVADER_SOUND: {
-                auto tag_data_parsed = Parser::InvaderSound::parse_hek_tag_file(tag_data, tag_data_size, true);
+                auto tag_data_parsed = parse_tag<Parser::InvaderSound>(parsed_tag, tag_data, tag_data_size);
                 if(this->engine_target == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
                     do_compile_tag(std::move(tag_data_parsed));
                 }
@@ -904,7 +1161,7 @@ namespace Invader {
             // And, of course, BSP tags
             case TagClassInt::TAG_CLASS_SCENARIO_STRUCTURE_BSP: {
                 // First thing's first - parse the tag data
-                auto tag_data_parsed = Parser::ScenarioStructureBSP::parse_hek_tag_file(tag_data, tag_data_size, true);
+                auto tag_data_parsed = parse_tag<Parser::ScenarioStructureBSP>(parsed_tag, tag_data, tag_data_size);
                 std::size_t bsp = this->bsp_count++;
 
                 // Next, if we're making a native map, we need to only do this
@@ -951,6 +1208,55 @@ namespace Invader {
             default:
                 throw UnknownTagClassException();
         }
+
+        this->tag_cache_dependencies = previous_tag_cache_dependencies;
+        if(tag_cache_key.has_value() && this->get_warnings() == warnings && this->get_errors() == errors) {
+            this->save_cached_tag(*tag_cache_key, tag_index, tag_cache_dependencies, first_struct, first_raw_data);
+        }
+    }
+
+    void BuildWorkload::index_tag(std::size_t tag_index) {
+        this->tag_indices_by_path[this->tags[tag_index].path].emplace_back(tag_index);
+    }
+
+    void BuildWorkload::rename_tag(std::size_t tag_index, std::string new_path) {
+        auto &tag = this->tags[tag_index];
+
+        // If it was indexed, move it to its new path (otherwise it'll be indexed under its new path on the next lookup)
+        if(tag_index < this->indexed_tag_count) {
+            auto &indices = this->tag_indices_by_path[tag.path];
+            indices.erase(std::find(indices.begin(), indices.end(), tag_index));
+            if(indices.empty()) {
+                this->tag_indices_by_path.erase(tag.path);
+            }
+            tag.path = std::move(new_path);
+            this->index_tag(tag_index);
+        }
+        else {
+            tag.path = std::move(new_path);
+        }
+    }
+
+    std::optional<std::size_t> BuildWorkload::find_tag(const std::string &tag_path, TagClassInt tag_class_int) {
+        // Index any tags added since the last lookup
+        std::size_t tag_count = this->tags.size();
+        for(; this->indexed_tag_count < tag_count; this->indexed_tag_count++) {
+            this->index_tag(this->indexed_tag_count);
+        }
+
+        auto indices = this->tag_indices_by_path.find(tag_path);
+        if(indices == this->tag_indices_by_path.end()) {
+            return std::nullopt;
+        }
+
+        std::optional<std::size_t> return_value;
+        for(auto i : indices->second) {
+            auto &tag = this->tags[i];
+            if((tag.tag_class_int == tag_class_int || tag.alias == tag_class_int) && (!return_value.has_value() || i < *return_value)) {
+                return_value = i;
+            }
+        }
+        return return_value;
     }
 
     std::size_t BuildWorkload::compile_tag_recursively(const char *tag_path, TagClassInt tag_class_int) {
@@ -958,20 +1264,22 @@ namespace Invader {
         auto fixed_path = Invader::File::remove_duplicate_slashes(tag_path);
         tag_path = fixed_path.c_str();
 
+        // If the tag referencing this is going to be cached, it'll need to reference it again when it's loaded
+        if(this->tag_cache_dependencies) {
+            this->tag_cache_dependencies->emplace_back(fixed_path, tag_class_int);
+        }
+
         // Search for the tag
         std::size_t return_value = this->tags.size();
         bool found = false;
-        for(std::size_t i = 0; i < return_value; i++) {
-            auto &tag = this->tags[i];
-            if((tag.tag_class_int == tag_class_int || tag.alias == tag_class_int) && tag.path == tag_path) {
-                if(tag.base_struct.has_value()) {
-                    return i;
-                }
-                return_value = i;
-                found = true;
-                tag.stubbed = false;
-                break;
-            }
+        if(auto index = this->find_tag(fixed_path, tag_class_int); index.has_value()) {
+            auto &tag = this->tags[*index];
+            if(tag.base_struct.has_value() || tag.file_path.has_value()) {
+                return *index;
+            }
+            return_value = *index;
+            found = true;
+            tag.stubbed = false;
         }
 
         // Find it
@@ -983,41 +1291,29 @@ namespace Invader {
             new_path = Invader::File::tag_path_to_file_path(formatted_path, *this->tags_directories, true);
         }
         else {
-            #define TRY_THIS(new_int) if(!new_path.has_value()) { \
-                std::snprintf(formatted_path, sizeof(formatted_path), "%s.%s", tag_path, tag_class_to_extension(new_int)); \
-                Invader::File::halo_path_to_preferred_path_chars(formatted_path); \
-                new_path = Invader::File::tag_path_to_file_path(formatted_path, *this->tags_directories, true); \
-                tag_class_int = new_int; \
-            }
-            TRY_THIS(TagClassInt::TAG_CLASS_BIPED);
-            TRY_THIS(TagClassInt::TAG_CLASS_VEHICLE);
-            TRY_THIS(TagClassInt::TAG_CLASS_WEAPON);
-            TRY_THIS(TagClassInt::TAG_CLASS_EQUIPMENT);
-            TRY_THIS(TagClassInt::TAG_CLASS_GARBAGE);
-            TRY_THIS(TagClassInt::TAG_CLASS_SCENERY);
-            TRY_THIS(TagClassInt::TAG_CLASS_PLACEHOLDER);
-            TRY_THIS(TagClassInt::TAG_CLASS_SOUND_SCENERY);
-            TRY_THIS(TagClassInt::TAG_CLASS_DEVICE_CONTROL);
-            TRY_THIS(TagClassInt::TAG_CLASS_DEVICE_MACHINE);
-            TRY_THIS(TagClassInt::TAG_CLASS_DEVICE_LIGHT_FIXTURE);
-            #undef TRY_THIS
+            for(auto object_class : OBJECT_TAG_CLASSES) {
+                std::snprintf(formatted_path, sizeof(formatted_path), "%s.%s", tag_path, tag_class_to_extension(object_class));
+                Invader::File::halo_path_to_preferred_path_chars(formatted_path);
+                new_path = Invader::File::tag_path_to_file_path(formatted_path, *this->tags_directories, true);
+                if(new_path.has_value()) {
+                    tag_class_int = object_class;
+                    break;
+                }
+            }
             if(!new_path.has_value()) {
                 tag_class_int = TagClassInt::TAG_CLASS_OBJECT;
                 std::snprintf(formatted_path, sizeof(formatted_path), "%s.%s", tag_path, tag_class_to_extension(tag_class_int));
             }
             else {
                 // Look for it again
-                for(std::size_t i = 0; i < return_value; i++) {
-                    auto &tag = this->tags[i];
-                    if(tag.tag_class_int == tag_class_int && tag.path == tag_path) {
-                        if(tag.base_struct.has_value()) {
-                            return i;
-                        }
-                        return_value = i;
-                        found = true;
-                        tag.stubbed = false;
-                        break;
+                if(auto index = this->find_tag(fixed_path, tag_class_int); index.has_value()) {
+                    auto &tag = this->tags[*index];
+                    if(tag.base_struct.has_value() || tag.file_path.has_value()) {
+                        return *index;
                     }
+                    return_value = *index;
+                    found = true;
+                    tag.stubbed = false;
                 }
             }
         }
@@ -1040,16 +1336,43 @@ namespace Invader {
             throw InvalidTagPathException();
         }
 
-        // Open it
-        auto tag_file = Invader::File::open_file(new_path->data());
-        if(!tag_file.has_value()) {
-            eprintf_error("Failed to open %s\n", formatted_path);
-            throw FailedToOpenFileException();
+        // If we only need to know what it references, we don't need to compile it
+        if(this->dependencies_only) {
+            auto tag_file = Invader::File::open_file(new_path->data());
+            if(!tag_file.has_value()) {
+                eprintf_error("Failed to open %s\n", formatted_path);
+                throw FailedToOpenFileException();
+            }
+            this->tags[return_value].file_path = *new_path;
+
+            try {
+                this->resolve_tag_dependencies(tag_file->data(), tag_file->size(), return_value, tag_class_int);
+            }
+            catch(std::exception &e) {
+                eprintf("Failed to read dependencies of %s\n", formatted_path);
+                throw;
+            }
+
+            return return_value;
+        }
+
+        // Open it (or take it if it was already loaded)
+        std::optional<TagPrefetcher::PrefetchedTag> prefetched_tag;
+        if(this->prefetcher) {
+            prefetched_tag = this->prefetcher->take(tag_path, tag_class_int);
+        }
+        if(!prefetched_tag.has_value()) {
+            auto tag_file = Invader::File::open_file(new_path->data());
+            if(!tag_file.has_value()) {
+                eprintf_error("Failed to open %s\n", formatted_path);
+                throw FailedToOpenFileException();
+            }
+            prefetched_tag = TagPrefetcher::PrefetchedTag { std::move(*tag_file), nullptr };
         }
-        auto &tag_file_data = *tag_file;
+        auto &tag_file_data = prefetched_tag->data;
 
         try {
-            this->compile_tag_data_recursively(tag_file_data.data(), tag_file_data.size(), return_value, tag_class_int);
+            this->compile_tag_data_recursively(tag_file_data.data(), tag_file_data.size(), return_value, tag_class_int, std::move(prefetched_tag->parsed));
         }
         catch(std::exception &e) {
             eprintf("Failed to compile tag %s\n", formatted_path);
@@ -1091,6 +1414,22 @@ namespace Invader {
                                    std::strcmp(this->scenario_name.string, "ui") == 0 ||
                                    std::strcmp(this->scenario_name.string, "wizard") == 0;
 
+        // Start reading tags in the background if we can
+        if(this->jobs > 1) {
+            this->prefetcher = std::make_shared<TagPrefetcher>(*this->tags_directories, std::vector<TagPrefetcher::TagKey> {
+                { TagClassInt::TAG_CLASS_SCENARIO, File::remove_duplicate_slashes(this->scenario) },
+                { TagClassInt::TAG_CLASS_GLOBALS, "globals\\globals" },
+                { TagClassInt::TAG_CLASS_TAG_COLLECTION, "ui\\ui_tags_loaded_all_scenario_types" },
+                { TagClassInt::TAG_CLASS_SOUND, "sound\\sfx\\ui\\cursor" },
+                { TagClassInt::TAG_CLASS_SOUND, "sound\\sfx\\ui\\back" },
+                { TagClassInt::TAG_CLASS_SOUND, "sound\\sfx\\ui\\flag_failure" },
+                { TagClassInt::TAG_CLASS_UNICODE_STRING_LIST, "ui\\shell\\main_menu\\mp_map_list" },
+                { TagClassInt::TAG_CLASS_UNICODE_STRING_LIST, "ui\\shell\\strings\\loading" },
+                { TagClassInt::TAG_CLASS_BITMAP, "ui\\shell\\bitmaps\\trouble_brewing" },
+                { TagClassInt::TAG_CLASS_BITMAP, "ui\\shell\\bitmaps\\background" }
+            }, this->jobs);
+        }
+
         this->scenario_index = this->compile_tag_recursively(this->scenario, TagClassInt::TAG_CLASS_SCENARIO);
         std::string full_scenario_path = this->tags[this->scenario_index].path;
         const char *first_char = full_scenario_path.c_str();
@@ -1100,7 +1439,7 @@ namespace Invader {
                 last_slash = i + 1;
             }
         }
-        this->tags[this->scenario_index].path = std::string(first_char, last_slash - first_char) + this->scenario_name.string;
+        this->rename_tag(this->scenario_index, std::string(first_char, last_slash - first_char) + this->scenario_name.string);
 
         this->compile_tag_recursively("globals\\globals", TagClassInt::TAG_CLASS_GLOBALS);
         this->compile_tag_recursively("ui\\ui_tags_loaded_all_scenario_types", TagClassInt::TAG_CLASS_TAG_COLLECTION);
@@ -1129,6 +1468,9 @@ namespace Invader {
         this->compile_tag_recursively("ui\\shell\\bitmaps\\trouble_brewing", TagClassInt::TAG_CLASS_BITMAP);
         this->compile_tag_recursively("ui\\shell\\bitmaps\\background", TagClassInt::TAG_CLASS_BITMAP);
 
+        // Everything we need is loaded
+        this->prefetcher.reset();
+
         // Mark stubs
         std::size_t warned = 0;
         for(auto &tag : this->tags) {
@@ -1139,7 +1481,7 @@ namespace Invader {
                     warned++;
                 }
 
-                tag.path = "MISSINGNO.";
+                this->rename_tag(&tag - this->tags.data(), "MISSINGNO.");
                 tag.tag_class_int = TagClassInt::TAG_CLASS_NONE;
                 this->stubbed_tag_count++;
             }
@@ -1153,54 +1495,163 @@ namespace Invader {
     }
 
     void BuildWorkload::dedupe_structs() {
-        bool found_something = true;
         std::size_t total_savings = 0;
         std::size_t struct_count = this->structs.size();
+        auto &structs = this->structs;
 
         oprintf("Optimizing tag space...");
         oflush();
 
-        while(found_something) {
-            found_something = false;
-            for(std::size_t i = 0; i < struct_count; i++) {
-                if(this->structs[i].unsafe_to_dedupe) {
-                    continue;
+        // Union-find table; every struct is its own representative until it's merged into another struct
+        std::vector<std::size_t> representatives(struct_count);
+        for(std::size_t s = 0; s < struct_count; s++) {
+            representatives[s] = s;
+        }
+        auto find = [&representatives](std::size_t s) -> std::size_t {
+            while(representatives[s] != s) {
+                s = representatives[s] = representatives[representatives[s]];
+            }
+            return s;
+        };
+
+        // Get every struct that points to each struct, since they need to be checked again if that struct gets merged
+        std::vector<std::vector<std::size_t>> parents(struct_count);
+        for(std::size_t s = 0; s < struct_count; s++) {
+            for(auto &pointer : structs[s].pointers) {
+                parents[pointer.struct_index].emplace_back(s);
+            }
+        }
+
+        // Hash everything but the data. A struct can be merged into a struct whose data it is a prefix of, so data is instead compared when sorting each bucket.
+        auto hash_struct = [&structs, &find](std::size_t s) -> std::size_t {
+            auto &st = structs[s];
+            std::size_t hash = st.bsp.has_value() ? *st.bsp + 1 : 0;
+            auto combine = [&hash](std::size_t value) {
+                hash ^= value + 0x9E3779B9 + (hash << 6) + (hash >> 2);
+            };
+            for(auto &dependency : st.dependencies) {
+                combine(dependency.tag_index);
+                combine(dependency.offset);
+                combine(dependency.tag_id_only);
+            }
+            for(auto &pointer : st.pointers) {
+                combine(find(pointer.struct_index));
+                combine(pointer.offset);
+            }
+            return hash;
+        };
+
+        // Order by BSP, dependencies, and pointers (these must all match to merge), then data, then index (higher indices first so the lowest index is kept)
+        auto compare_structs = [&structs, &find](std::size_t a, std::size_t b, bool compare_data) -> int {
+            #define COMPARE_VALUE(a_value, b_value) if((a_value) != (b_value)) { return (a_value) < (b_value) ? -1 : 1; }
+            auto &sa = structs[a];
+            auto &sb = structs[b];
+            COMPARE_VALUE(sa.bsp, sb.bsp)
+            COMPARE_VALUE(sa.dependencies.size(), sb.dependencies.size())
+            COMPARE_VALUE(sa.pointers.size(), sb.pointers.size())
+            for(std::size_t d = 0; d < sa.dependencies.size(); d++) {
+                auto &da = sa.dependencies[d];
+                auto &db = sb.dependencies[d];
+                COMPARE_VALUE(da.tag_index, db.tag_index)
+                COMPARE_VALUE(da.offset, db.offset)
+                COMPARE_VALUE(da.tag_id_only, db.tag_id_only)
+            }
+            for(std::size_t p = 0; p < sa.pointers.size(); p++) {
+                auto &pa = sa.pointers[p];
+                auto &pb = sb.pointers[p];
+                COMPARE_VALUE(find(pa.struct_index), find(pb.struct_index))
+                COMPARE_VALUE(pa.offset, pb.offset)
+            }
+            if(compare_data) {
+                std::size_t a_size = sa.data.size();
+                std::size_t b_size = sb.data.size();
+                int data_difference = std::memcmp(sa.data.data(), sb.data.data(), std::min(a_size, b_size));
+                if(data_difference != 0) {
+                    return data_difference < 0 ? -1 : 1;
                 }
-                for(std::size_t j = i + 1; j < struct_count; j++) {
-                    if(this->structs[j].unsafe_to_dedupe) {
-                        continue;
-                    }
+                COMPARE_VALUE(a_size, b_size)
+                COMPARE_VALUE(b, a)
+            }
+            return 0;
+            #undef COMPARE_VALUE
+        };
 
-                    // Check if the structs are the same
-                    if(this->structs[i].can_dedupe(this->structs[j])) {
-                        // If so, go through every struct pointer. If they equal j, set to i. If they're greater than j, decrement
-                        for(std::size_t k = 0; k < struct_count; k++) {
-                            for(auto &pointer : this->structs[k].pointers) {
-                                auto &struct_index = pointer.struct_index;
-                                if(struct_index == j) {
-                                    struct_index = i;
-                                }
-                            }
-                        }
+        // Go through everything at first. After that, only go through structs whose pointed-to structs got merged.
+        std::unordered_map<std::size_t, std::vector<std::size_t>> buckets;
+        std::vector<std::size_t> struct_hashes(struct_count);
+        std::vector<std::size_t> dirty_structs;
+        for(std::size_t s = 0; s < struct_count; s++) {
+            if(!structs[s].unsafe_to_dedupe) {
+                dirty_structs.emplace_back(s);
+            }
+        }
 
-                        // Also go through every tag, too
-                        for(auto &tag : this->tags) {
-                            if(tag.base_struct.has_value()) {
-                                auto &base_struct = tag.base_struct.value();
-                                if(base_struct == j) {
-                                    base_struct = i;
-                                }
-                            }
-                        }
+        while(!dirty_structs.empty()) {
+            std::sort(dirty_structs.begin(), dirty_structs.end());
+            dirty_structs.erase(std::unique(dirty_structs.begin(), dirty_structs.end()), dirty_structs.end());
+
+            // Rehash everything that changed. Old bucket entries are left in place and skipped later.
+            std::vector<std::size_t> dirty_buckets;
+            for(auto s : dirty_structs) {
+                if(structs[s].unsafe_to_dedupe || find(s) != s) {
+                    continue;
+                }
+                auto hash = hash_struct(s);
+                struct_hashes[s] = hash;
+                buckets[hash].emplace_back(s);
+                dirty_buckets.emplace_back(hash);
+            }
+            dirty_structs.clear();
+
+            std::sort(dirty_buckets.begin(), dirty_buckets.end());
+            dirty_buckets.erase(std::unique(dirty_buckets.begin(), dirty_buckets.end()), dirty_buckets.end());
 
-                        total_savings += this->structs[j].data.size();
-                        this->structs[j].unsafe_to_dedupe = true;
+            for(auto hash : dirty_buckets) {
+                auto &bucket = buckets[hash];
+                bucket.erase(std::remove_if(bucket.begin(), bucket.end(), [&find, &struct_hashes, &hash](std::size_t s) { return find(s) != s || struct_hashes[s] != hash; }), bucket.end());
+                std::sort(bucket.begin(), bucket.end(), [&compare_structs](std::size_t a, std::size_t b) { return compare_structs(a, b, true) < 0; });
+                bucket.erase(std::unique(bucket.begin(), bucket.end()), bucket.end());
 
-                        found_something = true;
+                // Each struct can be merged into the next struct if its data is a prefix of it, and whatever that was merged into
+                std::size_t bucket_size = bucket.size();
+                if(bucket_size < 2) {
+                    continue;
+                }
+                std::size_t merge_into = bucket[bucket_size - 1];
+                for(std::size_t b = bucket_size - 1; b > 0; b--) {
+                    std::size_t s = bucket[b - 1];
+                    std::size_t next = bucket[b];
+                    auto &data = structs[s].data;
+                    auto &next_data = structs[next].data;
+                    if(compare_structs(s, next, false) != 0 || data.size() > next_data.size() || std::memcmp(data.data(), next_data.data(), data.size()) != 0) {
+                        merge_into = s;
+                        continue;
                     }
+
+                    representatives[s] = merge_into;
+                    total_savings += data.size();
+                    dirty_structs.insert(dirty_structs.end(), parents[s].begin(), parents[s].end());
+                    parents[merge_into].insert(parents[merge_into].end(), parents[s].begin(), parents[s].end());
+                    parents[s] = std::vector<std::size_t>();
                 }
             }
         }
+
+        // Lastly, point everything to the structs they were merged into
+        for(std::size_t s = 0; s < struct_count; s++) {
+            for(auto &pointer : structs[s].pointers) {
+                pointer.struct_index = find(pointer.struct_index);
+            }
+            if(find(s) != s) {
+                structs[s].unsafe_to_dedupe = true;
+            }
+        }
+        for(auto &tag : this->tags) {
+            if(tag.base_struct.has_value()) {
+                tag.base_struct = find(*tag.base_struct);
+            }
+        }
+
         oprintf(" done; reduced tag space usage by %.02f MiB\n", BYTES_TO_MiB(total_savings));
     }
 
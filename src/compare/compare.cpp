@@ -234,20 +234,25 @@ int main(int argc, const char **argv) {
             
         if(i.map.has_value()) {
             // Load resource maps
-            std::vector<std::byte> loc, bitmaps, sounds;
-            if(i.maps.has_value() && !i.ignore_resource_maps) {
-                loc = File::open_file((*i.maps / "loc.map").string().c_str()).value_or(std::vector<std::byte>());
-                bitmaps = File::open_file((*i.maps / "bitmaps.map").string().c_str()).value_or(std::vector<std::byte>());
-                sounds = File::open_file((*i.maps / "sounds.map").string().c_str()).value_or(std::vector<std::byte>());
+            std::string loc, bitmaps, sounds;
+            bool use_resource_maps = i.maps.has_value() && !i.ignore_resource_maps;
+            if(use_resource_maps) {
+                loc = (*i.maps / "loc.map").string();
+                bitmaps = (*i.maps / "bitmaps.map").string();
+                sounds = (*i.maps / "sounds.map").string();
             }
-        
-            auto data = File::open_file(*i.map);
-            if(!data.has_value()) {
-                eprintf_error("Failed to read %s", *i.map);
+            
+            try {
+                i.map_data = std::make_unique<Map>(Map::map_with_mmap(*i.map,
+                                                                      use_resource_maps ? bitmaps.c_str() : nullptr,
+                                                                      use_resource_maps ? loc.c_str() : nullptr,
+                                                                      use_resource_maps ? sounds.c_str() : nullptr));
+            }
+            catch(std::exception &e) {
+                eprintf_error("Failed to read %s: %s", *i.map, e.what());
                 return EXIT_FAILURE;
             }
-            
-            auto &map = *(i.map_data = std::make_unique<Map>(Map::map_with_move(*std::move(data),std::move(bitmaps),std::move(loc),std::move(sounds))));
+            auto &map = *i.map_data;
             
             // Warn if we failed to open some resource maps
             if(!i.ignore_resource_maps) {
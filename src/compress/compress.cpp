@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <chrono>
+#include <cstdio>
+#include <filesystem>
 #include <zstd.h>
 #include <invader/command_line_option.hpp>
 #include <invader/printf.hpp>
@@ -19,6 +21,7 @@ int main(int argc, const char **argv) {
         const char *output = nullptr;
         long compression_level = 19;
         bool decompress = false;
+        std::size_t jobs = 1;
     } compress_options;
 
     std::vector<CommandLineOption> options;
@@ -26,6 +29,7 @@ int main(int argc, const char **argv) {
     options.emplace_back("output", 'o', 1, "Emit the resulting map at the given path. By default, this is the map path (overwrite).", "<file>");
     options.emplace_back("level", 'l', 1, "Set the compression level. Must be between 1 and 19. If compressing an Xbox map, this will be clamped from 1 to 9. Default: 19", "<level>");
     options.emplace_back("decompress", 'd', 0, "Decompress instead of compress.");
+    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for compressing or decompressing. The resulting map is the same regardless of this value. Default: 1", "<#>");
 
     static constexpr char DESCRIPTION[] = "Compress cache files.";
     static constexpr char USAGE[] = "[options] <map>";
@@ -45,6 +49,19 @@ int main(int argc, const char **argv) {
             case 'o':
                 compress_options.output = arguments[0];
                 break;
+            case 'j':
+                try {
+                    int jobs = std::stoi(arguments[0]);
+                    if(jobs < 1) {
+                        throw std::exception();
+                    }
+                    compress_options.jobs = static_cast<std::size_t>(jobs);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
             case 'i':
                 show_version_info();
                 std::exit(EXIT_SUCCESS);
@@ -59,21 +76,55 @@ int main(int argc, const char **argv) {
     }
 
     auto start = std::chrono::steady_clock::now();
+
+    #define TIME_ELAPSED_MS std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+
+    // Xbox maps can be compressed straight from one file to another without loading the whole map
+    if(!compress_options.decompress) {
+        HEK::CacheFileHeader header;
+        bool streamable = false;
+        if(std::FILE *f = std::fopen(input, "rb")) {
+            streamable = std::fread(&header, sizeof(header), 1, f) == 1 && header.valid() && header.engine == HEK::CacheFileEngine::CACHE_FILE_XBOX && header.decompressed_file_size == 0;
+            std::fclose(f);
+        }
+
+        if(streamable) {
+            // If we're overwriting the map, write to a temporary file first since we're still reading from it
+            auto output_path = std::filesystem::path(compress_options.output);
+            auto temp_path = output_path;
+            temp_path += ".tmp";
+            std::size_t input_size = std::filesystem::file_size(input);
+            std::size_t output_size;
+            try {
+                output_size = Compression::compress_map_file(input, temp_path.string().c_str(), static_cast<int>(compress_options.compression_level), compress_options.jobs);
+                std::filesystem::rename(temp_path, output_path);
+            }
+            catch(std::exception &e) {
+                std::error_code ec;
+                std::filesystem::remove(temp_path, ec);
+                eprintf_error("Failed to compress %s: %s", compress_options.output, e.what());
+                return EXIT_FAILURE;
+            }
+
+            auto finished = TIME_ELAPSED_MS;
+            oprintf("Compressed %s (%s, %zu -> %zu, %.02f%%, %zu ms)\n", input, COMPRESSION_FORMAT_DEFLATE, input_size, output_size, output_size * 100.0 / input_size, finished);
+            return EXIT_SUCCESS;
+        }
+    }
+
     auto input_file = File::open_file(input);
     if(!input_file.has_value()) {
         eprintf_error("Failed to open %s", input);
         return EXIT_FAILURE;
     }
     auto input_file_data = input_file.value();
-
-    #define TIME_ELAPSED_MS std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
     
     const char *compression_format;
 
     if(compress_options.decompress) {
         std::vector<std::byte> decompressed_data;
         try {
-            decompressed_data = Compression::decompress_map_data(input_file_data.data(), input_file_data.size());
+            decompressed_data = Compression::decompress_map_data(input_file_data.data(), input_file_data.size(), compress_options.jobs);
         }
         catch(Invader::MapNeedsCompressedException &) {
             eprintf_error("Failed to decompress %s: map is already uncompressed", compress_options.output);
@@ -104,7 +155,7 @@ int main(int argc, const char **argv) {
     else {
         std::vector<std::byte> compressed_data;
         try {
-            compressed_data = Compression::compress_map_data(input_file_data.data(), input_file_data.size(), static_cast<int>(compress_options.compression_level));
+            compressed_data = Compression::compress_map_data(input_file_data.data(), input_file_data.size(), static_cast<int>(compress_options.compression_level), compress_options.jobs);
         }
         catch(Invader::MapNeedsDecompressedException &) {
             eprintf_error("Failed to decompress %s: map is already compressed", compress_options.output);
@@ -2,9 +2,13 @@
 
 #include <invader/compress/compression.hpp>
 #include <invader/map/map.hpp>
+#include <invader/file/file.hpp>
+#include <invader/thread/thread_pool.hpp>
 #include <zstd.h>
 #include <cstdio>
 #include <filesystem>
+#include <atomic>
+#include <array>
 
 #ifndef DISABLE_ZLIB
 #include <zlib.h>
@@ -137,7 +141,297 @@ namespace Invader::Compression {
 
     constexpr std::size_t HEADER_SIZE = sizeof(HEK::CacheFileHeader);
 
-    std::size_t compress_map_data(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size, int compression_level) {
+    /** Size of each independently compressed Zstandard frame. Level 19 uses an 8 MiB window, so very little is lost by splitting here. */
+    constexpr std::size_t ZSTD_FRAME_SIZE = 8 * 1024 * 1024;
+
+    /** Magic for the skippable frame holding the seek table (see zstd's contrib/seekable_format) */
+    constexpr std::uint32_t ZSTD_SEEK_TABLE_SKIPPABLE_MAGIC = 0x184D2A5E;
+
+    /** Magic at the end of the seek table */
+    constexpr std::uint32_t ZSTD_SEEK_TABLE_FOOTER_MAGIC = 0x8F92EAB1;
+
+    /** Skippable frame header, then the table entries (compressed size, decompressed size), then the footer (frame count, descriptor, magic) */
+    constexpr std::size_t ZSTD_SEEK_TABLE_HEADER_SIZE = 8;
+    constexpr std::size_t ZSTD_SEEK_TABLE_ENTRY_SIZE = 8;
+    constexpr std::size_t ZSTD_SEEK_TABLE_FOOTER_SIZE = 9;
+
+    static std::size_t zstd_frame_count(std::size_t data_size) noexcept {
+        return data_size == 0 ? 1 : (data_size + ZSTD_FRAME_SIZE - 1) / ZSTD_FRAME_SIZE;
+    }
+
+    static std::size_t zstd_compress_bound(std::size_t data_size) noexcept {
+        std::size_t frame_count = zstd_frame_count(data_size);
+        return ZSTD_compressBound(ZSTD_FRAME_SIZE) * frame_count + ZSTD_SEEK_TABLE_HEADER_SIZE + ZSTD_SEEK_TABLE_ENTRY_SIZE * frame_count + ZSTD_SEEK_TABLE_FOOTER_SIZE;
+    }
+
+    static void write_uint32(std::byte *where, std::uint32_t value) noexcept {
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            where[i] = static_cast<std::byte>(value >> (i * 8));
+        }
+    }
+
+    static std::uint32_t read_uint32(const std::byte *where) noexcept {
+        std::uint32_t value = 0;
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            value |= static_cast<std::uint32_t>(where[i]) << (i * 8);
+        }
+        return value;
+    }
+
+    /**
+     * Run function(i) for every i in [0, count) on up to the given number of threads
+     */
+    template <typename F> static void run_in_parallel(std::size_t count, std::size_t jobs, const F &function) {
+        ThreadPool thread_pool(std::min(jobs, count));
+        std::vector<std::future<void>> results;
+        results.reserve(count);
+        for(std::size_t i = 0; i < count; i++) {
+            results.emplace_back(thread_pool.submit([&function, i]() { function(i); }));
+        }
+        for(auto &r : results) {
+            r.get();
+        }
+    }
+
+    /**
+     * Compress data as independent Zstandard frames followed by a seek table, compressing frames on multiple threads
+     */
+    static std::size_t zstd_compress_frames(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size, int compression_level, std::size_t jobs) {
+        std::size_t frame_count = zstd_frame_count(data_size);
+        if(frame_count > UINT32_MAX) {
+            throw MaximumFileSizeException();
+        }
+
+        // Compress everything
+        std::vector<std::vector<std::byte>> frames(frame_count);
+        std::atomic<bool> failed = false;
+        run_in_parallel(frame_count, jobs, [&frames, &failed, &data, &data_size, &compression_level](std::size_t f) {
+            std::size_t offset = f * ZSTD_FRAME_SIZE;
+            std::size_t size = std::min(ZSTD_FRAME_SIZE, data_size - offset);
+            auto &frame = frames[f];
+            frame.resize(ZSTD_compressBound(size));
+            auto compressed_size = ZSTD_compress(frame.data(), frame.size(), data + offset, size, compression_level);
+            if(ZSTD_isError(compressed_size)) {
+                failed = true;
+                return;
+            }
+            frame.resize(compressed_size);
+        });
+        if(failed) {
+            throw CompressionFailureException();
+        }
+
+        // Put it all together
+        std::size_t seek_table_size = ZSTD_SEEK_TABLE_ENTRY_SIZE * frame_count + ZSTD_SEEK_TABLE_FOOTER_SIZE;
+        std::size_t total_size = ZSTD_SEEK_TABLE_HEADER_SIZE + seek_table_size;
+        for(auto &frame : frames) {
+            total_size += frame.size();
+        }
+        if(total_size > output_size) {
+            throw CompressionFailureException();
+        }
+
+        auto *cursor = output;
+        for(auto &frame : frames) {
+            std::copy(frame.begin(), frame.end(), cursor);
+            cursor += frame.size();
+        }
+
+        write_uint32(cursor, ZSTD_SEEK_TABLE_SKIPPABLE_MAGIC);
+        write_uint32(cursor + 4, static_cast<std::uint32_t>(seek_table_size));
+        cursor += ZSTD_SEEK_TABLE_HEADER_SIZE;
+        for(std::size_t f = 0; f < frame_count; f++) {
+            write_uint32(cursor, static_cast<std::uint32_t>(frames[f].size()));
+            write_uint32(cursor + 4, static_cast<std::uint32_t>(std::min(ZSTD_FRAME_SIZE, data_size - f * ZSTD_FRAME_SIZE)));
+            cursor += ZSTD_SEEK_TABLE_ENTRY_SIZE;
+        }
+        write_uint32(cursor, static_cast<std::uint32_t>(frame_count));
+        cursor[4] = std::byte(); // no checksums
+        write_uint32(cursor + 5, ZSTD_SEEK_TABLE_FOOTER_MAGIC);
+
+        return total_size;
+    }
+
+    /**
+     * Decompress Zstandard data. If it ends with a seek table, the frames are decompressed on multiple threads.
+     */
+    static std::size_t zstd_decompress(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size, std::size_t jobs) {
+        auto decompress_whole = [&]() -> std::size_t {
+            return ZSTD_decompress(output, output_size, data, data_size);
+        };
+
+        // Look for a seek table
+        if(data_size < ZSTD_SEEK_TABLE_HEADER_SIZE + ZSTD_SEEK_TABLE_FOOTER_SIZE || read_uint32(data + data_size - 4) != ZSTD_SEEK_TABLE_FOOTER_MAGIC || data[data_size - 5] != std::byte()) {
+            return decompress_whole();
+        }
+        std::size_t frame_count = read_uint32(data + data_size - ZSTD_SEEK_TABLE_FOOTER_SIZE);
+        std::size_t seek_table_size = ZSTD_SEEK_TABLE_ENTRY_SIZE * frame_count + ZSTD_SEEK_TABLE_FOOTER_SIZE;
+        if(frame_count == 0 || frame_count > data_size / ZSTD_SEEK_TABLE_ENTRY_SIZE || seek_table_size + ZSTD_SEEK_TABLE_HEADER_SIZE > data_size) {
+            return decompress_whole();
+        }
+        std::size_t frames_size = data_size - seek_table_size - ZSTD_SEEK_TABLE_HEADER_SIZE;
+        const auto *seek_table = data + frames_size;
+        if(read_uint32(seek_table) != ZSTD_SEEK_TABLE_SKIPPABLE_MAGIC || read_uint32(seek_table + 4) != seek_table_size) {
+            return decompress_whole();
+        }
+
+        // Find where each frame goes, making sure it all adds up
+        struct Frame {
+            std::size_t input_offset;
+            std::size_t input_size;
+            std::size_t output_offset;
+            std::size_t output_size;
+        };
+        std::vector<Frame> frames(frame_count);
+        std::size_t input_offset = 0;
+        std::size_t output_offset = 0;
+        for(std::size_t f = 0; f < frame_count; f++) {
+            const auto *entry = seek_table + ZSTD_SEEK_TABLE_HEADER_SIZE + f * ZSTD_SEEK_TABLE_ENTRY_SIZE;
+            auto &frame = frames[f];
+            frame.input_offset = input_offset;
+            frame.input_size = read_uint32(entry);
+            frame.output_offset = output_offset;
+            frame.output_size = read_uint32(entry + 4);
+            input_offset += frame.input_size;
+            output_offset += frame.output_size;
+        }
+        if(input_offset != frames_size || output_offset > output_size) {
+            return decompress_whole();
+        }
+
+        std::atomic<bool> failed = false;
+        run_in_parallel(frame_count, jobs, [&frames, &failed, &data, &output](std::size_t f) {
+            auto &frame = frames[f];
+            auto decompressed_size = ZSTD_decompress(output + frame.output_offset, frame.output_size, data + frame.input_offset, frame.input_size);
+            if(ZSTD_isError(decompressed_size) || decompressed_size != frame.output_size) {
+                failed = true;
+            }
+        });
+        if(failed) {
+            throw DecompressionFailureException();
+        }
+
+        return output_offset;
+    }
+
+    #ifndef DISABLE_ZLIB
+    /** Size of each chunk deflated on its own thread. Each chunk is primed with the 32 KiB before it, so only a few bytes are lost per chunk. */
+    constexpr std::size_t DEFLATE_CHUNK_SIZE = 1024 * 1024;
+
+    /** Maximum distance DEFLATE can look back */
+    constexpr std::size_t DEFLATE_DICTIONARY_SIZE = 32 * 1024;
+
+    static int clamp_deflate_level(int compression_level) noexcept {
+        if(compression_level > Z_BEST_COMPRESSION) {
+            return Z_BEST_COMPRESSION;
+        }
+        else if(compression_level < Z_NO_COMPRESSION) {
+            return Z_NO_COMPRESSION;
+        }
+        return compression_level;
+    }
+
+    /**
+     * Get the two byte zlib header deflateInit() would write for the given level
+     */
+    static std::array<std::byte, 2> zlib_header(int compression_level) noexcept {
+        std::uint8_t level_flags = compression_level < 2 ? 0 : compression_level < 6 ? 1 : compression_level == 6 ? 2 : 3;
+        std::uint16_t header = 0x7800 | (level_flags << 6);
+        header += 31 - (header % 31);
+        return { static_cast<std::byte>(header >> 8), static_cast<std::byte>(header & 0xFF) };
+    }
+
+    /**
+     * Deflate chunks of data on multiple threads into raw DEFLATE data that can be concatenated into one stream. Chunks are
+     * ended with a sync flush (or finished, if it's the end of the stream) so they end on a byte boundary.
+     * @param data                 data to compress; dictionary_available bytes before this must also be readable
+     * @param data_size            size of data
+     * @param dictionary_available number of bytes before data that can be used as a dictionary
+     * @param end_of_stream        this is the end of the stream
+     * @param compression_level    compression level
+     * @param jobs                 number of threads to use
+     * @return                     compressed chunks, in order
+     */
+    static std::vector<std::vector<std::byte>> deflate_chunks(const std::byte *data, std::size_t data_size, std::size_t dictionary_available, bool end_of_stream, int compression_level, std::size_t jobs) {
+        std::size_t chunk_count = std::max((data_size + DEFLATE_CHUNK_SIZE - 1) / DEFLATE_CHUNK_SIZE, static_cast<std::size_t>(end_of_stream));
+        std::vector<std::vector<std::byte>> chunks(chunk_count);
+        std::atomic<bool> failed = false;
+
+        run_in_parallel(chunk_count, jobs, [&](std::size_t c) {
+            std::size_t offset = c * DEFLATE_CHUNK_SIZE;
+            std::size_t size = std::min(DEFLATE_CHUNK_SIZE, data_size - offset);
+            std::size_t dictionary_size = std::min(DEFLATE_DICTIONARY_SIZE, dictionary_available + offset);
+            bool last = end_of_stream && c + 1 == chunk_count;
+
+            z_stream deflate_stream = {};
+            deflate_stream.zalloc = Z_NULL;
+            deflate_stream.zfree = Z_NULL;
+            deflate_stream.opaque = Z_NULL;
+            if(deflateInit2(&deflate_stream, compression_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                failed = true;
+                return;
+            }
+            if(dictionary_size && deflateSetDictionary(&deflate_stream, reinterpret_cast<const Bytef *>(data + offset - dictionary_size), static_cast<uInt>(dictionary_size)) != Z_OK) {
+                deflateEnd(&deflate_stream);
+                failed = true;
+                return;
+            }
+
+            // Leave room for the sync flush marker
+            auto &chunk = chunks[c];
+            chunk.resize(deflateBound(&deflate_stream, size) + 16);
+            deflate_stream.next_in = reinterpret_cast<Bytef *>(const_cast<std::byte *>(data + offset));
+            deflate_stream.avail_in = static_cast<uInt>(size);
+            deflate_stream.next_out = reinterpret_cast<Bytef *>(chunk.data());
+            deflate_stream.avail_out = static_cast<uInt>(chunk.size());
+            int result = deflate(&deflate_stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+            if((last ? result != Z_STREAM_END : (result != Z_OK || deflate_stream.avail_out == 0)) || deflate_stream.avail_in != 0) {
+                failed = true;
+            }
+            chunk.resize(deflate_stream.total_out);
+            deflateEnd(&deflate_stream);
+        });
+
+        if(failed) {
+            throw CompressionFailureException();
+        }
+
+        return chunks;
+    }
+
+    /**
+     * Deflate data into a zlib stream, compressing on multiple threads
+     */
+    static std::size_t zlib_compress_chunks(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size, int compression_level, std::size_t jobs) {
+        compression_level = clamp_deflate_level(compression_level);
+        auto chunks = deflate_chunks(data, data_size, 0, true, compression_level, jobs);
+
+        std::size_t total_size = 2 + 4;
+        for(auto &chunk : chunks) {
+            total_size += chunk.size();
+        }
+        if(total_size > output_size) {
+            throw CompressionFailureException();
+        }
+
+        auto header = zlib_header(compression_level);
+        auto *cursor = std::copy(header.begin(), header.end(), output);
+        for(auto &chunk : chunks) {
+            cursor = std::copy(chunk.begin(), chunk.end(), cursor);
+        }
+
+        // Adler-32 is stored big endian
+        auto checksum = adler32(adler32(0, Z_NULL, 0), reinterpret_cast<const Bytef *>(data), data_size);
+        for(std::size_t i = 0; i < 4; i++) {
+            *(cursor++) = static_cast<std::byte>(checksum >> (24 - i * 8));
+        }
+
+        return total_size;
+    }
+
+    #endif
+
+    std::size_t compress_map_data(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size, int compression_level, std::size_t jobs) {
         // Load the data
         auto map = Map::map_with_pointer(const_cast<std::byte *>(data), data_size);
 
@@ -148,35 +442,17 @@ namespace Invader::Compression {
             compress_header<HEK::CacheFileHeader>(map, output, data_size);
 
             // Compress that!
-            z_stream deflate_stream = {};
-            auto offset = sizeof(HEK::CacheFileHeader);
-            deflate_stream.zalloc = Z_NULL;
-            deflate_stream.zfree = Z_NULL;
-            deflate_stream.opaque = Z_NULL;
-            deflate_stream.avail_in = data_size - offset;
-            deflate_stream.next_in = reinterpret_cast<Bytef *>(const_cast<std::byte *>(data + offset));
-            deflate_stream.avail_out = output_size - offset;
-            deflate_stream.next_out = reinterpret_cast<Bytef *>(output + offset);
-            
-            // Clamp
-            if(compression_level > Z_BEST_COMPRESSION) {
-                compression_level = Z_BEST_COMPRESSION;
-            }
-            else if(compression_level < Z_NO_COMPRESSION) {
-                compression_level = Z_NO_COMPRESSION;
-            }
-            
-            if((deflateInit(&deflate_stream, compression_level) != Z_OK) || (deflate(&deflate_stream, Z_FINISH) != Z_STREAM_END) || (deflateEnd(&deflate_stream) != Z_OK)) {
-                throw DecompressionFailureException();
-            }
-            
+            auto compressed_size = zlib_compress_chunks(data + HEADER_SIZE, data_size - HEADER_SIZE, output + HEADER_SIZE, output_size - HEADER_SIZE, compression_level, jobs);
+
             // Align to 4096 bytes
-            std::size_t padding_required = 4096 - ((deflate_stream.total_out + HEADER_SIZE) % 4096);
-            if(padding_required) {
-                reinterpret_cast<HEK::CacheFileHeader *>(output)->compressed_padding = static_cast<std::uint32_t>(padding_required);
+            std::size_t padding_required = 4096 - ((compressed_size + HEADER_SIZE) % 4096);
+            if(compressed_size + HEADER_SIZE + padding_required > output_size) {
+                throw CompressionFailureException();
             }
-            
-            return deflate_stream.total_out + HEADER_SIZE + padding_required;
+            reinterpret_cast<HEK::CacheFileHeader *>(output)->compressed_padding = static_cast<std::uint32_t>(padding_required);
+            std::fill(output + HEADER_SIZE + compressed_size, output + HEADER_SIZE + compressed_size + padding_required, std::byte());
+
+            return compressed_size + HEADER_SIZE + padding_required;
             
             #else
             std::terminate();
@@ -193,17 +469,14 @@ namespace Invader::Compression {
             }
 
             // Immediately compress it
-            auto compressed_size = ZSTD_compress(output + HEADER_SIZE, output_size - HEADER_SIZE, data + HEADER_SIZE, data_size - HEADER_SIZE, compression_level);
-            if(ZSTD_isError(compressed_size)) {
-                throw CompressionFailureException();
-            }
+            auto compressed_size = zstd_compress_frames(data + HEADER_SIZE, data_size - HEADER_SIZE, output + HEADER_SIZE, output_size - HEADER_SIZE, compression_level, jobs);
 
             // Done
             return compressed_size + HEADER_SIZE;
         }
     }
 
-    std::size_t decompress_map_data(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size) {
+    std::size_t decompress_map_data(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size, std::size_t jobs) {
         // Check the header
         const auto *header = reinterpret_cast<const HEK::CacheFileHeader *>(data);
         if(sizeof(*header) > data_size || !header->valid()) {
@@ -245,7 +518,7 @@ namespace Invader::Compression {
         }
 
         // Immediately decompress
-        auto decompressed_size = ZSTD_decompress(output + HEADER_SIZE, output_size - HEADER_SIZE, data + HEADER_SIZE, data_size - HEADER_SIZE);
+        auto decompressed_size = zstd_decompress(data + HEADER_SIZE, data_size - HEADER_SIZE, output + HEADER_SIZE, output_size - HEADER_SIZE, jobs);
         if(ZSTD_isError(decompressed_size) || (decompressed_size + HEADER_SIZE) != header->decompressed_file_size) {
             throw DecompressionFailureException();
         }
@@ -254,7 +527,7 @@ namespace Invader::Compression {
         return decompressed_size + HEADER_SIZE;
     }
 
-    std::vector<std::byte> compress_map_data(const std::byte *data, std::size_t data_size, int compression_level) {
+    std::vector<std::byte> compress_map_data(const std::byte *data, std::size_t data_size, int compression_level, std::size_t jobs) {
         // Allocate the data
         std::vector<std::byte> new_data;
         if(data_size < HEADER_SIZE) {
@@ -262,10 +535,10 @@ namespace Invader::Compression {
         }
         
         // Allocate data
-        new_data.resize(ZSTD_compressBound(data_size - HEADER_SIZE) + HEADER_SIZE);
+        new_data.resize(std::max(ZSTD_compressBound(data_size - HEADER_SIZE), zstd_compress_bound(data_size - HEADER_SIZE)) + HEADER_SIZE);
 
         // Compress
-        auto compressed_size = compress_map_data(data, data_size, new_data.data(), new_data.size(), compression_level);
+        auto compressed_size = compress_map_data(data, data_size, new_data.data(), new_data.size(), compression_level, jobs);
 
         // Resize and return it
         new_data.resize(compressed_size);
@@ -273,7 +546,7 @@ namespace Invader::Compression {
         return new_data;
     }
 
-    std::vector<std::byte> decompress_map_data(const std::byte *data, std::size_t data_size) {
+    std::vector<std::byte> decompress_map_data(const std::byte *data, std::size_t data_size, std::size_t jobs) {
         // Allocate and decompress using data from the header
         const auto *header = reinterpret_cast<const HEK::CacheFileHeader *>(data);
         std::vector<std::byte> new_data = std::vector<std::byte>(header->decompressed_file_size);
@@ -287,7 +560,7 @@ namespace Invader::Compression {
         }
 
         // Decompress
-        auto decompressed_size = decompress_map_data(data, data_size, new_data.data(), new_data.size());
+        auto decompressed_size = decompress_map_data(data, data_size, new_data.data(), new_data.size(), jobs);
 
         // Shrink the buffer to the new size
         new_data.resize(decompressed_size);
@@ -476,4 +749,104 @@ namespace Invader::Compression {
 
         return output_writer.output_position;
     }
+
+    std::size_t compress_map_file([[maybe_unused]] const char *input, [[maybe_unused]] const char *output, [[maybe_unused]] int compression_level, [[maybe_unused]] std::size_t jobs) {
+        #ifndef DISABLE_ZLIB
+        // Map the input file so only what's being compressed at the moment needs to be in memory
+        auto input_file = File::map_file(input);
+        if(!input_file.has_value()) {
+            throw FailedToOpenFileException();
+        }
+        const auto *input_data = input_file->data();
+        std::size_t total_size = input_file->size();
+
+        // Make sure we can stream it before loading it, since loading a compressed map would decompress it
+        const auto *header_input = reinterpret_cast<const HEK::CacheFileHeader *>(input_data);
+        if(total_size < HEADER_SIZE || !header_input->valid()) {
+            throw InvalidMapException();
+        }
+        if(header_input->engine != HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+            throw UnsupportedMapEngineException();
+        }
+        if(header_input->decompressed_file_size != 0) {
+            throw MapNeedsDecompressedException();
+        }
+
+        // Load it so it gets checked the same way as when compressing it in memory
+        auto map = Map::map_with_pointer(input_file->data(), total_size);
+        std::byte header_output[HEADER_SIZE];
+        compress_header<HEK::CacheFileHeader>(map, header_output, total_size);
+
+        std::FILE *output_file = std::fopen(output, "wb");
+        if(!output_file) {
+            throw FailedToOpenFileException();
+        }
+
+        std::size_t compressed_size = 0;
+        try {
+            auto write_data = [&output_file](const std::byte *data, std::size_t size) {
+                if(size && std::fwrite(data, size, 1, output_file) != 1) {
+                    throw CompressionFailureException();
+                }
+            };
+
+            // The padding isn't known until the end, so the header is written again then
+            write_data(header_output, sizeof(header_output));
+
+            compression_level = clamp_deflate_level(compression_level);
+            auto zlib_header_data = zlib_header(compression_level);
+            write_data(zlib_header_data.data(), zlib_header_data.size());
+            compressed_size += zlib_header_data.size();
+
+            // Compress a few chunks per thread at a time, using the end of the previous batch as a dictionary
+            std::size_t batch_size = DEFLATE_CHUNK_SIZE * std::max(jobs, static_cast<std::size_t>(1)) * 2;
+            auto checksum = adler32(0, Z_NULL, 0);
+            std::size_t offset = HEADER_SIZE;
+            do {
+                std::size_t dictionary_size = std::min(DEFLATE_DICTIONARY_SIZE, offset - HEADER_SIZE);
+                std::size_t read_size = std::min(batch_size, total_size - offset);
+                checksum = adler32(checksum, reinterpret_cast<const Bytef *>(input_data + offset), read_size);
+                offset += read_size;
+
+                for(auto &chunk : deflate_chunks(input_data + offset - read_size, read_size, dictionary_size, offset == total_size, compression_level, jobs)) {
+                    write_data(chunk.data(), chunk.size());
+                    compressed_size += chunk.size();
+                }
+            }
+            while(offset < total_size);
+
+            // Adler-32 is stored big endian
+            std::byte checksum_data[4];
+            for(std::size_t i = 0; i < sizeof(checksum_data); i++) {
+                checksum_data[i] = static_cast<std::byte>(checksum >> (24 - i * 8));
+            }
+            write_data(checksum_data, sizeof(checksum_data));
+            compressed_size += sizeof(checksum_data);
+
+            // Align to 4096 bytes
+            std::size_t padding_required = 4096 - ((compressed_size + HEADER_SIZE) % 4096);
+            std::vector<std::byte> padding(padding_required);
+            write_data(padding.data(), padding.size());
+            compressed_size += padding_required;
+
+            reinterpret_cast<HEK::CacheFileHeader *>(header_output)->compressed_padding = static_cast<std::uint32_t>(padding_required);
+            if(std::fseek(output_file, 0, SEEK_SET) != 0) {
+                throw CompressionFailureException();
+            }
+            write_data(header_output, sizeof(header_output));
+        }
+        catch(std::exception &) {
+            std::fclose(output_file);
+            throw;
+        }
+
+        if(std::fclose(output_file) != 0) {
+            throw CompressionFailureException();
+        }
+
+        return compressed_size + HEADER_SIZE;
+        #else
+        throw UnsupportedMapEngineException();
+        #endif
+    }
 }
@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Changes done for Invader
+// - added GPL version 3 only identifier (the original code to this uses the below license, but my modifications are GPL version 3 only, as is Invader itself)
+// - added "crc32.h" include
+// - removed platform specific includes <sys/param.h> and <sys/systm.h>
+// - generate the table at compile time and extend it to slicing-by-16
+// - added a PCLMULQDQ path used when the CPU supports it
+// - added crc32_combine()
+
+#include <cstdint>
+#include <cstddef>
+#include "crc32.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define INVADER_CRC32_PCLMUL_TARGET
+#else
+#include <cpuid.h>
+#define INVADER_CRC32_PCLMUL_TARGET __attribute__((target("sse2,pclmul")))
+#endif
+#define INVADER_CRC32_PCLMUL
+#endif
+
+/*-
+ *  COPYRIGHT (C) 1986 Gary S. Brown.  You may use this program, or
+ *  code or tables extracted from it, as desired without restriction.
+ *
+ *  First, the polynomial itself and its table of feedback terms.  The
+ *  polynomial is
+ *  X^32+X^26+X^23+X^22+X^16+X^12+X^11+X^10+X^8+X^7+X^5+X^4+X^2+X^1+X^0
+ *
+ *  Note that we take it "backwards" and put the highest-order term in
+ *  the lowest-order bit.  The X^32 term is "implied"; the LSB is the
+ *  X^31 term, etc.  The X^0 term (usually shown as "+1") results in
+ *  the MSB being 1
+ *
+ *  Note that the usual hardware shift register implementation, which
+ *  is what we're using (we're merely optimizing it by doing eight-bit
+ *  chunks at a time) shifts bits into the lowest-order term.  In our
+ *  implementation, that means shifting towards the right.  Why do we
+ *  do it this way?  Because the calculated CRC must be transmitted in
+ *  order from highest-order term to lowest-order term.  UARTs transmit
+ *  characters in order from LSB to MSB.  By storing the CRC this way
+ *  we hand it to the UART in the order low-byte to high-byte; the UART
+ *  sends each low-bit to hight-bit; and the result is transmission bit
+ *  by bit from highest- to lowest-order term without requiring any bit
+ *  shuffling on our part.  Reception works similarly
+ *
+ *  The feedback terms table consists of 256, 32-bit entries.  Notes
+ *
+ *      The table can be generated at runtime if desired; code to do so
+ *      is shown later.  It might not be obvious, but the feedback
+ *      terms simply represent the results of eight shift/xor opera
+ *      tions for all combinations of data and CRC register values
+ *
+ *      The values must be right-shifted by eight bits by the "updcrc
+ *      logic; the shift must be unsigned (bring in zeroes).  On some
+ *      hardware you could probably optimize the shift in assembler by
+ *      using byte-swap instructions
+ *      polynomial $edb88320
+ *
+ *
+ * CRC32 code derived from work by Gary S. Brown.
+ */
+
+/** Polynomial, reversed */
+static constexpr std::uint32_t CRC32_POLYNOMIAL = 0xEDB88320;
+
+struct CRC32Tables {
+    /** table[0] is the byte-at-a-time table; table[n] is the CRC of a byte followed by n zero bytes */
+    std::uint32_t table[16][256];
+};
+
+static constexpr CRC32Tables generate_crc32_tables() {
+    CRC32Tables tables = {};
+    for(std::uint32_t b = 0; b < 256; b++) {
+        std::uint32_t c = b;
+        for(int i = 0; i < 8; i++) {
+            c = (c & 1) ? (c >> 1) ^ CRC32_POLYNOMIAL : (c >> 1);
+        }
+        tables.table[0][b] = c;
+    }
+    for(std::size_t t = 1; t < 16; t++) {
+        for(std::size_t b = 0; b < 256; b++) {
+            std::uint32_t c = tables.table[t - 1][b];
+            tables.table[t][b] = (c >> 8) ^ tables.table[0][c & 0xFF];
+        }
+    }
+    return tables;
+}
+
+static constexpr CRC32Tables crc32_tab = generate_crc32_tables();
+
+/**
+ * Update the CRC register 16 bytes at a time, then a byte at a time for the rest
+ * @param crc  CRC register (not inverted)
+ * @param p    data
+ * @param size size of the data
+ * @return     new CRC register
+ */
+static std::uint32_t crc32_slice_by_16(std::uint32_t crc, const std::uint8_t *p, std::size_t size) {
+    const auto &t = crc32_tab.table;
+    while(size >= 16) {
+        std::uint32_t c = crc ^ (static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) | (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24));
+        crc = t[15][c & 0xFF] ^ t[14][(c >> 8) & 0xFF] ^ t[13][(c >> 16) & 0xFF] ^ t[12][c >> 24] ^
+              t[11][p[4]] ^ t[10][p[5]] ^ t[9][p[6]] ^ t[8][p[7]] ^
+              t[7][p[8]] ^ t[6][p[9]] ^ t[5][p[10]] ^ t[4][p[11]] ^
+              t[3][p[12]] ^ t[2][p[13]] ^ t[1][p[14]] ^ t[0][p[15]];
+        p += 16;
+        size -= 16;
+    }
+    while(size--) {
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef INVADER_CRC32_PCLMUL
+static bool cpu_has_pclmul() noexcept {
+    #ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 1)) != 0;
+    #else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL) != 0;
+    #endif
+}
+
+/**
+ * Fold a block into the next block
+ * @param a block to fold
+ * @param b next block
+ * @param k constants for the distance between the blocks
+ * @return  folded block
+ */
+INVADER_CRC32_PCLMUL_TARGET static inline __m128i crc32_pclmul_fold(__m128i a, __m128i b, __m128i k) {
+    __m128i lo = _mm_clmulepi64_si128(a, k, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(a, k, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(hi, lo), b);
+}
+
+/**
+ * Update the CRC register by folding 64 bytes at a time with carry-less multiplication, then reducing to 32 bits. See
+ * Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ * @param crc  CRC register (not inverted)
+ * @param p    data
+ * @param size size of the data; this must be a multiple of 16 and at least 64
+ * @return     new CRC register
+ */
+INVADER_CRC32_PCLMUL_TARGET static std::uint32_t crc32_pclmul(std::uint32_t crc, const std::uint8_t *p, std::size_t size) {
+    // x^(4*128+32) and x^(4*128-32), x^(128+32) and x^(128-32), x^64, and then the polynomial and its Barrett constant
+    const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163CD6124);
+    const __m128i poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x00));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x10));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x20));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    p += 64;
+    size -= 64;
+
+    // Fold 4 blocks at a time
+    while(size >= 64) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 0x30)));
+        p += 64;
+        size -= 64;
+    }
+
+    // Fold those into one block, then fold in whatever blocks are left
+    x1 = crc32_pclmul_fold(x1, x2, k3k4);
+    x1 = crc32_pclmul_fold(x1, x3, k3k4);
+    x1 = crc32_pclmul_fold(x1, x4, k3k4);
+    while(size >= 16) {
+        x1 = crc32_pclmul_fold(x1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), k3k4);
+        p += 16;
+        size -= 16;
+    }
+
+    // Fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduce to 32 bits
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<std::uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+}
+#endif
+
+uint32_t crc32(uint32_t crc, const void *buf, size_t size) {
+    const auto *p = static_cast<const std::uint8_t *>(buf);
+    crc = crc ^ ~0U;
+
+    #ifdef INVADER_CRC32_PCLMUL
+    static const bool use_pclmul = cpu_has_pclmul();
+    if(use_pclmul && size >= 64) {
+        std::size_t pclmul_size = size & ~static_cast<std::size_t>(15);
+        crc = crc32_pclmul(crc, p, pclmul_size);
+        p += pclmul_size;
+        size -= pclmul_size;
+    }
+    #endif
+
+    crc = crc32_slice_by_16(crc, p, size);
+    return crc ^ ~0U;
+}
+
+/**
+ * Multiply two polynomials modulo the CRC32 polynomial (reflected, so x^0 is the highest bit)
+ * @param a first polynomial; this must not be 0
+ * @param b second polynomial
+ * @return  product
+ */
+static constexpr std::uint32_t crc32_multiply_mod(std::uint32_t a, std::uint32_t b) {
+    std::uint32_t m = 1U << 31;
+    std::uint32_t p = 0;
+    while(true) {
+        if(a & m) {
+            p ^= b;
+            if((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32_POLYNOMIAL : (b >> 1);
+    }
+    return p;
+}
+
+struct CRC32PowerTable {
+    /** power[k] is x^(2^k) modulo the CRC32 polynomial */
+    std::uint32_t power[32];
+};
+
+static constexpr CRC32PowerTable generate_crc32_power_table() {
+    CRC32PowerTable table = {};
+    std::uint32_t p = 1U << 30; // x^1
+    table.power[0] = p;
+    for(std::size_t k = 1; k < 32; k++) {
+        table.power[k] = p = crc32_multiply_mod(p, p);
+    }
+    return table;
+}
+
+static constexpr CRC32PowerTable crc32_power_tab = generate_crc32_power_table();
+
+namespace Invader {
+    std::uint32_t crc32_combine(std::uint32_t crc1, std::uint32_t crc2, std::size_t size2) noexcept {
+        // Shift crc1 past size2 zero bytes (multiply by x^(8 * size2)), then add crc2
+        std::uint32_t shift = 1U << 31; // x^0
+        for(std::size_t k = 3; size2 != 0; size2 >>= 1, k++) {
+            if(size2 & 1) {
+                shift = crc32_multiply_mod(crc32_power_tab.power[k & 31], shift);
+            }
+        }
+        return crc32_multiply_mod(shift, crc1) ^ crc2;
+    }
+}
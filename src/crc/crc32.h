@@ -9,10 +9,33 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdlib.h>
+
+/**
+ * Update a CRC32 with more data
+ * @param crc  CRC32 of the data so far (0 if there is none)
+ * @param buf  data
+ * @param size size of the data
+ * @return     CRC32 of the data so far followed by buf
+ */
 uint32_t crc32(uint32_t crc, const void *buf, size_t size);
 
 #ifdef __cplusplus
 }
+
+#include <cstddef>
+#include <cstdint>
+
+// This is kept out of the global namespace since zlib also has a crc32_combine() (which takes a z_off_t instead)
+namespace Invader {
+    /**
+     * Combine the CRC32s of two pieces of data into the CRC32 of both pieces, one after another
+     * @param crc1  CRC32 of the first piece
+     * @param crc2  CRC32 of the second piece
+     * @param size2 size of the second piece
+     * @return      CRC32 of the first piece followed by the second piece
+     */
+    std::uint32_t crc32_combine(std::uint32_t crc1, std::uint32_t crc2, std::size_t size2) noexcept;
+}
 #endif
 
 #endif
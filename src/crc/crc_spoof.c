@@ -4,6 +4,7 @@
 // - added GPL version 3 only identifier (the original code to this uses the below license, but my modifications are GPL version 3 only, as is Invader itself)
 // - commented out main function
 // - added a fake file handle data type and functions so this can be done with data in memory
+// - calculate the CRC32 of the data with crc32() rather than a bit at a time
 
 /*
  * CRC-32 forcer (C)
@@ -35,6 +36,7 @@
 #include <string.h>
 
 #include "crc_spoof.h"
+#include "crc32.h"
 
 
 /* Forward declarations */
@@ -159,26 +161,9 @@ static const uint64_t POLYNOMIAL = UINT64_C(0x104C11DB7);
 
 
 uint32_t get_crc32_and_length(FakeFileHandle *f, uint64_t *length) {
-    crc_spoof_fake_rewind(f);
-    uint32_t crc = UINT32_C(0xFFFFFFFF);
-    *length = 0;
-    while (true) {
-        char buffer[32 * 1024];
-        size_t n = crc_spoof_fake_fread(buffer, sizeof(buffer[0]), sizeof(buffer) / sizeof(buffer[0]), f);
-        for (size_t i = 0; i < n; i++) {
-            for (int j = 0; j < 8; j++) {
-                uint32_t bit = ((uint8_t)buffer[i] >> j) & 1;
-                crc ^= bit << 31;
-                bool xor = (crc >> 31) != 0;
-                crc = (crc & UINT32_C(0x7FFFFFFF)) << 1;
-                if (xor)
-                    crc ^= (uint32_t)POLYNOMIAL;
-            }
-        }
-        *length += n;
-        if (crc_spoof_fake_feof(f) != 0)
-            return ~crc;
-    }
+    // The data is already in memory, so use the table-driven CRC32 (bit-reversed, as that's what this file works with)
+    *length = f->size;
+    return crc_spoof_reverse_bits(crc32(0, f->data, (size_t)f->size));
 }
 
 
@@ -1,20 +1,64 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <future>
 #include <vector>
 #include "../crc32.h"
 #include "../crc_spoof.h"
 #include <invader/tag/hek/definition.hpp>
 #include <invader/crc/hek/crc.hpp>
 #include <invader/map/map.hpp>
+#include <invader/thread/thread_pool.hpp>
 
 namespace Invader {
-    std::uint32_t calculate_map_crc(Invader::Map &map, const std::uint32_t *new_crc, std::uint32_t *new_random, bool *check_dirty) {
+    /** Smallest piece of data to give to a thread */
+    static constexpr std::size_t MIN_CRC_PIECE_SIZE = 4 * 1024 * 1024;
+
+    /**
+     * Calculate the CRC32 of regions of data, one after another
+     * @param data    data
+     * @param regions start and end offsets of each region
+     * @param jobs    number of threads to use
+     * @return        CRC32
+     */
+    static std::uint32_t calculate_regions_crc(const std::byte *data, const std::vector<std::pair<std::size_t, std::size_t>> &regions, std::size_t jobs) {
+        // Split the regions into about one piece per thread, then combine the CRC32 of each piece in order
+        std::size_t total_size = 0;
+        for(auto &[start, end] : regions) {
+            total_size += end - start;
+        }
+        std::size_t piece_size = std::max(total_size / std::max(jobs, static_cast<std::size_t>(1)) + 1, MIN_CRC_PIECE_SIZE);
+
+        std::vector<std::pair<const std::byte *, std::size_t>> pieces;
+        for(auto &[start, end] : regions) {
+            for(std::size_t offset = start; offset < end; offset += piece_size) {
+                pieces.emplace_back(data + offset, std::min(piece_size, end - offset));
+            }
+        }
+
+        ThreadPool thread_pool(std::min(jobs, pieces.size()));
+        std::vector<std::future<std::uint32_t>> piece_crcs;
+        piece_crcs.reserve(pieces.size());
+        for(auto &[piece, piece_length] : pieces) {
+            piece_crcs.emplace_back(thread_pool.submit([piece = piece, piece_length = piece_length]() {
+                return crc32(0, piece, piece_length);
+            }));
+        }
+
+        std::uint32_t crc = 0;
+        for(std::size_t p = 0; p < pieces.size(); p++) {
+            crc = Invader::crc32_combine(crc, piece_crcs[p].get(), pieces[p].second);
+        }
+        return crc;
+    }
+
+    std::uint32_t calculate_map_crc(Invader::Map &map, const std::uint32_t *new_crc, std::uint32_t *new_random, bool *check_dirty, std::size_t jobs) {
         // Reassign variables if needed
         auto *data = map.get_data();
         auto size = map.get_data_length();
         
         std::vector<std::byte> data_crc;
-        std::uint32_t crc = 0;
+        std::vector<std::pair<std::size_t, std::size_t>> regions;
 
         if(new_crc && !new_random) {
             std::terminate();
@@ -34,7 +78,7 @@ namespace Invader {
                 data_crc.insert(data_crc.end(), data + data_start, data + data_end); \
             } \
             else { \
-                crc = crc32(crc, data + data_start, data_end - data_start); \
+                regions.emplace_back(data_start, data_end); \
             }
 
         auto &scenario_tag = map.get_tag(map.get_scenario_tag_id());
@@ -95,7 +139,7 @@ namespace Invader {
             return ~crc32(0, data_crc.data(), data_crc.size());
         }
         else {
-            std::uint32_t crc_value = ~crc;
+            std::uint32_t crc_value = ~calculate_regions_crc(data, regions, jobs);
             if(check_dirty) {
                 *check_dirty = crc_value != map.get_header_crc32();
             }
@@ -103,9 +147,9 @@ namespace Invader {
         }
     }
     
-    std::uint32_t calculate_map_crc(const std::byte *data, std::size_t size, const std::uint32_t *new_crc, std::uint32_t *new_random, bool *check_dirty, bool allow_compressed) {
+    std::uint32_t calculate_map_crc(const std::byte *data, std::size_t size, const std::uint32_t *new_crc, std::uint32_t *new_random, bool *check_dirty, bool allow_compressed, std::size_t jobs) {
         // Parse the map
         Map map = allow_compressed ? Map::map_with_copy(data, size) : Map::map_with_pointer(const_cast<std::byte *>(data), size);
-        return calculate_map_crc(map, new_crc, new_random, check_dirty);
+        return calculate_map_crc(map, new_crc, new_random, check_dirty, jobs);
     }
 }
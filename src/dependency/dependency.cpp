@@ -18,6 +18,7 @@ int main(int argc, char * const *argv) {
     options.emplace_back("reverse", 'R', 0, "Find all tags that depend on the tag, instead.");
     options.emplace_back("recursive", 'r', 0, "Recursively get all depended tags.");
     options.emplace_back("fs-path", 'P', 0, "Use a filesystem path for the tag.");
+    options.emplace_back("index", 'I', 1, "Use a reverse dependency index saved at the given path with --reverse, creating or updating it as needed. Only tags that changed since it was last updated are read.", "<file>");
 
     static constexpr char DESCRIPTION[] = "Check dependencies for a tag.";
     static constexpr char USAGE[] = "[options] <tag.class>";
@@ -28,6 +29,7 @@ int main(int argc, char * const *argv) {
         std::vector<std::string> tags;
         std::string output;
         bool use_filesystem_path = false;
+        std::optional<std::filesystem::path> index;
     } dependency_options;
 
     auto remaining_arguments = Invader::CommandLineOption::parse_arguments<DependencyOption &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, dependency_options, [](char opt, const auto &arguments, auto &dependency_options) {
@@ -47,6 +49,9 @@ int main(int argc, char * const *argv) {
             case 'P':
                 dependency_options.use_filesystem_path = true;
                 break;
+            case 'I':
+                dependency_options.index = arguments[0];
+                break;
         }
     });
 
@@ -101,7 +106,7 @@ int main(int argc, char * const *argv) {
 
     // Here's an array we can use to hold what we got
     bool success;
-    auto found_tags = Invader::FoundTagDependency::find_dependencies(tag_path_to_find, tag_int_to_find, dependency_options.tags, dependency_options.reverse, dependency_options.recursive, success);
+    auto found_tags = Invader::FoundTagDependency::find_dependencies(tag_path_to_find, tag_int_to_find, dependency_options.tags, dependency_options.reverse, dependency_options.recursive, success, dependency_options.index);
 
     if(!success) {
         return EXIT_FAILURE;
@@ -1,31 +1,46 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <invader/dependency/found_tag_dependency.hpp>
+#include <invader/dependency/reverse_dependency_index.hpp>
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
 #include <invader/build/build_workload.hpp>
+#include <invader/tag/hek/header.hpp>
+#include <invader/tag/parser/parser.hpp>
 
 #include <filesystem>
 
 namespace Invader {
-    static std::vector<std::pair<std::string, TagClassInt>> get_dependencies(const BuildWorkload &tag_compiled) {
+    std::vector<std::pair<std::string, TagClassInt>> FoundTagDependency::find_dependencies_in_tag_file(const std::byte *tag_data, std::size_t tag_data_size) {
         std::vector<std::pair<std::string, TagClassInt>> dependencies;
-        for(auto &s : tag_compiled.structs) {
-            for(auto &d : s.dependencies) {
-                // Skip anything referencing ourselves
-                if(d.tag_index == 0) {
-                    continue;
-                }
 
-                // Continue
-                auto &tag = tag_compiled.tags[d.tag_index];
-                dependencies.emplace_back(tag.path, tag.tag_class_int);
+        // Scenarios can also reference tags in their scripts, which are only found by compiling them
+        const auto *header = reinterpret_cast<const HEK::TagFileHeader *>(tag_data);
+        if(tag_data_size >= sizeof(*header) && header->tag_class_int == TagClassInt::TAG_CLASS_SCENARIO) {
+            auto tag_compiled = BuildWorkload::compile_single_tag(tag_data, tag_data_size);
+            for(auto &s : tag_compiled.structs) {
+                for(auto &d : s.dependencies) {
+                    // Skip anything referencing ourselves
+                    if(d.tag_index == 0) {
+                        continue;
+                    }
+
+                    // Continue
+                    auto &tag = tag_compiled.tags[d.tag_index];
+                    dependencies.emplace_back(tag.path, tag.tag_class_int);
+                }
             }
+            return dependencies;
+        }
+
+        // Everything else just needs its references read
+        for(auto &d : Parser::ParserStruct::scan_hek_tag_file_dependencies(tag_data, tag_data_size)) {
+            dependencies.emplace_back(std::move(d.path), d.tag_class_int);
         }
         return dependencies;
     }
 
-    std::vector<FoundTagDependency> FoundTagDependency::find_dependencies(const char *tag_path_to_find_2, Invader::TagClassInt tag_int_to_find, std::vector<std::string> tags, bool reverse, bool recursive, bool &success) {
+    std::vector<FoundTagDependency> FoundTagDependency::find_dependencies(const char *tag_path_to_find_2, Invader::TagClassInt tag_int_to_find, std::vector<std::string> tags, bool reverse, bool recursive, bool &success, const std::optional<std::filesystem::path> &reverse_index_path) {
         std::vector<FoundTagDependency> found_tags;
         success = true;
 
@@ -53,7 +68,7 @@ namespace Invader {
                     std::fclose(f);
 
                     try {
-                        auto dependencies = get_dependencies(BuildWorkload::compile_single_tag(tag_data.get(), file_size));
+                        auto dependencies = find_dependencies_in_tag_file(tag_data.get(), file_size);
                         for(auto &dependency : dependencies) {
                             // Make sure it's not in found_tags
                             bool dupe = false;
@@ -108,82 +123,16 @@ namespace Invader {
         }
         else {
             // Turn all forward slashes into backslashes if not on Windows
-            std::string tag_path_to_find = File::preferred_path_to_halo_path(tag_path_to_find_2);
-
-            // Iterate
-            for(auto &tags_directory : tags) {
-                auto iterate_recursively = [&found_tags, &tag_int_to_find, &tag_path_to_find](const std::string &current_path, const std::filesystem::path &dir, auto &recursion) -> void {
-                    for(auto file : std::filesystem::directory_iterator(dir)) {
-                        if(file.is_directory()) {
-                            std::string dir_tag_path = current_path + file.path().filename().string() + "\\";
-                            recursion(dir_tag_path, file.path(), recursion);
-                        }
-                        else if(file.is_regular_file()) {
-                            std::string dir_tag_path = current_path + file.path().filename().stem().string();
-                            auto class_int = Invader::HEK::extension_to_tag_class(file.path().extension().string().c_str() + 1);
-
-                            // Skip some obvious stuff as well as null tag class ints
-                            if(
-                                class_int == Invader::TagClassInt::TAG_CLASS_NULL ||
-                                class_int == Invader::TagClassInt::TAG_CLASS_BITMAP ||
-                                class_int == Invader::TagClassInt::TAG_CLASS_CAMERA_TRACK ||
-                                class_int == Invader::TagClassInt::TAG_CLASS_HUD_MESSAGE_TEXT ||
-                                class_int == Invader::TagClassInt::TAG_CLASS_PHYSICS ||
-                                class_int == Invader::TagClassInt::TAG_CLASS_SOUND_ENVIRONMENT ||
-                                class_int == Invader::TagClassInt::TAG_CLASS_UNICODE_STRING_LIST ||
-                                class_int == Invader::TagClassInt::TAG_CLASS_WIND) {
-                                continue;
-                            }
-
-                            // If we already found this, ignore it
-                            bool skip = false;
-                            for(auto &f : found_tags) {
-                                if(f.path == dir_tag_path && f.class_int == class_int) {
-                                    skip = true;
-                                    break;
-                                }
-                            }
-                            if(skip) {
-                                break;
-                            }
+            File::TagFilePath tag_to_find(File::preferred_path_to_halo_path(tag_path_to_find_2), tag_int_to_find);
 
-                            // Attempt to open and read the tag
-                            std::FILE *f = std::fopen(file.path().string().c_str(), "rb");
-                            if(!f) {
-                                eprintf_error("Failed to open tag %s.", file.path().string().c_str());
-                                continue;
-                            }
-
-                            std::fseek(f, 0, SEEK_END);
-                            long file_size = std::ftell(f);
-                            std::fseek(f, 0, SEEK_SET);
-                            auto tag_data = std::make_unique<std::byte []>(static_cast<std::size_t>(file_size));
-                            if(!std::fread(tag_data.get(), file_size, 1, f)) {
-                                std::fclose(f);
-                                eprintf_error("Failed to read file %s", file.path().string().c_str());
-                                continue;
-                            }
-                            std::fclose(f);
-
-                            // Attempt to parse
-                            try {
-                                auto dependencies = get_dependencies(BuildWorkload::compile_single_tag(tag_data.get(), file_size));
-                                for(auto &dependency : dependencies) {
-                                    if(dependency.first == tag_path_to_find && dependency.second == tag_int_to_find) {
-                                        found_tags.emplace_back(dir_tag_path, class_int, false, file.path().string());
-                                        break;
-                                    }
-                                }
-                            }
-                            catch (std::exception &e) {
-                                eprintf_warn("Warning: Failed to compile tag %s: %s", file.path().string().c_str(), e.what());
-                            }
-                        }
-                    }
-                };
+            // Index everything (reusing a saved index if we have one), then look it up
+            auto index = ReverseDependencyIndex::index_tags_directories(tags, reverse_index_path);
+            if(reverse_index_path.has_value() && !index.save(*reverse_index_path)) {
+                eprintf_warn("Warning: Failed to save the reverse dependency index to %s", reverse_index_path->string().c_str());
+            }
 
-                std::filesystem::path tags_dir_path(tags_directory);
-                iterate_recursively("", tags_dir_path, iterate_recursively);
+            for(auto *tag : index.find_references(tag_to_find)) {
+                found_tags.emplace_back(tag->tag.path, tag->tag.class_int, false, tag->file_path);
             }
         }
 
@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstring>
+#include <unordered_set>
+
+#include <invader/dependency/reverse_dependency_index.hpp>
+#include <invader/dependency/found_tag_dependency.hpp>
+#include <invader/file/serializer.hpp>
+#include <invader/error.hpp>
+#include <invader/printf.hpp>
+#include "../crc/crc32.h"
+
+namespace Invader {
+    /** Bump this whenever the format of the index changes */
+    static constexpr std::uint32_t REVERSE_DEPENDENCY_INDEX_VERSION = 1;
+
+    /** Magic at the start of the index */
+    static constexpr char REVERSE_DEPENDENCY_INDEX_MAGIC[8] = { 'i', 'n', 'v', 'r', 'd', 'e', 'p', 'i' };
+
+    // These tag classes can't reference other tags, so there's no need to read them
+    static bool tag_class_has_no_dependencies(TagClassInt class_int) noexcept {
+        switch(class_int) {
+            case TagClassInt::TAG_CLASS_BITMAP:
+            case TagClassInt::TAG_CLASS_CAMERA_TRACK:
+            case TagClassInt::TAG_CLASS_HUD_MESSAGE_TEXT:
+            case TagClassInt::TAG_CLASS_PHYSICS:
+            case TagClassInt::TAG_CLASS_SOUND_ENVIRONMENT:
+            case TagClassInt::TAG_CLASS_UNICODE_STRING_LIST:
+            case TagClassInt::TAG_CLASS_WIND:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    ReverseDependencyIndex ReverseDependencyIndex::index_tags_directories(const std::vector<std::string> &tags, const std::optional<std::filesystem::path> &index_path) {
+        ReverseDependencyIndex index;
+        auto saved_tags = index_path.has_value() ? load(*index_path) : std::unordered_map<std::string, IndexedTag>();
+
+        // Tags in lower priority directories are overridden by tags in higher priority ones, so skip them
+        std::unordered_set<std::string> indexed_paths;
+        auto all_tags = File::load_virtual_tag_folder(tags);
+        index.tags.reserve(all_tags.size());
+
+        for(auto &t : all_tags) {
+            auto split_path = File::split_tag_class_extension(File::preferred_path_to_halo_path(t.tag_path));
+            if(!split_path.has_value() || !indexed_paths.insert(split_path->join()).second) {
+                continue;
+            }
+
+            IndexedTag tag;
+            tag.tag = *split_path;
+            tag.file_path = t.full_path.string();
+
+            try {
+                tag.modified_time = static_cast<std::int64_t>(std::filesystem::last_write_time(t.full_path).time_since_epoch().count());
+                tag.file_size = static_cast<std::uint64_t>(std::filesystem::file_size(t.full_path));
+            }
+            catch(std::exception &e) {
+                eprintf_warn("Warning: Failed to stat tag %s: %s", tag.file_path.c_str(), e.what());
+                continue;
+            }
+
+            // If the tag hasn't changed since it was last indexed, we can use that
+            auto saved_tag = saved_tags.find(tag.file_path);
+            bool saved_tag_usable = saved_tag != saved_tags.end() && saved_tag->second.tag == tag.tag && saved_tag->second.file_size == tag.file_size;
+            if(saved_tag_usable && saved_tag->second.modified_time == tag.modified_time) {
+                index.tags.emplace_back(std::move(saved_tag->second));
+                continue;
+            }
+
+            if(tag_class_has_no_dependencies(tag.tag.class_int)) {
+                index.tags.emplace_back(std::move(tag));
+                continue;
+            }
+
+            // Otherwise, read it
+            auto tag_data = File::open_file(tag.file_path.c_str());
+            if(!tag_data.has_value()) {
+                eprintf_error("Failed to open tag %s.", tag.file_path.c_str());
+                continue;
+            }
+            index.read_tag_count++;
+            tag.crc32 = crc32(0, tag_data->data(), tag_data->size());
+
+            // The modification time may have changed without the contents changing (e.g. if it was copied)
+            if(saved_tag_usable && saved_tag->second.crc32 == tag.crc32) {
+                tag.dependencies = std::move(saved_tag->second.dependencies);
+                index.tags.emplace_back(std::move(tag));
+                continue;
+            }
+
+            try {
+                for(auto &d : FoundTagDependency::find_dependencies_in_tag_file(tag_data->data(), tag_data->size())) {
+                    tag.dependencies.emplace_back(d.first, d.second);
+                }
+            }
+            catch(std::exception &e) {
+                // Don't index it so it gets read again next time
+                eprintf_warn("Warning: Failed to read dependencies of %s: %s", tag.file_path.c_str(), e.what());
+                continue;
+            }
+
+            index.tags.emplace_back(std::move(tag));
+        }
+
+        // Build the reverse lookup
+        std::size_t tag_count = index.tags.size();
+        for(std::size_t t = 0; t < tag_count; t++) {
+            for(auto &d : index.tags[t].dependencies) {
+                auto &referenced_by = index.references[d.join()];
+                if(referenced_by.empty() || referenced_by.back() != t) {
+                    referenced_by.emplace_back(t);
+                }
+            }
+        }
+
+        return index;
+    }
+
+    std::vector<const ReverseDependencyIndex::IndexedTag *> ReverseDependencyIndex::find_references(const File::TagFilePath &tag) const {
+        std::vector<const IndexedTag *> found_tags;
+        auto referenced_by = this->references.find(tag.join());
+        if(referenced_by != this->references.end()) {
+            found_tags.reserve(referenced_by->second.size());
+            for(auto t : referenced_by->second) {
+                found_tags.emplace_back(&this->tags[t]);
+            }
+        }
+        return found_tags;
+    }
+
+    bool ReverseDependencyIndex::save(const std::filesystem::path &index_path) const {
+        File::BinaryWriter writer;
+        writer.write_raw(REVERSE_DEPENDENCY_INDEX_MAGIC, sizeof(REVERSE_DEPENDENCY_INDEX_MAGIC));
+        writer.write_int(REVERSE_DEPENDENCY_INDEX_VERSION);
+        writer.write_int(this->tags.size());
+        for(auto &t : this->tags) {
+            writer.write_string(t.tag.path);
+            writer.write_int(static_cast<std::uint64_t>(t.tag.class_int));
+            writer.write_string(t.file_path);
+            writer.write_int(static_cast<std::uint64_t>(t.modified_time));
+            writer.write_int(t.file_size);
+            writer.write_int(t.crc32);
+            writer.write_int(t.dependencies.size());
+            for(auto &d : t.dependencies) {
+                writer.write_string(d.path);
+                writer.write_int(static_cast<std::uint64_t>(d.class_int));
+            }
+        }
+
+        // Write to a temporary file first so an interrupted save doesn't leave a broken index
+        auto temp_path = index_path;
+        temp_path += ".tmp";
+        if(!File::save_file(temp_path.string().c_str(), writer.data)) {
+            return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp_path, index_path, ec);
+        if(ec) {
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+    std::unordered_map<std::string, ReverseDependencyIndex::IndexedTag> ReverseDependencyIndex::load(const std::filesystem::path &index_path) {
+        std::unordered_map<std::string, IndexedTag> saved_tags;
+        auto index_data = File::open_file(index_path.string().c_str());
+        if(!index_data.has_value()) {
+            return saved_tags;
+        }
+
+        // If it isn't a valid index or it's from a different version, it'll just be regenerated
+        if(index_data->size() < sizeof(REVERSE_DEPENDENCY_INDEX_MAGIC) || std::memcmp(index_data->data(), REVERSE_DEPENDENCY_INDEX_MAGIC, sizeof(REVERSE_DEPENDENCY_INDEX_MAGIC)) != 0) {
+            return saved_tags;
+        }
+
+        try {
+            File::BinaryReader reader(index_data->data() + sizeof(REVERSE_DEPENDENCY_INDEX_MAGIC), index_data->size() - sizeof(REVERSE_DEPENDENCY_INDEX_MAGIC));
+            if(reader.read_int() != REVERSE_DEPENDENCY_INDEX_VERSION) {
+                return saved_tags;
+            }
+            auto tag_count = reader.read_int();
+            for(std::uint64_t t = 0; t < tag_count; t++) {
+                IndexedTag tag;
+                tag.tag.path = reader.read_string();
+                tag.tag.class_int = static_cast<TagClassInt>(reader.read_int());
+                tag.file_path = reader.read_string();
+                tag.modified_time = static_cast<std::int64_t>(reader.read_int());
+                tag.file_size = reader.read_int();
+                tag.crc32 = static_cast<std::uint32_t>(reader.read_int());
+                auto dependency_count = reader.read_int();
+                for(std::uint64_t d = 0; d < dependency_count; d++) {
+                    auto path = reader.read_string();
+                    auto class_int = static_cast<TagClassInt>(reader.read_int());
+                    tag.dependencies.emplace_back(path, class_int);
+                }
+                auto file_path = tag.file_path;
+                saved_tags.emplace(std::move(file_path), std::move(tag));
+            }
+            if(!reader.at_end()) {
+                throw OutOfBoundsException();
+            }
+        }
+        catch(std::exception &) {
+            eprintf_warn("Warning: %s is corrupt and will be regenerated", index_path.string().c_str());
+            saved_tags.clear();
+        }
+
+        return saved_tags;
+    }
+}
@@ -352,8 +352,9 @@ namespace Invader::EditQt {
         
         // Deswizzle if necessary
         if(bitmap_data->flags & Invader::HEK::BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_SWIZZLED) {
-            auto deswizzled = Invader::Swizzle::swizzle(reinterpret_cast<std::byte *>(data.data()), 32, real_width, real_height, true);
-            std::memcpy(data.data(), deswizzled.data(), deswizzled.size());
+            std::vector<std::uint32_t> deswizzled(data.size());
+            Invader::Swizzle::swizzle(reinterpret_cast<const std::byte *>(data.data()), reinterpret_cast<std::byte *>(deswizzled.data()), 32, real_width, real_height, true);
+            data.swap(deswizzled);
         }
 
         // Scale if needed
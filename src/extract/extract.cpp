@@ -26,6 +26,7 @@ int main(int argc, const char **argv) {
         bool overwrite = false;
         bool non_mp_globals = false;
         bool ignore_resource_maps = false;
+        std::size_t jobs = 1;
     } extract_options;
 
     // Command line options
@@ -38,6 +39,7 @@ int main(int argc, const char **argv) {
     options.emplace_back("info", 'i', 0, "Show credits, source info, and other info");
     options.emplace_back("search", 's', 1, "Search for tags (* and ? are wildcards); use multiple times for multiple queries", "<expr>");
     options.emplace_back("non-mp-globals", 'n', 0, "Enable extraction of non-multiplayer .globals");
+    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for extracting tags. Default: 1", "<#>");
 
     static constexpr char DESCRIPTION[] = "Extract data from cache files.";
     static constexpr char USAGE[] = "[options] <map>";
@@ -71,6 +73,19 @@ int main(int argc, const char **argv) {
                 extract_options.search_queries.emplace_back(args[0]);
                 extract_options.search_all_tags = false;
                 break;
+            case 'j':
+                try {
+                    int jobs = std::stoi(args[0]);
+                    if(jobs < 1) {
+                        throw std::exception();
+                    }
+                    extract_options.jobs = static_cast<std::size_t>(jobs);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s", args[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
             case 'i':
                 Invader::show_version_info();
                 std::exit(EXIT_SUCCESS);
@@ -94,7 +109,7 @@ int main(int argc, const char **argv) {
         return EXIT_FAILURE;
     }
 
-    std::vector<std::byte> loc, bitmaps, sounds;
+    std::optional<std::string> loc, bitmaps, sounds;
 
     // Find the asset data
     if(!extract_options.maps_directory.has_value()) {
@@ -108,17 +123,16 @@ int main(int argc, const char **argv) {
     // Load resource maps
     if(extract_options.maps_directory.has_value() && !extract_options.ignore_resource_maps) {
         std::filesystem::path maps_directory(*extract_options.maps_directory);
-        auto open_map_possibly = [&maps_directory](const char *map, const char *map_alt, auto &open_map_possibly) -> std::vector<std::byte> {
-            auto potential_map_path = (maps_directory / map).string();
-            auto potential_map = Invader::File::open_file(potential_map_path.c_str());
-            if(potential_map.has_value()) {
-                return *potential_map;
+        auto open_map_possibly = [&maps_directory](const char *map, const char *map_alt, auto &open_map_possibly) -> std::optional<std::string> {
+            auto potential_map_path = maps_directory / map;
+            if(std::filesystem::is_regular_file(potential_map_path)) {
+                return potential_map_path.string();
             }
             else if(map_alt) {
                 return open_map_possibly(map_alt, nullptr, open_map_possibly);
             }
             else {
-                return std::vector<std::byte>();
+                return std::nullopt;
             }
         };
 
@@ -167,13 +181,13 @@ int main(int argc, const char **argv) {
     // Load map
     std::unique_ptr<Map> map;
     try {
-        auto file = File::open_file(remaining_arguments[0]).value();
-        map = std::make_unique<Map>(Map::map_with_move(std::move(file), std::move(bitmaps), std::move(loc), std::move(sounds)));
+        auto path_or_null = [](const std::optional<std::string> &path) { return path.has_value() ? path->c_str() : nullptr; };
+        map = std::make_unique<Map>(Map::map_with_mmap(remaining_arguments[0], path_or_null(bitmaps), path_or_null(loc), path_or_null(sounds)));
     }
     catch (std::exception &e) {
         eprintf_error("Failed to parse %s: %s", remaining_arguments[0], e.what());
         return EXIT_FAILURE;
     }
 
-    ExtractionWorkload::extract_map(*map, *extract_options.tags_directory, extract_options.search_queries, extract_options.recursive, extract_options.overwrite, extract_options.non_mp_globals);
+    ExtractionWorkload::extract_map(*map, *extract_options.tags_directory, extract_options.search_queries, extract_options.recursive, extract_options.overwrite, extract_options.non_mp_globals, ErrorHandler::ReportingLevel::REPORTING_LEVEL_ALL, extract_options.jobs);
 }
@@ -1,13 +1,16 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <regex>
+#include <deque>
+#include <future>
 #include <invader/build/build_workload.hpp>
 #include <invader/extract/extraction.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/tag/parser/parser.hpp>
+#include <invader/thread/thread_pool.hpp>
 
 namespace Invader {
-    void ExtractionWorkload::extract_map(const Map &map, const std::string &tags, const std::vector<std::string> &queries, bool recursive, bool overwrite, bool non_mp_globals, ReportingLevel reporting_level) {
+    void ExtractionWorkload::extract_map(const Map &map, const std::string &tags, const std::vector<std::string> &queries, bool recursive, bool overwrite, bool non_mp_globals, ReportingLevel reporting_level, std::size_t jobs) {
         // There's no need to extract recursively if we're extracting all tags
         if(queries.size() == 0) {
             recursive = false;
@@ -15,7 +18,7 @@ namespace Invader {
         
         ExtractionWorkload workload(map, reporting_level);
         auto start = std::chrono::steady_clock::now();
-        auto success = workload.perform_extraction(queries, tags, recursive, overwrite, non_mp_globals);
+        auto success = workload.perform_extraction(queries, tags, recursive, overwrite, non_mp_globals, jobs);
         auto matched = workload.matched_tags.size();
         auto warnings = workload.get_warnings();
         auto errors = workload.get_errors();
@@ -47,132 +50,174 @@ namespace Invader {
         }
     }
     
-    std::size_t ExtractionWorkload::perform_extraction(const std::vector<std::string> &queries, const std::filesystem::path &tags, bool recursive, bool overwrite, bool non_mp_globals) {
-        // Set these variables up
-        auto *map = &this->map;
-        auto type = map->get_type();
-        auto tag_count = map->get_tag_count();
-        std::vector<bool> extracted_tags(tag_count);
-        std::deque<std::size_t> all_tags_to_extract;
-        auto &workload = *this;
+    /**
+     * Result of extracting a tag on a worker thread. Anything that needs to be reported is held here until the tag is
+     * finished on the calling thread, so errors come out in the same order regardless of the number of threads used.
+     */
+    struct ExtractionWorkload::ExtractedTag {
+        /** Tag data to write, if the tag was extracted */
+        std::optional<std::vector<std::byte>> data;
 
-        auto extract_tag = [&extracted_tags, &map, &tags, &all_tags_to_extract, &type, &recursive, &overwrite, &non_mp_globals, &workload](std::size_t tag_index) -> bool {
-            // Do it
-            extracted_tags[tag_index] = true;
+        /** Path to write the tag to */
+        std::filesystem::path path;
 
-            // Get the tag path
-            const auto &tag = map->get_tag(tag_index);
+        /** Dependencies of the tag, if extracting recursively */
+        std::vector<std::pair<std::string, TagClassInt>> dependencies;
 
-            // See if we can extract this
-            auto tag_class_int = tag.get_tag_class_int();
-            const char *tag_extension = Invader::HEK::tag_class_to_extension(tag_class_int);
-            if(!tag.data_is_available()) {
-                return false;
-            }
+        /** Errors and warnings to report once the tag is finished */
+        std::vector<std::pair<ErrorType, std::string>> reports;
 
-            // Get the path
-            auto path = Invader::File::halo_path_to_preferred_path(tag.get_path());
-            if(path.size() == 0) {
-                workload.report_error(ErrorType::ERROR_TYPE_ERROR, "Tag path is invalid", tag_index);
-                return false;
-            }
+        void report_error(ErrorType type, const char *error, std::optional<std::size_t>) {
+            this->reports.emplace_back(type, error);
+        }
+    };
 
-            // Lowercase everything
-            for(char &c : path) {
-                c = std::tolower(c);
-            }
+    ExtractionWorkload::ExtractedTag ExtractionWorkload::prepare_tag(std::size_t tag_index, bool recursive, bool overwrite, bool non_mp_globals) const {
+        ExtractedTag result;
 
-            // Figure out the path we're writing to
-            auto tag_path_to_write_to = tags / (path + "." + tag_extension);
-            if(!overwrite && std::filesystem::exists(tag_path_to_write_to)) {
-                return false;
+        // Get the tag path
+        const auto &tag = this->map.get_tag(tag_index);
+        auto type = this->map.get_type();
+
+        // See if we can extract this
+        auto tag_class_int = tag.get_tag_class_int();
+        const char *tag_extension = Invader::HEK::tag_class_to_extension(tag_class_int);
+        if(!tag.data_is_available()) {
+            return result;
+        }
+
+        // Get the path
+        auto path = Invader::File::halo_path_to_preferred_path(tag.get_path());
+        if(path.size() == 0) {
+            result.report_error(ErrorType::ERROR_TYPE_ERROR, "Tag path is invalid", tag_index);
+            return result;
+        }
+
+        // Lowercase everything
+        for(char &c : path) {
+            c = std::tolower(c);
+        }
+
+        // Figure out the path we're writing to
+        result.path = this->tags / (path + "." + tag_extension);
+        if(!overwrite && std::filesystem::exists(result.path)) {
+            return result;
+        }
+
+        // Skip globals
+        if(tag_class_int == Invader::TagClassInt::TAG_CLASS_GLOBALS && !non_mp_globals && type != Invader::HEK::CacheFileType::SCENARIO_TYPE_MULTIPLAYER) {
+            result.report_error(ErrorType::ERROR_TYPE_WARNING_PEDANTIC, "Skipping the non-multiplayer map's globals tag", tag_index);
+            return result;
+        }
+
+        // Get the tag data. This runs on worker threads, so nothing is printed here; errors are held in the result instead.
+        std::vector<std::byte> new_tag;
+        try {
+            ExtractionWorkload tag_workload(this->map, ReportingLevel::REPORTING_LEVEL_HIDE_EVERYTHING);
+            auto extracted_tag = tag_workload.extract_tag(tag_index);
+            if(!extracted_tag.has_value()) {
+                REPORT_ERROR_PRINTF(result, ERROR_TYPE_ERROR, tag_index, "Tag class %s is unsupported", tag_extension);
+                return result;
             }
+            new_tag = extracted_tag->get()->generate_hek_tag_data(tag_class_int);
 
-            // Skip globals
-            if(tag_class_int == Invader::TagClassInt::TAG_CLASS_GLOBALS && !non_mp_globals && type != Invader::HEK::CacheFileType::SCENARIO_TYPE_MULTIPLAYER) {
-                workload.report_error(ErrorType::ERROR_TYPE_WARNING_PEDANTIC, "Skipping the non-multiplayer map's globals tag", tag_index);
-                return false;
+            // If we're recursive, we want to also get that stuff, too
+            if(recursive) {
+                auto tag_compiled = BuildWorkload::compile_single_tag(new_tag.data(), new_tag.size(), std::vector<std::string>(), false);
+                for(auto &s : tag_compiled.structs) {
+                    for(auto &d : s.dependencies) {
+                        auto &tag = tag_compiled.tags[d.tag_index];
+                        result.dependencies.emplace_back(tag.path, tag.tag_class_int);
+                    }
+                }
             }
+        }
+        catch (std::exception &e) {
+            REPORT_ERROR_PRINTF(result, ERROR_TYPE_ERROR, tag_index, "Failed to extract %s.%s: %s", Invader::File::halo_path_to_preferred_path(tag.get_path()).c_str(), tag_extension, e.what());
+            return result;
+        }
 
-            // Get the tag data
-            std::vector<std::byte> new_tag;
-            try {
-                new_tag = Invader::ExtractionWorkload::extract_single_tag(tag);
-
-                // If we're recursive, we want to also get that stuff, too
-                if(recursive) {
-                    auto tag_compiled = BuildWorkload::compile_single_tag(new_tag.data(), new_tag.size(), std::vector<std::string>(), false);
-                    std::vector<std::pair<const std::string *, Invader::TagClassInt>> dependencies;
-                    for(auto &s : tag_compiled.structs) {
-                        for(auto &d : s.dependencies) {
-                            auto &tag = tag_compiled.tags[d.tag_index];
-                            dependencies.emplace_back(&tag.path, tag.tag_class_int);
+        // Jason Jones the tag
+        if(type == Invader::HEK::CacheFileType::SCENARIO_TYPE_SINGLEPLAYER) {
+            auto tag_path = tag.get_path();
+            bool changed = false;
+            switch(tag_class_int) {
+                case Invader::TagClassInt::TAG_CLASS_WEAPON: {
+                    #define ALTER_TAG_DATA(from, to) if(from != to) { from = to; changed = true; } 
+                    
+                    if(tag_path == "weapons\\pistol\\pistol") {
+                        auto parsed = Invader::Parser::Weapon::parse_hek_tag_file(new_tag.data(), new_tag.size());
+                        if(parsed.triggers.size() >= 1) {
+                            auto &first_trigger = parsed.triggers[0];
+                            ALTER_TAG_DATA(first_trigger.minimum_error, DEGREES_TO_RADIANS(0.0F));
+                            ALTER_TAG_DATA(first_trigger.error_angle.from, DEGREES_TO_RADIANS(0.2F));
+                            ALTER_TAG_DATA(first_trigger.error_angle.to, DEGREES_TO_RADIANS(2.0F));
                         }
+                        new_tag = parsed.generate_hek_tag_data(TagClassInt::TAG_CLASS_WEAPON);
                     }
-                    for(auto &d : dependencies) {
-                        auto tag_index = map->find_tag(d.first->c_str(), d.second);
-                        if(tag_index.has_value() && extracted_tags[*tag_index] == false) {
-                            all_tags_to_extract.push_back(*tag_index);
+                    else if(tag_path == "weapons\\plasma rifle\\plasma rifle") {
+                        auto parsed = Invader::Parser::Weapon::parse_hek_tag_file(new_tag.data(), new_tag.size());
+                        if(parsed.triggers.size() >= 1) {
+                            auto &first_trigger = parsed.triggers[0];
+                            ALTER_TAG_DATA(first_trigger.error_angle.from, DEGREES_TO_RADIANS(0.5F));
+                            ALTER_TAG_DATA(first_trigger.error_angle.to, DEGREES_TO_RADIANS(5.0F));
                         }
+                        new_tag = parsed.generate_hek_tag_data(TagClassInt::TAG_CLASS_WEAPON);
                     }
+                    break;
                 }
+                case Invader::TagClassInt::TAG_CLASS_DAMAGE_EFFECT:
+                    if(tag_path == "weapons\\pistol\\bullet") {
+                        auto parsed = Invader::Parser::DamageEffect::parse_hek_tag_file(new_tag.data(), new_tag.size());
+                        ALTER_TAG_DATA(parsed.elite_energy_shield, 1.0F);
+                        new_tag = parsed.generate_hek_tag_data(TagClassInt::TAG_CLASS_DAMAGE_EFFECT);
+                    }
+                    break;
+                default:
+                    break;
+                    
+                    #undef ALTER_TAG_DATA
+            }
+            
+            if(changed) {
+                REPORT_ERROR_PRINTF(result, ERROR_TYPE_WARNING_PEDANTIC, tag_index, "%s.%s was changed due to being altered in singleplayer", Invader::File::halo_path_to_preferred_path(tag.get_path()).c_str(), tag_extension);
             }
-            catch (std::exception &e) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_ERROR, tag_index, "Failed to extract %s.%s: %s", Invader::File::halo_path_to_preferred_path(tag.get_path()).c_str(), tag_extension, e.what());
+        }
+
+        result.data = std::move(new_tag);
+        return result;
+    }
+
+    std::size_t ExtractionWorkload::perform_extraction(const std::vector<std::string> &queries, const std::filesystem::path &tags, bool recursive, bool overwrite, bool non_mp_globals, std::size_t jobs) {
+        // Set these variables up
+        auto *map = &this->map;
+        auto tag_count = map->get_tag_count();
+        std::vector<bool> extracted_tags(tag_count);
+        std::deque<std::size_t> all_tags_to_extract;
+        auto &workload = *this;
+        this->tags = tags;
+
+        // Write the tag and queue its dependencies. This is always done on this thread in the order tags were queued.
+        auto finish_tag = [&extracted_tags, &map, &all_tags_to_extract, &workload](std::size_t tag_index, ExtractedTag &result) -> bool {
+            for(auto &r : result.reports) {
+                workload.report_error(r.first, r.second.c_str(), tag_index);
+            }
+
+            if(!result.data.has_value()) {
                 return false;
             }
 
-            // Jason Jones the tag
-            if(type == Invader::HEK::CacheFileType::SCENARIO_TYPE_SINGLEPLAYER) {
-                auto tag_path = tag.get_path();
-                bool changed = false;
-                switch(tag_class_int) {
-                    case Invader::TagClassInt::TAG_CLASS_WEAPON: {
-                        #define ALTER_TAG_DATA(from, to) if(from != to) { from = to; changed = true; } 
-                        
-                        if(tag_path == "weapons\\pistol\\pistol") {
-                            auto parsed = Invader::Parser::Weapon::parse_hek_tag_file(new_tag.data(), new_tag.size());
-                            if(parsed.triggers.size() >= 1) {
-                                auto &first_trigger = parsed.triggers[0];
-                                ALTER_TAG_DATA(first_trigger.minimum_error, DEGREES_TO_RADIANS(0.0F));
-                                ALTER_TAG_DATA(first_trigger.error_angle.from, DEGREES_TO_RADIANS(0.2F));
-                                ALTER_TAG_DATA(first_trigger.error_angle.to, DEGREES_TO_RADIANS(2.0F));
-                            }
-                            new_tag = parsed.generate_hek_tag_data(TagClassInt::TAG_CLASS_WEAPON);
-                        }
-                        else if(tag_path == "weapons\\plasma rifle\\plasma rifle") {
-                            auto parsed = Invader::Parser::Weapon::parse_hek_tag_file(new_tag.data(), new_tag.size());
-                            if(parsed.triggers.size() >= 1) {
-                                auto &first_trigger = parsed.triggers[0];
-                                ALTER_TAG_DATA(first_trigger.error_angle.from, DEGREES_TO_RADIANS(0.5F));
-                                ALTER_TAG_DATA(first_trigger.error_angle.to, DEGREES_TO_RADIANS(5.0F));
-                            }
-                            new_tag = parsed.generate_hek_tag_data(TagClassInt::TAG_CLASS_WEAPON);
-                        }
-                        break;
-                    }
-                    case Invader::TagClassInt::TAG_CLASS_DAMAGE_EFFECT:
-                        if(tag_path == "weapons\\pistol\\bullet") {
-                            auto parsed = Invader::Parser::DamageEffect::parse_hek_tag_file(new_tag.data(), new_tag.size());
-                            ALTER_TAG_DATA(parsed.elite_energy_shield, 1.0F);
-                            new_tag = parsed.generate_hek_tag_data(TagClassInt::TAG_CLASS_DAMAGE_EFFECT);
-                        }
-                        break;
-                    default:
-                        break;
-                        
-                        #undef ALTER_TAG_DATA
-                }
-                
-                if(changed) {
-                    REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING_PEDANTIC, tag_index, "%s.%s was changed due to being altered in singleplayer", Invader::File::halo_path_to_preferred_path(tag.get_path()).c_str(), tag_extension);
+            for(auto &d : result.dependencies) {
+                auto dependency_index = map->find_tag(d.first.c_str(), d.second);
+                if(dependency_index.has_value() && extracted_tags[*dependency_index] == false) {
+                    all_tags_to_extract.push_back(*dependency_index);
                 }
             }
 
             // Create directories along the way
             try {
-                if(!std::filesystem::exists(tag_path_to_write_to.parent_path())) {
-                    std::filesystem::create_directories(tag_path_to_write_to.parent_path());
+                if(!std::filesystem::exists(result.path.parent_path())) {
+                    std::filesystem::create_directories(result.path.parent_path());
                 }
             }
             catch(std::exception &e) {
@@ -181,8 +226,8 @@ namespace Invader {
             }
 
             // Save it
-            auto tag_path_str = tag_path_to_write_to.string();
-            if(!Invader::File::save_file(tag_path_str.c_str(), new_tag)) {
+            auto tag_path_str = result.path.string();
+            if(!Invader::File::save_file(tag_path_str.c_str(), *result.data)) {
                 REPORT_ERROR_PRINTF(workload, ERROR_TYPE_ERROR, tag_index, "Failed to save %s", tag_path_str.c_str());
                 return false;
             }
@@ -229,17 +274,45 @@ namespace Invader {
             }
         }
 
+        // Tags are extracted on worker threads and then finished here in the order they were started. Only a limited
+        // number of tags can be in flight at once so finished tags don't pile up in memory waiting to be written.
+        ThreadPool thread_pool(jobs);
+        std::deque<std::pair<std::size_t, std::future<ExtractedTag>>> in_flight;
+        std::size_t max_in_flight = jobs > 1 ? jobs * 2 : 1;
+
         // Extract tags
         std::size_t total = 0;
         std::size_t extracted = 0;
-        while(all_tags_to_extract.size() > 0) {
-            std::size_t tag = all_tags_to_extract[0];
-            all_tags_to_extract.erase(all_tags_to_extract.begin());
-            if(extracted_tags[tag]) {
-                continue;
+        while(all_tags_to_extract.size() > 0 || in_flight.size() > 0) {
+            // Start on as many tags as we can
+            while(all_tags_to_extract.size() > 0 && in_flight.size() < max_in_flight) {
+                std::size_t tag = all_tags_to_extract[0];
+                all_tags_to_extract.erase(all_tags_to_extract.begin());
+                if(extracted_tags[tag]) {
+                    continue;
+                }
+                extracted_tags[tag] = true;
+                in_flight.emplace_back(tag, thread_pool.submit([this, tag, recursive, overwrite, non_mp_globals]() {
+                    return this->prepare_tag(tag, recursive, overwrite, non_mp_globals);
+                }));
             }
+            if(in_flight.size() == 0) {
+                break;
+            }
+
+            // Wait for the oldest tag to be done
+            auto [tag, future] = std::move(in_flight.front());
+            in_flight.pop_front();
+            ExtractedTag result;
+            try {
+                result = future.get();
+            }
+            catch(std::exception &e) {
+                REPORT_ERROR_PRINTF(result, ERROR_TYPE_ERROR, tag, "Failed to extract: %s", e.what());
+            }
+
             const auto &tag_map = map->get_tag(tag);
-            if(extract_tag(tag)) {
+            if(finish_tag(tag, result)) {
                 oprintf_success("Extracted %s.%s", Invader::File::halo_path_to_preferred_path(tag_map.get_path()).c_str(), HEK::tag_class_to_extension(tag_map.get_tag_class_int()));
                 extracted++;
             }
@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstring>
+#include <vector>
+
+#include <invader/error.hpp>
+#include <invader/file/file.hpp>
+#include <invader/printf.hpp>
+#include <invader/version.hpp>
+#include <invader/file/batch_cache.hpp>
+#include <invader/file/serializer.hpp>
+#include "../crc/crc32.h"
+
+namespace Invader::File {
+    /** Bump this whenever the format of the cache changes */
+    static constexpr std::uint32_t BATCH_CACHE_VERSION = 1;
+
+    /** Magic at the start of the cache */
+    static constexpr char BATCH_CACHE_MAGIC[8] = { 'i', 'n', 'v', 'b', 't', 'c', 'c', 'h' };
+
+    std::optional<BatchCache::CachedFile> BatchCache::read_file_info(const std::filesystem::path &path) {
+        CachedFile file;
+        file.path = path.string();
+        try {
+            file.modified_time = static_cast<std::int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+            file.file_size = static_cast<std::uint64_t>(std::filesystem::file_size(path));
+        }
+        catch(std::exception &) {
+            return std::nullopt;
+        }
+
+        auto data = open_file(file.path.c_str());
+        if(!data.has_value()) {
+            return std::nullopt;
+        }
+        file.crc32 = crc32(0, data->data(), data->size());
+        return file;
+    }
+
+    bool BatchCache::file_is_unchanged(const CachedFile &cached, const std::filesystem::path &path) {
+        if(cached.path != path.string()) {
+            return false;
+        }
+
+        std::int64_t modified_time;
+        std::uint64_t file_size;
+        try {
+            modified_time = static_cast<std::int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+            file_size = static_cast<std::uint64_t>(std::filesystem::file_size(path));
+        }
+        catch(std::exception &) {
+            return false;
+        }
+
+        if(file_size != cached.file_size) {
+            return false;
+        }
+        if(modified_time == cached.modified_time) {
+            return true;
+        }
+
+        // The modification time may have changed without the contents changing (e.g. if it was copied)
+        auto current = read_file_info(path);
+        return current.has_value() && current->crc32 == cached.crc32;
+    }
+
+    bool BatchCache::is_unchanged(const std::string &tag, const std::vector<std::filesystem::path> &source_paths, const std::filesystem::path &tag_path, const std::string &settings) const {
+        CachedTag cached;
+        {
+            std::scoped_lock<std::mutex> lock(this->mutex);
+            auto cached_tag = this->tags.find(tag);
+            if(cached_tag == this->tags.end()) {
+                return false;
+            }
+            cached = cached_tag->second;
+        }
+
+        if(cached.settings != settings || cached.sources.size() != source_paths.size() || !file_is_unchanged(cached.tag, tag_path)) {
+            return false;
+        }
+        for(std::size_t s = 0; s < source_paths.size(); s++) {
+            if(!file_is_unchanged(cached.sources[s], source_paths[s])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void BatchCache::update(const std::string &tag, const std::vector<std::filesystem::path> &source_paths, const std::filesystem::path &tag_path, const std::string &settings) {
+        CachedTag cached;
+        cached.settings = settings;
+
+        // If we can't read any of them, forget the tag so it gets made again next time
+        bool readable = true;
+        auto tag_file = read_file_info(tag_path);
+        if(tag_file.has_value()) {
+            cached.tag = std::move(*tag_file);
+            for(auto &source_path : source_paths) {
+                auto source = read_file_info(source_path);
+                if(!source.has_value()) {
+                    readable = false;
+                    break;
+                }
+                cached.sources.emplace_back(std::move(*source));
+            }
+        }
+        else {
+            readable = false;
+        }
+
+        std::scoped_lock<std::mutex> lock(this->mutex);
+        if(readable) {
+            this->tags[tag] = std::move(cached);
+        }
+        else {
+            this->tags.erase(tag);
+        }
+    }
+
+    bool BatchCache::save(const std::filesystem::path &cache_path) const {
+        BinaryWriter writer;
+        writer.write_raw(BATCH_CACHE_MAGIC, sizeof(BATCH_CACHE_MAGIC));
+        writer.write_int(BATCH_CACHE_VERSION);
+        writer.write_string(full_version());
+
+        std::scoped_lock<std::mutex> lock(this->mutex);
+        writer.write_int(this->tags.size());
+        for(auto &t : this->tags) {
+            writer.write_string(t.first);
+            writer.write_int(t.second.sources.size());
+            auto write_file = [&writer](const CachedFile &file) {
+                writer.write_string(file.path);
+                writer.write_int(static_cast<std::uint64_t>(file.modified_time));
+                writer.write_int(file.file_size);
+                writer.write_int(file.crc32);
+            };
+            for(auto &source : t.second.sources) {
+                write_file(source);
+            }
+            write_file(t.second.tag);
+            writer.write_string(t.second.settings);
+        }
+
+        // Write to a temporary file first so an interrupted save doesn't leave a broken cache
+        auto temp_path = cache_path;
+        temp_path += ".tmp";
+        std::error_code ec;
+        if(save_file(temp_path.string().c_str(), writer.data)) {
+            std::filesystem::rename(temp_path, cache_path, ec);
+            if(!ec) {
+                return true;
+            }
+            std::filesystem::remove(temp_path, ec);
+        }
+        eprintf_warn("Warning: Failed to save the batch cache to %s", cache_path.string().c_str());
+        return false;
+    }
+
+    BatchCache::BatchCache(const std::filesystem::path &cache_path) {
+        auto cache_data = open_file(cache_path.string().c_str());
+        if(!cache_data.has_value()) {
+            return;
+        }
+
+        // If it isn't a valid cache or it's from a different version, every tag will just be made again
+        if(cache_data->size() < sizeof(BATCH_CACHE_MAGIC) || std::memcmp(cache_data->data(), BATCH_CACHE_MAGIC, sizeof(BATCH_CACHE_MAGIC)) != 0) {
+            return;
+        }
+
+        try {
+            BinaryReader reader(cache_data->data() + sizeof(BATCH_CACHE_MAGIC), cache_data->size() - sizeof(BATCH_CACHE_MAGIC));
+            if(reader.read_int() != BATCH_CACHE_VERSION || reader.read_string() != full_version()) {
+                return;
+            }
+            auto tag_count = reader.read_int();
+            for(std::uint64_t t = 0; t < tag_count; t++) {
+                auto tag_path = reader.read_string();
+                CachedTag tag;
+                auto read_file = [&reader]() {
+                    CachedFile file;
+                    file.path = reader.read_string();
+                    file.modified_time = static_cast<std::int64_t>(reader.read_int());
+                    file.file_size = reader.read_int();
+                    file.crc32 = static_cast<std::uint32_t>(reader.read_int());
+                    return file;
+                };
+                auto source_count = reader.read_int();
+                for(std::uint64_t s = 0; s < source_count; s++) {
+                    tag.sources.emplace_back(read_file());
+                }
+                tag.tag = read_file();
+                tag.settings = reader.read_string();
+                this->tags.emplace(std::move(tag_path), std::move(tag));
+            }
+            if(!reader.at_end()) {
+                throw OutOfBoundsException();
+            }
+        }
+        catch(std::exception &) {
+            eprintf_warn("Warning: %s is corrupt and will be regenerated", cache_path.string().c_str());
+            this->tags.clear();
+        }
+    }
+
+    std::optional<std::vector<std::string>> read_batch_list(const char *path) {
+        auto batch_list = open_file(path);
+        if(!batch_list.has_value()) {
+            return std::nullopt;
+        }
+
+        std::vector<std::string> tags;
+        std::string line;
+        for(std::size_t i = 0; i <= batch_list->size(); i++) {
+            char c = i == batch_list->size() ? '\n' : static_cast<char>((*batch_list)[i]);
+            if(c == '\n' || c == '\r') {
+                if(!line.empty()) {
+                    tags.emplace_back(std::move(line));
+                    line.clear();
+                }
+            }
+            else {
+                line += c;
+            }
+        }
+        return tags;
+    }
+
+    void record_batch_setting(std::string &settings, char opt, const std::vector<const char *> &arguments, const char *ignored_opts) {
+        if(std::strchr(ignored_opts, opt)) {
+            return;
+        }
+        settings += opt;
+        for(auto *argument : arguments) {
+            settings += ' ';
+            settings += argument;
+        }
+        settings += '\n';
+    }
+
+    void print_batch_summary(const char *tag_type, std::size_t made, std::size_t total, std::optional<std::size_t> unchanged) {
+        oprintf("Made %zu out of %zu %s tag%s", made, total, tag_type, total == 1 ? "" : "s");
+        if(unchanged.has_value()) {
+            oprintf(" (%zu unchanged)", *unchanged);
+        }
+        oprintf("\n");
+    }
+}
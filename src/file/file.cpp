@@ -2,6 +2,11 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #include <invader/file/file.hpp>
@@ -67,6 +72,93 @@ namespace Invader::File {
         return file_data;
     }
 
+    std::optional<MemoryMappedFile> map_file(const char *path) {
+        MemoryMappedFile mapped_file;
+
+        #ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file == INVALID_HANDLE_VALUE) {
+            return std::nullopt;
+        }
+
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(file, &size) || static_cast<std::uint64_t>(size.QuadPart) > SIZE_MAX) {
+            CloseHandle(file);
+            return std::nullopt;
+        }
+        mapped_file.file_size = static_cast<std::size_t>(size.QuadPart);
+
+        // Empty files can't be mapped, but there's nothing to map anyway
+        if(mapped_file.file_size > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+            if(!mapping) {
+                CloseHandle(file);
+                return std::nullopt;
+            }
+            mapped_file.file_data = reinterpret_cast<std::byte *>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        #else
+        int file = open(path, O_RDONLY);
+        if(file == -1) {
+            return std::nullopt;
+        }
+
+        struct stat file_stat;
+        if(fstat(file, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+            close(file);
+            return std::nullopt;
+        }
+        mapped_file.file_size = static_cast<std::size_t>(file_stat.st_size);
+
+        // Empty files can't be mapped, but there's nothing to map anyway
+        if(mapped_file.file_size > 0) {
+            void *mapping = mmap(nullptr, mapped_file.file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+            mapped_file.file_data = mapping == MAP_FAILED ? nullptr : reinterpret_cast<std::byte *>(mapping);
+        }
+        close(file);
+        #endif
+
+        if(mapped_file.file_size > 0 && !mapped_file.file_data) {
+            return std::nullopt;
+        }
+
+        return mapped_file;
+    }
+
+    MemoryMappedFile::MemoryMappedFile(MemoryMappedFile &&move) noexcept : file_data(move.file_data), file_size(move.file_size) {
+        move.file_data = nullptr;
+        move.file_size = 0;
+    }
+
+    MemoryMappedFile &MemoryMappedFile::operator=(MemoryMappedFile &&move) noexcept {
+        if(this != &move) {
+            this->unmap();
+            this->file_data = move.file_data;
+            this->file_size = move.file_size;
+            move.file_data = nullptr;
+            move.file_size = 0;
+        }
+        return *this;
+    }
+
+    MemoryMappedFile::~MemoryMappedFile() {
+        this->unmap();
+    }
+
+    void MemoryMappedFile::unmap() noexcept {
+        if(this->file_data) {
+            #ifdef _WIN32
+            UnmapViewOfFile(this->file_data);
+            #else
+            munmap(this->file_data, this->file_size);
+            #endif
+            this->file_data = nullptr;
+        }
+        this->file_size = 0;
+    }
+
     bool save_file(const char *path, const std::vector<std::byte> &data) {
         // Open the file
         std::FILE *f = std::fopen(path, "wb");
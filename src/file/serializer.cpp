@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/file/serializer.hpp>
+#include <invader/error.hpp>
+
+namespace Invader::File {
+    void BinaryWriter::write_int(std::uint64_t value) {
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            this->data.emplace_back(static_cast<std::byte>(value >> (i * 8)));
+        }
+    }
+
+    void BinaryWriter::write_raw(const void *bytes, std::size_t size) {
+        this->data.insert(this->data.end(), reinterpret_cast<const std::byte *>(bytes), reinterpret_cast<const std::byte *>(bytes) + size);
+    }
+
+    void BinaryWriter::write_bytes(const void *bytes, std::size_t size) {
+        this->write_int(size);
+        this->write_raw(bytes, size);
+    }
+
+    void BinaryWriter::write_string(const std::string &string) {
+        this->write_bytes(string.data(), string.size());
+    }
+
+    std::uint64_t BinaryReader::read_int() {
+        auto *bytes = this->read_raw(sizeof(std::uint64_t));
+        std::uint64_t value = 0;
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            value |= static_cast<std::uint64_t>(bytes[i]) << (i * 8);
+        }
+        return value;
+    }
+
+    const std::byte *BinaryReader::read_raw(std::size_t size) {
+        if(size > this->size - this->offset) {
+            throw OutOfBoundsException();
+        }
+        auto *bytes = this->data + this->offset;
+        this->offset += size;
+        return bytes;
+    }
+
+    const std::byte *BinaryReader::read_bytes(std::size_t &size) {
+        size = this->read_int();
+        return this->read_raw(size);
+    }
+
+    std::string BinaryReader::read_string() {
+        std::size_t size;
+        auto *bytes = reinterpret_cast<const char *>(this->read_bytes(size));
+        return std::string(bytes, size);
+    }
+}
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <filesystem>
 #include <optional>
 #include <invader/map/map.hpp>
 #include <invader/file/file.hpp>
@@ -21,7 +22,6 @@ struct DisplayValue {
 
 #define MAKE_DISPLAY_VALUE(name) {# name, Invader::Info::name }
 
-static std::byte header_cache[sizeof(Invader::HEK::NativeCacheFileHeader)];
 static std::size_t file_size = 0;
 
 // Calculating compression ratio:
@@ -52,7 +52,7 @@ namespace Invader::Info {
         PRINT_LINE(oprintf, "Engine:", "%s\n", engine_name(engine));
         
         if(engine == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-            PRINT_LINE(oprintf, "Timestamp:", "%s\n", reinterpret_cast<Invader::HEK::NativeCacheFileHeader *>(header_cache)->timestamp.string);
+            PRINT_LINE(oprintf, "Timestamp:", "%s\n", reinterpret_cast<const Invader::HEK::NativeCacheFileHeader *>(map.get_data())->timestamp.string);
         }
         
         PRINT_LINE(oprintf, "Map type:", "%s\n", type_name(map.get_type()));
@@ -281,12 +281,8 @@ int main(int argc, const char **argv) {
     // Load it
     std::unique_ptr<Map> map;
     try {
-        auto file = File::open_file(remaining_arguments[0]).value();
-        file_size = file.size();
-        if(file_size >= sizeof(header_cache)) {
-            std::memcpy(header_cache, file.data(), sizeof(header_cache));
-        }
-        map = std::make_unique<Map>(Map::map_with_move(std::move(file)));
+        map = std::make_unique<Map>(Map::map_with_mmap(remaining_arguments[0]));
+        file_size = std::filesystem::file_size(remaining_arguments[0]);
     }
     catch (std::exception &e) {
         eprintf_error("Failed to parse %s: %s", remaining_arguments[0], e.what());
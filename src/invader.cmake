@@ -18,6 +18,7 @@ set(INVADER_PARSER_FILES
     "${CMAKE_CURRENT_BINARY_DIR}/parser-compare.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/parser-normalize.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/parser-read-hek-file.cpp"
+    "${CMAKE_CURRENT_BINARY_DIR}/parser-scan-hek-dependencies.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/bitfield.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/enum.cpp"
 )
@@ -33,6 +34,7 @@ if(${INVADER_USE_AUDIO})
         src/sound/sound_reader_16_bit_pcm_big_endian.cpp
         src/sound/sound_reader_flac.cpp
         src/sound/sound_reader_ogg.cpp
+        src/sound/sound_reader_stream.cpp
         src/sound/sound_reader_wav.cpp
         src/sound/sound_reader_xbox_adpcm.cpp
         src/sound/adpcm_xq/adpcm-lib.c
@@ -64,6 +66,7 @@ set(INVADER_SOURCE_FILES
     "${CMAKE_CURRENT_BINARY_DIR}/parser-compare.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/parser-normalize.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/parser-read-hek-file.cpp"
+    "${CMAKE_CURRENT_BINARY_DIR}/parser-scan-hek-dependencies.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/bitfield.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/enum.cpp"
 
@@ -74,13 +77,21 @@ set(INVADER_SOURCE_FILES
     src/hek/map.cpp
     src/resource/resource_map.cpp
     src/dependency/found_tag_dependency.cpp
+    src/dependency/reverse_dependency_index.cpp
     src/map/map.cpp
     src/map/tag.cpp
     src/file/file.cpp
+    src/file/batch_cache.cpp
+    src/file/serializer.cpp
+    src/thread/thread_pool.cpp
     src/build/build_workload.cpp
-    src/bitmap/s3tc/s3tc.cpp
+    src/build/build_tag_cache.cpp
+    src/build/build_dependencies.cpp
     src/bitmap/swizzle.cpp
     src/bitmap/bitmap_encode.cpp
+    src/bitmap/dxt_decode.cpp
+    src/bitmap/dxt_encode.cpp
+    src/bitmap/p8_palettize.cpp
     src/error_handler/error_handler.cpp
     src/script/compiler.cpp
     src/script/script_tree.cpp
@@ -126,7 +137,7 @@ set(INVADER_SOURCE_FILES
     src/tag/parser/compile/sound.cpp
     src/tag/parser/compile/string_list.cpp
 
-    src/crc/crc32.c
+    src/crc/crc32.cpp
     src/crc/crc_spoof.c
     src/crc/hek/crc.cpp
 
@@ -245,6 +256,11 @@ endif()
 # Remove warnings from this
 set_source_files_properties(src/bitmap/stb/stb_impl.c PROPERTIES COMPILE_FLAGS -Wno-unused-function)
 
+# Keep DXT compression the same on every target by not fusing floating point multiplies and adds
+if(CMAKE_CXX_COMPILER_ID MATCHES "GNU" OR CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+    set_source_files_properties(src/bitmap/dxt_encode.cpp PROPERTIES COMPILE_FLAGS -ffp-contract=off)
+endif()
+
 # Include that
 include_directories(${CMAKE_CURRENT_BINARY_DIR} ${ZLIB_INCLUDE_DIRS})
 
@@ -80,6 +80,49 @@ namespace Invader {
         return map;
     }
 
+    Map Map::map_with_mmap(const char *path,
+                           const char *bitmaps_path,
+                           const char *loc_path,
+                           const char *sounds_path) {
+        Map map;
+
+        auto mapped_map = File::map_file(path);
+        if(!mapped_map.has_value()) {
+            eprintf_error("Failed to map %s", path);
+            throw FailedToOpenFileException();
+        }
+
+        if(map.decompress_if_needed(mapped_map->data(), mapped_map->size())) {
+            map.data = map.data_m.data();
+            map.data_length = map.data_m.size();
+        }
+        else {
+            map.data = mapped_map->data();
+            map.data_length = mapped_map->size();
+            map.mappings.emplace_back(std::move(*mapped_map));
+        }
+
+        // Resource maps that can't be opened are treated as not being there
+        auto map_resource_file = [&map](const char *resource_path, std::byte *&resource_data, std::size_t &resource_data_length) {
+            if(!resource_path) {
+                return;
+            }
+            auto mapped_resource = File::map_file(resource_path);
+            if(!mapped_resource.has_value()) {
+                return;
+            }
+            resource_data = mapped_resource->data();
+            resource_data_length = mapped_resource->size();
+            map.mappings.emplace_back(std::move(*mapped_resource));
+        };
+        map_resource_file(bitmaps_path, map.bitmap_data, map.bitmap_data_length);
+        map_resource_file(loc_path, map.loc_data, map.loc_data_length);
+        map_resource_file(sounds_path, map.sound_data, map.sound_data_length);
+
+        map.load_map();
+        return map;
+    }
+
     bool Map::decompress_if_needed(const std::byte *data, std::size_t data_size) {
         using namespace Invader::HEK;
         const auto *potential_header = reinterpret_cast<const CacheFileHeader *>(data);
@@ -315,6 +358,8 @@ namespace Invader {
         const auto &header = *reinterpret_cast<const CacheFileTagDataHeader *>(this->get_tag_data_at_offset(0, sizeof(CacheFileTagDataHeader)));
         std::size_t tag_count = header.tag_count;
         this->tags.reserve(tag_count);
+        this->tag_indices_by_path.clear();
+        this->tag_indices_by_path.reserve(tag_count);
 
         // Determine our scenario tag
         this->scenario_tag_id = header.scenario_tag.read().index;
@@ -378,6 +423,15 @@ namespace Invader {
                     tag.path = "";
                 }
 
+                // Index it by path so it can be found without going through every tag, including as its parent classes (e.g. a biped as a unit or object)
+                auto &indices = map.tag_indices_by_path[tag.path];
+                indices.emplace_back(tag.tag_class_int, i);
+                for(TagClassInt parent_class : { tags[i].secondary_class.read(), tags[i].tertiary_class.read() }) {
+                    if(parent_class != TagClassInt::TAG_CLASS_NULL && parent_class != TagClassInt::TAG_CLASS_NONE && parent_class != tag.tag_class_int) {
+                        indices.emplace_back(parent_class, i);
+                    }
+                }
+
                 if(tag.tag_class_int == TagClassInt::TAG_CLASS_SCENARIO_STRUCTURE_BSP && map.engine != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
                     continue;
                 }
@@ -562,15 +616,20 @@ namespace Invader {
     }
 
     std::optional<std::size_t> Map::find_tag(const char *tag_path, TagClassInt tag_class_int) const noexcept {
-        for(auto &tag : tags) {
-            if(tag.get_tag_class_int() == tag_class_int && tag.get_path() == tag_path) {
-                return &tag - tags.data();
+        auto indices = this->tag_indices_by_path.find(tag_path);
+        if(indices == this->tag_indices_by_path.end()) {
+            return std::nullopt;
+        }
+        for(auto &index : indices->second) {
+            if(index.first == tag_class_int) {
+                return index.second;
             }
         }
         return std::nullopt;
     }
 
     Map::Map(Map &&move) {
+        this->mappings = std::move(move.mappings);
         this->data_m = std::move(move.data_m);
         this->data = move.data;
         this->data_length = move.data_length;
@@ -604,6 +663,7 @@ namespace Invader {
         }
 
         move.tags.clear();
+        move.tag_indices_by_path.clear();
 
         this->load_map();
         this->compressed = move.compressed;
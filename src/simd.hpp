@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__SIMD_HPP
+#define INVADER__SIMD_HPP
+
+// Every x86-64 CPU has SSE2, so it's used whenever the compiler targets it. AVX2 is only used if it's enabled when compiling.
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define INVADER_SSE2
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define INVADER_AVX2
+#endif
+
+#endif
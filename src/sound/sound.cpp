@@ -2,16 +2,23 @@
 
 #include <filesystem>
 #include <invader/command_line_option.hpp>
+#include <invader/error.hpp>
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/batch_cache.hpp>
+#include <invader/thread/thread_pool.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/sound/sound_encoder.hpp>
 #include <invader/sound/sound_reader.hpp>
 #include <invader/version.hpp>
 #include <vorbis/vorbisenc.h>
 #include <samplerate.h>
-#include <atomic>
-#include <thread>
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <memory>
+#include <set>
+#include <tuple>
 
 using namespace Invader;
 using namespace Invader::HEK;
@@ -29,13 +36,82 @@ struct SoundOptions {
     std::optional<std::uint32_t> sample_rate;
     std::optional<std::uint16_t> bitrate;
     std::size_t max_threads = 1;
+    SoundEncoder::XboxADPCMQuality adpcm_quality = SoundEncoder::XboxADPCMQuality::XBOX_ADPCM_QUALITY_NORMAL;
+
+    /** Make every sound tag in the tags directory that has a data directory */
+    bool all = false;
+
+    /** File listing tag paths to make */
+    std::optional<const char *> batch;
+
+    /** File to cache the source files and settings of each tag in */
+    std::optional<const char *> batch_cache;
+
+    /** Options that affect the tag, used for checking if a tag needs to be made again */
+    std::string settings;
+
+    /** Show the sounds being loaded and encoded */
+    bool verbose = true;
+};
+
+/** Maximum size of the PCM data of each permutation when splitting */
+static constexpr std::size_t SPLIT_BUFFER_SIZE = 0x38E00;
+
+/** Number of frames to read from a source file at a time */
+static constexpr std::size_t READ_CHUNK_FRAMES = 0x4000;
+
+/** Sound file found in the data directory */
+struct SourcePermutation {
+    /** Permutation name */
+    std::string name;
+
+    /** Path to the file */
+    std::string path;
+
+    /** Sample rate of the file */
+    std::uint32_t sample_rate;
+
+    /** Channel count of the file */
+    std::uint16_t channel_count;
+
+    /** Number of bits per sample of the PCM data read from the file */
+    std::uint32_t bits_per_sample;
+
+    /** Number of bits per sample of the file itself */
+    std::uint32_t input_bits_per_sample;
+
+    /** Index of the source FLAC to encode the file into, if it isn't already a FLAC file */
+    std::optional<std::size_t> source_flac_index;
+};
+
+/** Encoded data for one permutation in the tag */
+struct EncodedPermutation {
+    std::vector<std::byte> samples;
+    std::size_t buffer_size = 0;
+};
+
+/** Result of encoding a source file */
+struct EncodedSound {
+    /** Encoded permutations (more than one if split) */
+    std::vector<EncodedPermutation> permutations;
+
+    /** Source FLAC, if one was requested */
+    std::vector<std::byte> source_flac;
+
+    /** Mouth data, if this is dialogue */
+    std::vector<std::byte> mouth_data;
+
+    /** Size of the PCM data that was encoded, after resampling */
+    std::size_t pcm_size = 0;
+
+    /** Bits per sample of the PCM data that was encoded */
+    std::uint32_t bits_per_sample = 0;
 };
 
-static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count, std::size_t pitch_range_index, Parser::InvaderSound *invader_sound);
-static void process_permutation_thread(SoundReader::Sound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, std::atomic<std::size_t> *thread_count, bool fit_adpcm_block_size);
+static void populate_pitch_range(std::vector<SourcePermutation> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count, std::size_t pitch_range_index, Parser::InvaderSound *invader_sound);
+static EncodedSound encode_permutation(const SourcePermutation *permutation, std::uint32_t sample_rate, std::uint16_t channel_count, SoundFormat format, bool split, bool fit_adpcm_block_size, bool is_dialogue, const SoundOptions *sound_options, ThreadPool *adpcm_thread_pool);
 
 template<typename T> static std::vector<std::byte> make_sound_tag(const std::filesystem::path &tag_path, const std::filesystem::path &data_path, SoundOptions &sound_options) {
-    static constexpr std::size_t SPLIT_BUFFER_SIZE = 0x38E00;
     static constexpr std::size_t MAX_PERMUTATIONS = UINT16_MAX - 1;
 
     // Parse the sound tag
@@ -45,7 +121,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     if(std::filesystem::exists(tag_path)) {
         if(std::filesystem::is_directory(tag_path)) {
             eprintf_error("A directory exists at %s where a file was expected", tag_path.string().c_str());
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
         auto sound_file = File::open_file(tag_path.string().c_str());
         if(sound_file.has_value()) {
@@ -55,7 +131,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
             }
             catch(std::exception &e) {
                 eprintf_error("An error occurred while attempting to read %s", tag_path.string().c_str());
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
         }
         if(sound_options.sound_class.has_value()) {
@@ -64,6 +140,11 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
         else {
             sound_options.sound_class = sound_tag.sound_class;
         }
+
+        // Keep the format of an existing sound tag if one wasn't given (invader_sound tags keep theirs below)
+        if(!invader_sound && !sound_options.format.has_value()) {
+            sound_options.format = sound_tag.format;
+        }
     }
     else {
         sound_tag.format = SoundFormat::SOUND_FORMAT_16_BIT_PCM;
@@ -76,7 +157,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
 
         if(!sound_options.sound_class.has_value()) {
             eprintf_error("A sound class is required when generating new sound tags");
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
         sound_tag.sound_class = *sound_options.sound_class;
     }
@@ -194,15 +275,15 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
         case SoundFormat::SOUND_FORMAT_FLAC:
             if(!invader_sound) {
                 eprintf_error("FLAC cannot be used without --extended");
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
             break;
         case SoundFormat::SOUND_FORMAT_IMA_ADPCM:
             eprintf_error("IMA ADPCM is unsupported");
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         default:
             eprintf_error("Unsupported audio codec");
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
     }
 
     auto &format = sound_tag.format;
@@ -215,7 +296,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     // Error if bullshit compression levels were given
     if(sound_options.compression_level > 1.0F || sound_options.compression_level < 0.0F) {
         eprintf_error("Compression level (%.05f) is outside of the allowed range of 0.0 to 1.0", *sound_options.compression_level);
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
 
     // Clear the old one
@@ -254,23 +335,25 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     // Is it bullshit?
     if(contains_files && contains_directories) {
         eprintf_error("Data directory must have only directories or only files");
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
     if(!contains_files && !contains_directories) {
         eprintf_error("Data directory is empty");
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
 
     std::uint16_t highest_channel_count = 0;
     std::uint32_t highest_sample_rate = 0;
-    std::vector<std::pair<std::vector<SoundReader::Sound>, std::string>> pitch_ranges;
+    std::vector<std::pair<std::vector<SourcePermutation>, std::string>> pitch_ranges;
 
-    oprintf("Loading sounds... ");
-    oflush();
+    if(sound_options.verbose) {
+        oprintf("Loading sounds... ");
+        oflush();
+    }
     
     // Load the sounds
     if(contains_files) {
-        auto &pitch_range = pitch_ranges.emplace_back(std::vector<SoundReader::Sound>(), "default");
+        auto &pitch_range = pitch_ranges.emplace_back(std::vector<SourcePermutation>(), "default");
         populate_pitch_range(pitch_range.first, data_path, highest_sample_rate, highest_channel_count, 0, invader_sound);
     }
     else if(contains_directories) {
@@ -279,24 +362,26 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
             auto &path = f.path();
             if(!f.is_directory()) {
                 eprintf_error("Unexpected file %s", path.string().c_str());
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
-            auto &pitch_range = pitch_ranges.emplace_back(std::vector<SoundReader::Sound>(), path.filename().string());
+            auto &pitch_range = pitch_ranges.emplace_back(std::vector<SourcePermutation>(), path.filename().string());
             populate_pitch_range(pitch_range.first, path, highest_sample_rate, highest_channel_count, i++, invader_sound);
             if(i == NULL_INDEX) {
                 eprintf_error("%u or more pitch ranges are present", NULL_INDEX);
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
 
             // Make sure we have stuff
             if(pitch_range.first.size() == 0) {
                 eprintf_error("No permutations found in %s", path.string().c_str());
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
         }
     }
 
-    oprintf("done!\n");
+    if(sound_options.verbose) {
+        oprintf("done!\n");
+    }
 
     // Force channel count
     if(sound_options.channel_count.has_value()) {
@@ -325,7 +410,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     }
     else {
         eprintf_error("Unsupported sample rate %u", highest_sample_rate);
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
 
     // Sound tags currently only support single and dual channels
@@ -337,44 +422,14 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     }
     else {
         eprintf_error("Unsupported channel count %u", highest_channel_count);
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
 
-    // Resample permutations when needed
-    oprintf("Processing sounds... ");
-    oflush();
     std::size_t total_sound_count = 0;
-    std::atomic<std::size_t> thread_count;
-    
-    // Wait until we have 0 threads working
-    auto wait_until_threads_are_done = [&thread_count]() {
-        while(thread_count > 0) {
-            std::this_thread::sleep_for(std::chrono::microseconds(1000));
-        }
-    };
-    
-    // Wait until we have room for more threads
-    auto wait_until_threads_are_open = [&thread_count, &sound_options]() {
-        while(thread_count >= sound_options.max_threads) {
-            std::this_thread::sleep_for(std::chrono::microseconds(1000));
-        }
-    };
-    
-    // Process things!
     for(auto &pitch_range : pitch_ranges) {
-        for(auto &permutation : pitch_range.first) {
-            total_sound_count++;
-            wait_until_threads_are_open();
-            thread_count++;
-            std::thread(process_permutation_thread, &permutation, highest_sample_rate, format, highest_channel_count, &thread_count, sound_tag.flags & SoundFlagsFlag::SOUND_FLAGS_FLAG_FIT_TO_ADPCM_BLOCKSIZE).detach();
-        }
+        total_sound_count += pitch_range.first.size();
     }
     
-    // Wait until done
-    wait_until_threads_are_done();
-    
-    oprintf("done!\n");
-    
     // Remove pitch ranges that are present in the tag but not in what we found
     while(true) {
         bool should_continue = false;
@@ -449,7 +504,9 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
             eprintf_error("Invalid format output name. What?");
             std::terminate();
     }
-    oprintf("Found %zu sound%s:\n", total_sound_count, total_sound_count == 1 ? "" : "s");
+    if(sound_options.verbose) {
+        oprintf("Found %zu sound%s:\n", total_sound_count, total_sound_count == 1 ? "" : "s");
+    }
 
     // Check if this is dialogue
     bool is_dialogue;
@@ -466,24 +523,33 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
 
     if(is_dialogue && split) {
         eprintf_error("Split dialogue is unsupported.");
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
     
-    // Make sure we don't completely blow things up
-    std::mutex encoding_mutex;
-    
-    // Block size
-    std::size_t adpcm_block_size = SoundEncoder::calculate_adpcm_pcm_block_size(highest_channel_count);
+    // Stream each permutation through resampling and encoding, remembering which pitch range and permutation each result goes in
+    bool fit_adpcm_block_size = sound_tag.flags & SoundFlagsFlag::SOUND_FLAGS_FLAG_FIT_TO_ADPCM_BLOCKSIZE;
 
-    // Encode this
+    // Permutations get a thread each first, and Xbox ADPCM segments get whatever is left, so -j is never exceeded. A
+    // pool with one thread runs its tasks on the calling thread, so a single permutation runs here and leaves every
+    // thread to ADPCM, and a single leftover thread is not worth a pool.
+    std::size_t total_permutation_count = 0;
+    for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
+        total_permutation_count += pitch_ranges[pr].first.size();
+    }
+    std::size_t permutation_thread_count = std::min(sound_options.max_threads, total_permutation_count);
+    if(permutation_thread_count == 1) {
+        permutation_thread_count = 0;
+    }
+    std::size_t adpcm_thread_count = format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM ? sound_options.max_threads - permutation_thread_count : 0;
+    ThreadPool thread_pool(permutation_thread_count);
+    ThreadPool adpcm_thread_pool(adpcm_thread_count < 2 ? 0 : adpcm_thread_count);
+    std::vector<std::tuple<std::size_t, std::size_t, const SourcePermutation *, std::future<EncodedSound>>> encoded_sounds;
     for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
-        encoding_mutex.lock();
         auto &pitch_range = sound_tag.pitch_ranges[pitch_range_index[pr]];
         auto &permutations = pitch_ranges[pr].first;
         auto actual_permutation_count = permutations.size();
         pitch_range.actual_permutation_count = actual_permutation_count;
         pitch_range.permutations.resize(actual_permutation_count);
-        encoding_mutex.unlock();
         
         for(auto &p : pitch_range.permutations) {
             p.format = sound_tag.format;
@@ -491,245 +557,159 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
         
         for(std::size_t i = 0; i < actual_permutation_count; i++) {
             // Get the permutation and set its name, too
-            auto &permutation = permutations[i];
-            std::strncpy(pitch_range.permutations[i].name.string, permutation.name.c_str(), sizeof(pitch_range.permutations[i].name.string) - 1);
-
-            // Calculate length
-            double seconds = permutation.pcm.size() / static_cast<double>(static_cast<std::size_t>(permutation.sample_rate) * static_cast<std::size_t>(permutation.bits_per_sample / 8) * static_cast<std::size_t>(permutation.channel_count));
-            std::size_t bytes_per_sample_one_channel = permutation.bits_per_sample / 8;
-            std::size_t bytes_per_sample_all_channels = bytes_per_sample_one_channel * permutation.channel_count;
-
-            // Encode a permutation
-            auto encode_permutation = [](auto *sound_tag, std::size_t pitch_range, std::size_t pitch_range_permutation, std::mutex *mutex, std::vector<std::byte> pcm, const SoundReader::Sound *permutation, bool is_dialogue, SoundFormat format, SoundOptions *sound_options, std::atomic<std::size_t> *thread_count) {
-                auto generate_mouth_data = [&permutation](const std::vector<std::uint8_t> &pcm_8_bit) -> std::vector<std::byte> {
-                    // Basically, take the sample rate, multiply by channel count, divide by tick rate (30 Hz), and round the result
-                    std::size_t samples_per_tick = static_cast<std::size_t>((permutation->sample_rate * permutation->channel_count) / TICK_RATE + 0.5);
-                    std::size_t sample_count = pcm_8_bit.size();
-
-                    // Generate samples, adding an extra tick for incomplete ticks
-                    std::size_t tick_count = (sample_count + samples_per_tick - 1) / samples_per_tick;
-                    std::vector<std::byte> mouth_data = std::vector<std::byte>(tick_count);
-                    auto *pcm_data = pcm_8_bit.data();
-
-                    // Get max and total
-                    std::uint8_t max = 0;
-                    double mouth_total = 0;
-                    for(std::size_t t = 0; t < tick_count; t++) {
-                        // Get the sample range, accounting for when there aren't enough ticks
-                        std::size_t first_sample = t * samples_per_tick;
-                        std::size_t sample_count_to_check = sample_count - first_sample;
-                        if(sample_count_to_check > samples_per_tick) {
-                            sample_count_to_check = samples_per_tick;
-                        }
-                        std::size_t last_sample = first_sample + sample_count_to_check;
-                        double total = 0;
-                        for(std::size_t s = first_sample; s < last_sample; s++) {
-                            total += pcm_data[s];
-                        }
-
-                        // Divide by samples per tick
-                        double average = total / samples_per_tick;
-                        mouth_total += average;
-                        mouth_data[t] = static_cast<std::byte>(average);
-
-                        if(average > max) {
-                            max = average;
-                        }
-                    }
+            auto *permutation = &permutations[i];
+            std::strncpy(pitch_range.permutations[i].name.string, permutation->name.c_str(), sizeof(pitch_range.permutations[i].name.string) - 1);
 
-                    // Get average and min, clamping min to 0-255
-                    double average = mouth_total / tick_count;
-                    double min = 2.0 * average - max;
-                    if(min > UINT8_MAX) {
-                        min = UINT8_MAX;
-                    }
-                    else if(min < 0) {
-                        min = 0;
-                    }
+            // Punch it
+            encoded_sounds.emplace_back(pitch_range_index[pr], i, permutation, thread_pool.submit([permutation, highest_sample_rate, highest_channel_count, format, split, fit_adpcm_block_size, is_dialogue, &sound_options, &adpcm_thread_pool]() {
+                return encode_permutation(permutation, highest_sample_rate, highest_channel_count, format, split, fit_adpcm_block_size, is_dialogue, &sound_options, &adpcm_thread_pool);
+            }));
+        }
+    }
+    
+    // Wait for each permutation to finish, putting them in the tag in the same order every time
+    for(auto &[pr, i, permutation, encoded] : encoded_sounds) {
+        auto encoded_sound = encoded.get();
+        auto &permutations = sound_tag.pitch_ranges[pr].permutations;
+        std::size_t split_count = encoded_sound.permutations.size();
+        for(std::size_t s = 0; s < split_count; s++) {
+            // Basically, if this is the first one, use the i-th permutation, otherwise make a new one as a copy
+            auto &p = s == 0 ? permutations[i] : permutations.emplace_back(permutations[i]);
+            if(s + 1 == split_count) {
+                p.next_permutation_index = NULL_INDEX;
+            }
+            else {
+                std::size_t next_permutation = permutations.size();
+                if(next_permutation > MAX_PERMUTATIONS) {
+                    eprintf_error("Maximum number of total permutations (%zu > %zu) exceeded", next_permutation, MAX_PERMUTATIONS);
+                    throw InvalidInputSoundException();
+                }
+                p.next_permutation_index = static_cast<Index>(next_permutation);
+            }
+            p.gain = 1.0F;
+            p.samples = std::move(encoded_sound.permutations[s].samples);
+            p.buffer_size = encoded_sound.permutations[s].buffer_size;
 
-                    // Get range
-                    double range = static_cast<double>(max + average) / 2 - min;
+            // Dialogue can't be split, so only the first permutation can have mouth data
+            p.mouth_data = s == 0 ? std::move(encoded_sound.mouth_data) : std::vector<std::byte>();
+        }
 
-                    // Do nothing if there's no range
-                    if(range == 0) {
-                        return mouth_data;
-                    }
+        if(permutation->source_flac_index.has_value()) {
+            invader_sound->source_FLACs[*permutation->source_flac_index].compressed_audio_data = std::move(encoded_sound.source_flac);
+        }
 
-                    // Go through each sample
-                    for(std::size_t t = 0; t < tick_count; t++) {
-                        double sample = (static_cast<std::uint8_t>(mouth_data[t]) - min) / range;
-
-                        // Clamp to 0 - 255
-                        if(sample >= 1.0) {
-                            mouth_data[t] = static_cast<std::byte>(UINT8_MAX);
-                        }
-                        else if(sample <= 0.0) {
-                            mouth_data[t] = static_cast<std::byte>(0);
-                        }
-                        else {
-                            mouth_data[t] = static_cast<std::byte>(sample * UINT8_MAX);
-                        }
-                    }
-                    
-                    return mouth_data;
-                };
-
-                // Generate mouth data if needed
-                if(is_dialogue) {
-                    // Convert samples to 8-bit unsigned so we can use it to generate mouth data
-                    auto samples_float = SoundEncoder::convert_int_to_float(permutation->pcm, permutation->bits_per_sample);
-                    std::vector<std::uint8_t> pcm_8_bit;
-                    pcm_8_bit.reserve(samples_float.size());
-                    for(auto &f : samples_float) {
-                        float ff = f;
-                        if(ff < 0.0F) {
-                            ff *= -1.0F;
-                        }
-                        pcm_8_bit.emplace_back(static_cast<std::uint8_t>(ff * UINT8_MAX));
-                    }
-                    samples_float = {};
-                    generate_mouth_data(pcm_8_bit);
-                }
-                
-                // Do the encoding thing
-                std::vector<std::byte> samples;
-                std::size_t buffer_size = 0;
-
-                switch(format) {
-                    // Basically, just make it 16-bit big endian
-                    case SoundFormat::SOUND_FORMAT_16_BIT_PCM:
-                        samples = Invader::SoundEncoder::convert_to_16_bit_pcm_big_endian(pcm, permutation->bits_per_sample);
-                        buffer_size = samples.size();
-                        break;
-
-                    // Encode to Vorbis in an Ogg container
-                    case SoundFormat::SOUND_FORMAT_OGG_VORBIS: {
-                        if(sound_options->compression_level > 1.0F) {
-                            sound_options->compression_level = 1.0F;
-                        }
-                        else if(sound_options->compression_level < 0.0F) {
-                            sound_options->compression_level = 0.0F;
-                        }
-                        if(sound_options->bitrate.has_value()) {
-                            samples = Invader::SoundEncoder::encode_to_ogg_vorbis_cbr(pcm, permutation->bits_per_sample, permutation->channel_count, permutation->sample_rate, *sound_options->bitrate);
-                        }
-                        else {
-                            samples = Invader::SoundEncoder::encode_to_ogg_vorbis_vbr(pcm, permutation->bits_per_sample, permutation->channel_count, permutation->sample_rate, *sound_options->compression_level);
-                        }
-                        buffer_size = pcm.size() / (permutation->bits_per_sample / 8) * sizeof(std::int16_t);
-                        break;
-                    }
+        // Print sound info
+        if(sound_options.verbose) {
+            double seconds = encoded_sound.pcm_size / static_cast<double>(static_cast<std::size_t>(highest_sample_rate) * static_cast<std::size_t>(encoded_sound.bits_per_sample / 8) * static_cast<std::size_t>(highest_channel_count));
+            oprintf("    %-32s%2zu:%06.3f (%2zu-bit %6s %5zu Hz)\n", permutation->name.c_str(), static_cast<std::size_t>(seconds) / 60, std::fmod(seconds, 60.0), static_cast<std::size_t>(permutation->input_bits_per_sample), permutation->channel_count == 1 ? "mono" : "stereo", static_cast<std::size_t>(permutation->sample_rate));
+        }
+    }
 
-                    // Encode to FLAC
-                    case SoundFormat::SOUND_FORMAT_FLAC: {
-                        // Clamp to 0.0 - 0.8
-                        if(sound_options->compression_level > 0.8F) {
-                            sound_options->compression_level = 0.8F;
-                        }
-                        else if(sound_options->compression_level < 0.0F) {
-                            sound_options->compression_level = 0.0F;
-                        }
-                        // Convert to integer, rounding to the nearest level
-                        int flac_level = static_cast<int>(*sound_options->compression_level * 10.0F + 0.5F);
-                        samples = Invader::SoundEncoder::encode_to_flac(pcm, permutation->bits_per_sample, permutation->channel_count, permutation->sample_rate, flac_level);
-                        break;
-                    }
+    auto sound_tag_data = sound_tag.generate_hek_tag_data(invader_sound == nullptr ? TagClassInt::TAG_CLASS_SOUND : TagClassInt::TAG_CLASS_INVADER_SOUND, true);
+    if(sound_options.verbose) {
+        oprintf("Output: %s, %s, %zu Hz%s, %s, %.03f MiB%s\n", output_name, highest_channel_count == 1 ? "mono" : "stereo", static_cast<std::size_t>(highest_sample_rate), split ? ", split" : "", SoundClass_to_string(sound_class), sound_tag_data.size() / 1024.0 / 1024.0, invader_sound == nullptr ? "" : " [--extended]");
+    }
 
-                    // Encode to Xbox ADPCMeme
-                    case SoundFormat::SOUND_FORMAT_XBOX_ADPCM:
-                        samples = Invader::SoundEncoder::encode_to_xbox_adpcm(pcm, permutation->bits_per_sample, permutation->channel_count);
-                        break;
+    return sound_tag_data;
+}
 
-                    default:
-                        eprintf_error("Invalid format. What?");
-                        std::terminate();
-                }
-                
-                // Set the default stuff
-                mutex->lock();
-                auto &p = sound_tag->pitch_ranges[pitch_range].permutations[pitch_range_permutation];
-                p.gain = 1.0F;
-                p.samples = samples;
-                p.buffer_size = buffer_size;
-                p.samples.shrink_to_fit();
-                mutex->unlock();
-                
-                // Finish up
-                (*thread_count)--;
-            };
-
-            // Split if requested
-            if(split) {
-                std::size_t max_split_size = SPLIT_BUFFER_SIZE - (SPLIT_BUFFER_SIZE % bytes_per_sample_all_channels);
-                
-                // If ADPCM, also take block size into account
-                if(format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM) {
-                    max_split_size = max_split_size - (max_split_size % (bytes_per_sample_all_channels * adpcm_block_size));
-                }
-                
-                std::size_t digested = 0;
-                while(permutation.pcm.size() > 0) {
-                    // Basically, if we haven't encoded anything, use the i-th permutation, otherwise make a new one as a copy
-                    encoding_mutex.lock();
-                    auto &p = digested == 0 ? pitch_range.permutations[i] : pitch_range.permutations.emplace_back(pitch_range.permutations[i]);
-                    encoding_mutex.unlock();
-                    std::size_t remaining_size = permutation.pcm.size();
-                    std::size_t permutation_size = remaining_size > max_split_size ? max_split_size : remaining_size;
-
-                    // Encode it
-                    auto *sample_data_start = permutation.pcm.data();
-                    auto sample_data = std::vector<std::byte>(sample_data_start, sample_data_start + permutation_size);
-                    permutation.pcm = std::vector<std::byte>(permutation.pcm.begin() + permutation_size, permutation.pcm.end());
-                    permutation.pcm.shrink_to_fit();
-                    digested += permutation_size;
-
-                    if(permutation.pcm.size() == 0) {
-                        p.next_permutation_index = NULL_INDEX;
-                    }
-                    else {
-                        std::size_t next_permutation = pitch_range.permutations.size();
-                        if(next_permutation > MAX_PERMUTATIONS) {
-                            encoding_mutex.lock();
-                            eprintf_error("Maximum number of total permutations (%zu > %zu) exceeded", next_permutation, MAX_PERMUTATIONS);
-                            std::exit(EXIT_FAILURE);
-                        }
-                        p.next_permutation_index = static_cast<Index>(next_permutation);
-                    }
-                    
-                    // Wait until we have threads cleared up
-                    wait_until_threads_are_open();
-                    
-                    // Punch it
-                    thread_count++;
-                    std::thread(encode_permutation, &sound_tag, pr, &p - pitch_range.permutations.data(), &encoding_mutex, std::move(sample_data), &permutation, is_dialogue, format, &sound_options, &thread_count).detach();
+/**
+ * Find the paths of a sound tag, and then make and save it
+ * @param halo_tag_path tag path (or a filesystem path if using --fs-path)
+ * @param sound_options options to make the tag with
+ * @param cache         cache to skip the tag with if it is unchanged (and to update if it isn't), if any
+ * @param unchanged     set to true if the tag was skipped for being unchanged
+ * @return              EXIT_SUCCESS if successful
+ */
+static int make_and_save_sound_tag(std::string halo_tag_path, SoundOptions sound_options, File::BatchCache *cache, bool &unchanged) {
+    // Get our paths and make sure a data directory exists
+    if(sound_options.fs_path) {
+        std::vector<std::string> data;
+        data.emplace_back(std::string(sound_options.data));
+        try {
+            halo_tag_path = Invader::File::file_path_to_tag_path(halo_tag_path, data, false).value();
+        }
+        catch(std::exception &) {
+            eprintf_error("Cannot find %s in %s", halo_tag_path.c_str(), sound_options.data);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Remove trailing slashes
+    halo_tag_path = Invader::File::remove_trailing_slashes(halo_tag_path);
+    auto data_path = std::filesystem::path(sound_options.data) / halo_tag_path;
+    if(!std::filesystem::is_directory(data_path)) {
+        eprintf_error("No directory exists at %s", data_path.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Find it!
+    auto tag_path = std::filesystem::path(sound_options.tags) / (halo_tag_path + ".invader_sound");
+    if(std::filesystem::exists(tag_path)) {
+        sound_options.extended = true;
+    }
+    if(!sound_options.extended) {
+        tag_path = std::filesystem::path(sound_options.tags) / (halo_tag_path + ".sound");
+
+        // Make sure format was set if there isn't already a tag to get it from
+        if(!sound_options.format.has_value() && !std::filesystem::exists(tag_path)) {
+            eprintf_error("No sound format set (required for new .sound tags). Use -h for more information.");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Generate sound tag
+    std::vector<std::byte> sound_tag_data;
+    std::vector<std::filesystem::path> source_paths;
+    try {
+        // If the source files and settings haven't changed since the tag was last made, we don't need to make it again
+        if(cache) {
+            for(auto &f : std::filesystem::recursive_directory_iterator(data_path)) {
+                if(f.is_regular_file()) {
+                    source_paths.emplace_back(f.path());
                 }
             }
-            else {
-                // Wait until we have threads cleared up
-                wait_until_threads_are_open();
-                    
-                // Punch it
-                thread_count++;
-                auto &p = pitch_range.permutations[i];
-                p.next_permutation_index = NULL_INDEX;
-                std::thread(encode_permutation, &sound_tag, pr, &p - pitch_range.permutations.data(), &encoding_mutex, std::move(permutation.pcm), &permutation, is_dialogue, format, &sound_options, &thread_count).detach();
+            std::sort(source_paths.begin(), source_paths.end());
+            if(cache->is_unchanged(halo_tag_path, source_paths, tag_path, sound_options.settings)) {
+                unchanged = true;
+                return EXIT_SUCCESS;
             }
+        }
 
-            // Print sound info
-            encoding_mutex.lock();
-            oprintf("    %-32s%2zu:%06.3f (%2zu-bit %6s %5zu Hz)\n", permutation.name.c_str(), static_cast<std::size_t>(seconds) / 60, std::fmod(seconds, 60.0), static_cast<std::size_t>(permutation.input_bits_per_sample), permutation.input_channel_count == 1 ? "mono" : "stereo", static_cast<std::size_t>(permutation.input_sample_rate));
-            permutation.pcm = std::vector<std::byte>();
-            encoding_mutex.unlock();
+        if(!sound_options.extended) {
+            sound_tag_data = make_sound_tag<Parser::Sound>(tag_path, data_path, sound_options);
+        }
+        else {
+            sound_tag_data = make_sound_tag<Parser::InvaderSound>(tag_path, data_path, sound_options);
         }
     }
-    
-    // Wait until we have 0 threads left
-    wait_until_threads_are_done();
+    catch(std::exception &e) {
+        eprintf_error("Failed to create sound tag due to an exception error: %s", e.what());
+        return EXIT_FAILURE;
+    }
 
-    auto sound_tag_data = sound_tag.generate_hek_tag_data(invader_sound == nullptr ? TagClassInt::TAG_CLASS_SOUND : TagClassInt::TAG_CLASS_INVADER_SOUND, true);
-    oprintf("Output: %s, %s, %zu Hz%s, %s, %.03f MiB%s\n", output_name, highest_channel_count == 1 ? "mono" : "stereo", static_cast<std::size_t>(highest_sample_rate), split ? ", split" : "", SoundClass_to_string(sound_class), sound_tag_data.size() / 1024.0 / 1024.0, invader_sound == nullptr ? "" : " [--extended]");
+    // Create missing directories if needed
+    try {
+        if(!std::filesystem::exists(tag_path.parent_path())) {
+            std::filesystem::create_directories(tag_path.parent_path());
+        }
+    }
+    catch(std::exception &e) {
+        eprintf_error("Error: Failed to create a directory: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
 
-    return sound_tag_data;
+    // Save
+    if(!Invader::File::save_file(tag_path.string().c_str(), sound_tag_data)) {
+        eprintf_error("Failed to save %s", tag_path.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    if(cache) {
+        cache->update(halo_tag_path, source_paths, tag_path, sound_options.settings);
+    }
+
+    return EXIT_SUCCESS;
 }
 
 int main(int argc, const char **argv) {
@@ -744,19 +724,26 @@ int main(int argc, const char **argv) {
     options.emplace_back("split", 's', 0, "Split permutations into 227.5 KiB chunks. This is necessary for longer sounds (e.g. music) when being played in the original Halo engine.");
     options.emplace_back("no-split", 'S', 0, "Do not split permutations.");
     options.emplace_back("extended", 'x', 0, "Create an invader_sound tag (required for some features).");
-    options.emplace_back("format", 'F', 1, "Set the format. Can be: 16-bit-pcm, ogg-vorbis, or xbox-adpcm. Using flac requires --extended. Setting this is required unless creating an extended tag, in which case it defaults to 16-bit-pcm.", "<fmt>");
+    options.emplace_back("format", 'F', 1, "Set the format. Can be: 16-bit-pcm, ogg-vorbis, or xbox-adpcm. Using flac requires --extended. By default, the format of the existing tag is kept. Setting this is required when creating a new non-extended tag, and new extended tags default to 16-bit-pcm.", "<fmt>");
     options.emplace_back("fs-path", 'P', 0, "Use a filesystem path for the data.");
     options.emplace_back("channel-count", 'C', 1, "[REQUIRES --extended] Set the channel count. Can be: mono, stereo. By default, this is determined based on the input audio.", "<#>");
     options.emplace_back("sample-rate", 'r', 1, "[REQUIRES --extended] Set the sample rate in Hz. Halo supports 22050 and 44100. By default, this is determined based on the input audio.", "<Hz>");
     options.emplace_back("compress-level", 'l', 1, "Set the compression level. This can be between 0.0 and 1.0. For Ogg Vorbis, higher levels result in better quality but worse sizes. For FLAC, higher levels result in better sizes but longer compression time, clamping from 0.0 to 0.8 (FLAC 0 to FLAC 8). Default: 1.0", "<lvl>");
     options.emplace_back("bitrate", 'b', 1, "Set the bitrate in kilobits per second. This only applies to vorbis.", "<br>");
     options.emplace_back("class", 'c', 1, "Set the class. This is required when generating new sounds. Can be: ambient-computers, ambient-machinery, ambient-nature, device-computers, device-door, device-force-field, device-machinery, device-nature, first-person-damage, game-event, music, object-impacts, particle-impacts, projectile-impact, projectile-detonation, scripted-dialog-force-unspatialized, scripted-dialog-other, scripted-dialog-player, scripted-effect, slow-particle-impacts, unit-dialog, unit-footsteps, vehicle-collision, vehicle-engine, weapon-charge, weapon-empty, weapon-fire, weapon-idle, weapon-overheat, weapon-ready, weapon-reload", "<class>");
-    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for parallel resampling and encoding. Default: 1");
+    options.emplace_back("adpcm-quality", 'Q', 1, "Set the Xbox ADPCM encoding quality. Can be: fast, normal, or high. Fast is useful for previewing, while high is much slower. Default: normal", "<quality>");
+    options.emplace_back("threads", 'j', 1, "Set the number of threads to use for parallel resampling and encoding. If --all or --batch is used, this is the number of tags to make at once instead. Default: 1");
+    options.emplace_back("all", 'a', 0, "Make every sound tag in the tags directory that has a directory in the data directory. Each tag keeps its own format unless --format is set.");
+    options.emplace_back("batch", 'B', 1, "Make a sound tag for each tag path listed in a file (one per line).", "<file>");
+    options.emplace_back("batch-cache", 'k', 1, "Remember the source files and settings of each tag in a file, and skip tags that are unchanged since then.", "<file>");
 
     static constexpr char DESCRIPTION[] = "Create or modify a sound tag.";
-    static constexpr char USAGE[] = "[options] <sound-tag>";
+    static constexpr char USAGE[] = "[options] <-a | -B <file> | sound-tag>";
+
+    auto remaining_arguments = CommandLineOption::parse_arguments<SoundOptions &>(argc, argv, options, USAGE, DESCRIPTION, 0, 1, sound_options, [](char opt, const std::vector<const char *> &arguments, auto &sound_options) {
+        // Remember the options that can change the tag, leaving out directories, threads, and batch options
+        File::record_batch_setting(sound_options.settings, opt, arguments, "idtPjaBk");
 
-    auto remaining_arguments = CommandLineOption::parse_arguments<SoundOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, sound_options, [](char opt, const std::vector<const char *> &arguments, auto &sound_options) {
         switch(opt) {
             case 'd':
                 sound_options.data = arguments[0];
@@ -791,6 +778,22 @@ int main(int argc, const char **argv) {
                 sound_options.split = false;
                 break;
 
+            case 'Q':
+                if(std::strcmp(arguments[0], "fast") == 0) {
+                    sound_options.adpcm_quality = SoundEncoder::XboxADPCMQuality::XBOX_ADPCM_QUALITY_FAST;
+                }
+                else if(std::strcmp(arguments[0], "normal") == 0) {
+                    sound_options.adpcm_quality = SoundEncoder::XboxADPCMQuality::XBOX_ADPCM_QUALITY_NORMAL;
+                }
+                else if(std::strcmp(arguments[0], "high") == 0) {
+                    sound_options.adpcm_quality = SoundEncoder::XboxADPCMQuality::XBOX_ADPCM_QUALITY_HIGH;
+                }
+                else {
+                    eprintf_error("Unknown ADPCM quality %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+
             case 'b':
                 try {
                     sound_options.bitrate = static_cast<std::uint16_t>(std::stol(arguments[0]));
@@ -856,6 +859,18 @@ int main(int argc, const char **argv) {
                     std::exit(EXIT_FAILURE);
                 }
                 break;
+
+            case 'a':
+                sound_options.all = true;
+                break;
+
+            case 'B':
+                sound_options.batch = arguments[0];
+                break;
+
+            case 'k':
+                sound_options.batch_cache = arguments[0];
+                break;
         }
     });
     
@@ -864,79 +879,130 @@ int main(int argc, const char **argv) {
         return EXIT_FAILURE;
     }
 
-    // Get our paths and make sure a data directory exists
-    std::string halo_tag_path;
-    if(sound_options.fs_path) {
-        std::vector<std::string> data;
-        data.emplace_back(std::string(sound_options.data));
+    bool batch_mode = sound_options.all || sound_options.batch.has_value();
+    if(sound_options.all && sound_options.batch.has_value()) {
+        eprintf_error("--all and --batch cannot be used at the same time. Use -h for more information.");
+        return EXIT_FAILURE;
+    }
+    if(batch_mode && remaining_arguments.size() != 0) {
+        eprintf_error("--all or --batch and a tag path cannot be used at the same time. Use -h for more information.");
+        return EXIT_FAILURE;
+    }
+    if(!batch_mode && remaining_arguments.size() == 0) {
+        eprintf_error("Expected --all, --batch, or a tag path. Use -h for more information.");
+        return EXIT_FAILURE;
+    }
+
+    // Load the cache, if we're using one
+    std::optional<File::BatchCache> cache;
+    if(sound_options.batch_cache.has_value()) {
+        cache.emplace(*sound_options.batch_cache);
+    }
+    auto *cache_ptr = cache.has_value() ? &*cache : nullptr;
+    auto save_cache = [&cache, &sound_options]() {
+        if(cache.has_value()) {
+            cache->save(*sound_options.batch_cache);
+        }
+    };
+
+    // Just one tag?
+    if(!batch_mode) {
+        bool unchanged = false;
+        int result = make_and_save_sound_tag(remaining_arguments[0], sound_options, cache_ptr, unchanged);
+        if(unchanged) {
+            oprintf("%s is unchanged\n", remaining_arguments[0]);
+        }
+        save_cache();
+        return result;
+    }
+
+    // Find the tags to make
+    std::vector<std::string> sound_tags;
+    if(sound_options.all) {
+        // Sound tags without a data directory (e.g. extracted tags) can't be made again, so leave them alone
+        std::set<std::string> found_tags;
+        std::filesystem::path tags_path(sound_options.tags);
+        std::filesystem::path data_path(sound_options.data);
         try {
-            halo_tag_path = Invader::File::file_path_to_tag_path(remaining_arguments[0], data, false).value();
+            for(auto &i : std::filesystem::recursive_directory_iterator(tags_path)) {
+                auto extension = i.path().extension().string();
+                if(!i.is_regular_file() || (extension != ".sound" && extension != ".invader_sound")) {
+                    continue;
+                }
+                auto tag = i.path().lexically_relative(tags_path).replace_extension();
+                if(std::filesystem::is_directory(data_path / tag)) {
+                    found_tags.emplace(tag.string());
+                }
+            }
         }
-        catch(std::exception &) {
-            eprintf_error("Cannot find %s in %s", remaining_arguments[0], sound_options.data);
+        catch(std::exception &e) {
+            eprintf_error("Failed to read the tags directory %s: %s", sound_options.tags, e.what());
             return EXIT_FAILURE;
         }
+        sound_tags.assign(found_tags.begin(), found_tags.end());
+        sound_options.fs_path = false;
     }
     else {
-        halo_tag_path = remaining_arguments[0];
-    }
-
-    // Remove trailing slashes
-    halo_tag_path = Invader::File::remove_trailing_slashes(halo_tag_path);
-    auto data_path = std::filesystem::path(sound_options.data) / halo_tag_path;
-    if(!std::filesystem::is_directory(data_path)) {
-        eprintf_error("No directory exists at %s", data_path.string().c_str());
-        return EXIT_FAILURE;
+        auto batch_list = File::read_batch_list(*sound_options.batch);
+        if(!batch_list.has_value()) {
+            eprintf_error("Failed to open %s", *sound_options.batch);
+            return EXIT_FAILURE;
+        }
+        sound_tags = std::move(*batch_list);
     }
 
-    // Find it!
-    auto tag_path = std::filesystem::path(sound_options.tags) / (halo_tag_path + ".invader_sound");
-    if(std::filesystem::exists(tag_path)) {
-        sound_options.extended = true;
+    // Make each tag on its own thread rather than splitting up each tag, so one tag can be loading while another is encoding
+    ThreadPool thread_pool(std::min(sound_options.max_threads, sound_tags.size()));
+    sound_options.max_threads = 1;
+    sound_options.verbose = false;
+
+    // Each result is the exit code and whether or not it was skipped for being unchanged
+    std::vector<std::future<std::pair<int, bool>>> results;
+    results.reserve(sound_tags.size());
+    for(auto &sound_tag : sound_tags) {
+        results.emplace_back(thread_pool.submit([&sound_tag, &sound_options, cache_ptr]() {
+            bool unchanged = false;
+            int result = make_and_save_sound_tag(sound_tag, sound_options, cache_ptr, unchanged);
+            return std::pair(result, unchanged);
+        }));
     }
 
-    // Generate sound tag
-    std::vector<std::byte> sound_tag_data;
-    try {
-        if(!sound_options.extended) {
-            tag_path = std::filesystem::path(sound_options.tags) / (halo_tag_path + ".sound");
-
-            // Make sure format was set
-            if(!sound_options.format.has_value()) {
-                eprintf_error("No sound format set (required for .sound tags). Use -h for more information.");
-                return EXIT_FAILURE;
+    // Report them in the order they were listed
+    std::size_t made = 0, unchanged = 0, failed = 0;
+    for(std::size_t t = 0; t < sound_tags.size(); t++) {
+        auto &sound_tag = sound_tags[t];
+        int result;
+        try {
+            auto [tag_result, tag_unchanged] = results[t].get();
+            if(tag_unchanged) {
+                unchanged++;
+                continue;
             }
+            result = tag_result;
+        }
+        catch(std::exception &e) {
+            eprintf_error("Failed to make %s: %s", sound_tag.c_str(), e.what());
+            result = EXIT_FAILURE;
+        }
 
-            sound_tag_data = make_sound_tag<Parser::Sound>(tag_path, data_path, sound_options);
+        if(result == EXIT_SUCCESS) {
+            made++;
+            oprintf_success("Made %s", sound_tag.c_str());
         }
         else {
-            sound_tag_data = make_sound_tag<Parser::InvaderSound>(tag_path, data_path, sound_options);
+            failed++;
+            oprintf_fail("Failed to make %s", sound_tag.c_str());
         }
     }
-    catch(std::exception &e) {
-        eprintf_error("Failed to create sound tag due to an exception error: %s", e.what());
-        return EXIT_FAILURE;
-    }
 
-    // Create missing directories if needed
-    try {
-        if(!std::filesystem::exists(tag_path.parent_path())) {
-            std::filesystem::create_directories(tag_path.parent_path());
-        }
-    }
-    catch(std::exception &e) {
-        eprintf_error("Error: Failed to create a directory: %s\n", e.what());
-        return EXIT_FAILURE;
-    }
+    save_cache();
 
-    // Save
-    if(!Invader::File::save_file(tag_path.string().c_str(), sound_tag_data)) {
-        eprintf_error("Failed to save %s", tag_path.string().c_str());
-        return EXIT_FAILURE;
-    }
+    File::print_batch_summary("sound", made, sound_tags.size(), cache.has_value() ? std::optional(unchanged) : std::nullopt);
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count, std::size_t pitch_range_index, Parser::InvaderSound *invader_sound) {
+static void populate_pitch_range(std::vector<SourcePermutation> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count, std::size_t pitch_range_index, Parser::InvaderSound *invader_sound) {
     for(auto &wav : std::filesystem::directory_iterator(directory)) {
         // Skip directories
         auto path = wav.path();
@@ -944,27 +1010,30 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
         auto *path_str_cstr = path_str.c_str();
         if(wav.is_directory()) {
             eprintf_error("Unexpected directory %s", path_str_cstr);
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
         auto extension = path.extension().string();
 
-        // Get the sound
-        SoundReader::Sound sound = {};
+        // Get the format of the sound (it's read later when it's encoded)
+        SourcePermutation sound = {};
+        sound.path = path_str;
         try {
-            if(extension == ".wav") {
-                sound = SoundReader::sound_from_wav_file(path_str_cstr);
-            }
-            else if(extension == ".flac") {
-                sound = SoundReader::sound_from_flac_file(path_str_cstr);
-            }
-            else {
+            if(extension != ".wav" && extension != ".flac") {
                 eprintf_error("Unknown file format for %s", path_str_cstr);
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
+            auto stream = SoundReader::open_sound_stream(path_str_cstr);
+            sound.sample_rate = stream->get_sample_rate();
+            sound.channel_count = stream->get_channel_count();
+            sound.bits_per_sample = stream->get_bits_per_sample();
+            sound.input_bits_per_sample = stream->get_input_bits_per_sample();
+        }
+        catch(InvalidInputSoundException &) {
+            throw;
         }
         catch(std::exception &e) {
             eprintf_error("Failed to load %s: %s", path_str_cstr, e.what());
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
 
         // Get the permutation name
@@ -972,7 +1041,7 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
         sound.name = filename.substr(0, filename.size() - extension.size());
         if(sound.name.size() >= sizeof(HEK::TagString)) {
             eprintf_error("Permutation name %s exceeds the maximum permutation name size (%zu >= %zu)", sound.name.c_str(), sound.name.size(), sizeof(HEK::TagString));
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
 
         // Lowercase it
@@ -980,7 +1049,7 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
             c = std::tolower(c);
         }
 
-        // Add it to the source list
+        // Add it to the source list (WAV files are encoded to FLAC as they're read)
         if(invader_sound) {
             auto &source = invader_sound->source_FLACs.emplace_back();
             std::memset(source.file_name.string, 0, sizeof(source.file_name.string));
@@ -989,7 +1058,7 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
                 source.compressed_audio_data = *File::open_file(path_str_cstr);
             }
             else {
-                source.compressed_audio_data = SoundEncoder::encode_to_flac(sound.pcm, sound.bits_per_sample, sound.channel_count, sound.sample_rate, 5);
+                sound.source_flac_index = invader_sound->source_FLACs.size() - 1;
             }
             source.pitch_range = pitch_range_index;
         }
@@ -1005,16 +1074,13 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
         // Make sure we can actually work with this
         if(sound.channel_count > 2 || sound.channel_count < 1) {
             eprintf_error("Unsupported channel count %u in %s", static_cast<unsigned int>(sound.channel_count), path_str.c_str());
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
         if(sound.bits_per_sample % 8 != 0 || sound.bits_per_sample < 8 || sound.bits_per_sample > 24) {
             eprintf_error("Bits per sample (%u) is not divisible by 8 in %s (or is too small or too big)", static_cast<unsigned int>(sound.bits_per_sample), path_str.data());
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
 
-        // Make it small
-        sound.pcm.shrink_to_fit();
-
         // Add it
         std::size_t i;
         for(i = 0; i < permutations.size(); i++) {
@@ -1023,140 +1089,474 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
             }
             else if(sound.name == permutations[i].name) {
                 eprintf_error("Multiple permutations with the same name (%s) cannot be added", permutations[i].name.c_str());
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
         }
         permutations.insert(permutations.begin() + i, std::move(sound));
     }
 }
 
-static void process_permutation_thread(SoundReader::Sound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, std::atomic<std::size_t> *thread_count, bool fit_adpcm_block_size) {
-    // Calculate some stuff
-    std::size_t bytes_per_sample = permutation->bits_per_sample / 8;
-    std::size_t sample_count = permutation->pcm.size() / bytes_per_sample;
-    
-    // Mutex for errors
-    static std::mutex error_mutex;
+/**
+ * Reads a source file a chunk at a time, converting it to the bits per sample, channel count, and sample rate of the tag
+ */
+class PermutationReader {
+public:
+    /**
+     * Open the source file
+     * @param permutation     permutation to read
+     * @param sample_rate     sample rate to resample to
+     * @param channel_count   channel count to convert to
+     * @param bits_per_sample bits per sample to convert to
+     * @param source_encoder  encoder to also give the unconverted PCM data to, if any
+     */
+    PermutationReader(const SourcePermutation *permutation, std::uint32_t sample_rate, std::uint16_t channel_count, std::uint32_t bits_per_sample, SoundEncoder::StreamEncoder *source_encoder) :
+        stream(SoundReader::open_sound_stream(permutation->path.c_str())),
+        source_encoder(source_encoder),
+        channel_count(channel_count),
+        bits_per_sample(bits_per_sample),
+        ratio(static_cast<double>(sample_rate) / this->stream->get_sample_rate()) {
+
+        // Sample rate doesn't match; this can be fixed with resampling
+        if(this->stream->get_sample_rate() != sample_rate) {
+            int error = 0;
+            this->resampler = src_callback_new(supply_resampler, SRC_SINC_BEST_QUALITY, channel_count, &error, this);
+            if(this->resampler == nullptr) {
+                eprintf_error("Failed to resample: %s", src_strerror(error));
+                throw SoundEncodeFailureException();
+            }
+        }
+    }
 
-    // Bits per sample doesn't match; we can fix that though
-    if(bytes_per_sample != sizeof(std::uint16_t) && (format == SoundFormat::SOUND_FORMAT_16_BIT_PCM || format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM)) {
-        std::size_t new_bytes_per_sample = sizeof(std::uint16_t);
-        permutation->pcm = SoundEncoder::convert_int_to_int(permutation->pcm, permutation->bits_per_sample, new_bytes_per_sample * 8);
-        bytes_per_sample = new_bytes_per_sample;
-        permutation->bits_per_sample = new_bytes_per_sample * 8;
+    /**
+     * Read converted PCM data
+     * @param pcm         where to read to; this must hold frame_count frames
+     * @param frame_count maximum number of frames to read
+     * @return            number of frames read; this is less than frame_count only at the end of the file
+     */
+    std::size_t read(std::byte *pcm, std::size_t frame_count) {
+        if(this->resampler == nullptr) {
+            std::size_t frames_read = this->read_converted(frame_count);
+            std::memcpy(pcm, this->converted_pcm.data(), frames_read * this->bits_per_sample / 8 * this->channel_count);
+            return frames_read;
+        }
+
+        // Resample it
+        this->resampled_pcm.resize(frame_count * this->channel_count);
+        std::size_t frames_read = 0;
+        while(frames_read < frame_count) {
+            long frames_resampled = src_callback_read(this->resampler, this->ratio, frame_count - frames_read, this->resampled_pcm.data() + frames_read * this->channel_count);
+
+            // Anything thrown while reading the file is thrown here instead of through libsamplerate
+            if(this->read_exception) {
+                std::rethrow_exception(this->read_exception);
+            }
+            int error = src_error(this->resampler);
+            if(error) {
+                eprintf_error("Failed to resample: %s", src_strerror(error));
+                throw SoundEncodeFailureException();
+            }
+
+            if(frames_resampled <= 0) {
+                break;
+            }
+            frames_read += frames_resampled;
+        }
+
+        SoundEncoder::convert_float_to_int(this->resampled_pcm.data(), frames_read * this->channel_count, this->bits_per_sample, pcm);
+        return frames_read;
     }
 
-    // Mono -> Stereo (just duplicate the channels)
-    if(permutation->channel_count == 1 && highest_channel_count == 2) {
-        std::vector<std::byte> new_samples(sample_count * 2 * bytes_per_sample);
-        const std::byte *old_sample = permutation->pcm.data();
-        const std::byte *old_sample_end = permutation->pcm.data() + permutation->pcm.size();
-        std::byte *new_sample = new_samples.data();
+    ~PermutationReader() {
+        if(this->resampler) {
+            src_delete(this->resampler);
+        }
+    }
+
+    PermutationReader(const PermutationReader &) = delete;
+    PermutationReader &operator=(const PermutationReader &) = delete;
+
+private:
+    std::unique_ptr<SoundReader::SoundStream> stream;
+    SoundEncoder::StreamEncoder *source_encoder;
+    std::uint16_t channel_count;
+    std::uint32_t bits_per_sample;
+    double ratio;
+    SRC_STATE *resampler = nullptr;
+    std::exception_ptr read_exception;
+
+    /** Buffers for each step, kept around so they aren't reallocated every chunk */
+    std::vector<std::byte> source_pcm;
+    std::vector<std::byte> converted_pcm;
+    std::vector<float> float_pcm;
+    std::vector<float> resampled_pcm;
+
+    /**
+     * Read from the file into converted_pcm, converting the bits per sample and channel count in one pass
+     * @param frame_count maximum number of frames to read
+     * @return            number of frames read
+     */
+    std::size_t read_converted(std::size_t frame_count) {
+        std::size_t source_bits_per_sample = this->stream->get_bits_per_sample();
+        std::size_t source_channel_count = this->stream->get_channel_count();
+        std::size_t source_frame_size = source_bits_per_sample / 8 * source_channel_count;
+        this->source_pcm.resize(frame_count * source_frame_size);
+        std::size_t frames_read = this->stream->read(this->source_pcm.data(), frame_count);
+        if(this->source_encoder) {
+            this->source_encoder->encode(this->source_pcm.data(), frames_read * source_frame_size);
+        }
+
+        // Convert the bits per sample and channel count (mono is duplicated to stereo, and stereo is mixed down to mono)
+        this->converted_pcm.resize(frames_read * this->bits_per_sample / 8 * this->channel_count);
+        SoundEncoder::convert_pcm(this->source_pcm.data(), frames_read, source_bits_per_sample, source_channel_count, this->bits_per_sample, this->channel_count, this->converted_pcm.data());
+
+        return frames_read;
+    }
+
+    /**
+     * Give libsamplerate the next chunk to resample
+     * @param reader reader
+     * @param data   set to the samples
+     * @return       number of frames given (0 at the end of the file)
+     */
+    static long supply_resampler(void *reader, float **data) {
+        auto &r = *reinterpret_cast<PermutationReader *>(reader);
+        std::size_t frames_read;
+        try {
+            frames_read = r.read_converted(READ_CHUNK_FRAMES);
+        }
+        catch(...) {
+            r.read_exception = std::current_exception();
+            return 0;
+        }
+
+        std::size_t sample_count = frames_read * r.channel_count;
+        r.float_pcm.resize(sample_count);
+        SoundEncoder::convert_int_to_float(r.converted_pcm.data(), sample_count, r.bits_per_sample, r.float_pcm.data());
+        *data = r.float_pcm.data();
+        return static_cast<long>(frames_read);
+    }
+};
+
+/**
+ * Generates mouth data for dialogue from PCM data given a chunk at a time
+ */
+class MouthDataGenerator {
+public:
+    /**
+     * Start generating mouth data
+     * @param sample_rate   sample rate of the PCM data
+     * @param channel_count channel count of the PCM data
+     */
+    MouthDataGenerator(std::uint32_t sample_rate, std::uint16_t channel_count) :
+        // Basically, take the sample rate, multiply by channel count, divide by tick rate (30 Hz), and round the result
+        samples_per_tick(static_cast<std::size_t>((sample_rate * channel_count) / TICK_RATE + 0.5)) {}
+
+    /**
+     * Add more samples
+     * @param pcm             PCM data
+     * @param sample_count    number of samples
+     * @param bits_per_sample bits per sample of the PCM data
+     */
+    void add(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample) {
+        // Convert samples to 8-bit unsigned so we can use it to generate mouth data
+        this->samples_float.resize(sample_count);
+        SoundEncoder::convert_int_to_float(pcm, sample_count, bits_per_sample, this->samples_float.data());
+        for(auto &f : this->samples_float) {
+            float ff = f;
+            if(ff < 0.0F) {
+                ff *= -1.0F;
+            }
+            this->tick_total += static_cast<std::uint8_t>(ff * UINT8_MAX);
+            if(++this->tick_sample_count == this->samples_per_tick) {
+                this->end_tick();
+            }
+        }
+    }
+
+    /**
+     * Finish generating mouth data
+     * @return mouth data
+     */
+    std::vector<std::byte> finish() {
+        // Add an extra tick for incomplete ticks
+        if(this->tick_sample_count > 0) {
+            this->end_tick();
+        }
+
+        // Get average and min, clamping min to 0-255
+        std::size_t tick_count = this->mouth_data.size();
+        double average = this->mouth_total / tick_count;
+        double min = 2.0 * average - this->max;
+        if(min > UINT8_MAX) {
+            min = UINT8_MAX;
+        }
+        else if(min < 0) {
+            min = 0;
+        }
+
+        // Get range
+        double range = static_cast<double>(this->max + average) / 2 - min;
 
-        while(old_sample < old_sample_end) {
-            std::memcpy(new_sample, old_sample, bytes_per_sample);
-            std::memcpy(new_sample + bytes_per_sample, old_sample, bytes_per_sample);
-            old_sample += bytes_per_sample;
-            new_sample += bytes_per_sample * 2;
+        // Do nothing if there's no range
+        if(range == 0) {
+            return std::move(this->mouth_data);
         }
 
-        permutation->pcm = std::move(new_samples);
-        permutation->pcm.shrink_to_fit();
-        permutation->channel_count = 2;
+        // Go through each sample
+        for(std::size_t t = 0; t < tick_count; t++) {
+            double sample = (static_cast<std::uint8_t>(this->mouth_data[t]) - min) / range;
+
+            // Clamp to 0 - 255
+            if(sample >= 1.0) {
+                this->mouth_data[t] = static_cast<std::byte>(UINT8_MAX);
+            }
+            else if(sample <= 0.0) {
+                this->mouth_data[t] = static_cast<std::byte>(0);
+            }
+            else {
+                this->mouth_data[t] = static_cast<std::byte>(sample * UINT8_MAX);
+            }
+        }
+
+        return std::move(this->mouth_data);
     }
 
-    // Stereo -> Mono (mixdown)
-    else if(permutation->channel_count == 2 && highest_channel_count == 1) {
-        std::vector<std::byte> new_samples(sample_count * bytes_per_sample / 2);
-        std::byte *new_sample = new_samples.data();
-        const std::byte *old_sample = permutation->pcm.data();
-        const std::byte *old_sample_end = permutation->pcm.data() + permutation->pcm.size();
+private:
+    std::size_t samples_per_tick;
+    std::vector<std::byte> mouth_data;
+    std::vector<float> samples_float;
+
+    /** Total and sample count of the current tick */
+    double tick_total = 0;
+    std::size_t tick_sample_count = 0;
 
-        while(old_sample < old_sample_end) {
-            std::int32_t a = Invader::SoundEncoder::read_sample(old_sample, permutation->bits_per_sample);
-            std::int32_t b = Invader::SoundEncoder::read_sample(old_sample + bytes_per_sample, permutation->bits_per_sample);
-            std::int64_t ab = a + b;
-            Invader::SoundEncoder::write_sample(static_cast<std::int32_t>(ab / 2), new_sample, permutation->bits_per_sample);
+    /** Max and total of all ticks */
+    std::uint8_t max = 0;
+    double mouth_total = 0;
 
-            old_sample += bytes_per_sample * 2;
-            new_sample += bytes_per_sample;
+    void end_tick() {
+        // Divide by samples per tick
+        double average = this->tick_total / this->samples_per_tick;
+        this->mouth_total += average;
+        this->mouth_data.emplace_back(static_cast<std::byte>(average));
+
+        if(average > this->max) {
+            this->max = average;
         }
 
-        permutation->pcm = std::move(new_samples);
-        permutation->pcm.shrink_to_fit();
-        permutation->channel_count = 1;
+        this->tick_total = 0;
+        this->tick_sample_count = 0;
     }
+};
 
-    // Sample rate doesn't match; this can be fixed with resampling
-    if(static_cast<double>(highest_sample_rate) != permutation->sample_rate) {
-        double ratio = static_cast<double>(highest_sample_rate) / permutation->sample_rate;
-        std::vector<float> float_samples = SoundEncoder::convert_int_to_float(permutation->pcm, permutation->bits_per_sample);
-        std::vector<float> new_samples(float_samples.size() * ratio);
-        permutation->sample_rate = highest_sample_rate;
+static std::unique_ptr<SoundEncoder::StreamEncoder> create_encoder(SoundFormat format, std::uint32_t bits_per_sample, std::uint16_t channel_count, std::uint32_t sample_rate, const SoundOptions *sound_options, ThreadPool *adpcm_thread_pool) {
+    switch(format) {
+        // Basically, just make it 16-bit big endian
+        case SoundFormat::SOUND_FORMAT_16_BIT_PCM:
+            return SoundEncoder::create_16_bit_pcm_big_endian_encoder(bits_per_sample);
 
-        // Resample it
-        SRC_DATA data = {};
-        data.data_in = float_samples.data();
-        data.data_out = new_samples.data();
-        data.input_frames = float_samples.size() / permutation->channel_count;
-        data.output_frames = new_samples.size() / permutation->channel_count;
-        data.src_ratio = ratio;
-        int res = src_simple(&data, SRC_SINC_BEST_QUALITY, permutation->channel_count);
-        if(res) {
-            error_mutex.lock();
-            eprintf_error("Failed to resample: %s", src_strerror(res));
-            std::exit(EXIT_FAILURE);
-        }
-        new_samples.resize(data.output_frames_gen * permutation->channel_count);
-
-        // Set stuff
-        if(format == SoundFormat::SOUND_FORMAT_16_BIT_PCM) {
-            bytes_per_sample = sizeof(std::uint16_t);
-        }
-        permutation->sample_rate = highest_sample_rate;
-        permutation->bits_per_sample = bytes_per_sample * 8;
-        sample_count = new_samples.size();
-        permutation->pcm = SoundEncoder::convert_float_to_int(new_samples, permutation->bits_per_sample);
+        // Encode to Vorbis in an Ogg container
+        case SoundFormat::SOUND_FORMAT_OGG_VORBIS: {
+            float compression_level = *sound_options->compression_level;
+            if(compression_level > 1.0F) {
+                compression_level = 1.0F;
+            }
+            else if(compression_level < 0.0F) {
+                compression_level = 0.0F;
+            }
+            if(sound_options->bitrate.has_value()) {
+                return SoundEncoder::create_ogg_vorbis_cbr_encoder(bits_per_sample, channel_count, sample_rate, *sound_options->bitrate);
+            }
+            else {
+                return SoundEncoder::create_ogg_vorbis_vbr_encoder(bits_per_sample, channel_count, sample_rate, compression_level);
+            }
+        }
+
+        // Encode to FLAC
+        case SoundFormat::SOUND_FORMAT_FLAC: {
+            // Clamp to 0.0 - 0.8
+            float compression_level = *sound_options->compression_level;
+            if(compression_level > 0.8F) {
+                compression_level = 0.8F;
+            }
+            else if(compression_level < 0.0F) {
+                compression_level = 0.0F;
+            }
+            // Convert to integer, rounding to the nearest level
+            int flac_level = static_cast<int>(compression_level * 10.0F + 0.5F);
+            return SoundEncoder::create_flac_encoder(bits_per_sample, channel_count, sample_rate, flac_level);
+        }
+
+        // Encode to Xbox ADPCMeme
+        case SoundFormat::SOUND_FORMAT_XBOX_ADPCM:
+            return SoundEncoder::create_xbox_adpcm_encoder(bits_per_sample, channel_count, sound_options->adpcm_quality, adpcm_thread_pool);
+
+        default:
+            eprintf_error("Invalid format. What?");
+            std::terminate();
     }
-    
+}
+
+static void fit_to_adpcm_block_size(std::vector<std::byte> &pcm, std::uint32_t bits_per_sample, std::uint16_t channel_count) {
+    std::size_t bytes_per_sample = bits_per_sample / 8;
+    std::size_t sample_count = pcm.size() / bytes_per_sample;
 
     // Add samples to fit block size via resampling
-    auto adpcm_block_size = SoundEncoder::calculate_adpcm_pcm_block_size(highest_channel_count);
+    auto adpcm_block_size = SoundEncoder::calculate_adpcm_pcm_block_size(channel_count);
     auto trip_adpcm_block_size = adpcm_block_size * 123;
     auto quad_adpcm_block_size = adpcm_block_size * 124;
-    
-    if(fit_adpcm_block_size && format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM && sample_count > quad_adpcm_block_size) {
+
+    if(sample_count > quad_adpcm_block_size) {
         std::size_t delta = trip_adpcm_block_size + (adpcm_block_size - (sample_count % adpcm_block_size));
         if(delta > 0) {
             double ratio = delta / static_cast<double>(quad_adpcm_block_size);
-            std::vector<float> float_samples = SoundEncoder::convert_int_to_float(permutation->pcm, permutation->bits_per_sample);
+            std::vector<float> float_samples = SoundEncoder::convert_int_to_float(pcm, bits_per_sample);
             std::vector<float> new_samples(float_samples.size() * ratio);
             auto new_quad = static_cast<std::size_t>(quad_adpcm_block_size * ratio);
-            
+
             // Resample it
             SRC_DATA data = {};
             data.data_in = float_samples.data();
             data.data_out = new_samples.data();
-            data.input_frames = float_samples.size() / permutation->channel_count;
-            data.output_frames = new_samples.size() / permutation->channel_count;
+            data.input_frames = float_samples.size() / channel_count;
+            data.output_frames = new_samples.size() / channel_count;
             data.src_ratio = ratio;
-            int res = src_simple(&data, SRC_SINC_BEST_QUALITY, permutation->channel_count);
+            int res = src_simple(&data, SRC_SINC_BEST_QUALITY, channel_count);
             if(res) {
-                error_mutex.lock();
                 eprintf_error("Failed to resample: %s", src_strerror(res));
-                std::exit(EXIT_FAILURE);
+                throw SoundEncodeFailureException();
             }
-            
-            new_samples.resize(data.output_frames_gen * permutation->channel_count);
-            auto new_int_samples = SoundEncoder::convert_float_to_int(new_samples, permutation->bits_per_sample);
-            
-            permutation->pcm.erase(permutation->pcm.begin(), permutation->pcm.begin() + quad_adpcm_block_size * bytes_per_sample);
-            permutation->pcm.insert(permutation->pcm.begin(), new_int_samples.begin(), new_int_samples.begin() + new_quad * bytes_per_sample);
-            
-            sample_count -= quad_adpcm_block_size;
-            sample_count += new_quad;
+
+            new_samples.resize(data.output_frames_gen * channel_count);
+            auto new_int_samples = SoundEncoder::convert_float_to_int(new_samples, bits_per_sample);
+
+            pcm.erase(pcm.begin(), pcm.begin() + quad_adpcm_block_size * bytes_per_sample);
+            pcm.insert(pcm.begin(), new_int_samples.begin(), new_int_samples.begin() + new_quad * bytes_per_sample);
         }
     }
-    
-    (*thread_count)--;
+}
+
+static EncodedSound encode_permutation(const SourcePermutation *permutation, std::uint32_t sample_rate, std::uint16_t channel_count, SoundFormat format, bool split, bool fit_adpcm_block_size, bool is_dialogue, const SoundOptions *sound_options, ThreadPool *adpcm_thread_pool) {
+    EncodedSound encoded;
+
+    // 16-bit PCM and Xbox ADPCM need 16-bit samples; everything else can keep what the file has
+    std::uint32_t bits_per_sample = (format == SoundFormat::SOUND_FORMAT_16_BIT_PCM || format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM) ? 16 : permutation->bits_per_sample;
+    std::size_t bytes_per_sample_one_channel = bits_per_sample / 8;
+    std::size_t bytes_per_sample_all_channels = bytes_per_sample_one_channel * channel_count;
+    encoded.bits_per_sample = bits_per_sample;
+
+    // Split if requested
+    std::size_t max_split_size = SIZE_MAX;
+    if(split) {
+        max_split_size = SPLIT_BUFFER_SIZE - (SPLIT_BUFFER_SIZE % bytes_per_sample_all_channels);
+
+        // If ADPCM, also take block size into account
+        if(format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM) {
+            std::size_t adpcm_block_size = SoundEncoder::calculate_adpcm_pcm_block_size(channel_count);
+            max_split_size = max_split_size - (max_split_size % (bytes_per_sample_all_channels * adpcm_block_size));
+        }
+    }
+
+    // Encode the source FLAC while we're reading it, too
+    std::unique_ptr<SoundEncoder::StreamEncoder> source_encoder;
+    if(permutation->source_flac_index.has_value()) {
+        source_encoder = SoundEncoder::create_flac_encoder(permutation->bits_per_sample, permutation->channel_count, permutation->sample_rate, 5);
+    }
+
+    std::optional<MouthDataGenerator> mouth_data;
+    if(is_dialogue) {
+        mouth_data.emplace(sample_rate, channel_count);
+    }
+
+    // Encode PCM data, starting a new permutation whenever the current one is full
+    std::unique_ptr<SoundEncoder::StreamEncoder> encoder;
+    std::size_t encoder_pcm_size = 0;
+    auto finish_permutation = [&]() {
+        auto &p = encoded.permutations.emplace_back();
+        p.samples = encoder->finish();
+        p.samples.shrink_to_fit();
+        switch(format) {
+            case SoundFormat::SOUND_FORMAT_16_BIT_PCM:
+                p.buffer_size = p.samples.size();
+                break;
+            case SoundFormat::SOUND_FORMAT_OGG_VORBIS:
+                p.buffer_size = encoder_pcm_size / bytes_per_sample_one_channel * sizeof(std::int16_t);
+                break;
+            default:
+                break;
+        }
+        encoder.reset();
+    };
+    auto encode_pcm = [&](const std::byte *pcm, std::size_t size) {
+        if(mouth_data.has_value()) {
+            mouth_data->add(pcm, size / bytes_per_sample_one_channel, bits_per_sample);
+        }
+        encoded.pcm_size += size;
+
+        while(size > 0) {
+            if(!encoder) {
+                encoder = create_encoder(format, bits_per_sample, channel_count, sample_rate, sound_options, adpcm_thread_pool);
+                encoder_pcm_size = 0;
+            }
+
+            std::size_t size_to_encode = std::min(size, max_split_size - encoder_pcm_size);
+            encoder->encode(pcm, size_to_encode);
+            encoder_pcm_size += size_to_encode;
+            pcm += size_to_encode;
+            size -= size_to_encode;
+
+            if(encoder_pcm_size == max_split_size) {
+                finish_permutation();
+            }
+        }
+    };
+
+    PermutationReader reader(permutation, sample_rate, channel_count, bits_per_sample, source_encoder.get());
+    std::vector<std::byte> pcm;
+
+    // Fitting to the ADPCM block size needs the whole sound, so read all of it first
+    if(fit_adpcm_block_size && format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM) {
+        std::size_t frames_read;
+        do {
+            std::size_t offset = pcm.size();
+            pcm.resize(offset + READ_CHUNK_FRAMES * bytes_per_sample_all_channels);
+            frames_read = reader.read(pcm.data() + offset, READ_CHUNK_FRAMES);
+            pcm.resize(offset + frames_read * bytes_per_sample_all_channels);
+        }
+        while(frames_read == READ_CHUNK_FRAMES);
+
+        fit_to_adpcm_block_size(pcm, bits_per_sample, channel_count);
+        encode_pcm(pcm.data(), pcm.size());
+    }
+
+    // Otherwise, encode it as it's read
+    else {
+        pcm.resize(READ_CHUNK_FRAMES * bytes_per_sample_all_channels);
+        std::size_t frames_read;
+        do {
+            frames_read = reader.read(pcm.data(), READ_CHUNK_FRAMES);
+            encode_pcm(pcm.data(), frames_read * bytes_per_sample_all_channels);
+        }
+        while(frames_read == READ_CHUNK_FRAMES);
+    }
+
+    // Finish whatever is left (or make an empty permutation if the sound was empty)
+    if(encoder || encoded.permutations.empty()) {
+        if(!encoder) {
+            encoder = create_encoder(format, bits_per_sample, channel_count, sample_rate, sound_options, adpcm_thread_pool);
+            encoder_pcm_size = 0;
+        }
+        finish_permutation();
+    }
+
+    // Generate mouth data if needed
+    if(mouth_data.has_value()) {
+        encoded.mouth_data = mouth_data->finish();
+    }
+
+    if(source_encoder) {
+        encoded.source_flac = source_encoder->finish();
+    }
+
+    return encoded;
 }
@@ -1,5 +1,7 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include "../simd.hpp"
+
 #include <invader/sound/sound_encoder.hpp>
 #include <invader/printf.hpp>
 #include <invader/version.hpp>
@@ -7,6 +9,8 @@
 #include <vorbis/vorbisenc.h>
 #include <memory>
 #include <cstdint>
+#include <cstring>
+#include <utility>
 #include <samplerate.h>
 
 extern "C" {
@@ -32,110 +36,567 @@ namespace Invader::SoundEncoder {
         return sample_value;
     }
 
+    class PCM16BitBigEndianEncoder : public StreamEncoder {
+    public:
+        PCM16BitBigEndianEncoder(std::size_t bits_per_sample) : bits_per_sample(bits_per_sample) {}
+
+        void encode(const std::byte *pcm, std::size_t size) override {
+            // Convert to 16 bits per sample if needed
+            std::size_t sample_count = size / (this->bits_per_sample / 8);
+            std::size_t offset = this->output.size();
+            this->output.resize(offset + sample_count * sizeof(std::uint16_t));
+            auto *output_pcm = this->output.data() + offset;
+            if(this->bits_per_sample != 16) {
+                convert_int_to_int(pcm, sample_count, this->bits_per_sample, 16, output_pcm);
+            }
+            else {
+                std::memcpy(output_pcm, pcm, size);
+            }
+
+            // Swap endianness
+            for(std::size_t i = 0; i < sample_count; i++) {
+                std::swap(output_pcm[i * 2], output_pcm[i * 2 + 1]);
+            }
+        }
+
+        std::vector<std::byte> finish() override {
+            return std::move(this->output);
+        }
+
+    private:
+        std::size_t bits_per_sample;
+        std::vector<std::byte> output;
+    };
+
+    std::unique_ptr<StreamEncoder> create_16_bit_pcm_big_endian_encoder(std::size_t bits_per_sample) {
+        return std::make_unique<PCM16BitBigEndianEncoder>(bits_per_sample);
+    }
+
     std::vector<std::byte> convert_to_16_bit_pcm_big_endian(const std::vector<std::byte> &pcm, std::size_t bits_per_sample) {
-        // Convert to 16 bits per sample if needed
-        std::vector<std::byte> pcm_to_use;
-        if(bits_per_sample != 16) {
-            pcm_to_use = convert_int_to_int(pcm, bits_per_sample, 16);
+        PCM16BitBigEndianEncoder encoder(bits_per_sample);
+        encoder.encode(pcm.data(), pcm.size());
+        return encoder.finish();
+    }
+
+    // Conversion kernels are specialized for each bits per sample so the sample size and scale are known at compile
+    // time; anything other than 8, 16, 24, or 32 bits goes through read_sample and write_sample instead.
+
+    template<std::size_t bits_per_sample> static inline std::int32_t load_sample(const std::byte *pcm) noexcept {
+        auto *bytes = reinterpret_cast<const std::uint8_t *>(pcm);
+        if constexpr(bits_per_sample == 8) {
+            return static_cast<std::int8_t>(bytes[0]);
+        }
+        else if constexpr(bits_per_sample == 16) {
+            return static_cast<std::int16_t>(bytes[0] | bytes[1] << 8);
+        }
+        else if constexpr(bits_per_sample == 24) {
+            return static_cast<std::int32_t>(static_cast<std::uint32_t>(bytes[0] | bytes[1] << 8 | bytes[2] << 16) << 8) >> 8;
         }
         else {
-            pcm_to_use = pcm;
+            static_assert(bits_per_sample == 32);
+            return static_cast<std::int32_t>(static_cast<std::uint32_t>(bytes[0]) | static_cast<std::uint32_t>(bytes[1]) << 8 | static_cast<std::uint32_t>(bytes[2]) << 16 | static_cast<std::uint32_t>(bytes[3]) << 24);
         }
+    }
 
-        // Swap endianness
-        std::uint16_t *samples = reinterpret_cast<std::uint16_t *>(pcm_to_use.data());
-        std::size_t sample_count = pcm_to_use.size() / sizeof(*samples);
-        for(std::size_t i = 0; i < sample_count; i++) {
-            auto sample = samples[i];
-            auto *sample_bytes = reinterpret_cast<std::byte *>(samples + i);
-            sample_bytes[1] = static_cast<std::byte>(sample & 0xFF);
-            sample_bytes[0] = static_cast<std::byte>((sample >> 8) & 0xFF);
+    template<std::size_t bits_per_sample> static inline void store_sample(std::int32_t sample, std::byte *pcm) noexcept {
+        for(std::size_t b = 0; b < bits_per_sample / 8; b++) {
+            pcm[b] = static_cast<std::byte>((sample >> b * 8) & 0xFF);
         }
+    }
 
-        // Done!
-        return pcm_to_use;
+    /** Scale a sample from one bits per sample to another, rounding toward zero */
+    template<std::size_t bits_per_sample, std::size_t new_bits_per_sample> static inline std::int32_t rescale_sample(std::int32_t sample) noexcept {
+        if constexpr(new_bits_per_sample >= bits_per_sample) {
+            return static_cast<std::int32_t>(static_cast<std::int64_t>(sample) * (static_cast<std::int64_t>(1) << (new_bits_per_sample - bits_per_sample)));
+        }
+        else {
+            return static_cast<std::int32_t>(sample / (static_cast<std::int32_t>(1) << (bits_per_sample - new_bits_per_sample)));
+        }
     }
 
-    std::vector<std::byte> convert_int_to_int(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t new_bits_per_sample) {
+    #ifdef INVADER_SSE2
+    /** Load four samples, sign extended to 32 bits, without reading past the last one */
+    template<std::size_t bits_per_sample> static inline __m128i load_samples_sse2(const std::byte *pcm) noexcept {
+        if constexpr(bits_per_sample == 8) {
+            std::int32_t bytes;
+            std::memcpy(&bytes, pcm, sizeof(bytes));
+            auto samples = _mm_cvtsi32_si128(bytes);
+            samples = _mm_unpacklo_epi8(samples, samples);
+            return _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 24);
+        }
+        else if constexpr(bits_per_sample == 16) {
+            auto samples = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pcm));
+            return _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        }
+        else if constexpr(bits_per_sample == 24) {
+            // Put bytes 0-7 in the low half and bytes 6-11 in the high half so each half starts with two samples, then
+            // move the second sample of each half up a byte and sign extend them all
+            std::int32_t last_bytes;
+            std::memcpy(&last_bytes, pcm + 8, sizeof(last_bytes));
+            auto low = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pcm));
+            auto high = _mm_or_si128(_mm_srli_epi64(low, 48), _mm_slli_epi64(_mm_cvtsi32_si128(last_bytes), 16));
+            auto pairs = _mm_unpacklo_epi64(low, high);
+            auto first = _mm_and_si128(pairs, _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF));
+            auto second = _mm_and_si128(_mm_slli_epi64(pairs, 8), _mm_set_epi32(0xFFFFFF, 0, 0xFFFFFF, 0));
+            return _mm_srai_epi32(_mm_slli_epi32(_mm_or_si128(first, second), 8), 8);
+        }
+        else {
+            static_assert(bits_per_sample == 32);
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(pcm));
+        }
+    }
+
+    /** Store four samples that already fit in bits_per_sample without writing past the last one */
+    template<std::size_t bits_per_sample> static inline void store_samples_sse2(__m128i samples, std::byte *pcm) noexcept {
+        if constexpr(bits_per_sample == 8) {
+            auto words = _mm_packs_epi32(samples, samples);
+            auto bytes = _mm_cvtsi128_si32(_mm_packs_epi16(words, words));
+            std::memcpy(pcm, &bytes, sizeof(bytes));
+        }
+        else if constexpr(bits_per_sample == 16) {
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(pcm), _mm_packs_epi32(samples, samples));
+        }
+        else if constexpr(bits_per_sample == 24) {
+            // Pack each pair of samples into the low 6 bytes of each half, then write the halves back to back
+            auto pairs = _mm_or_si128(_mm_and_si128(samples, _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF)), _mm_and_si128(_mm_srli_epi64(samples, 8), _mm_set_epi32(0xFFFF, static_cast<int>(0xFF000000), 0xFFFF, static_cast<int>(0xFF000000))));
+            auto high = _mm_unpackhi_epi64(pairs, pairs);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(pcm), _mm_or_si128(pairs, _mm_slli_epi64(high, 48)));
+            auto last_bytes = _mm_cvtsi128_si32(_mm_srli_epi64(high, 16));
+            std::memcpy(pcm + 8, &last_bytes, sizeof(last_bytes));
+        }
+        else {
+            static_assert(bits_per_sample == 32);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pcm), samples);
+        }
+    }
+
+    /** Scale four samples from one bits per sample to another, rounding toward zero like rescale_sample */
+    template<std::size_t bits_per_sample, std::size_t new_bits_per_sample> static inline __m128i rescale_samples_sse2(__m128i samples) noexcept {
+        if constexpr(new_bits_per_sample >= bits_per_sample) {
+            return _mm_slli_epi32(samples, new_bits_per_sample - bits_per_sample);
+        }
+        else {
+            // Negative samples need 2^shift - 1 added first so the shift rounds toward zero rather than down
+            constexpr int shift = bits_per_sample - new_bits_per_sample;
+            auto bias = _mm_and_si128(_mm_srai_epi32(samples, 31), _mm_set1_epi32((1 << shift) - 1));
+            return _mm_srai_epi32(_mm_add_epi32(samples, bias), shift);
+        }
+    }
+
+    /** Divide by divide_by if negative or divide_by_minus_one if not, the same as the scalar conversion */
+    static inline __m128 int_to_float_sse2(__m128i samples, __m128 divide_by, __m128 divide_by_minus_one) noexcept {
+        auto negative = _mm_castsi128_ps(_mm_cmplt_epi32(samples, _mm_setzero_si128()));
+        auto divisor = _mm_or_ps(_mm_and_ps(negative, divide_by), _mm_andnot_ps(negative, divide_by_minus_one));
+        return _mm_div_ps(_mm_cvtepi32_ps(samples), divisor);
+    }
+
+    /** Multiply by multiply_by if negative or multiply_by_minus_one if not, clamp, and round toward zero */
+    static inline __m128i float_to_int_sse2(__m128 samples, __m128 multiply_by, __m128 multiply_by_minus_one, __m128 min) noexcept {
+        auto negative = _mm_cmplt_ps(samples, _mm_setzero_ps());
+        auto multiplier = _mm_or_ps(_mm_and_ps(negative, multiply_by), _mm_andnot_ps(negative, multiply_by_minus_one));
+
+        // Clamping before rounding gives the same result as rounding before clamping, and it keeps the values in range of a 32-bit int
+        auto sample = _mm_min_ps(_mm_max_ps(_mm_mul_ps(samples, multiplier), min), multiply_by_minus_one);
+        return _mm_cvttps_epi32(sample);
+    }
+    #endif
+
+    template<std::size_t bits_per_sample, std::size_t new_bits_per_sample> static void convert_int_to_int_kernel(const std::byte *pcm, std::size_t sample_count, std::byte *output) noexcept {
+        constexpr std::size_t bytes_per_sample = bits_per_sample / 8;
+        constexpr std::size_t new_bytes_per_sample = new_bits_per_sample / 8;
+        std::size_t i = 0;
+
+        #ifdef INVADER_SSE2
+        for(; i + 4 <= sample_count; i += 4) {
+            auto samples = rescale_samples_sse2<bits_per_sample, new_bits_per_sample>(load_samples_sse2<bits_per_sample>(pcm + i * bytes_per_sample));
+            store_samples_sse2<new_bits_per_sample>(samples, output + i * new_bytes_per_sample);
+        }
+        #endif
+
+        for(; i < sample_count; i++) {
+            store_sample<new_bits_per_sample>(rescale_sample<bits_per_sample, new_bits_per_sample>(load_sample<bits_per_sample>(pcm + i * bytes_per_sample)), output + i * new_bytes_per_sample);
+        }
+    }
+
+    template<std::size_t bits_per_sample, std::size_t new_bits_per_sample> static void convert_mono_to_stereo_kernel(const std::byte *pcm, std::size_t frame_count, std::byte *output) noexcept {
+        constexpr std::size_t bytes_per_sample = bits_per_sample / 8;
+        constexpr std::size_t new_bytes_per_sample = new_bits_per_sample / 8;
+        std::size_t f = 0;
+
+        // Just duplicate the channel
+        #ifdef INVADER_SSE2
+        for(; f + 4 <= frame_count; f += 4) {
+            auto samples = rescale_samples_sse2<bits_per_sample, new_bits_per_sample>(load_samples_sse2<bits_per_sample>(pcm + f * bytes_per_sample));
+            store_samples_sse2<new_bits_per_sample>(_mm_unpacklo_epi32(samples, samples), output + f * 2 * new_bytes_per_sample);
+            store_samples_sse2<new_bits_per_sample>(_mm_unpackhi_epi32(samples, samples), output + (f * 2 + 4) * new_bytes_per_sample);
+        }
+        #endif
+
+        for(; f < frame_count; f++) {
+            auto sample = rescale_sample<bits_per_sample, new_bits_per_sample>(load_sample<bits_per_sample>(pcm + f * bytes_per_sample));
+            store_sample<new_bits_per_sample>(sample, output + f * 2 * new_bytes_per_sample);
+            store_sample<new_bits_per_sample>(sample, output + (f * 2 + 1) * new_bytes_per_sample);
+        }
+    }
+
+    template<std::size_t bits_per_sample, std::size_t new_bits_per_sample> static void convert_stereo_to_mono_kernel(const std::byte *pcm, std::size_t frame_count, std::byte *output) noexcept {
+        constexpr std::size_t bytes_per_sample = bits_per_sample / 8;
+        constexpr std::size_t new_bytes_per_sample = new_bits_per_sample / 8;
+        std::size_t f = 0;
+
+        // Mix down after converting so it's the same as converting and then mixing down
+        #ifdef INVADER_SSE2
+        // Two 32-bit samples can overflow when added, so those are only done one at a time
+        if constexpr(new_bits_per_sample < 32) {
+            for(; f + 4 <= frame_count; f += 4) {
+                auto first = _mm_castsi128_ps(rescale_samples_sse2<bits_per_sample, new_bits_per_sample>(load_samples_sse2<bits_per_sample>(pcm + f * 2 * bytes_per_sample)));
+                auto second = _mm_castsi128_ps(rescale_samples_sse2<bits_per_sample, new_bits_per_sample>(load_samples_sse2<bits_per_sample>(pcm + (f * 2 + 4) * bytes_per_sample)));
+                auto left = _mm_castps_si128(_mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)));
+                auto right = _mm_castps_si128(_mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+
+                // Halve it, adding 1 to negative sums first so it rounds toward zero
+                auto sum = _mm_add_epi32(left, right);
+                store_samples_sse2<new_bits_per_sample>(_mm_srai_epi32(_mm_add_epi32(sum, _mm_srli_epi32(sum, 31)), 1), output + f * new_bytes_per_sample);
+            }
+        }
+        #endif
+
+        for(; f < frame_count; f++) {
+            std::int64_t a = rescale_sample<bits_per_sample, new_bits_per_sample>(load_sample<bits_per_sample>(pcm + f * 2 * bytes_per_sample));
+            std::int64_t b = rescale_sample<bits_per_sample, new_bits_per_sample>(load_sample<bits_per_sample>(pcm + (f * 2 + 1) * bytes_per_sample));
+            store_sample<new_bits_per_sample>(static_cast<std::int32_t>((a + b) / 2), output + f * new_bytes_per_sample);
+        }
+    }
+
+    template<std::size_t bits_per_sample, std::size_t new_bits_per_sample> static void convert_pcm_kernel(const std::byte *pcm, std::size_t frame_count, std::size_t channel_count, std::size_t new_channel_count, std::byte *output) noexcept {
+        if(channel_count == 1 && new_channel_count == 2) {
+            convert_mono_to_stereo_kernel<bits_per_sample, new_bits_per_sample>(pcm, frame_count, output);
+        }
+        else if(channel_count == 2 && new_channel_count == 1) {
+            convert_stereo_to_mono_kernel<bits_per_sample, new_bits_per_sample>(pcm, frame_count, output);
+        }
+        else {
+            convert_int_to_int_kernel<bits_per_sample, new_bits_per_sample>(pcm, frame_count * channel_count, output);
+        }
+    }
+
+    template<std::size_t bits_per_sample> static void convert_pcm_from(const std::byte *pcm, std::size_t frame_count, std::size_t channel_count, std::size_t new_bits_per_sample, std::size_t new_channel_count, std::byte *output) noexcept {
+        switch(new_bits_per_sample) {
+            case 8:
+                return convert_pcm_kernel<bits_per_sample, 8>(pcm, frame_count, channel_count, new_channel_count, output);
+            case 16:
+                return convert_pcm_kernel<bits_per_sample, 16>(pcm, frame_count, channel_count, new_channel_count, output);
+            case 24:
+                return convert_pcm_kernel<bits_per_sample, 24>(pcm, frame_count, channel_count, new_channel_count, output);
+            case 32:
+                return convert_pcm_kernel<bits_per_sample, 32>(pcm, frame_count, channel_count, new_channel_count, output);
+        }
+    }
+
+    static void convert_pcm_generic(const std::byte *pcm, std::size_t frame_count, std::size_t bits_per_sample, std::size_t channel_count, std::size_t new_bits_per_sample, std::size_t new_channel_count, std::byte *output) noexcept {
         std::size_t bytes_per_sample = bits_per_sample / 8;
         std::size_t new_bytes_per_sample = new_bits_per_sample / 8;
-        std::size_t sample_count = pcm.size() / bytes_per_sample;
-        std::vector<std::byte> samples(sample_count * new_bytes_per_sample);
 
         // Calculate what we divide by
-        std::int64_t divide_by = 1 << bits_per_sample;
+        std::int64_t divide_by = static_cast<std::int64_t>(1) << bits_per_sample;
 
         // Calculate what we multiply by
-        std::int64_t multiply_by = 1 << new_bits_per_sample;
+        std::int64_t multiply_by = static_cast<std::int64_t>(1) << new_bits_per_sample;
 
-        auto *pcm_data = pcm.data();
-        auto *output_pcm_data = samples.data();
+        auto convert_sample = [&](const std::byte *sample) -> std::int64_t {
+            return read_sample(sample, bits_per_sample) * multiply_by / divide_by;
+        };
 
-        for(std::size_t i = 0; i < sample_count; i++) {
-            // Get the new sample value
-            std::int64_t sample = read_sample(pcm_data, bits_per_sample);
-            std::int64_t new_sample = sample * multiply_by / divide_by;
-            write_sample(static_cast<std::int32_t>(new_sample), output_pcm_data, new_bits_per_sample);
+        for(std::size_t f = 0; f < frame_count; f++) {
+            if(channel_count == 1 && new_channel_count == 2) {
+                auto sample = static_cast<std::int32_t>(convert_sample(pcm));
+                write_sample(sample, output, new_bits_per_sample);
+                write_sample(sample, output + new_bytes_per_sample, new_bits_per_sample);
+            }
+            else if(channel_count == 2 && new_channel_count == 1) {
+                write_sample(static_cast<std::int32_t>((convert_sample(pcm) + convert_sample(pcm + bytes_per_sample)) / 2), output, new_bits_per_sample);
+            }
+            else {
+                for(std::size_t c = 0; c < channel_count; c++) {
+                    write_sample(static_cast<std::int32_t>(convert_sample(pcm + c * bytes_per_sample)), output + c * new_bytes_per_sample, new_bits_per_sample);
+                }
+            }
+            pcm += bytes_per_sample * channel_count;
+            output += new_bytes_per_sample * new_channel_count;
+        }
+    }
 
-            // Add it
-            pcm_data += bytes_per_sample;
-            output_pcm_data += new_bytes_per_sample;
+    static bool is_specialized(std::size_t bits_per_sample) noexcept {
+        return bits_per_sample == 8 || bits_per_sample == 16 || bits_per_sample == 24 || bits_per_sample == 32;
+    }
+
+    void convert_pcm(const std::byte *pcm, std::size_t frame_count, std::size_t bits_per_sample, std::size_t channel_count, std::size_t new_bits_per_sample, std::size_t new_channel_count, std::byte *output) noexcept {
+        // Nothing to convert
+        if(bits_per_sample == new_bits_per_sample && channel_count == new_channel_count) {
+            std::memmove(output, pcm, frame_count * channel_count * bits_per_sample / 8);
+            return;
+        }
+
+        if(!is_specialized(bits_per_sample) || !is_specialized(new_bits_per_sample)) {
+            return convert_pcm_generic(pcm, frame_count, bits_per_sample, channel_count, new_bits_per_sample, new_channel_count, output);
         }
 
+        switch(bits_per_sample) {
+            case 8:
+                return convert_pcm_from<8>(pcm, frame_count, channel_count, new_bits_per_sample, new_channel_count, output);
+            case 16:
+                return convert_pcm_from<16>(pcm, frame_count, channel_count, new_bits_per_sample, new_channel_count, output);
+            case 24:
+                return convert_pcm_from<24>(pcm, frame_count, channel_count, new_bits_per_sample, new_channel_count, output);
+            case 32:
+                return convert_pcm_from<32>(pcm, frame_count, channel_count, new_bits_per_sample, new_channel_count, output);
+        }
+    }
+
+    void convert_int_to_int(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample, std::size_t new_bits_per_sample, std::byte *output) noexcept {
+        convert_pcm(pcm, sample_count, bits_per_sample, 1, new_bits_per_sample, 1, output);
+    }
+
+    std::vector<std::byte> convert_int_to_int(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t new_bits_per_sample) {
+        std::size_t sample_count = pcm.size() / (bits_per_sample / 8);
+        std::vector<std::byte> samples(sample_count * (new_bits_per_sample / 8));
+        convert_int_to_int(pcm.data(), sample_count, bits_per_sample, new_bits_per_sample, samples.data());
         return samples;
     }
 
-    std::vector<float> convert_int_to_float(const std::vector<std::byte> &pcm, std::size_t bits_per_sample) {
-        std::vector<float> samples;
-        std::size_t bytes_per_sample = bits_per_sample / 8;
-        std::size_t sample_count = pcm.size() / bytes_per_sample;
-        samples.reserve(sample_count);
+    /** Calculate what we divide by to convert to floating point (depending on if the sample is negative) */
+    static void int_to_float_divisors(std::size_t bits_per_sample, float &divide_by, float &divide_by_minus_one) noexcept {
+        divide_by = (static_cast<std::int64_t>(1) << bits_per_sample) / 2.0F;
+        divide_by_minus_one = divide_by - 1;
+    }
 
-        // Calculate what we divide by
-        float divide_by = (1 << bits_per_sample) / 2.0F;
-        float divide_by_minus_one = divide_by - 1;
-        float divide_by_arr[2] = { divide_by_minus_one, divide_by };
+    template<std::size_t bits_per_sample> static void convert_int_to_float_kernel(const std::byte *pcm, std::size_t sample_count, float *output) noexcept {
+        float divide_by, divide_by_minus_one;
+        int_to_float_divisors(bits_per_sample, divide_by, divide_by_minus_one);
+        std::size_t i = 0;
 
-        auto *pcm_data = pcm.data();
+        #ifdef INVADER_SSE2
+        auto divide_by_v = _mm_set1_ps(divide_by);
+        auto divide_by_minus_one_v = _mm_set1_ps(divide_by_minus_one);
+        if constexpr(bits_per_sample == 16) {
+            // Sign extend 8 samples at a time
+            for(; i + 8 <= sample_count; i += 8) {
+                auto samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pcm + i * 2));
+                auto low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+                auto high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+                _mm_storeu_ps(output + i, int_to_float_sse2(low, divide_by_v, divide_by_minus_one_v));
+                _mm_storeu_ps(output + i + 4, int_to_float_sse2(high, divide_by_v, divide_by_minus_one_v));
+            }
+        }
+        else {
+            for(; i + 4 <= sample_count; i += 4) {
+                _mm_storeu_ps(output + i, int_to_float_sse2(load_samples_sse2<bits_per_sample>(pcm + i * (bits_per_sample / 8)), divide_by_v, divide_by_minus_one_v));
+            }
+        }
+        #endif
+
+        for(; i < sample_count; i++) {
+            float sample = static_cast<float>(load_sample<bits_per_sample>(pcm + i * (bits_per_sample / 8)));
+            output[i] = sample / (sample < 0 ? divide_by : divide_by_minus_one);
+        }
+    }
+
+    void convert_int_to_float(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample, float *output) noexcept {
+        switch(bits_per_sample) {
+            case 8:
+                return convert_int_to_float_kernel<8>(pcm, sample_count, output);
+            case 16:
+                return convert_int_to_float_kernel<16>(pcm, sample_count, output);
+            case 24:
+                return convert_int_to_float_kernel<24>(pcm, sample_count, output);
+            case 32:
+                return convert_int_to_float_kernel<32>(pcm, sample_count, output);
+        }
 
+        float divide_by, divide_by_minus_one;
+        int_to_float_divisors(bits_per_sample, divide_by, divide_by_minus_one);
         for(std::size_t i = 0; i < sample_count; i++) {
-            std::int64_t sample = read_sample(pcm_data, bits_per_sample);
-            samples.emplace_back(sample / divide_by_arr[sample < 0]);
-            pcm_data += bytes_per_sample;
+            std::int64_t sample = read_sample(pcm + i * (bits_per_sample / 8), bits_per_sample);
+            output[i] = sample / (sample < 0 ? divide_by : divide_by_minus_one);
+        }
+    }
+
+    template<std::size_t bits_per_sample> static void convert_int_to_float_deinterleaved_kernel(const std::byte *pcm, std::size_t frame_count, std::size_t channel_count, float *const *output) noexcept {
+        float divide_by, divide_by_minus_one;
+        int_to_float_divisors(bits_per_sample, divide_by, divide_by_minus_one);
+        std::size_t f = 0;
+
+        #ifdef INVADER_SSE2
+        if constexpr(bits_per_sample == 16) {
+            if(channel_count == 2) {
+                // Convert 4 frames at a time and then split the left and right channels
+                auto divide_by_v = _mm_set1_ps(divide_by);
+                auto divide_by_minus_one_v = _mm_set1_ps(divide_by_minus_one);
+                for(; f + 4 <= frame_count; f += 4) {
+                    auto samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pcm + f * 4));
+                    auto low = int_to_float_sse2(_mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16), divide_by_v, divide_by_minus_one_v);
+                    auto high = int_to_float_sse2(_mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16), divide_by_v, divide_by_minus_one_v);
+                    _mm_storeu_ps(output[0] + f, _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+                    _mm_storeu_ps(output[1] + f, _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+                }
+            }
+        }
+        #endif
+
+        for(; f < frame_count; f++) {
+            for(std::size_t c = 0; c < channel_count; c++) {
+                float sample = static_cast<float>(load_sample<bits_per_sample>(pcm + (f * channel_count + c) * (bits_per_sample / 8)));
+                output[c][f] = sample / (sample < 0 ? divide_by : divide_by_minus_one);
+            }
+        }
+    }
+
+    void convert_int_to_float_deinterleaved(const std::byte *pcm, std::size_t frame_count, std::size_t bits_per_sample, std::size_t channel_count, float *const *output) noexcept {
+        // Mono is already deinterleaved
+        if(channel_count == 1) {
+            return convert_int_to_float(pcm, frame_count, bits_per_sample, output[0]);
+        }
+
+        switch(bits_per_sample) {
+            case 8:
+                return convert_int_to_float_deinterleaved_kernel<8>(pcm, frame_count, channel_count, output);
+            case 16:
+                return convert_int_to_float_deinterleaved_kernel<16>(pcm, frame_count, channel_count, output);
+            case 24:
+                return convert_int_to_float_deinterleaved_kernel<24>(pcm, frame_count, channel_count, output);
+            case 32:
+                return convert_int_to_float_deinterleaved_kernel<32>(pcm, frame_count, channel_count, output);
+        }
+
+        float divide_by, divide_by_minus_one;
+        int_to_float_divisors(bits_per_sample, divide_by, divide_by_minus_one);
+        for(std::size_t f = 0; f < frame_count; f++) {
+            for(std::size_t c = 0; c < channel_count; c++) {
+                std::int64_t sample = read_sample(pcm + (f * channel_count + c) * (bits_per_sample / 8), bits_per_sample);
+                output[c][f] = sample / (sample < 0 ? divide_by : divide_by_minus_one);
+            }
         }
+    }
 
+    std::vector<float> convert_int_to_float(const std::vector<std::byte> &pcm, std::size_t bits_per_sample) {
+        std::vector<float> samples(pcm.size() / (bits_per_sample / 8));
+        convert_int_to_float(pcm.data(), samples.size(), bits_per_sample, samples.data());
         return samples;
     }
 
-    std::vector<std::byte> convert_float_to_int(const std::vector<float> &pcm, std::size_t new_bits_per_sample) {
-        std::size_t sample_count = pcm.size();
-        std::size_t bytes_per_sample = new_bits_per_sample / 8;
-        std::vector<std::byte> samples(sample_count * bytes_per_sample);
-        auto *sample_data = samples.data();
+    /** Convert one sample to an integer, clamping it */
+    static inline std::int64_t float_to_int(float sample, std::int64_t multiply_by, std::int64_t multiply_by_minus_one) noexcept {
+        std::int64_t value = sample * (sample < 0 ? multiply_by : multiply_by_minus_one);
+
+        // Clamp
+        if(value >= multiply_by_minus_one) {
+            value = multiply_by_minus_one;
+        }
+        else if(value <= -multiply_by) {
+            value = -multiply_by;
+        }
 
+        return value;
+    }
+
+    template<std::size_t new_bits_per_sample> static void convert_float_to_int_kernel(const float *pcm, std::size_t sample_count, std::byte *output) noexcept {
         // Calculate what we multiply by
-        std::int64_t multiply_by = (1 << new_bits_per_sample) / 2.0;
-        std::int64_t multiply_by_minus_one = multiply_by - 1;
-        std::int64_t multiply_by_arr[2] = { multiply_by_minus_one, multiply_by };
+        constexpr std::int64_t multiply_by = static_cast<std::int64_t>(1) << (new_bits_per_sample - 1);
+        constexpr std::int64_t multiply_by_minus_one = multiply_by - 1;
+        std::size_t i = 0;
 
-        for(std::size_t i = 0; i < sample_count; i++) {
-            std::int64_t sample = pcm[i] * multiply_by_arr[pcm[i] < 0];
+        #ifdef INVADER_SSE2
+        // 32-bit samples can't be clamped as floats (2^31 - 1 isn't a float), so those are only done one at a time
+        if constexpr(new_bits_per_sample <= 24) {
+            auto multiply_by_v = _mm_set1_ps(static_cast<float>(multiply_by));
+            auto multiply_by_minus_one_v = _mm_set1_ps(static_cast<float>(multiply_by_minus_one));
+            auto min_v = _mm_set1_ps(-static_cast<float>(multiply_by));
 
-            // Clamp
-            if(sample >= multiply_by_minus_one) {
-                sample = multiply_by_minus_one;
+            if constexpr(new_bits_per_sample == 16) {
+                for(; i + 8 <= sample_count; i += 8) {
+                    auto low = float_to_int_sse2(_mm_loadu_ps(pcm + i), multiply_by_v, multiply_by_minus_one_v, min_v);
+                    auto high = float_to_int_sse2(_mm_loadu_ps(pcm + i + 4), multiply_by_v, multiply_by_minus_one_v, min_v);
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i * 2), _mm_packs_epi32(low, high));
+                }
             }
-            else if(sample <= -multiply_by) {
-                sample = -multiply_by;
+            else {
+                for(; i + 4 <= sample_count; i += 4) {
+                    store_samples_sse2<new_bits_per_sample>(float_to_int_sse2(_mm_loadu_ps(pcm + i), multiply_by_v, multiply_by_minus_one_v, min_v), output + i * (new_bits_per_sample / 8));
+                }
             }
+        }
+        #endif
 
-            write_sample(static_cast<std::int32_t>(sample), sample_data, new_bits_per_sample);
-            sample_data += bytes_per_sample;
+        for(; i < sample_count; i++) {
+            store_sample<new_bits_per_sample>(static_cast<std::int32_t>(float_to_int(pcm[i], multiply_by, multiply_by_minus_one)), output + i * (new_bits_per_sample / 8));
+        }
+    }
+
+    void convert_float_to_int(const float *pcm, std::size_t sample_count, std::size_t new_bits_per_sample, std::byte *output) noexcept {
+        switch(new_bits_per_sample) {
+            case 8:
+                return convert_float_to_int_kernel<8>(pcm, sample_count, output);
+            case 16:
+                return convert_float_to_int_kernel<16>(pcm, sample_count, output);
+            case 24:
+                return convert_float_to_int_kernel<24>(pcm, sample_count, output);
+            case 32:
+                return convert_float_to_int_kernel<32>(pcm, sample_count, output);
         }
 
+        std::int64_t multiply_by = static_cast<std::int64_t>(1) << (new_bits_per_sample - 1);
+        std::size_t bytes_per_sample = new_bits_per_sample / 8;
+        for(std::size_t i = 0; i < sample_count; i++) {
+            write_sample(static_cast<std::int32_t>(float_to_int(pcm[i], multiply_by, multiply_by - 1)), output + i * bytes_per_sample, new_bits_per_sample);
+        }
+    }
+
+    std::vector<std::byte> convert_float_to_int(const std::vector<float> &pcm, std::size_t new_bits_per_sample) {
+        std::vector<std::byte> samples(pcm.size() * (new_bits_per_sample / 8));
+        convert_float_to_int(pcm.data(), pcm.size(), new_bits_per_sample, samples.data());
         return samples;
     }
 
+    template<std::size_t bits_per_sample> static void unpack_samples_kernel(const std::byte *pcm, std::size_t sample_count, std::int32_t *output) noexcept {
+        std::size_t i = 0;
+
+        #ifdef INVADER_SSE2
+        if constexpr(bits_per_sample == 16) {
+            for(; i + 8 <= sample_count; i += 8) {
+                auto samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pcm + i * 2));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i + 4), _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16));
+            }
+        }
+        else {
+            for(; i + 4 <= sample_count; i += 4) {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), load_samples_sse2<bits_per_sample>(pcm + i * (bits_per_sample / 8)));
+            }
+        }
+        #endif
+
+        for(; i < sample_count; i++) {
+            output[i] = load_sample<bits_per_sample>(pcm + i * (bits_per_sample / 8));
+        }
+    }
+
+    void unpack_samples(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample, std::int32_t *output) noexcept {
+        switch(bits_per_sample) {
+            case 8:
+                return unpack_samples_kernel<8>(pcm, sample_count, output);
+            case 16:
+                return unpack_samples_kernel<16>(pcm, sample_count, output);
+            case 24:
+                return unpack_samples_kernel<24>(pcm, sample_count, output);
+            case 32:
+                return unpack_samples_kernel<32>(pcm, sample_count, output);
+        }
+
+        for(std::size_t i = 0; i < sample_count; i++) {
+            output[i] = read_sample(pcm + i * (bits_per_sample / 8), bits_per_sample);
+        }
+    }
+
     void write_sample(std::int32_t sample, std::byte *pcm, std::size_t bits_per_sample) noexcept {
         std::size_t bytes_per_sample = bits_per_sample / 8;
         for(std::size_t b = 0; b < bytes_per_sample; b++) {
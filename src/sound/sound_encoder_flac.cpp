@@ -34,52 +34,73 @@ namespace Invader::SoundEncoder {
         return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
     }
 
-    std::vector<std::byte> encode_to_flac(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint32_t compression_level) {
-        // First make our buffer
-        std::vector<FLAC__int32> buffer;
-        const auto *pcm_data = pcm.data();
-        std::size_t bytes_per_sample = bits_per_sample / 8;
-        if(pcm.size() % bytes_per_sample * channel_count != 0) {
-            eprintf_error("PCM data size is not divisible by channel count * bytes per sample");
-            throw InvalidInputSoundException();
-        }
-        std::size_t pcm_size = pcm.size();
-        std::size_t sample_count = pcm_size / bytes_per_sample;
-        buffer.reserve(sample_count);
-        for(std::size_t s = 0; s < sample_count; s++) {
-            buffer.emplace_back(static_cast<FLAC__int32>(read_sample(pcm_data + bytes_per_sample * s, bits_per_sample)));
-        }
-
-        FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
-
-        // Set our FLAC holder 9000
-        FLACHolder holder = { };
+    class FLACEncoder : public StreamEncoder {
+    public:
+        FLACEncoder(std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint32_t compression_level) : bits_per_sample(bits_per_sample), channel_count(channel_count) {
+            this->encoder = FLAC__stream_encoder_new();
 
-        // Set our metadata
-        FLAC__stream_encoder_set_bits_per_sample(encoder, bits_per_sample);
-        FLAC__stream_encoder_set_channels(encoder, channel_count);
-        FLAC__stream_encoder_set_sample_rate(encoder, sample_rate);
-        FLAC__stream_encoder_set_compression_level(encoder, compression_level);
+            // Set our metadata
+            FLAC__stream_encoder_set_bits_per_sample(this->encoder, bits_per_sample);
+            FLAC__stream_encoder_set_channels(this->encoder, channel_count);
+            FLAC__stream_encoder_set_sample_rate(this->encoder, sample_rate);
+            FLAC__stream_encoder_set_compression_level(this->encoder, compression_level);
 
-        try {
-            if(FLAC__stream_encoder_init_stream(encoder, write_flac_data, seek_flac_data, tell_flac_data, NULL, &holder) != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+            if(FLAC__stream_encoder_init_stream(this->encoder, write_flac_data, seek_flac_data, tell_flac_data, NULL, &this->holder) != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+                FLAC__stream_encoder_delete(this->encoder);
                 eprintf_error("Failed to init FLAC stream");
                 throw InvalidInputSoundException();
             }
+        }
+
+        void encode(const std::byte *pcm, std::size_t size) override {
+            std::size_t bytes_per_sample = this->bits_per_sample / 8;
+            if(size % (bytes_per_sample * this->channel_count) != 0) {
+                eprintf_error("PCM data size is not divisible by channel count * bytes per sample");
+                throw InvalidInputSoundException();
+            }
+
+            // Convert to what libFLAC wants
+            std::size_t sample_count = size / bytes_per_sample;
+            this->buffer.resize(sample_count);
+            unpack_samples(pcm, sample_count, this->bits_per_sample, this->buffer.data());
 
-            if(!FLAC__stream_encoder_process_interleaved(encoder, buffer.data(), static_cast<std::size_t>(buffer.size()) / channel_count)) {
+            if(!FLAC__stream_encoder_process_interleaved(this->encoder, this->buffer.data(), sample_count / this->channel_count)) {
                 eprintf_error("Failed to encode PCM stream");
                 throw InvalidInputSoundException();
             }
+        }
 
-            FLAC__stream_encoder_finish(encoder);
-            FLAC__stream_encoder_delete(encoder);
+        std::vector<std::byte> finish() override {
+            FLAC__stream_encoder_finish(this->encoder);
+            return std::move(this->holder.flac);
         }
-        catch(std::exception &) {
-            FLAC__stream_encoder_delete(encoder);
-            throw;
+
+        ~FLACEncoder() override {
+            FLAC__stream_encoder_delete(this->encoder);
         }
 
-        return holder.flac;
+        FLACEncoder(const FLACEncoder &) = delete;
+        FLACEncoder &operator=(const FLACEncoder &) = delete;
+
+    private:
+        FLAC__StreamEncoder *encoder;
+        std::size_t bits_per_sample;
+        std::uint32_t channel_count;
+
+        // Set our FLAC holder 9000
+        FLACHolder holder = {};
+
+        /** Samples being given to libFLAC (kept around so it isn't reallocated every time) */
+        std::vector<FLAC__int32> buffer;
+    };
+
+    std::unique_ptr<StreamEncoder> create_flac_encoder(std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint32_t compression_level) {
+        return std::make_unique<FLACEncoder>(bits_per_sample, channel_count, sample_rate, compression_level);
+    }
+
+    std::vector<std::byte> encode_to_flac(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint32_t compression_level) {
+        FLACEncoder encoder(bits_per_sample, channel_count, sample_rate, compression_level);
+        encoder.encode(pcm.data(), pcm.size());
+        return encoder.finish();
     }
 }
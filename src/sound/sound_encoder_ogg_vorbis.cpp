@@ -7,153 +7,199 @@
 #include <vorbis/vorbisenc.h>
 #include <memory>
 #include <variant>
+#include <algorithm>
 #include <cstdint>
 
 namespace Invader::SoundEncoder {
-    static std::vector<std::byte> encode_to_ogg_vorbis(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::variant<float, std::uint16_t> vorbis_quality) {
-        // Begin
-        std::vector<std::byte> output_samples;
-        std::size_t bytes_per_sample_one_channel = bits_per_sample / 8;
-        std::size_t split_sample_count = pcm.size() / bytes_per_sample_one_channel;
-        std::size_t split_effective_sample_count = split_sample_count / channel_count;
-        std::vector<float> float_samples = SoundEncoder::convert_int_to_float(pcm, bytes_per_sample_one_channel * 8);
-
-        vorbis_info vi;
-        vorbis_info_init(&vi);
-        int ret;
-        
-        switch(vorbis_quality.index()) {
-            case 0:
-                if((ret = vorbis_encode_init_vbr(&vi, channel_count, sample_rate, std::get<0>(vorbis_quality)))) {
-                    eprintf_error("Failed to initialize vorbis encoder (invalid parameters given?)");
-                    vorbis_info_clear(&vi);
-                    throw SoundEncodeFailureException();
-                }
-                break;
-            case 1: {
-                int bitrate = static_cast<int>(std::get<1>(vorbis_quality)) * 1000;
-                if((ret = vorbis_encode_init(&vi, channel_count, sample_rate, bitrate, bitrate, bitrate))) {
-                    if(ret == OV_EIMPL) {
-                        eprintf_error("Failed to initialize vorbis encoder (bitrate likely too low or too high)");
-                    }
-                    else {
+    class OggVorbisEncoder : public StreamEncoder {
+    public:
+        OggVorbisEncoder(std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::variant<float, std::uint16_t> vorbis_quality) : bits_per_sample(bits_per_sample), channel_count(channel_count) {
+            vorbis_info_init(&this->vi);
+            int ret;
+
+            switch(vorbis_quality.index()) {
+                case 0:
+                    if((ret = vorbis_encode_init_vbr(&this->vi, channel_count, sample_rate, std::get<0>(vorbis_quality)))) {
                         eprintf_error("Failed to initialize vorbis encoder (invalid parameters given?)");
+                        vorbis_info_clear(&this->vi);
+                        throw SoundEncodeFailureException();
                     }
-                    vorbis_info_clear(&vi);
-                    throw SoundEncodeFailureException();
+                    break;
+                case 1: {
+                    int bitrate = static_cast<int>(std::get<1>(vorbis_quality)) * 1000;
+                    if((ret = vorbis_encode_init(&this->vi, channel_count, sample_rate, bitrate, bitrate, bitrate))) {
+                        if(ret == OV_EIMPL) {
+                            eprintf_error("Failed to initialize vorbis encoder (bitrate likely too low or too high)");
+                        }
+                        else {
+                            eprintf_error("Failed to initialize vorbis encoder (invalid parameters given?)");
+                        }
+                        vorbis_info_clear(&this->vi);
+                        throw SoundEncodeFailureException();
+                    }
+                    break;
                 }
-                break;
+                default:
+                    break;
+            }
+
+            // Set the comment
+            vorbis_comment_init(&this->vc);
+            vorbis_comment_add_tag(&this->vc, "ENCODER", full_version());
+
+            // Start making a vorbis block
+            vorbis_analysis_init(&this->vd, &this->vi);
+            vorbis_block_init(&this->vd, &this->vb);
+
+            // Ogg packet stuff
+            ogg_packet op;
+            ogg_packet op_comment;
+            ogg_packet op_code;
+            ogg_page og;
+            ogg_stream_init(&this->os, 0);
+            vorbis_analysis_headerout(&this->vd, &this->vc, &op, &op_comment, &op_code);
+            ogg_stream_packetin(&this->os, &op);
+            ogg_stream_packetin(&this->os, &op_comment);
+            ogg_stream_packetin(&this->os, &op_code);
+
+            // Do stuff until we don't do stuff anymore since we need the data on a separate page
+            while(ogg_stream_flush(&this->os, &og)) {
+                this->write_page(og);
             }
-            default:
-                ret = 0;
-                break;
         }
 
-        // Set the comment
-        vorbis_comment vc;
-        vorbis_comment_init(&vc);
-        vorbis_comment_add_tag(&vc, "ENCODER", full_version());
+        void encode(const std::byte *pcm, std::size_t size) override {
+            std::size_t frame_size = this->bits_per_sample / 8 * this->channel_count;
+            std::size_t frame_count = size / frame_size;
+
+            // Fill up what's left over from last time first
+            if(!this->pending_pcm.empty()) {
+                std::size_t pending_frame_count = this->pending_pcm.size() / frame_size;
+                std::size_t frames_to_add = std::min(frame_count, SPLIT_COUNT - pending_frame_count);
+                this->pending_pcm.insert(this->pending_pcm.end(), pcm, pcm + frames_to_add * frame_size);
+                pcm += frames_to_add * frame_size;
+                frame_count -= frames_to_add;
+                if(pending_frame_count + frames_to_add < SPLIT_COUNT) {
+                    return;
+                }
+                this->analyze(this->pending_pcm.data(), SPLIT_COUNT);
+                this->pending_pcm.clear();
+            }
 
-        // Start making a vorbis block
-        vorbis_dsp_state vd;
-        vorbis_block vb;
-        vorbis_analysis_init(&vd, &vi);
-        vorbis_block_init(&vd, &vb);
-
-        // Ogg packet stuff
-        ogg_packet op;
-        ogg_packet op_comment;
-        ogg_packet op_code;
-        ogg_page og;
-        ogg_stream_state os;
-        ogg_stream_init(&os, 0);
-        vorbis_analysis_headerout(&vd, &vc, &op, &op_comment, &op_code);
-        ogg_stream_packetin(&os, &op);
-        ogg_stream_packetin(&os, &op_comment);
-        ogg_stream_packetin(&os, &op_code);
-
-        // Do stuff until we don't do stuff anymore since we need the data on a separate page
-        while(ogg_stream_flush(&os, &og)) {
-            output_samples.insert(output_samples.end(), reinterpret_cast<std::byte *>(og.header), reinterpret_cast<std::byte *>(og.header) + og.header_len);
-            output_samples.insert(output_samples.end(), reinterpret_cast<std::byte *>(og.body), reinterpret_cast<std::byte *>(og.body) + og.body_len);
+            // Give libvorbis SPLIT_COUNT frames at a time, holding onto the rest until we have enough
+            for(; frame_count >= SPLIT_COUNT; frame_count -= SPLIT_COUNT) {
+                this->analyze(pcm, SPLIT_COUNT);
+                pcm += SPLIT_COUNT * frame_size;
+            }
+            this->pending_pcm.insert(this->pending_pcm.end(), pcm, pcm + frame_count * frame_size);
+        }
+
+        std::vector<std::byte> finish() override {
+            // Encode whatever is left, then tell libvorbis we're done by giving it 0 samples
+            std::size_t frame_count = this->pending_pcm.size() / (this->bits_per_sample / 8 * this->channel_count);
+            if(frame_count > 0) {
+                this->analyze(this->pending_pcm.data(), frame_count);
+                this->pending_pcm = {};
+            }
+            while(!this->eos) {
+                this->analyze(nullptr, 0);
+            }
+
+            this->output_samples.shrink_to_fit();
+            return std::move(this->output_samples);
         }
 
-        // Analyze data
+        ~OggVorbisEncoder() override {
+            // Clean up
+            ogg_stream_clear(&this->os);
+            vorbis_block_clear(&this->vb);
+            vorbis_dsp_clear(&this->vd);
+            vorbis_comment_clear(&this->vc);
+            vorbis_info_clear(&this->vi);
+        }
+
+        OggVorbisEncoder(const OggVorbisEncoder &) = delete;
+        OggVorbisEncoder &operator=(const OggVorbisEncoder &) = delete;
+
+    private:
+        // Make sure we don't read more than SPLIT_COUNT, since libvorbis can segfault if we read too much at once.
         static constexpr std::size_t SPLIT_COUNT = 1024;
-        std::size_t encoded_count = 0;
 
-        // Loop until we're done
+        vorbis_info vi;
+        vorbis_comment vc;
+        vorbis_dsp_state vd;
+        vorbis_block vb;
+        ogg_stream_state os;
+
+        std::size_t bits_per_sample;
+        std::uint32_t channel_count;
         bool eos = false;
-        std::size_t samples_read = 0;
-        while(!eos) {
-            // Subtract the sample count minus the number of samples read (we can and will get 0 here, too - this is intentional)
-            std::size_t sample_count_to_encode = (split_effective_sample_count - samples_read);
-            float **buffer = vorbis_analysis_buffer(&vd, sample_count_to_encode);
-
-            // Make sure we don't read more than SPLIT_COUNT, since libvorbis can segfault if we read too much at once.
-            if(sample_count_to_encode > SPLIT_COUNT) {
-                sample_count_to_encode = SPLIT_COUNT;
-            }
 
+        /** PCM data that hasn't been given to libvorbis yet (less than SPLIT_COUNT frames) */
+        std::vector<std::byte> pending_pcm;
+
+        /** Encoded data */
+        std::vector<std::byte> output_samples;
+
+        void write_page(const ogg_page &og) {
+            this->output_samples.insert(this->output_samples.end(), reinterpret_cast<std::byte *>(og.header), reinterpret_cast<std::byte *>(og.header) + og.header_len);
+            this->output_samples.insert(this->output_samples.end(), reinterpret_cast<std::byte *>(og.body), reinterpret_cast<std::byte *>(og.body) + og.body_len);
+        }
+
+        void analyze(const std::byte *pcm, std::size_t frame_count) {
             // Load each sample
-            for(std::size_t i = 0; i < sample_count_to_encode; i++) {
-                auto *sample = float_samples.data() + (i + encoded_count) * channel_count;
-                for(std::size_t c = 0; c < channel_count; c++) {
-                    buffer[c][i] = sample[c];
-                }
-            }
+            float **buffer = vorbis_analysis_buffer(&this->vd, frame_count);
+            convert_int_to_float_deinterleaved(pcm, frame_count, this->bits_per_sample, this->channel_count, buffer);
 
-            // Set how many samples we wrote
-            ret = vorbis_analysis_wrote(&vd, sample_count_to_encode);
-            if(ret) {
+            // Set how many samples we wrote (we will get 0 here at the end - this is intentional)
+            if(vorbis_analysis_wrote(&this->vd, frame_count)) {
                 eprintf_error("Failed to read samples");
-                std::exit(EXIT_FAILURE);
+                throw SoundEncodeFailureException();
             }
 
             // Encode the blocks
-            while(vorbis_analysis_blockout(&vd, &vb) == 1) {
-                vorbis_analysis(&vb, nullptr);
-                vorbis_bitrate_addblock(&vb);
-                while(vorbis_bitrate_flushpacket(&vd, &op)) {
-                    ogg_stream_packetin(&os, &op);
-                    while(!eos) {
+            ogg_packet op;
+            ogg_page og;
+            while(vorbis_analysis_blockout(&this->vd, &this->vb) == 1) {
+                vorbis_analysis(&this->vb, nullptr);
+                vorbis_bitrate_addblock(&this->vb);
+                while(vorbis_bitrate_flushpacket(&this->vd, &op)) {
+                    ogg_stream_packetin(&this->os, &op);
+                    while(!this->eos) {
                         // Write data if we have a page
-                        if(!ogg_stream_pageout(&os, &og)) {
+                        if(!ogg_stream_pageout(&this->os, &og)) {
                             break;
                         }
 
-                        output_samples.insert(output_samples.end(), reinterpret_cast<std::byte *>(og.header), reinterpret_cast<std::byte *>(og.header) + og.header_len);
-                        output_samples.insert(output_samples.end(), reinterpret_cast<std::byte *>(og.body), reinterpret_cast<std::byte *>(og.body) + og.body_len);
+                        this->write_page(og);
 
                         // End if we need to
                         if(ogg_page_eos(&og)) {
-                            eos = true;
+                            this->eos = true;
                         }
                     }
                 }
             }
-
-            // Increment
-            encoded_count += sample_count_to_encode;
-            samples_read += sample_count_to_encode;
         }
+    };
 
-        // Clean up
-        ogg_stream_clear(&os);
-        vorbis_block_clear(&vb);
-        vorbis_dsp_clear(&vd);
-        vorbis_comment_clear(&vc);
-        vorbis_info_clear(&vi);
+    std::unique_ptr<StreamEncoder> create_ogg_vorbis_vbr_encoder(std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, float vorbis_quality) {
+        return std::make_unique<OggVorbisEncoder>(bits_per_sample, channel_count, sample_rate, vorbis_quality);
+    }
 
-        output_samples.shrink_to_fit();
-        return output_samples;
+    std::unique_ptr<StreamEncoder> create_ogg_vorbis_cbr_encoder(std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint16_t vorbis_bitrate) {
+        return std::make_unique<OggVorbisEncoder>(bits_per_sample, channel_count, sample_rate, vorbis_bitrate);
     }
-    
+
     std::vector<std::byte> encode_to_ogg_vorbis_vbr(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, float vorbis_quality) {
-        return encode_to_ogg_vorbis(pcm, bits_per_sample, channel_count, sample_rate, vorbis_quality);
+        OggVorbisEncoder encoder(bits_per_sample, channel_count, sample_rate, vorbis_quality);
+        encoder.encode(pcm.data(), pcm.size());
+        return encoder.finish();
     }
     
     std::vector<std::byte> encode_to_ogg_vorbis_cbr(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint16_t vorbis_bitrate) {
-        return encode_to_ogg_vorbis(pcm, bits_per_sample, channel_count, sample_rate, vorbis_bitrate);
+        OggVorbisEncoder encoder(bits_per_sample, channel_count, sample_rate, vorbis_bitrate);
+        encoder.encode(pcm.data(), pcm.size());
+        return encoder.finish();
     }
 }
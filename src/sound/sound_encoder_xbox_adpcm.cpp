@@ -3,8 +3,13 @@
 #include <invader/sound/sound_encoder.hpp>
 #include <invader/printf.hpp>
 #include <invader/error.hpp>
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <future>
 #include <memory>
 #include <cstdint>
+#include <cstring>
 
 extern "C" {
 #include "adpcm_xq/adpcm-lib.h"
@@ -21,38 +26,43 @@ namespace Invader::SoundEncoder {
         return calculate_samples_per_block() * channel_count;
     }
     
-    // From the MEK - I have no clue how to do this
-    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count) {
-        // Set some parameters
-        std::unique_ptr<std::vector<std::byte>> pcm_16_bit_data_ptr;
-        const std::int16_t *pcm_stream;
-        std::size_t bytes_per_sample = bits_per_sample / 8;
-        std::size_t sample_count = pcm.size() / bytes_per_sample / channel_count;
-        if(bits_per_sample != 16) {
-            pcm_16_bit_data_ptr = std::make_unique<std::vector<std::byte>>(convert_int_to_int(pcm, bits_per_sample, 16));
-            bytes_per_sample = 2;
-            bits_per_sample = 16;
-            pcm_stream = reinterpret_cast<const std::int16_t *>(pcm_16_bit_data_ptr->data());
-        }
-        else {
-            pcm_stream = reinterpret_cast<const std::int16_t *>(pcm.data());
-        }
-
-        // Set our output
-        std::vector<std::byte> adpcm_stream_buffer(sample_count * bytes_per_sample);
-        std::uint8_t *adpcm_stream = reinterpret_cast<std::uint8_t *>(adpcm_stream_buffer.data());
-
-        std::size_t samples_per_block = code_chunks_count * 8;
-        std::size_t block_count = sample_count / samples_per_block;
-        std::size_t num_bytes_decoded = 0;
+    /** Number of blocks to encode with each encoder state */
+    static constexpr std::size_t SEGMENT_BLOCK_COUNT = 256;
 
+    /**
+     * Encode a segment of blocks with its own encoder state
+     * @param pcm           16-bit PCM data; this must hold one more frame than the blocks being encoded
+     * @param block_count   number of blocks to encode
+     * @param channel_count number of channels
+     * @param quality       quality to use
+     * @return              ADPCM data
+     */
+    static std::vector<std::byte> encode_segment(const std::vector<std::int16_t> &pcm, std::size_t block_count, std::size_t channel_count, XboxADPCMQuality quality) {
+        std::size_t samples_per_block = calculate_samples_per_block();
         std::size_t pcm_block_size   = calculate_adpcm_pcm_block_size(channel_count);  // number of pcm sint16 per block
         std::size_t adpcm_block_size = (code_chunks_count * 4 + 4) * channel_count;  // number of adpcm bytes per block
 
-        std::int32_t average_deltas[2];
-        void *adpcm_context = NULL;
+        // Look further ahead when picking each nibble for better quality (the cost grows exponentially)
+        int lookahead;
+        switch(quality) {
+            case XboxADPCMQuality::XBOX_ADPCM_QUALITY_FAST:
+                lookahead = 0;
+                break;
+            case XboxADPCMQuality::XBOX_ADPCM_QUALITY_NORMAL:
+                lookahead = 3;
+                break;
+            case XboxADPCMQuality::XBOX_ADPCM_QUALITY_HIGH:
+                lookahead = 5;
+                break;
+            default:
+                std::terminate();
+        }
+
+        std::vector<std::byte> adpcm(block_count * adpcm_block_size);
+        const std::int16_t *pcm_stream = pcm.data();
 
-        // calculate initial adpcm predictors using decaying average
+        // calculate initial adpcm predictors using decaying average (from the first block)
+        std::int32_t average_deltas[2];
         for (std::size_t c = 0; c < channel_count; c++) {
             average_deltas[c] = 0;
             for (std::size_t i = c + pcm_block_size - channel_count; i >= channel_count; i -= channel_count) {
@@ -60,18 +70,127 @@ namespace Invader::SoundEncoder {
             }
             average_deltas[c] /= 8;
         }
+        void *adpcm_context = adpcm_create_context(channel_count, lookahead, NOISE_SHAPING_OFF, average_deltas);
 
         // Encode!
-        adpcm_context = adpcm_create_context(channel_count, 3, 0, average_deltas);
+        auto *adpcm_stream = reinterpret_cast<std::uint8_t *>(adpcm.data());
+        std::size_t num_bytes_decoded = 0;
         for (std::size_t b = 0; b < block_count; b++) {
             adpcm_encode_block(adpcm_context, adpcm_stream, &num_bytes_decoded, pcm_stream, samples_per_block);
             adpcm_stream += adpcm_block_size;
             pcm_stream += pcm_block_size;
         }
+
         adpcm_free_context(adpcm_context);
+        return adpcm;
+    }
+
+    // From the MEK - I have no clue how to do this
+    class XboxADPCMEncoder : public StreamEncoder {
+    public:
+        XboxADPCMEncoder(std::size_t bits_per_sample, std::size_t channel_count, XboxADPCMQuality quality, ThreadPool *thread_pool) : bits_per_sample(bits_per_sample), channel_count(channel_count), quality(quality), thread_pool(thread_pool) {}
+
+        void encode(const std::byte *pcm, std::size_t size) override {
+            // Convert to 16-bit, adding it to whatever didn't fill a segment last time
+            std::size_t sample_count = size / (this->bits_per_sample / 8);
+            std::size_t offset = this->pcm_16_bit.size();
+            this->pcm_16_bit.resize(offset + sample_count);
+            auto *pcm_16_bit_data = reinterpret_cast<std::byte *>(this->pcm_16_bit.data() + offset);
+            if(this->bits_per_sample != 16) {
+                convert_int_to_int(pcm, sample_count, this->bits_per_sample, 16, pcm_16_bit_data);
+            }
+            else {
+                std::memcpy(pcm_16_bit_data, pcm, size);
+            }
+
+            this->encode_segments(false);
+        }
+
+        std::vector<std::byte> finish() override {
+            this->encode_segments(true);
+            while(!this->segments_encoding.empty()) {
+                this->collect_segment();
+            }
+            return std::move(this->adpcm_stream_buffer);
+        }
+
+        XboxADPCMEncoder(const XboxADPCMEncoder &) = delete;
+        XboxADPCMEncoder &operator=(const XboxADPCMEncoder &) = delete;
+
+    private:
+        std::size_t bits_per_sample;
+        std::size_t channel_count;
+        XboxADPCMQuality quality;
+        ThreadPool *thread_pool;
+
+        /** Samples that didn't fill a segment yet */
+        std::vector<std::int16_t> pcm_16_bit;
+
+        /** Segments being encoded, in order */
+        std::deque<std::future<std::vector<std::byte>>> segments_encoding;
+
+        /** Encoded data */
+        std::vector<std::byte> adpcm_stream_buffer;
+
+        void collect_segment() {
+            auto segment = this->segments_encoding.front().get();
+            this->segments_encoding.pop_front();
+            this->adpcm_stream_buffer.insert(this->adpcm_stream_buffer.end(), segment.begin(), segment.end());
+        }
+
+        void encode_segments(bool finishing) {
+            std::size_t pcm_block_size = calculate_adpcm_pcm_block_size(this->channel_count);
+
+            // Each block also reads the first sample of the next block, so hold onto the last block until we have that
+            // (or until there is nothing left, in which case it's just silence)
+            if(finishing) {
+                this->pcm_16_bit.resize(this->pcm_16_bit.size() + this->channel_count);
+            }
+
+            // Only the last segment can be short, so the segments are the same no matter how the PCM data was given to us
+            std::size_t offset = 0;
+            std::size_t max_segments_encoding = this->thread_pool ? std::max(this->thread_pool->get_thread_count(), static_cast<std::size_t>(1)) * 2 : 1;
+            while(true) {
+                std::size_t samples_left = this->pcm_16_bit.size() - offset;
+                if(samples_left < pcm_block_size + this->channel_count) {
+                    break;
+                }
+                std::size_t block_count = std::min((samples_left - this->channel_count) / pcm_block_size, SEGMENT_BLOCK_COUNT);
+                if(block_count < SEGMENT_BLOCK_COUNT && !finishing) {
+                    break;
+                }
+
+                std::vector<std::int16_t> segment(this->pcm_16_bit.begin() + offset, this->pcm_16_bit.begin() + offset + block_count * pcm_block_size + this->channel_count);
+                offset += block_count * pcm_block_size;
+
+                // Encode it on the thread pool if we have one, only letting a few segments wait there at a time
+                auto encode = [segment = std::move(segment), block_count, channel_count = this->channel_count, quality = this->quality]() {
+                    return encode_segment(segment, block_count, channel_count, quality);
+                };
+                if(this->thread_pool) {
+                    this->segments_encoding.emplace_back(this->thread_pool->submit(std::move(encode)));
+                    while(this->segments_encoding.size() >= max_segments_encoding) {
+                        this->collect_segment();
+                    }
+                }
+                else {
+                    auto adpcm = encode();
+                    this->adpcm_stream_buffer.insert(this->adpcm_stream_buffer.end(), adpcm.begin(), adpcm.end());
+                }
+            }
+
+            // Hold onto anything that wasn't encoded
+            this->pcm_16_bit.erase(this->pcm_16_bit.begin(), this->pcm_16_bit.begin() + offset);
+        }
+    };
+
+    std::unique_ptr<StreamEncoder> create_xbox_adpcm_encoder(std::size_t bits_per_sample, std::size_t channel_count, XboxADPCMQuality quality, ThreadPool *thread_pool) {
+        return std::make_unique<XboxADPCMEncoder>(bits_per_sample, channel_count, quality, thread_pool);
+    }
 
-        // Resize to fit the buffer
-        adpcm_stream_buffer.resize(reinterpret_cast<std::byte *>(adpcm_stream) - adpcm_stream_buffer.data());
-        return adpcm_stream_buffer;
+    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count, XboxADPCMQuality quality) {
+        XboxADPCMEncoder encoder(bits_per_sample, channel_count, quality, nullptr);
+        encoder.encode(pcm.data(), pcm.size());
+        return encoder.finish();
     }
 }
@@ -5,6 +5,8 @@
 #include <invader/sound/sound_reader.hpp>
 #include <FLAC/stream_decoder.h>
 #include <memory>
+#include <algorithm>
+#include <cstring>
 
 namespace Invader::SoundReader {
     static FLAC__StreamDecoderWriteStatus write_flac_data(const FLAC__StreamDecoder *, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data) noexcept {
@@ -156,4 +158,100 @@ namespace Invader::SoundReader {
         }
         return result;
     }
+
+    class FLACSoundStream : public SoundStream {
+    public:
+        FLACSoundStream(const char *path) {
+            this->decoder = FLAC__stream_decoder_new();
+            try {
+                if(FLAC__stream_decoder_init_file(this->decoder, path, write_flac_stream_data, on_flac_stream_metadata, on_flac_stream_error, this) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+                    eprintf_error("Failed to init FLAC stream");
+                    throw InvalidInputSoundException();
+                }
+                if(!FLAC__stream_decoder_process_until_end_of_metadata(this->decoder) || this->error || this->channel_count == 0 || this->bits_per_sample == 0) {
+                    eprintf_error("Failed to read FLAC metadata");
+                    throw InvalidInputSoundException();
+                }
+            }
+            catch(std::exception &) {
+                FLAC__stream_decoder_delete(this->decoder);
+                throw;
+            }
+        }
+
+        std::size_t read(std::byte *pcm, std::size_t frame_count) override {
+            std::size_t frame_size = this->bits_per_sample / 8 * this->channel_count;
+            std::size_t size = frame_count * frame_size;
+
+            // Decode frames until we have enough (or there is nothing left)
+            while(this->decoded.size() - this->decoded_offset < size && FLAC__stream_decoder_get_state(this->decoder) != FLAC__STREAM_DECODER_END_OF_STREAM) {
+                // Get rid of what was already read so this doesn't keep growing
+                this->decoded.erase(this->decoded.begin(), this->decoded.begin() + this->decoded_offset);
+                this->decoded_offset = 0;
+
+                if(!FLAC__stream_decoder_process_single(this->decoder) || this->error) {
+                    eprintf_error("Failed to process FLAC stream");
+                    throw InvalidInputSoundException();
+                }
+            }
+
+            std::size_t frames_read = std::min(size, this->decoded.size() - this->decoded_offset) / frame_size;
+            std::memcpy(pcm, this->decoded.data() + this->decoded_offset, frames_read * frame_size);
+            this->decoded_offset += frames_read * frame_size;
+            return frames_read;
+        }
+
+        ~FLACSoundStream() override {
+            FLAC__stream_decoder_delete(this->decoder);
+        }
+
+        FLACSoundStream(const FLACSoundStream &) = delete;
+        FLACSoundStream &operator=(const FLACSoundStream &) = delete;
+
+    private:
+        FLAC__StreamDecoder *decoder;
+
+        /** Decoded PCM data that hasn't been read yet, starting at decoded_offset */
+        std::vector<std::byte> decoded;
+        std::size_t decoded_offset = 0;
+
+        bool error = false;
+
+        static FLAC__StreamDecoderWriteStatus write_flac_stream_data(const FLAC__StreamDecoder *, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data) noexcept {
+            auto &stream = *reinterpret_cast<FLACSoundStream *>(client_data);
+            if(frame->header.bits_per_sample != stream.bits_per_sample || frame->header.channels != stream.channel_count) {
+                stream.error = true;
+                return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+            }
+            auto bytes = frame->header.bits_per_sample / 8;
+            for(std::size_t i = 0; i < frame->header.blocksize; i++) {
+                for(std::size_t c = 0; c < frame->header.channels; c++) {
+                    auto &s = buffer[c][i];
+                    for(std::size_t b = 0; b < bytes; b++) {
+                        stream.decoded.emplace_back(static_cast<std::byte>((s >> b * 8) & 0xFF));
+                    }
+                }
+            }
+            return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+        }
+
+        static void on_flac_stream_metadata(const FLAC__StreamDecoder *, const FLAC__StreamMetadata *metadata, void *client_data) noexcept {
+            if(metadata->type == FLAC__MetadataType::FLAC__METADATA_TYPE_STREAMINFO) {
+                auto &stream = *reinterpret_cast<FLACSoundStream *>(client_data);
+                auto &stream_info = metadata->data.stream_info;
+                stream.bits_per_sample = stream_info.bits_per_sample;
+                stream.input_bits_per_sample = stream_info.bits_per_sample;
+                stream.channel_count = stream_info.channels;
+                stream.sample_rate = stream_info.sample_rate;
+            }
+        }
+
+        static void on_flac_stream_error(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus, void *client_data) noexcept {
+            reinterpret_cast<FLACSoundStream *>(client_data)->error = true;
+        }
+    };
+
+    std::unique_ptr<SoundStream> open_flac_stream(const char *path) {
+        return std::make_unique<FLACSoundStream>(path);
+    }
 }
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/printf.hpp>
+#include <invader/error.hpp>
+#include <invader/sound/sound_reader.hpp>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+
+namespace Invader::SoundReader {
+    class PCMSoundStream : public SoundStream {
+    public:
+        PCMSoundStream(Sound sound) : pcm(std::move(sound.pcm)) {
+            this->sample_rate = sound.sample_rate;
+            this->channel_count = sound.channel_count;
+            this->bits_per_sample = sound.bits_per_sample;
+            this->input_bits_per_sample = sound.input_bits_per_sample == 0 ? sound.bits_per_sample : sound.input_bits_per_sample;
+            if(this->channel_count == 0 || this->bits_per_sample == 0 || this->bits_per_sample % 8 != 0) {
+                eprintf_error("Sound format is invalid");
+                throw InvalidInputSoundException();
+            }
+        }
+
+        std::size_t read(std::byte *output, std::size_t frame_count) override {
+            std::size_t frame_size = this->bits_per_sample / 8 * this->channel_count;
+            std::size_t frames_read = std::min(frame_count, (this->pcm.size() - this->offset) / frame_size);
+            std::memcpy(output, this->pcm.data() + this->offset, frames_read * frame_size);
+            this->offset += frames_read * frame_size;
+            return frames_read;
+        }
+
+    private:
+        std::vector<std::byte> pcm;
+        std::size_t offset = 0;
+    };
+
+    std::unique_ptr<SoundStream> open_pcm_stream(Sound sound) {
+        return std::make_unique<PCMSoundStream>(std::move(sound));
+    }
+
+    std::unique_ptr<SoundStream> open_sound_stream(const char *path) {
+        auto extension = std::filesystem::path(path).extension().string();
+        if(extension == ".wav") {
+            return open_wav_stream(path);
+        }
+        else if(extension == ".flac") {
+            return open_flac_stream(path);
+        }
+        else if(extension == ".ogg") {
+            return open_pcm_stream(sound_from_ogg_file(path));
+        }
+        else {
+            eprintf_error("Unknown file format for %s", path);
+            throw InvalidInputSoundException();
+        }
+    }
+}
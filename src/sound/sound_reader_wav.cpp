@@ -5,113 +5,233 @@
 #include <invader/sound/sound_reader.hpp>
 #include <invader/sound/sound_encoder.hpp>
 #include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <invader/file/file.hpp>
 #include "wav.hpp"
 
 namespace Invader::SoundReader {
     using namespace HEK;
 
-    Sound sound_from_wav(const std::byte *data, std::size_t data_length) {
-        Sound result = {};
-        std::size_t offset = 0;
-
-        #define READ_OR_BAIL(to_what) if(sizeof(to_what) > data_length - offset) { \
-            eprintf_error("Failed to read " # to_what); \
-            throw InvalidInputSoundException(); \
-        } std::memcpy(reinterpret_cast<std::uint8_t *>(&to_what), data + offset, sizeof(to_what)); offset += sizeof(to_what);
-
-        // Make sure everything is valid
-        WAVChunk wav_chunk;
-        READ_OR_BAIL(wav_chunk);
+    class WAVSoundStream : public SoundStream {
+    public:
+        /**
+         * Read a WAV file as needed
+         * @param path path to the file
+         */
+        WAVSoundStream(const char *path) {
+            this->file = std::fopen(path, "rb");
+            if(!this->file) {
+                throw FailedToOpenFileException();
+            }
 
-        if(wav_chunk.chunk_id != 0x52494646) {
-            eprintf_error("WAV chunk ID is wrong");
-            throw InvalidInputSoundException();
+            try {
+                this->read_header();
+            }
+            catch(std::exception &) {
+                std::fclose(this->file);
+                throw;
+            }
         }
-        if(wav_chunk.format != 0x57415645) {
-            eprintf_error("WAV chunk format is wrong");
-            throw InvalidInputSoundException();
+
+        /**
+         * Read WAV data that is already in memory
+         * @param data        pointer to data
+         * @param data_length data size
+         */
+        WAVSoundStream(const std::byte *data, std::size_t data_length) : data(data), data_length(data_length) {
+            this->read_header();
         }
 
-        // This is what we care about
-        WAVFmtSubchunk fmt_subchunk;
-        READ_OR_BAIL(fmt_subchunk);
+        std::size_t read(std::byte *pcm, std::size_t frame_count) override {
+            std::size_t frame_size = this->input_bits_per_sample / 8 * this->channel_count;
+            std::size_t frames_to_read = std::min(frame_count, this->data_remaining / frame_size);
+            if(frames_to_read == 0) {
+                return 0;
+            }
 
-        if(fmt_subchunk.subchunk_id != 0x666D7420) {
-            eprintf_error("First subchunk is not a fmt subchunk");
-            throw InvalidInputSoundException();
-        }
-        std::size_t fmt_subchunk_size = fmt_subchunk.subchunk_size;
-        std::size_t expected_fmt_subchunk_size = sizeof(WAVFmtSubchunk) - sizeof(WAVSubchunkHeader);
-        if(fmt_subchunk_size < expected_fmt_subchunk_size) {
-            eprintf_error("Fmt subchunk size is wrong");
-            throw InvalidInputSoundException();
-        }
+            // Integer PCM can be read directly
+            std::size_t size = frames_to_read * frame_size;
+            if(this->audio_format == 1) {
+                if(!this->read_bytes(pcm, size)) {
+                    eprintf_error("Failed to read PCM data");
+                    throw InvalidInputSoundException();
+                }
+            }
 
-        // Handle WAV files that are too big
-        std::size_t excess_data_ignored = fmt_subchunk_size - expected_fmt_subchunk_size;
-        offset += excess_data_ignored;
+            // Floating point PCM is converted to 24-bit integer PCM
+            else {
+                std::size_t sample_count = frames_to_read * this->channel_count;
+                this->float_samples.resize(sample_count);
+                if(!this->read_bytes(this->float_samples.data(), size)) {
+                    eprintf_error("Failed to read PCM data");
+                    throw InvalidInputSoundException();
+                }
+                SoundEncoder::convert_float_to_int(this->float_samples.data(), sample_count, 24, pcm);
+            }
 
-        // Make sure it's something we can handle
-        if(fmt_subchunk.audio_format != 1 && fmt_subchunk.audio_format != 3) {
-            eprintf_error("WAV data type (%u) is not integer or floating point PCM", static_cast<unsigned int>(fmt_subchunk.audio_format));
-            throw InvalidInputSoundException();
+            this->data_remaining -= size;
+            return frames_to_read;
         }
 
-        // Get the values we need from the fmt header
-        result.bits_per_sample = fmt_subchunk.bits_per_sample;
-        result.channel_count = fmt_subchunk.channel_count;
-        result.sample_rate = fmt_subchunk.sample_rate;
-        result.input_bits_per_sample = fmt_subchunk.bits_per_sample;
-        result.input_channel_count = fmt_subchunk.channel_count;
-        result.input_sample_rate = fmt_subchunk.sample_rate;
-
-        // Some more verification
-        std::uint16_t expected_align = result.channel_count * result.bits_per_sample / 8;
-        if(fmt_subchunk.block_align != expected_align) {
-            eprintf_error("WAV block align value is wrong");
-            throw InvalidInputSoundException();
+        /**
+         * Get the number of bytes of PCM data left in the file
+         * @return bytes remaining
+         */
+        std::size_t get_data_remaining() const noexcept {
+            return this->data_remaining;
         }
-        if(result.bits_per_sample == 0 || result.bits_per_sample % 8 != 0) {
-            eprintf_error("Bits per sample is zero or is not divisible by 8");
-            throw InvalidInputSoundException();
+
+        ~WAVSoundStream() override {
+            if(this->file) {
+                std::fclose(this->file);
+            }
         }
-        if(result.sample_rate == 0) {
-            eprintf_error("Sample rate is invalid");
-            throw InvalidInputSoundException();
+
+        WAVSoundStream(const WAVSoundStream &) = delete;
+        WAVSoundStream &operator=(const WAVSoundStream &) = delete;
+
+    private:
+        /** File being read, or nullptr if reading from memory */
+        std::FILE *file = nullptr;
+
+        /** Data being read if not reading from a file */
+        const std::byte *data = nullptr;
+        std::size_t data_length = 0;
+        std::size_t offset = 0;
+
+        std::uint16_t audio_format;
+        std::size_t data_remaining;
+        std::vector<float> float_samples;
+
+        bool read_bytes(void *where, std::size_t size) {
+            if(this->file) {
+                return std::fread(where, size, 1, this->file) == 1;
+            }
+            if(size > this->data_length - this->offset) {
+                return false;
+            }
+            std::memcpy(where, this->data + this->offset, size);
+            this->offset += size;
+            return true;
         }
 
-        // Search for the data subchunk
-        WAVSubchunkHeader subchunk = {};
-        while(true) {
-            READ_OR_BAIL(subchunk);
-            if(subchunk.subchunk_id == 0x64617461) {
-                break;
+        void skip_bytes(std::size_t size) {
+            if(this->file) {
+                std::fseek(this->file, size, SEEK_CUR);
             }
             else {
-                offset += subchunk.subchunk_size.read();
+                this->offset += std::min(size, this->data_length - this->offset);
             }
         }
 
-        // Convert PCM to integer
-        std::size_t data_size = subchunk.subchunk_size.read();
-        if(data_size > data_length) {
-            eprintf_error("Data is out of bounds");
-        }
+        void read_header() {
+            #define READ_OR_BAIL(to_what) if(!this->read_bytes(&to_what, sizeof(to_what))) { \
+                eprintf_error("Failed to read " # to_what); \
+                throw InvalidInputSoundException(); \
+            }
 
-        if(fmt_subchunk.audio_format == 1) {
-            result.pcm = std::vector<std::byte>(data_size);
-            std::memcpy(result.pcm.data(), data + offset, data_size);
-        }
-        else if(fmt_subchunk.audio_format == 3) {
-            std::vector<float> pcm_float(data_size / sizeof(*pcm_float.data()));
-            std::memcpy(result.pcm.data(), data + offset, data_size);
-            result.bits_per_sample = 24;
-            result.pcm = SoundEncoder::convert_float_to_int(pcm_float, 24);
-        }
-        else {
-            std::terminate();
+            // Make sure everything is valid
+            WAVChunk wav_chunk;
+            READ_OR_BAIL(wav_chunk);
+
+            if(wav_chunk.chunk_id != 0x52494646) {
+                eprintf_error("WAV chunk ID is wrong");
+                throw InvalidInputSoundException();
+            }
+            if(wav_chunk.format != 0x57415645) {
+                eprintf_error("WAV chunk format is wrong");
+                throw InvalidInputSoundException();
+            }
+
+            // This is what we care about
+            WAVFmtSubchunk fmt_subchunk;
+            READ_OR_BAIL(fmt_subchunk);
+
+            if(fmt_subchunk.subchunk_id != 0x666D7420) {
+                eprintf_error("First subchunk is not a fmt subchunk");
+                throw InvalidInputSoundException();
+            }
+            std::size_t fmt_subchunk_size = fmt_subchunk.subchunk_size;
+            std::size_t expected_fmt_subchunk_size = sizeof(WAVFmtSubchunk) - sizeof(WAVSubchunkHeader);
+            if(fmt_subchunk_size < expected_fmt_subchunk_size) {
+                eprintf_error("Fmt subchunk size is wrong");
+                throw InvalidInputSoundException();
+            }
+
+            // Handle WAV files that are too big
+            this->skip_bytes(fmt_subchunk_size - expected_fmt_subchunk_size);
+
+            // Make sure it's something we can handle
+            this->audio_format = fmt_subchunk.audio_format;
+            if(this->audio_format != 1 && this->audio_format != 3) {
+                eprintf_error("WAV data type (%u) is not integer or floating point PCM", static_cast<unsigned int>(this->audio_format));
+                throw InvalidInputSoundException();
+            }
+
+            // Get the values we need from the fmt header
+            this->input_bits_per_sample = fmt_subchunk.bits_per_sample;
+            this->bits_per_sample = this->audio_format == 3 ? 24 : this->input_bits_per_sample;
+            this->channel_count = fmt_subchunk.channel_count;
+            this->sample_rate = fmt_subchunk.sample_rate;
+
+            // Some more verification
+            std::uint16_t expected_align = this->channel_count * this->input_bits_per_sample / 8;
+            if(fmt_subchunk.block_align != expected_align) {
+                eprintf_error("WAV block align value is wrong");
+                throw InvalidInputSoundException();
+            }
+            if(this->input_bits_per_sample == 0 || this->input_bits_per_sample % 8 != 0) {
+                eprintf_error("Bits per sample is zero or is not divisible by 8");
+                throw InvalidInputSoundException();
+            }
+            if(this->audio_format == 3 && this->input_bits_per_sample != sizeof(float) * 8) {
+                eprintf_error("Floating point WAV data must be 32-bit");
+                throw InvalidInputSoundException();
+            }
+            if(this->channel_count == 0) {
+                eprintf_error("Channel count is invalid");
+                throw InvalidInputSoundException();
+            }
+            if(this->sample_rate == 0) {
+                eprintf_error("Sample rate is invalid");
+                throw InvalidInputSoundException();
+            }
+
+            // Search for the data subchunk
+            WAVSubchunkHeader subchunk = {};
+            while(true) {
+                READ_OR_BAIL(subchunk);
+                if(subchunk.subchunk_id == 0x64617461) {
+                    break;
+                }
+                else {
+                    this->skip_bytes(subchunk.subchunk_size.read());
+                }
+            }
+
+            #undef READ_OR_BAIL
+
+            this->data_remaining = subchunk.subchunk_size.read();
         }
+    };
+
+    Sound sound_from_wav(const std::byte *data, std::size_t data_length) {
+        WAVSoundStream stream(data, data_length);
+
+        Sound result = {};
+        result.sample_rate = stream.get_sample_rate();
+        result.channel_count = stream.get_channel_count();
+        result.bits_per_sample = stream.get_bits_per_sample();
+        result.input_sample_rate = result.sample_rate;
+        result.input_channel_count = result.channel_count;
+        result.input_bits_per_sample = stream.get_input_bits_per_sample();
+
+        // Read it all at once
+        std::size_t frame_count = stream.get_data_remaining() / (result.input_bits_per_sample / 8 * result.channel_count);
+        result.pcm.resize(frame_count * (result.bits_per_sample / 8 * result.channel_count));
+        stream.read(result.pcm.data(), frame_count);
 
         return result;
     }
@@ -126,4 +246,8 @@ namespace Invader::SoundReader {
             throw FailedToOpenFileException();
         }
     }
+
+    std::unique_ptr<SoundStream> open_wav_stream(const char *path) {
+        return std::make_unique<WAVSoundStream>(path);
+    }
 }
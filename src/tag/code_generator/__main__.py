@@ -7,10 +7,10 @@ import os
 from definition import make_definitions
 from parser import make_parser
 
-bitfield_cpp = 17
+bitfield_cpp = 18
 
 if len(sys.argv) < bitfield_cpp+4:
-    print("Usage: {} <definition.hpp> <parser.hpp> <parser-save-hek-data.cpp> <parser-read-hek-data.cpp> <parser-read-cache-file-data.cpp> <parser-cache-format.cpp> <parser-cache-deformat.cpp> <parser-refactor-reference.cpp> <parser-struct-value.cpp> <parser-check-broken-enums.cpp> <parser-check-invalid-references.cpp> <parser-check-invalid-ranges.cpp> <parser-normalize.cpp> <parser-read-hek-file.cpp> <bitfield.cpp> <enum.cpp> <extract-hidden> <json> [json [...]]".format(sys.argv[0]), file=sys.stderr)
+    print("Usage: {} <definition.hpp> <parser.hpp> <parser-save-hek-data.cpp> <parser-read-hek-data.cpp> <parser-read-cache-file-data.cpp> <parser-cache-format.cpp> <parser-cache-deformat.cpp> <parser-refactor-reference.cpp> <parser-struct-value.cpp> <parser-check-broken-enums.cpp> <parser-check-invalid-references.cpp> <parser-check-invalid-ranges.cpp> <parser-normalize.cpp> <parser-read-hek-file.cpp> <parser-scan-hek-dependencies.cpp> <bitfield.cpp> <enum.cpp> <extract-hidden> <json> [json [...]]".format(sys.argv[0]), file=sys.stderr)
     sys.exit(1)
 
 files = []
@@ -141,4 +141,5 @@ with open(sys.argv[2], "w") as hpp:
                                                 with open(sys.argv[14], "w") as cpp_compare:
                                                     with open(sys.argv[15], "w") as cpp_normalize:
                                                         with open(sys.argv[16], "w") as cpp_hek_file:
-                                                            make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, extract_hidden, hpp, cpp_save_hek_data, cpp_read_cache_file_data, cpp_read_hek_data, cpp_cache_format_data, cpp_cache_deformat_data, cpp_refactor_reference, cpp_struct_value, cpp_check_broken_enums, cpp_check_invalid_references, cpp_check_invalid_ranges, cpp_check_invalid_indices, cpp_compare, cpp_normalize, cpp_hek_file)
+                                                            with open(sys.argv[17], "w") as cpp_scan_hek_dependencies:
+                                                                make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, extract_hidden, hpp, cpp_save_hek_data, cpp_read_cache_file_data, cpp_read_hek_data, cpp_cache_format_data, cpp_cache_deformat_data, cpp_refactor_reference, cpp_struct_value, cpp_check_broken_enums, cpp_check_invalid_references, cpp_check_invalid_ranges, cpp_check_invalid_indices, cpp_compare, cpp_normalize, cpp_hek_file, cpp_scan_hek_dependencies)
@@ -6,6 +6,7 @@ from generate_hek_tag_data import make_cpp_save_hek_data
 from read_cache_file_data import make_parse_cache_file_data
 from read_hek_data import make_parse_hek_tag_data
 from read_hek_file import make_parse_hek_tag_file
+from scan_hek_dependencies import make_scan_hek_dependencies
 from cache_deformat_data import make_cache_deformat
 from refactor_reference import make_refactor_reference
 from parser_struct import make_parser_struct
@@ -16,7 +17,7 @@ from check_invalid_indices import make_check_invalid_indices
 from check_normalize import make_normalize
 from compare import make_compare
 
-def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, extract_hidden, hpp, cpp_save_hek_data, cpp_read_cache_file_data, cpp_read_hek_data, cpp_cache_format_data, cpp_cache_deformat_data, cpp_refactor_reference, cpp_struct_value, cpp_check_broken_enums, cpp_check_invalid_references, cpp_check_invalid_ranges, cpp_check_invalid_indices, cpp_compare, cpp_normalize, cpp_read_hek_file):
+def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, extract_hidden, hpp, cpp_save_hek_data, cpp_read_cache_file_data, cpp_read_hek_data, cpp_cache_format_data, cpp_cache_deformat_data, cpp_refactor_reference, cpp_struct_value, cpp_check_broken_enums, cpp_check_invalid_references, cpp_check_invalid_ranges, cpp_check_invalid_indices, cpp_compare, cpp_normalize, cpp_read_hek_file, cpp_scan_hek_dependencies):
     def write_for_all_cpps(what):
         cpp_save_hek_data.write(what)
         cpp_read_cache_file_data.write(what)
@@ -32,6 +33,7 @@ def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, ext
         cpp_compare.write(what)
         cpp_normalize.write(what)
         cpp_read_hek_file.write(what)
+        cpp_scan_hek_dependencies.write(what)
 
     hpp.write("// SPDX-License-Identifier: GPL-3.0-only\n\n// This file was auto-generated.\n// If you want to edit this, edit the .json definitions and rerun the generator script, instead.\n\n")
     write_for_all_cpps("// SPDX-License-Identifier: GPL-3.0-only\n\n// This file was auto-generated.\n// If you want to edit this, edit the .json definitions and rerun the generator script, instead.\n\n")
@@ -55,6 +57,8 @@ def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, ext
     cpp_cache_format_data.write("#include <invader/build/build_workload.hpp>\n")
     cpp_read_cache_file_data.write("#include <invader/file/file.hpp>\n")
     cpp_read_hek_data.write("#include <invader/file/file.hpp>\n")
+    cpp_scan_hek_dependencies.write("#include <cstring>\n")
+    cpp_scan_hek_dependencies.write("#include <invader/file/file.hpp>\n")
     cpp_save_hek_data.write("extern \"C\" std::uint32_t crc32(std::uint32_t crc, const void *buf, std::size_t size) noexcept;\n")
     write_for_all_cpps("namespace Invader::Parser {\n")
 
@@ -192,6 +196,7 @@ def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, ext
         make_parse_cache_file_data(post_cache_parse, all_bitfields, all_used_structs, struct_name, hpp, cpp_read_cache_file_data)
         make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, all_used_structs, hpp, cpp_read_hek_data)
         make_parse_hek_tag_file(struct_name, hpp, cpp_read_hek_file)
+        make_scan_hek_dependencies(struct_name, all_used_structs, hpp, cpp_scan_hek_dependencies)
         make_refactor_reference(all_used_structs, struct_name, hpp, cpp_refactor_reference)
         make_parser_struct(cpp_struct_value, all_enums, all_bitfields, all_used_structs, all_used_groups, hpp, struct_name, extract_hidden, read_only, title)
         make_check_broken_enums(all_enums, all_used_structs, struct_name, hpp, cpp_check_broken_enums)
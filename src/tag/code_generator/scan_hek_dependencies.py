@@ -0,0 +1,104 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+def make_scan_hek_dependencies(struct_name, all_used_structs, hpp, cpp_scan_hek_dependencies):
+    hpp.write("\n        /**\n")
+    hpp.write("         * Find the dependencies in HEK tag data without parsing the rest of the tag.\n")
+    hpp.write("         * @param data         Data to read from for structs, tag references, and reflexives; if data_this is nullptr, this must point to the struct\n")
+    hpp.write("         * @param data_size    Size of the buffer\n")
+    hpp.write("         * @param data_read    This will be set to the amount of data read. If data_this is null, then the initial struct will also be added\n")
+    hpp.write("         * @param dependencies Dependencies found will be added to this; if this is nullptr, the data is only checked\n")
+    hpp.write("         * @param data_this    Pointer to the struct; if this is null, then data will be used instead\n")
+    hpp.write("         */\n")
+    hpp.write("        static void scan_hek_tag_data_dependencies(const std::byte *data, std::size_t data_size, std::size_t &data_read, std::vector<Dependency> *dependencies, const std::byte *data_this = nullptr);\n")
+    hpp.write("\n        /**\n")
+    hpp.write("         * Find the dependencies in a HEK tag file without parsing the rest of the tag. Only dependencies that parse_hek_tag_file would read are returned.\n")
+    hpp.write("         * @param data      Tag file data to read from\n")
+    hpp.write("         * @param data_size Size of the tag file\n")
+    hpp.write("         * @return dependencies with a path set, in the order they appear in the tag\n")
+    hpp.write("         */\n")
+    hpp.write("        static std::vector<Dependency> scan_hek_tag_file_dependencies(const std::byte *data, std::size_t data_size);\n")
+
+    cpp_scan_hek_dependencies.write("    void {}::scan_hek_tag_data_dependencies(const std::byte *data, std::size_t data_size, std::size_t &data_read, [[maybe_unused]] std::vector<Dependency> *dependencies, const std::byte *data_this) {{\n".format(struct_name))
+    cpp_scan_hek_dependencies.write("        data_read = 0;\n")
+    cpp_scan_hek_dependencies.write("        if(data_this == nullptr) {\n")
+    cpp_scan_hek_dependencies.write("            if(sizeof(struct_big) > data_size) {\n")
+    cpp_scan_hek_dependencies.write("                eprintf_error(\"Failed to read {} base struct: %zu bytes needed > %zu bytes available\", sizeof(struct_big), data_size);\n".format(struct_name))
+    cpp_scan_hek_dependencies.write("                throw OutOfBoundsException();\n")
+    cpp_scan_hek_dependencies.write("            }\n")
+    cpp_scan_hek_dependencies.write("            data_this = data;\n")
+    cpp_scan_hek_dependencies.write("            data_size -= sizeof(struct_big);\n")
+    cpp_scan_hek_dependencies.write("            data_read += sizeof(struct_big);\n")
+    cpp_scan_hek_dependencies.write("            data += sizeof(struct_big);\n")
+    cpp_scan_hek_dependencies.write("        }\n")
+    cpp_scan_hek_dependencies.write("        [[maybe_unused]] const auto &h = *reinterpret_cast<const struct_big *>(data_this);\n")
+    for struct in all_used_structs:
+        name = struct["member_name"]
+        unread = ("cache_only" in struct and struct["cache_only"]) or ("unused" in struct and struct["unused"])
+        if struct["type"] == "TagDependency":
+            cpp_scan_hek_dependencies.write("        std::size_t h_{}_expected_length = h.{}.path_size;\n".format(name, name))
+            cpp_scan_hek_dependencies.write("        if(h_{}_expected_length > 0) {{\n".format(name))
+            cpp_scan_hek_dependencies.write("            if(h_{}_expected_length + 1 > data_size) {{\n".format(name))
+            cpp_scan_hek_dependencies.write("                eprintf_error(\"Failed to read dependency {}::{}: %zu bytes needed > %zu bytes available\", h_{}_expected_length, data_size);\n".format(struct_name, name, name))
+            cpp_scan_hek_dependencies.write("                throw OutOfBoundsException();\n")
+            cpp_scan_hek_dependencies.write("            }\n")
+            cpp_scan_hek_dependencies.write("            if(std::memchr(data, 0, h_{}_expected_length) != nullptr) {{\n".format(name))
+            cpp_scan_hek_dependencies.write("                eprintf_error(\"Failed to read dependency {}::{}: size is smaller than expected\");\n".format(struct_name, name))
+            cpp_scan_hek_dependencies.write("                throw InvalidTagDataException();\n")
+            cpp_scan_hek_dependencies.write("            }\n")
+            cpp_scan_hek_dependencies.write("            if(static_cast<char>(data[h_{}_expected_length]) != 0) {{\n".format(name))
+            cpp_scan_hek_dependencies.write("                eprintf_error(\"Failed to read dependency {}::{}: missing null terminator\");\n".format(struct_name, name))
+            cpp_scan_hek_dependencies.write("                throw InvalidTagDataException();\n")
+            cpp_scan_hek_dependencies.write("            }\n")
+            if not unread:
+                cpp_scan_hek_dependencies.write("            if(dependencies) {\n")
+                cpp_scan_hek_dependencies.write("                auto &dependency = dependencies->emplace_back();\n")
+                cpp_scan_hek_dependencies.write("                dependency.tag_class_int = h.{}.tag_class_int;\n".format(name))
+                cpp_scan_hek_dependencies.write("                dependency.path = Invader::File::remove_duplicate_slashes(std::string(reinterpret_cast<const char *>(data), h_{}_expected_length));\n".format(name))
+                cpp_scan_hek_dependencies.write("            }\n")
+            cpp_scan_hek_dependencies.write("            data_size -= h_{}_expected_length + 1;\n".format(name))
+            cpp_scan_hek_dependencies.write("            data_read += h_{}_expected_length + 1;\n".format(name))
+            cpp_scan_hek_dependencies.write("            data += h_{}_expected_length + 1;\n".format(name))
+            cpp_scan_hek_dependencies.write("        }\n")
+        elif struct["type"] == "TagReflexive":
+            cpp_scan_hek_dependencies.write("        std::size_t h_{}_count = h.{}.count;\n".format(name, name))
+            cpp_scan_hek_dependencies.write("        if(h_{}_count > 0) {{\n".format(name))
+            cpp_scan_hek_dependencies.write("            const auto *array = reinterpret_cast<const HEK::{}<HEK::BigEndian> *>(data);\n".format(struct["struct"]))
+            cpp_scan_hek_dependencies.write("            std::size_t total_size = sizeof(*array) * h_{}_count;\n".format(name))
+            cpp_scan_hek_dependencies.write("            if(total_size > data_size) {\n")
+            cpp_scan_hek_dependencies.write("                eprintf_error(\"Failed to read reflexive {}::{}: %zu bytes needed > %zu bytes available\", total_size, data_size);\n".format(struct_name, name))
+            cpp_scan_hek_dependencies.write("                throw OutOfBoundsException();\n")
+            cpp_scan_hek_dependencies.write("            }\n")
+            cpp_scan_hek_dependencies.write("            data_size -= total_size;\n")
+            cpp_scan_hek_dependencies.write("            data_read += total_size;\n")
+            cpp_scan_hek_dependencies.write("            data += total_size;\n")
+            cpp_scan_hek_dependencies.write("            for(std::size_t ref = 0; ref < h_{}_count; ref++) {{\n".format(name))
+            cpp_scan_hek_dependencies.write("                std::size_t ref_data_read = 0;\n")
+            cpp_scan_hek_dependencies.write("                {}::scan_hek_tag_data_dependencies(data, data_size, ref_data_read, {}, reinterpret_cast<const std::byte *>(array + ref));\n".format(struct["struct"], "nullptr" if unread else "dependencies"))
+            cpp_scan_hek_dependencies.write("                data += ref_data_read;\n")
+            cpp_scan_hek_dependencies.write("                data_read += ref_data_read;\n")
+            cpp_scan_hek_dependencies.write("                data_size -= ref_data_read;\n")
+            cpp_scan_hek_dependencies.write("            }\n")
+            cpp_scan_hek_dependencies.write("        }\n")
+        elif struct["type"] == "TagDataOffset":
+            cpp_scan_hek_dependencies.write("        std::size_t h_{}_size = h.{}.size;\n".format(name, name))
+            cpp_scan_hek_dependencies.write("        if(h_{}_size > data_size) {{\n".format(name))
+            cpp_scan_hek_dependencies.write("            eprintf_error(\"Failed to read tag data block {}::{}: %zu bytes needed > %zu bytes available\", h_{}_size, data_size);\n".format(struct_name, name, name))
+            cpp_scan_hek_dependencies.write("            throw OutOfBoundsException();\n")
+            cpp_scan_hek_dependencies.write("        }\n")
+            cpp_scan_hek_dependencies.write("        data_size -= h_{}_size;\n".format(name))
+            cpp_scan_hek_dependencies.write("        data_read += h_{}_size;\n".format(name))
+            cpp_scan_hek_dependencies.write("        data += h_{}_size;\n".format(name))
+    cpp_scan_hek_dependencies.write("    }\n")
+
+    cpp_scan_hek_dependencies.write("    std::vector<Dependency> {}::scan_hek_tag_file_dependencies(const std::byte *data, std::size_t data_size) {{\n".format(struct_name))
+    cpp_scan_hek_dependencies.write("        HEK::TagFileHeader::validate_header(reinterpret_cast<const HEK::TagFileHeader *>(data), data_size);\n")
+    cpp_scan_hek_dependencies.write("        std::vector<Dependency> dependencies;\n")
+    cpp_scan_hek_dependencies.write("        std::size_t data_read = 0;\n")
+    cpp_scan_hek_dependencies.write("        std::size_t expected_data_read = data_size - sizeof(HEK::TagFileHeader);\n")
+    cpp_scan_hek_dependencies.write("        scan_hek_tag_data_dependencies(data + sizeof(HEK::TagFileHeader), expected_data_read, data_read, &dependencies);\n")
+    cpp_scan_hek_dependencies.write("        if(data_read != expected_data_read) {\n")
+    cpp_scan_hek_dependencies.write("            eprintf_error(\"invalid tag file; tag data was left over\");\n")
+    cpp_scan_hek_dependencies.write("            throw InvalidTagDataException();\n")
+    cpp_scan_hek_dependencies.write("        }\n")
+    cpp_scan_hek_dependencies.write("        return dependencies;\n")
+    cpp_scan_hek_dependencies.write("    }\n")
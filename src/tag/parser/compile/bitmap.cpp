@@ -152,9 +152,11 @@ namespace Invader::Parser {
                     // Go through each mipmap and insert them deswizzled
                     for(std::size_t m = 0; m <= mipmap_count; m++) {
                         // Do it!
-                        auto deswizzled = Invader::Swizzle::swizzle(data, bits_per_pixel, width, height, true);
-                        data += deswizzled.size();
-                        bitmap->processed_pixel_data.insert(bitmap->processed_pixel_data.end(), deswizzled.begin(), deswizzled.end());
+                        std::size_t mipmap_size = width * height * bits_per_pixel / 8;
+                        std::size_t mipmap_offset = bitmap->processed_pixel_data.size();
+                        bitmap->processed_pixel_data.resize(mipmap_offset + mipmap_size);
+                        Invader::Swizzle::swizzle(data, bitmap->processed_pixel_data.data() + mipmap_offset, bits_per_pixel, width, height, true);
+                        data += mipmap_size;
                         
                         // Make sure we don't go below 1x1
                         width = std::max(width / 2, static_cast<std::size_t>(1));
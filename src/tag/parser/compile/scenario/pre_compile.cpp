@@ -11,6 +11,33 @@ namespace Invader::Parser {
     static void fix_script_data(BuildWorkload &workload, std::size_t tag_index, std::size_t struct_index, Scenario &scenario);
     static void fix_bsp_transitions(BuildWorkload &workload, std::size_t tag_index, Scenario &scenario);
     
+    std::optional<TagClassInt> script_node_tag_class(HEK::ScenarioScriptValueType type, HEK::ScenarioScriptNodeFlags flags) noexcept {
+        // Globals and script calls aren't tags
+        if((flags & HEK::ScenarioScriptNodeFlagsFlag::SCENARIO_SCRIPT_NODE_FLAGS_FLAG_IS_GLOBAL) || (flags & HEK::ScenarioScriptNodeFlagsFlag::SCENARIO_SCRIPT_NODE_FLAGS_FLAG_IS_SCRIPT_CALL)) {
+            return std::nullopt;
+        }
+
+        switch(type) {
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_SOUND:
+                return HEK::TAG_CLASS_SOUND;
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_EFFECT:
+                return HEK::TAG_CLASS_EFFECT;
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_DAMAGE:
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_DAMAGE_EFFECT:
+                return HEK::TAG_CLASS_DAMAGE_EFFECT;
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_LOOPING_SOUND:
+                return HEK::TAG_CLASS_SOUND_LOOPING;
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_ANIMATION_GRAPH:
+                return HEK::TAG_CLASS_MODEL_ANIMATIONS;
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_ACTOR_VARIANT:
+                return HEK::TAG_CLASS_ACTOR_VARIANT;
+            case HEK::SCENARIO_SCRIPT_VALUE_TYPE_OBJECT_DEFINITION:
+                return HEK::TAG_CLASS_OBJECT;
+            default:
+                return std::nullopt;
+        }
+    }
+
     void Scenario::pre_compile(BuildWorkload &workload, std::size_t tag_index, std::size_t struct_index, std::size_t) {
         merge_child_scenarios(workload, tag_index, *this);
 
@@ -159,98 +186,48 @@ namespace Invader::Parser {
         auto *nodes = reinterpret_cast<ScenarioScriptNode::struct_little *>(&table_header + 1);
         std::size_t errors = 0;
 
-        for(std::uint16_t i = 0; i < element_count; i++) {
-            // Check if we know the class
-            std::optional<TagClassInt> tag_class;
-            auto &node = nodes[i];
-
-            // Check the class type
-            switch(node.type.read()) {
-                case HEK::SCENARIO_SCRIPT_VALUE_TYPE_SOUND:
-                    tag_class = HEK::TAG_CLASS_SOUND;
-                    break;
-
-                case HEK::SCENARIO_SCRIPT_VALUE_TYPE_EFFECT:
-                    tag_class = HEK::TAG_CLASS_EFFECT;
-                    break;
-
-                case HEK::SCENARIO_SCRIPT_VALUE_TYPE_DAMAGE:
-                    tag_class = HEK::TAG_CLASS_DAMAGE_EFFECT;
-                    break;
-
-                case HEK::SCENARIO_SCRIPT_VALUE_TYPE_LOOPING_SOUND:
-                    tag_class = HEK::TAG_CLASS_SOUND_LOOPING;
-                    break;
-
-                case HEK::SCENARIO_SCRIPT_VALUE_TYPE_ANIMATION_GRAPH:
-                    tag_class = HEK::TAG_CLASS_MODEL_ANIMATIONS;
-                    break;
-
-                case HEK::SCENARIO_SCRIPT_VALUE_TYPE_ACTOR_VARIANT:
-                    tag_class = HEK::TAG_CLASS_ACTOR_VARIANT;
-                    break;
-
-                case HEK::SCENARIO_SCRIPT_VALUE_TYPE_DAMAGE_EFFECT:
-                    tag_class = HEK::TAG_CLASS_DAMAGE_EFFECT;
-                    break;
-
-                case HEK::SCENARIO_SCRIPT_VALUE_TYPE_OBJECT_DEFINITION:
-                    tag_class = HEK::TAG_CLASS_OBJECT;
-                    break;
-
-                default:
-                    continue;
+        for_each_script_tag_reference(nodes, element_count, [&](std::size_t i, ScenarioScriptNode::struct_little &node, TagClassInt tag_class) {
+            if(errors >= 5) {
+                return;
             }
 
-            if(tag_class.has_value()) {
-                // Check if we should leave it alone
-                auto flags = node.flags.read();
-                if(
-                    (flags & HEK::ScenarioScriptNodeFlagsFlag::SCENARIO_SCRIPT_NODE_FLAGS_FLAG_IS_GLOBAL) ||
-                    (flags & HEK::ScenarioScriptNodeFlagsFlag::SCENARIO_SCRIPT_NODE_FLAGS_FLAG_IS_SCRIPT_CALL)
-                ) {
-                    continue;
+            // Get the string
+            const char *string = string_data + node.string_offset.read();
+            if(string >= string_data_end) {
+                if(++errors == 5) {
+                    eprintf_error("... and more errors. Suffice it to say, the script node table needs recompiled");
                 }
-
-                // Get the string
-                const char *string = string_data + node.string_offset.read();
-                if(string >= string_data_end) {
-                    if(++errors == 5) {
-                        eprintf_error("... and more errors. Suffice it to say, the script node table needs recompiled");
-                        break;
-                    }
-                    else {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_ERROR, tag_index, "Script node #%zu has an invalid string offset", static_cast<std::size_t>(i));
-                    }
-                    continue;
+                else {
+                    REPORT_ERROR_PRINTF(workload, ERROR_TYPE_ERROR, tag_index, "Script node #%zu has an invalid string offset", i);
                 }
+                return;
+            }
 
-                // Add it to the list
-                std::size_t dependency_offset = reinterpret_cast<const std::byte *>(&node.data) - syntax_data;
-                std::size_t new_id = workload.compile_tag_recursively(string, *tag_class);
-                node.data = HEK::TagID { static_cast<std::uint32_t>(new_id) };
-                auto &dependency = script_data_struct.dependencies.emplace_back();
-                dependency.offset = dependency_offset;
-                dependency.tag_id_only = true;
-                dependency.tag_index = new_id;
+            // Add it to the list
+            std::size_t dependency_offset = reinterpret_cast<const std::byte *>(&node.data) - syntax_data;
+            std::size_t new_id = workload.compile_tag_recursively(string, tag_class);
+            node.data = HEK::TagID { static_cast<std::uint32_t>(new_id) };
+            auto &dependency = script_data_struct.dependencies.emplace_back();
+            dependency.offset = dependency_offset;
+            dependency.tag_id_only = true;
+            dependency.tag_index = new_id;
 
-                // Let's also add up a reference too. This is 110% pointless and only wastes tag data space, but it's what tool.exe does, and a Vap really wanted it.
-                bool exists = false;
-                auto &new_tag = workload.tags[new_id];
-                for(auto &r : scenario.references) {
-                    if(r.reference.tag_class_int == new_tag.tag_class_int && r.reference.path == new_tag.path) {
-                        exists = true;
-                        break;
-                    }
-                }
-                if(!exists) {
-                    auto &reference = scenario.references.emplace_back().reference;
-                    reference.tag_class_int = new_tag.tag_class_int;
-                    reference.path = new_tag.path;
-                    reference.tag_id = HEK::TagID { static_cast<std::uint32_t>(new_id) };
+            // Let's also add up a reference too. This is 110% pointless and only wastes tag data space, but it's what tool.exe does, and a Vap really wanted it.
+            bool exists = false;
+            auto &new_tag = workload.tags[new_id];
+            for(auto &r : scenario.references) {
+                if(r.reference.tag_class_int == new_tag.tag_class_int && r.reference.path == new_tag.path) {
+                    exists = true;
+                    break;
                 }
             }
-        }
+            if(!exists) {
+                auto &reference = scenario.references.emplace_back().reference;
+                reference.tag_class_int = new_tag.tag_class_int;
+                reference.path = new_tag.path;
+                reference.tag_id = HEK::TagID { static_cast<std::uint32_t>(new_id) };
+            }
+        });
 
         if(errors > 0 && errors < 5) {
             eprintf_error("The scripts need recompiled");
@@ -786,6 +786,34 @@ namespace Invader::Parser {
         #undef DO_TAG_CLASS
     }
 
+    std::vector<Dependency> ParserStruct::scan_hek_tag_file_dependencies(const std::byte *data, std::size_t data_size) {
+        const auto *header = reinterpret_cast<const HEK::TagFileHeader *>(data);
+        HEK::TagFileHeader::validate_header(header, data_size);
+
+        #define DO_TAG_CLASS(class_struct, class_int) case TagClassInt::class_int: { \
+            return Invader::Parser::class_struct::scan_hek_tag_file_dependencies(data, data_size); \
+        }
+
+        switch(header->tag_class_int) {
+            DO_BASED_ON_TAG_CLASS
+
+            case Invader::HEK::TagClassInt::TAG_CLASS_INVADER_SCENARIO:
+            case Invader::HEK::TagClassInt::TAG_CLASS_NONE:
+            case Invader::HEK::TagClassInt::TAG_CLASS_NULL:
+            case Invader::HEK::TagClassInt::TAG_CLASS_INVADER_FONT:
+            case Invader::HEK::TagClassInt::TAG_CLASS_INVADER_UI_WIDGET_DEFINITION:
+            case Invader::HEK::TagClassInt::TAG_CLASS_INVADER_UNIT_HUD_INTERFACE:
+            case Invader::HEK::TagClassInt::TAG_CLASS_INVADER_WEAPON_HUD_INTERFACE:
+            case Invader::HEK::TagClassInt::TAG_CLASS_SHADER_TRANSPARENT_GLSL:
+                break;
+        }
+
+        eprintf_error("Unknown tag class %s", tag_class_to_extension(header->tag_class_int));
+        throw InvalidTagDataException();
+
+        #undef DO_TAG_CLASS
+    }
+
     std::unique_ptr<ParserStruct> ParserStruct::generate_base_struct(TagClassInt tag_class) {
         #define DO_TAG_CLASS(class_struct, class_int) case TagClassInt::class_int: { \
             return std::unique_ptr<ParserStruct>(new class_struct()); \
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/thread/thread_pool.hpp>
+
+namespace Invader {
+    ThreadPool::ThreadPool(std::size_t thread_count) {
+        if(thread_count <= 1) {
+            return;
+        }
+        this->threads.reserve(thread_count);
+        for(std::size_t i = 0; i < thread_count; i++) {
+            this->threads.emplace_back(&ThreadPool::run_tasks, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::scoped_lock<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->task_added.notify_all();
+        for(auto &t : this->threads) {
+            t.join();
+        }
+    }
+
+    void ThreadPool::enqueue(std::function<void()> task) {
+        {
+            std::scoped_lock<std::mutex> lock(this->mutex);
+            this->tasks.emplace_back(std::move(task));
+        }
+        this->task_added.notify_one();
+    }
+
+    void ThreadPool::run_tasks() {
+        while(true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->task_added.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+
+                // Only stop once everything that was submitted is done
+                if(this->tasks.empty()) {
+                    return;
+                }
+                task = std::move(this->tasks.front());
+                this->tasks.pop_front();
+            }
+
+            // Exceptions are caught by the packaged task and given to its future
+            task();
+        }
+    }
+}